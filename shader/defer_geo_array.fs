@@ -0,0 +1,37 @@
+#version 330 core
+
+layout (location = 0) out vec4 gPosition;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gAlbedoSpec;
+
+in vec3 position;
+in vec2 texCoord;
+in vec3 normal;
+
+// defer_geo.fs 와 같지만 텍스처를 TextureArrayManager 의 array layer 에서 읽는다
+// scaleOffset 은 atlas page 안의 영역 (atlas 가 아니면 (1, 1, 0, 0))
+struct Material {
+	sampler2DArray diffuseArray;
+	int diffuseLayer;
+	vec4 diffuseScaleOffset;
+	sampler2DArray specularArray;
+	int specularLayer;
+	vec4 specularScaleOffset;
+};
+uniform Material material;
+
+vec4 SampleLayer(sampler2DArray array, int layer, vec4 scaleOffset) {
+	// 반복은 fract 로 직접 하고, mip 은 감싸기 전 uv 의 미분으로 골라서 경계에서 튀지 않게 한다
+	vec2 uv = fract(texCoord) * scaleOffset.xy + scaleOffset.zw;
+	return textureGrad(array, vec3(uv, float(layer)),
+		dFdx(texCoord) * scaleOffset.xy, dFdy(texCoord) * scaleOffset.xy);
+}
+
+void main() {
+	gPosition = vec4(position, 1.0);
+	gNormal = vec4(normalize(normal), 1.0);
+	gAlbedoSpec.rgb = SampleLayer(material.diffuseArray,
+		material.diffuseLayer, material.diffuseScaleOffset).rgb;
+	gAlbedoSpec.a = SampleLayer(material.specularArray,
+		material.specularLayer, material.specularScaleOffset).r;
+}
@@ -10,13 +10,47 @@ uniform sampler2D gAlbedoSpec;
 uniform sampler2D ssao;
 uniform int useSsao;
 
-struct Light {
-	vec3 position;
-	vec3 color;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 viewPos;
 };
-const int NR_LIGHTS = 32;
-uniform Light lights[NR_LIGHTS];
-uniform vec3 viewPos;
+
+// LightCluster (light_cluster.h) 가 채우는 froxel 별 light 목록
+// clusterLights 는 light 마다 texel 3개: (position, radius), (color, 0), (kc, kl, kq, 0)
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform vec3 clusterGridSize;
+uniform vec2 clusterScreenSize;
+uniform vec2 clusterDepthParams;
+
+// 현재 fragment 가 속한 cluster 의 (offset, count)
+uvec2 GetClusterRange(vec3 worldPos) {
+	ivec3 gridSize = ivec3(clusterGridSize);
+	float depth = -(view * vec4(worldPos, 1.0)).z;
+	int slice = int(floor(log(max(depth, 1e-4)) * clusterDepthParams.x + clusterDepthParams.y));
+	if (slice < 0 || slice >= gridSize.z)
+		return uvec2(0u);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterScreenSize * clusterGridSize.xy),
+		ivec2(0), gridSize.xy - 1);
+	return texelFetch(clusterGrid, (slice * gridSize.y + tile.y) * gridSize.x + tile.x).xy;
+}
+
+// radius 에서 0 이 되도록 감쇠 끝을 부드럽게 자른다
+vec3 GetClusterLightRadiance(int lightIndex, vec3 worldPos, out vec3 lightDir) {
+	vec4 positionRadius = texelFetch(clusterLights, lightIndex * 3);
+	vec3 color = texelFetch(clusterLights, lightIndex * 3 + 1).rgb;
+	vec3 coeff = texelFetch(clusterLights, lightIndex * 3 + 2).xyz;
+	vec3 toLight = positionRadius.xyz - worldPos;
+	float dist = length(toLight);
+	lightDir = toLight / max(dist, 1e-4);
+	float falloff = clamp(1.0 - pow(dist / positionRadius.w, 4.0), 0.0, 1.0);
+	float attenuation = falloff * falloff / (coeff.x + coeff.y * dist + coeff.z * dist * dist);
+	return color * attenuation;
+}
+
 void main() {
 	// retrieve data from G-buffer
 	vec3 fragPos = texture(gPosition, texCoord).rgb;
@@ -29,11 +63,14 @@ void main() {
 	    albedo * 0.4; // hard-coded ambient component
 	vec3 lighting = ambient; 
 	
-	vec3 viewDir = normalize(viewPos - fragPos);
-	for(int i = 0; i < NR_LIGHTS; ++i) {
-	    // diffuse
-	    vec3 lightDir = normalize(lights[i].position - fragPos);
-	    vec3 diffuse = max(dot(normal, lightDir), 0.0) * albedo * lights[i].color;
+	vec3 viewDir = normalize(viewPos.xyz - fragPos);
+	// 이 fragment 의 cluster 에 걸친 light 만 돈다
+	uvec2 clusterRange = GetClusterRange(fragPos);
+	for (uint i = 0u; i < clusterRange.y; i++) {
+		int lightIndex = int(texelFetch(clusterLightIndices, int(clusterRange.x + i)).r);
+		vec3 lightDir;
+		vec3 radiance = GetClusterLightRadiance(lightIndex, fragPos, lightDir);
+		vec3 diffuse = max(dot(normal, lightDir), 0.0) * albedo * radiance;
 		lighting += diffuse;
 	}
 	fragColor = vec4(lighting, 1.0);
@@ -4,6 +4,7 @@ in vec2 texCoord;
 in vec3 position;
 in vec3 normal;
 in vec3 tangent;
+in float tangentSign;
 
 out vec4 fragColor;
 
@@ -18,7 +19,7 @@ void main() {
     vec3 texNorm = normalize(texture(normalMap, texCoord).xyz * 2.0 - 1.0);
     vec3 N = normalize(normal);
     vec3 T = normalize(tangent);
-    vec3 B = cross(N, T);
+    vec3 B = cross(N, T) * (tangentSign < 0.0 ? -1.0 : 1.0);
     mat3 TBN = mat3(T, B, N);
     vec3 pixelNorm = normalize(TBN * texNorm);
     
@@ -6,14 +6,23 @@ in vec3 fragPos;
 
 out vec4 fragColor;
 
-uniform vec3 viewPos;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 viewPos;
+};
 
+// uniform_blocks.h 의 LightBlock 과 같은 layout
 struct Light {
-	vec3 position;
-	vec3 color;
+	vec4 position;
+	vec4 color;
+};
+const int MAX_LIGHT_COUNT = 256;
+layout (std140) uniform Lights {
+	Light lights[MAX_LIGHT_COUNT];
+	int lightCount;
 };
-const int LIGHT_COUNT = 4;
-uniform Light lights[LIGHT_COUNT];
 
 struct Material {
 	vec3 albedo;
@@ -28,6 +37,10 @@ uniform samplerCube preFilteredMap;
 uniform sampler2D brdfLookupTable;
 uniform int useIBL;
 
+// CPU 에서 bake 한 L2 spherical harmonics irradiance (irradianceMap 대신 사용)
+uniform vec3 shIrradiance[9];
+uniform int useSHIrradiance;
+
 const float PI = 3.14159265359;
 
 float DistributionGGX(vec3 normal, vec3 halfDir, float roughness) {
@@ -62,6 +75,20 @@ vec3 FresnelSchlick(float cosTheta, vec3 F0) {
 	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+vec3 EvaluateSHIrradiance(vec3 n) {
+	vec3 irradiance =
+	    shIrradiance[0] * 0.282095 +
+	    shIrradiance[1] * (0.488603 * n.y) +
+	    shIrradiance[2] * (0.488603 * n.z) +
+	    shIrradiance[3] * (0.488603 * n.x) +
+	    shIrradiance[4] * (1.092548 * n.x * n.y) +
+	    shIrradiance[5] * (1.092548 * n.y * n.z) +
+	    shIrradiance[6] * (0.315392 * (3.0 * n.z * n.z - 1.0)) +
+	    shIrradiance[7] * (1.092548 * n.x * n.z) +
+	    shIrradiance[8] * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(irradiance, vec3(0.0));
+}
+
 vec3 FresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
@@ -72,7 +99,7 @@ void main() {
 	float roughness = material.roughness;
 	float ao = material.ao;
 	vec3 fragNormal = normalize(normal);
-	vec3 viewDir = normalize(viewPos - fragPos);
+	vec3 viewDir = normalize(viewPos.xyz - fragPos);
 	float dotNV = max(dot(fragNormal, viewDir), 0.0);
 	
 	vec3 F0 = vec3(0.04);
@@ -80,14 +107,14 @@ void main() {
 	
 	// reflectance equation
 	vec3 outRadiance = vec3(0.0);
-	for (int i = 0; i < LIGHT_COUNT; i++) {
+	for (int i = 0; i < lightCount; i++) {
 	    // calculate per-light radiance
-	    vec3 lightDir = normalize(lights[i].position - fragPos);
+	    vec3 lightDir = normalize(lights[i].position.xyz - fragPos);
 	    vec3 halfDir = normalize(viewDir + lightDir);
 	
-	    float dist = length(lights[i].position - fragPos);
+	    float dist = length(lights[i].position.xyz - fragPos);
 	    float attenuation = 1.0 / (dist * dist);
-	    vec3 radiance = lights[i].color * attenuation;
+	    vec3 radiance = lights[i].color.rgb * attenuation;
 	
 	    // Cook-Torrance BRDF
 	    float ndf = DistributionGGX(fragNormal, halfDir, roughness);
@@ -113,7 +140,9 @@ void main() {
 	    vec3 kD = 1.0 - kS;
 	    kD *= 1.0 - metallic;
 	
-	    vec3 irradiance = texture(irradianceMap, fragNormal).rgb;
+	    vec3 irradiance = useSHIrradiance == 1 ?
+			EvaluateSHIrradiance(fragNormal) :
+			texture(irradianceMap, fragNormal).rgb;
 	    vec3 diffuse = irradiance * albedo;
 	
 	    vec3 R = reflect(-viewDir, fragNormal);
@@ -0,0 +1,212 @@
+#version 330 core
+
+in vec3 normal;
+in vec2 texCoord;
+in vec3 fragPos;
+flat in vec2 materialParams;
+
+out vec4 fragColor;
+
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 viewPos;
+};
+
+// uniform_blocks.h 의 LightBlock 과 같은 layout
+struct Light {
+	vec4 position;
+	vec4 color;
+};
+const int MAX_LIGHT_COUNT = 256;
+layout (std140) uniform Lights {
+	Light lights[MAX_LIGHT_COUNT];
+	int lightCount;
+};
+
+// roughness, metallic 은 instance attribute 로 들어온다
+struct Material {
+	vec3 albedo;
+	float ao;
+};
+uniform Material material; 
+
+uniform samplerCube irradianceMap;
+uniform samplerCube preFilteredMap;
+uniform sampler2D brdfLookupTable;
+uniform int useIBL;
+
+// CPU 에서 bake 한 L2 spherical harmonics irradiance (irradianceMap 대신 사용)
+uniform vec3 shIrradiance[9];
+uniform int useSHIrradiance;
+
+// LightCluster (light_cluster.h) 가 채우는 froxel 별 light 목록
+// clusterLights 는 light 마다 texel 3개: (position, radius), (color, 0), (kc, kl, kq, 0)
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform vec3 clusterGridSize;
+uniform vec2 clusterScreenSize;
+uniform vec2 clusterDepthParams;
+
+// 현재 fragment 가 속한 cluster 의 (offset, count)
+uvec2 GetClusterRange(vec3 worldPos) {
+	ivec3 gridSize = ivec3(clusterGridSize);
+	float depth = -(view * vec4(worldPos, 1.0)).z;
+	int slice = int(floor(log(max(depth, 1e-4)) * clusterDepthParams.x + clusterDepthParams.y));
+	if (slice < 0 || slice >= gridSize.z)
+		return uvec2(0u);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterScreenSize * clusterGridSize.xy),
+		ivec2(0), gridSize.xy - 1);
+	return texelFetch(clusterGrid, (slice * gridSize.y + tile.y) * gridSize.x + tile.x).xy;
+}
+
+// radius 에서 0 이 되도록 감쇠 끝을 부드럽게 자른다
+vec3 GetClusterLightRadiance(int lightIndex, vec3 worldPos, out vec3 lightDir) {
+	vec4 positionRadius = texelFetch(clusterLights, lightIndex * 3);
+	vec3 color = texelFetch(clusterLights, lightIndex * 3 + 1).rgb;
+	vec3 coeff = texelFetch(clusterLights, lightIndex * 3 + 2).xyz;
+	vec3 toLight = positionRadius.xyz - worldPos;
+	float dist = length(toLight);
+	lightDir = toLight / max(dist, 1e-4);
+	float falloff = clamp(1.0 - pow(dist / positionRadius.w, 4.0), 0.0, 1.0);
+	float attenuation = falloff * falloff / (coeff.x + coeff.y * dist + coeff.z * dist * dist);
+	return color * attenuation;
+}
+
+uniform int useClusteredLights;
+
+const float PI = 3.14159265359;
+
+float DistributionGGX(vec3 normal, vec3 halfDir, float roughness) {
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float dotNH = max(dot(normal, halfDir), 0.0);
+	float dotNH2 = dotNH * dotNH;
+	
+	float num = a2;
+	float denom = (dotNH2 * (a2 - 1.0) + 1.0);
+	return a2 / (PI * denom * denom);
+}
+
+float GeometrySchlickGGX(float dotNV, float roughness) {
+	float r = (roughness + 1.0);
+	float k = (r*r) / 8.0;
+	
+	float num = dotNV;
+	float denom = dotNV * (1.0 - k) + k;
+	return num / denom;
+}
+
+float GeometrySmith(vec3 normal, vec3 viewDir, vec3 lightDir, float roughness) {
+	float dotNV = max(dot(normal, viewDir), 0.0);
+	float dotNL = max(dot(normal, lightDir), 0.0);
+	float ggx2 = GeometrySchlickGGX(dotNV, roughness);
+	float ggx1 = GeometrySchlickGGX(dotNL, roughness);
+	return ggx1 * ggx2;
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 F0) {
+	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 EvaluateSHIrradiance(vec3 n) {
+	vec3 irradiance =
+	    shIrradiance[0] * 0.282095 +
+	    shIrradiance[1] * (0.488603 * n.y) +
+	    shIrradiance[2] * (0.488603 * n.z) +
+	    shIrradiance[3] * (0.488603 * n.x) +
+	    shIrradiance[4] * (1.092548 * n.x * n.y) +
+	    shIrradiance[5] * (1.092548 * n.y * n.z) +
+	    shIrradiance[6] * (0.315392 * (3.0 * n.z * n.z - 1.0)) +
+	    shIrradiance[7] * (1.092548 * n.x * n.z) +
+	    shIrradiance[8] * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(irradiance, vec3(0.0));
+}
+
+vec3 FresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// Cook-Torrance BRDF 로 light 하나의 기여분
+vec3 EvaluateBRDF(vec3 lightDir, vec3 radiance, vec3 fragNormal, vec3 viewDir,
+	float dotNV, vec3 F0, vec3 albedo, float roughness, float metallic) {
+	vec3 halfDir = normalize(viewDir + lightDir);
+	float ndf = DistributionGGX(fragNormal, halfDir, roughness);
+	float geometry = GeometrySmith(fragNormal, viewDir, lightDir, roughness);
+	vec3 fresnel = FresnelSchlick(max(dot(halfDir, viewDir), 0.0), F0);
+
+	vec3 kS = fresnel;
+	vec3 kD = 1.0 - kS;
+	kD *= (1.0 - metallic);
+
+	float dotNL = max(dot(fragNormal, lightDir), 0.0);
+	vec3 numerator = ndf * geometry * fresnel;
+	float denominator = 4.0 * dotNV * dotNL;
+	vec3 specular = numerator / max(denominator, 0.001);
+	return (kD * albedo / PI + specular) * radiance * dotNL;
+}
+
+void main() {
+	vec3 albedo = material.albedo;
+	float roughness = materialParams.x;
+	float metallic = materialParams.y;
+	float ao = material.ao;
+	vec3 fragNormal = normalize(normal);
+	vec3 viewDir = normalize(viewPos.xyz - fragPos);
+	float dotNV = max(dot(fragNormal, viewDir), 0.0);
+	
+	vec3 F0 = vec3(0.04);
+	F0 = mix(F0, albedo, metallic);
+	
+	// reflectance equation
+	vec3 outRadiance = vec3(0.0);
+	for (int i = 0; i < lightCount; i++) {
+	    // calculate per-light radiance
+	    vec3 lightDir = normalize(lights[i].position.xyz - fragPos);
+	    float dist = length(lights[i].position.xyz - fragPos);
+	    float attenuation = 1.0 / (dist * dist);
+	    vec3 radiance = lights[i].color.rgb * attenuation;
+	    outRadiance += EvaluateBRDF(lightDir, radiance, fragNormal, viewDir,
+	        dotNV, F0, albedo, roughness, metallic);
+	}
+	if (useClusteredLights == 1) {
+		uvec2 clusterRange = GetClusterRange(fragPos);
+		for (uint i = 0u; i < clusterRange.y; i++) {
+			int lightIndex = int(texelFetch(clusterLightIndices, int(clusterRange.x + i)).r);
+			vec3 lightDir;
+			vec3 radiance = GetClusterLightRadiance(lightIndex, fragPos, lightDir);
+			outRadiance += EvaluateBRDF(lightDir, radiance, fragNormal, viewDir,
+				dotNV, F0, albedo, roughness, metallic);
+		}
+	}
+
+	vec3 ambient = vec3(0.03) * albedo * ao;
+	if (useIBL == 1) {
+		vec3 kS = FresnelSchlickRoughness(dotNV, F0, roughness);
+	    vec3 kD = 1.0 - kS;
+	    kD *= 1.0 - metallic;
+	
+	    vec3 irradiance = useSHIrradiance == 1 ?
+			EvaluateSHIrradiance(fragNormal) :
+			texture(irradianceMap, fragNormal).rgb;
+	    vec3 diffuse = irradiance * albedo;
+	
+	    vec3 R = reflect(-viewDir, fragNormal);
+	    const float MAX_REFLECTION_LOD = 4.0;
+	    vec3 preFilteredColor = textureLod(preFilteredMap, R,
+			roughness * MAX_REFLECTION_LOD).rgb;
+	    vec2 envBrdf = texture(brdfLookupTable, vec2(dotNV, roughness)).rg;
+	    vec3 specular = preFilteredColor * (kS * envBrdf.x + envBrdf.y);
+	
+	    ambient = (kD * diffuse + specular) * ao;
+	}
+	vec3 color = ambient + outRadiance;
+	
+	// Reinhard tone mapping + gamma correction
+	color = color / (color + 1.0);
+	color = pow(color, vec3(1.0 / 2.2));
+	
+	fragColor = vec4(color, 1.0);
+}
\ No newline at end of file
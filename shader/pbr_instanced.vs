@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 4) in mat4 aModelTransform;
+layout (location = 8) in vec4 aMaterialParams;
+
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 viewPos;
+};
+
+out vec3 fragPos;
+out vec3 normal;
+out vec2 texCoord;
+flat out vec2 materialParams;
+
+void main() {
+	vec4 worldPos = aModelTransform * vec4(aPos, 1.0);
+	gl_Position = viewProjection * worldPos;
+	fragPos = worldPos.xyz;
+	normal = (transpose(inverse(aModelTransform)) * vec4(aNormal, 0.0)).xyz;
+	texCoord = aTexCoord;
+	materialParams = aMaterialParams.xy;
+}
@@ -0,0 +1,40 @@
+#version 330 core
+// PackedVertex (vertex_packing.h) 를 읽는 pbr_instanced.vs
+layout (location = 0) in vec4 aPackedPos;
+layout (location = 1) in vec2 aPackedNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 4) in mat4 aModelTransform;
+layout (location = 8) in vec4 aMaterialParams;
+
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 viewPos;
+};
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+out vec3 fragPos;
+out vec3 normal;
+out vec2 texCoord;
+flat out vec2 materialParams;
+
+vec3 DecodeOctahedral(vec2 e) {
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		vec2 signs = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+		v.xy = (1.0 - abs(v.yx)) * signs;
+	}
+	return normalize(v);
+}
+
+void main() {
+	vec3 pos = positionOffset + positionScale * aPackedPos.xyz;
+	vec4 worldPos = aModelTransform * vec4(pos, 1.0);
+	gl_Position = viewProjection * worldPos;
+	fragPos = worldPos.xyz;
+	normal = (transpose(inverse(aModelTransform)) * vec4(DecodeOctahedral(aPackedNormal), 0.0)).xyz;
+	texCoord = aTexCoord;
+	materialParams = aMaterialParams.xy;
+}
@@ -6,14 +6,23 @@ in mat3 TBN;
 
 out vec4 fragColor;
 
-uniform vec3 viewPos;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 viewPos;
+};
 
+// uniform_blocks.h 의 LightBlock 과 같은 layout
 struct Light {
-	vec3 position;
-	vec3 color;
+	vec4 position;
+	vec4 color;
+};
+const int MAX_LIGHT_COUNT = 256;
+layout (std140) uniform Lights {
+	Light lights[MAX_LIGHT_COUNT];
+	int lightCount;
 };
-const int LIGHT_COUNT = 4;
-uniform Light lights[LIGHT_COUNT];
 
 struct Material {
 	sampler2D albedo;
@@ -65,7 +74,7 @@ void main() {
     float ao = material.ao;
     vec3 fragNormal = texture(material.normal, texCoord).rgb * 2.0 - 1.0;
     fragNormal = TBN * fragNormal;
-	vec3 viewDir = normalize(viewPos - fragPos);
+	vec3 viewDir = normalize(viewPos.xyz - fragPos);
 	float dotNV = max(dot(fragNormal, viewDir), 0.0);
 	
 	vec3 F0 = vec3(0.04);
@@ -73,14 +82,14 @@ void main() {
 	
 	// reflectance equation
 	vec3 outRadiance = vec3(0.0);
-	for (int i = 0; i < LIGHT_COUNT; i++) {
+	for (int i = 0; i < lightCount; i++) {
 	    // calculate per-light radiance
-	    vec3 lightDir = normalize(lights[i].position - fragPos);
+	    vec3 lightDir = normalize(lights[i].position.xyz - fragPos);
 	    vec3 halfDir = normalize(viewDir + lightDir);
 	
-	    float dist = length(lights[i].position - fragPos);
+	    float dist = length(lights[i].position.xyz - fragPos);
 	    float attenuation = 1.0 / (dist * dist);
-	    vec3 radiance = lights[i].color * attenuation;
+	    vec3 radiance = lights[i].color.rgb * attenuation;
 	
 	    // Cook-Torrance BRDF
 	    float ndf = DistributionGGX(fragNormal, halfDir, roughness);
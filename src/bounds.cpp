@@ -0,0 +1,346 @@
+#include "bounds.h"
+#include "simd.h"
+#include <random>
+
+AABB AABB::Transform(const glm::mat4& transform) const {
+    if (!IsValid())
+        return *this;
+    // 중심은 그대로 옮기고, 반 크기는 |회전 + scale| 행렬로 옮긴다
+    auto center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+    auto extents = GetExtents();
+    glm::vec3 newExtents(0.0f);
+    for (int col = 0; col < 3; col++) {
+        for (int row = 0; row < 3; row++)
+            newExtents[row] += fabsf(transform[col][row]) * extents[col];
+    }
+    AABB result;
+    result.min = center - newExtents;
+    result.max = center + newExtents;
+    return result;
+}
+
+BoundingSphere BoundingSphere::Transform(const glm::mat4& transform) const {
+    if (!IsValid())
+        return *this;
+    float scale2 = 0.0f;
+    for (int col = 0; col < 3; col++)
+        scale2 = glm::max(scale2, glm::dot(glm::vec3(transform[col]), glm::vec3(transform[col])));
+    BoundingSphere result;
+    result.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+    result.radius = radius * sqrtf(scale2);
+    return result;
+}
+
+void ComputeBounds(const void* vertices, size_t vertexCount, size_t stride,
+    AABB& box, BoundingSphere& sphere) {
+    box = AABB();
+    sphere = BoundingSphere();
+    if (vertexCount == 0)
+        return;
+
+    auto data = (const uint8_t*)vertices;
+    for (size_t i = 0; i < vertexCount; i++)
+        box.Expand(*(const glm::vec3*)(data + i * stride));
+
+    // AABB 의 반 대각선보다 실제 vertex 까지의 최대 거리가 더 작은 경우가 대부분이다
+    sphere.center = box.GetCenter();
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < vertexCount; i++) {
+        auto offset = *(const glm::vec3*)(data + i * stride) - sphere.center;
+        radius2 = glm::max(radius2, glm::dot(offset, offset));
+    }
+    sphere.radius = sqrtf(radius2);
+}
+
+BoundingSphere MergeBoundingSphere(const BoundingSphere& a, const BoundingSphere& b) {
+    if (!a.IsValid())
+        return b;
+    if (!b.IsValid())
+        return a;
+    auto offset = b.center - a.center;
+    float dist = glm::length(offset);
+    if (dist + b.radius <= a.radius)
+        return a;
+    if (dist + a.radius <= b.radius)
+        return b;
+    BoundingSphere result;
+    result.radius = (dist + a.radius + b.radius) * 0.5f;
+    result.center = a.center + offset * ((result.radius - a.radius) / dist);
+    return result;
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4& m) {
+    // Gribb / Hartmann: clip 공간의 -w <= x, y, z <= w 를 행 벡터 조합으로 옮긴다
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0);
+    frustum.planes[1] = row(3) - row(0);
+    frustum.planes[2] = row(3) + row(1);
+    frustum.planes[3] = row(3) - row(1);
+    frustum.planes[4] = row(3) + row(2);
+    frustum.planes[5] = row(3) - row(2);
+    for (auto& plane: frustum.planes) {
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f)
+            plane = plane / length;
+    }
+    return frustum;
+}
+
+void BoundsBatch::Clear() {
+    for (auto array: { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ,
+        &m_sphereX, &m_sphereY, &m_sphereZ, &m_radius })
+        array->clear();
+}
+
+void BoundsBatch::Reserve(size_t count) {
+    for (auto array: { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ,
+        &m_sphereX, &m_sphereY, &m_sphereZ, &m_radius })
+        array->reserve(count);
+}
+
+void BoundsBatch::Add(const AABB& box, const BoundingSphere& sphere) {
+    auto center = box.GetCenter();
+    auto extents = box.GetExtents();
+    m_centerX.push_back(center.x);
+    m_centerY.push_back(center.y);
+    m_centerZ.push_back(center.z);
+    m_extentX.push_back(extents.x);
+    m_extentY.push_back(extents.y);
+    m_extentZ.push_back(extents.z);
+    m_sphereX.push_back(sphere.center.x);
+    m_sphereY.push_back(sphere.center.y);
+    m_sphereZ.push_back(sphere.center.z);
+    m_radius.push_back(sphere.radius);
+}
+
+size_t BoundsBatch::Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const {
+    size_t count = GetCount();
+    visible.resize(count);
+    size_t visibleCount = 0;
+    size_t i = 0;
+    const auto& planes = frustum.planes;
+
+    // 평면마다 sphere: dot(n, c) + w >= -r, AABB: dot(n, c) + dot(|n|, e) + w >= 0
+    // 둘 다 보수적인 검사라서 둘 다 통과해야 보이는 것으로 본다
+#if USE_AVX
+    for (; i + 8 <= count; i += 8) {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 cx = _mm256_loadu_ps(&m_centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&m_centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&m_centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&m_extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&m_extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&m_extentZ[i]);
+        __m256 sx = _mm256_loadu_ps(&m_sphereX[i]);
+        __m256 sy = _mm256_loadu_ps(&m_sphereY[i]);
+        __m256 sz = _mm256_loadu_ps(&m_sphereZ[i]);
+        __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&m_radius[i]));
+        for (auto& plane: planes) {
+            __m256 nx = _mm256_set1_ps(plane.x);
+            __m256 ny = _mm256_set1_ps(plane.y);
+            __m256 nz = _mm256_set1_ps(plane.z);
+            __m256 w = _mm256_set1_ps(plane.w);
+            __m256 sphereDist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, sx), _mm256_mul_ps(ny, sy)),
+                _mm256_add_ps(_mm256_mul_ps(nz, sz), w));
+            __m256 boxDist = _mm256_add_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                    _mm256_add_ps(_mm256_mul_ps(nz, cz), w)),
+                _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(fabsf(plane.x)), ex),
+                    _mm256_mul_ps(_mm256_set1_ps(fabsf(plane.y)), ey)),
+                    _mm256_mul_ps(_mm256_set1_ps(fabsf(plane.z)), ez)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(sphereDist, negRadius, _CMP_GE_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(boxDist, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; lane++) {
+            visible[i + lane] = (mask >> lane) & 1;
+            visibleCount += visible[i + lane];
+        }
+    }
+#endif
+#if USE_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 cx = _mm_loadu_ps(&m_centerX[i]);
+        __m128 cy = _mm_loadu_ps(&m_centerY[i]);
+        __m128 cz = _mm_loadu_ps(&m_centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&m_extentX[i]);
+        __m128 ey = _mm_loadu_ps(&m_extentY[i]);
+        __m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+        __m128 sx = _mm_loadu_ps(&m_sphereX[i]);
+        __m128 sy = _mm_loadu_ps(&m_sphereY[i]);
+        __m128 sz = _mm_loadu_ps(&m_sphereZ[i]);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_radius[i]));
+        for (auto& plane: planes) {
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            __m128 w = _mm_set1_ps(plane.w);
+            __m128 sphereDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)),
+                _mm_add_ps(_mm_mul_ps(nz, sz), w));
+            __m128 boxDist = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                    _mm_add_ps(_mm_mul_ps(nz, cz), w)),
+                _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(fabsf(plane.x)), ex),
+                    _mm_mul_ps(_mm_set1_ps(fabsf(plane.y)), ey)),
+                    _mm_mul_ps(_mm_set1_ps(fabsf(plane.z)), ez)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(sphereDist, negRadius));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(boxDist, _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++) {
+            visible[i + lane] = (mask >> lane) & 1;
+            visibleCount += visible[i + lane];
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        bool inside = true;
+        for (auto& plane: planes) {
+            float sphereDist = plane.x * m_sphereX[i] + plane.y * m_sphereY[i] + plane.z * m_sphereZ[i] + plane.w;
+            float boxDist = plane.x * m_centerX[i] + plane.y * m_centerY[i] + plane.z * m_centerZ[i] + plane.w +
+                fabsf(plane.x) * m_extentX[i] + fabsf(plane.y) * m_extentY[i] + fabsf(plane.z) * m_extentZ[i];
+            if (sphereDist < -m_radius[i] || boxDist < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+        visible[i] = inside ? 1 : 0;
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+bool RunFrustumCullTest() {
+    bool success = true;
+    auto Check = [&](bool condition, const std::string& message) {
+        if (!condition) {
+            SPDLOG_ERROR("frustum cull test failed: {}", message);
+            success = false;
+        }
+    };
+
+    std::mt19937 random(42);
+    auto Uniform = [&](float minValue, float maxValue) {
+        return std::uniform_real_distribution<float>(minValue, maxValue)(random);
+    };
+    auto RandomVec3 = [&](float minValue, float maxValue) {
+        return glm::vec3(Uniform(minValue, maxValue), Uniform(minValue, maxValue), Uniform(minValue, maxValue));
+    };
+
+    // sphere 가 AABB 를 감싸지 않는 경우도 섞어서 두 검사가 각각 결과를 가르도록 한다
+    const size_t objectCount = 4096;
+    std::vector<AABB> boxes(objectCount);
+    std::vector<BoundingSphere> spheres(objectCount);
+    for (size_t i = 0; i < objectCount; i++) {
+        auto center = RandomVec3(-20.0f, 20.0f);
+        auto halfSize = RandomVec3(0.0f, 3.0f);
+        boxes[i].Expand(center - halfSize);
+        boxes[i].Expand(center + halfSize);
+        spheres[i].center = center + RandomVec3(-1.0f, 1.0f);
+        spheres[i].radius = (i % 3 == 0) ? glm::length(halfSize) : Uniform(0.0f, 3.0f);
+    }
+
+    // 카메라 frustum 과, 정규화된 임의의 평면 6 개짜리 frustum 을 섞는다
+    std::vector<Frustum> frustums;
+    for (int i = 0; i < 32; i++) {
+        auto eye = RandomVec3(-25.0f, 25.0f);
+        auto view = glm::lookAt(eye, eye + RandomVec3(-1.0f, 1.0f) + glm::vec3(0.0f, 0.0f, 0.01f),
+            glm::vec3(0.0f, 1.0f, 0.0f));
+        auto projection = glm::perspective(glm::radians(Uniform(30.0f, 90.0f)), Uniform(0.5f, 2.0f),
+            0.1f, Uniform(10.0f, 60.0f));
+        frustums.push_back(Frustum::FromMatrix(projection * view));
+    }
+    for (int i = 0; i < 32; i++) {
+        Frustum frustum;
+        for (auto& plane: frustum.planes) {
+            auto normal = glm::normalize(RandomVec3(-1.0f, 1.0f) + glm::vec3(0.0f, 0.0f, 0.001f));
+            plane = glm::vec4(normal, Uniform(5.0f, 25.0f));
+        }
+        frustums.push_back(frustum);
+    }
+
+    // 평면까지의 거리를 double 로 따로 계산한 기준. 경계에 아주 가까우면 (margin 안) 반올림 차이로 보고 넘긴다
+    const double margin = 1e-4;
+    auto Reference = [&](const Frustum& frustum, size_t index, bool& ambiguous) {
+        auto center = boxes[index].GetCenter();
+        auto extents = boxes[index].GetExtents();
+        auto& sphere = spheres[index];
+        bool inside = true;
+        ambiguous = false;
+        for (auto& plane: frustum.planes) {
+            double sphereDist = (double)plane.x * sphere.center.x + (double)plane.y * sphere.center.y +
+                (double)plane.z * sphere.center.z + plane.w + sphere.radius;
+            double boxDist = (double)plane.x * center.x + (double)plane.y * center.y +
+                (double)plane.z * center.z + plane.w + fabs((double)plane.x) * extents.x +
+                fabs((double)plane.y) * extents.y + fabs((double)plane.z) * extents.z;
+            if (fabs(sphereDist) < margin || fabs(boxDist) < margin)
+                ambiguous = true;
+            if (sphereDist < 0.0 || boxDist < 0.0)
+                inside = false;
+        }
+        return inside;
+    };
+
+    // Cull 은 앞에서부터 AVX (8 개), SSE (4 개), scalar 순서로 처리하므로
+    // batch 크기를 8 / 4 / 1 로 잘라 넣으면 같은 object 를 각 경로로 검사할 수 있다
+    struct Path {
+        const char* name;
+        size_t batchSize;
+        bool enabled;
+    };
+    const Path paths[] = {
+        { "avx x8", 8, USE_AVX != 0 },
+        { "sse x4", 4, USE_SSE != 0 },
+        { "scalar", 1, true },
+        // 전체를 한 batch 로 넣어서 경로가 바뀌는 경계 (4095 = 8 * 511 + 4 + 3) 도 검사한다
+        { "mixed", objectCount - 1, true },
+    };
+    std::vector<uint8_t> visible;
+    BoundsBatch batch;
+    for (auto& path: paths) {
+        if (!path.enabled) {
+            SPDLOG_INFO("  {}: not compiled in", path.name);
+            continue;
+        }
+        size_t testedCount = 0;
+        size_t visibleCount = 0;
+        size_t ambiguousCount = 0;
+        size_t mismatchCount = 0;
+        for (auto& frustum: frustums) {
+            for (size_t start = 0; start + path.batchSize <= objectCount; start += path.batchSize) {
+                batch.Clear();
+                for (size_t i = start; i < start + path.batchSize; i++)
+                    batch.Add(boxes[i], spheres[i]);
+                size_t count = batch.Cull(frustum, visible);
+                size_t flagCount = 0;
+                for (size_t i = 0; i < path.batchSize; i++) {
+                    bool ambiguous = false;
+                    bool expected = Reference(frustum, start + i, ambiguous);
+                    flagCount += visible[i];
+                    testedCount++;
+                    visibleCount += expected ? 1 : 0;
+                    if (ambiguous)
+                        ambiguousCount++;
+                    else if ((visible[i] != 0) != expected)
+                        mismatchCount++;
+                }
+                Check(count == flagCount, fmt::format("{}: returned count {} != visible flags {}",
+                    path.name, count, flagCount));
+            }
+        }
+        SPDLOG_INFO("  {}: {} tests, {} visible, {} near a plane, {} mismatches",
+            path.name, testedCount, visibleCount, ambiguousCount, mismatchCount);
+        Check(mismatchCount == 0, fmt::format("{} differs from the scalar reference", path.name));
+        // 모두 보이거나 모두 안 보이면 비교가 의미 없다
+        Check(visibleCount > testedCount / 20 && visibleCount < testedCount - testedCount / 20,
+            fmt::format("{}: visible ratio {}/{} is degenerate", path.name, visibleCount, testedCount));
+    }
+
+    if (success)
+        SPDLOG_INFO("frustum cull test passed");
+    return success;
+}
@@ -0,0 +1,72 @@
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__
+
+#include "common.h"
+#include <vector>
+#include <cfloat>
+
+struct AABB {
+    glm::vec3 min { glm::vec3(FLT_MAX) };
+    glm::vec3 max { glm::vec3(-FLT_MAX) };
+
+    bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+    glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+    // BVH build 처럼 아주 많이 불리므로 inline 으로 둔다
+    void Expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void Expand(const AABB& box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    // transform 후의 8 꼭짓점을 감싸는 AABB
+    AABB Transform(const glm::mat4& transform) const;
+};
+
+struct BoundingSphere {
+    glm::vec3 center { glm::vec3(0.0f) };
+    float radius { -1.0f };
+
+    bool IsValid() const { return radius >= 0.0f; }
+    BoundingSphere Transform(const glm::mat4& transform) const;
+};
+
+// position 만 stride 간격으로 읽어서 AABB 와 그 중심 기준 bounding sphere 를 만든다
+void ComputeBounds(const void* vertices, size_t vertexCount, size_t stride,
+    AABB& box, BoundingSphere& sphere);
+// 두 sphere 를 모두 감싸는 sphere
+BoundingSphere MergeBoundingSphere(const BoundingSphere& a, const BoundingSphere& b);
+
+// 평면 6개 (left, right, bottom, top, near, far), 안쪽이 dot(xyz, p) + w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+    // viewProjection 에 model transform 까지 곱해서 넘기면 model 공간 frustum 이 된다
+    static Frustum FromMatrix(const glm::mat4& viewProjection);
+};
+
+// frustum culling 용 SoA bounds 목록
+// 한 번에 4개 (AVX 면 8개) 의 sphere / AABB 를 모든 평면에 대해 검사한다
+class BoundsBatch {
+public:
+    void Clear();
+    void Reserve(size_t count);
+    void Add(const AABB& box, const BoundingSphere& sphere);
+    size_t GetCount() const { return m_radius.size(); }
+
+    // visible[i] 에 0 / 1 을 쓰고 보이는 개수를 돌려준다
+    size_t Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+private:
+    std::vector<float> m_centerX, m_centerY, m_centerZ;
+    std::vector<float> m_extentX, m_extentY, m_extentZ;
+    std::vector<float> m_sphereX, m_sphereY, m_sphereZ;
+    std::vector<float> m_radius;
+};
+
+// 임의의 bounds / frustum 에 대해 BoundsBatch::Cull 의 AVX (8 개), SSE (4 개), scalar 경로가
+// double 로 계산한 기준과 같은 결과를 내는지 검사한다. GL context 없이 동작
+bool RunFrustumCullTest();
+
+#endif // __BOUNDS_H__
@@ -19,6 +19,20 @@ void Buffer::Bind() const {
     glBindBuffer(m_bufferType, m_buffer);
 }
 
+void Buffer::BindBase(uint32_t index) const {
+    glBindBufferBase(m_bufferType, index, m_buffer);
+}
+
+void Buffer::Update(const void* data, size_t size, size_t offset) const {
+    if (offset + size > m_stride * m_count) {
+        SPDLOG_ERROR("buffer update out of range: {} + {} > {}",
+            offset, size, m_stride * m_count);
+        return;
+    }
+    Bind();
+    glBufferSubData(m_bufferType, offset, size, data);
+}
+
 bool Buffer::Init(uint32_t bufferType, uint32_t usage,
     const void* data, size_t stride, size_t count) {
 
@@ -14,6 +14,10 @@ public:
     size_t GetStride() const { return m_stride; }
 	size_t GetCount() const { return m_count; }
     void Bind() const;
+    // GL_UNIFORM_BUFFER 등 indexed target 의 binding point 에 연결
+    void BindBase(uint32_t index) const;
+    // 기존 storage 를 유지한 채 일부 구간만 갱신
+    void Update(const void* data, size_t size, size_t offset = 0) const;
 
 private:
     Buffer() {}
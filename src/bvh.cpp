@@ -0,0 +1,533 @@
+#include "bvh.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+static float SurfaceArea(const AABB& box) {
+    if (!box.IsValid())
+        return 0.0f;
+    auto size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool Overlaps(const AABB& a, const AABB& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+        a.min.y <= b.max.y && a.max.y >= b.min.y &&
+        a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// slab 검사. 맞으면 진입 거리 (원점이 안쪽이면 0), 아니면 FLT_MAX
+static float IntersectRayAABB(const glm::vec3& origin, const glm::vec3& invDirection,
+    float maxDistance, const AABB& box) {
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (box.min[axis] - origin[axis]) * invDirection[axis];
+        float t1 = (box.max[axis] - origin[axis]) * invDirection[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tMin = glm::max(tMin, t0);
+        tMax = glm::min(tMax, t1);
+        if (tMin > tMax)
+            return FLT_MAX;
+    }
+    return tMin;
+}
+
+BvhUPtr Bvh::Create(const std::vector<AABB>& bounds, ThreadPool* threadPool) {
+    auto bvh = BvhUPtr(new Bvh());
+    if (!bvh->Build(bounds, threadPool ? threadPool : ThreadPool::GetDefault()))
+        return nullptr;
+    return std::move(bvh);
+}
+
+bool Bvh::Build(const std::vector<AABB>& bounds, ThreadPool* threadPool) {
+    if (bounds.empty()) {
+        SPDLOG_ERROR("failed to build bvh: no items");
+        return false;
+    }
+    uint32_t itemCount = (uint32_t)bounds.size();
+    std::vector<BuildItem> items(itemCount);
+    for (uint32_t i = 0; i < itemCount; i++) {
+        items[i].bounds = bounds[i];
+        items[i].centroid = bounds[i].GetCenter();
+        items[i].index = i;
+    }
+
+    // node 수는 최대 2N - 1. 자식 쌍을 atomic 으로 할당해서 subtree 를 병렬로 만든다
+    m_nodes.resize(itemCount * 2);
+    m_nodeCount = 1;
+    BuildNode(0, 0, itemCount, 0, items, threadPool);
+    m_nodes.resize(m_nodeCount);
+    m_nodes.shrink_to_fit();
+
+    m_itemIndices.resize(itemCount);
+    m_itemBounds.resize(itemCount);
+    for (uint32_t i = 0; i < itemCount; i++) {
+        m_itemIndices[i] = items[i].index;
+        m_itemBounds[i] = items[i].bounds;
+    }
+    return true;
+}
+
+void Bvh::BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth,
+    std::vector<BuildItem>& items, ThreadPool* threadPool) {
+    auto& node = m_nodes[nodeIndex];
+    node.bounds = AABB();
+    AABB centroidBounds;
+    for (uint32_t i = first; i < first + count; i++) {
+        node.bounds.Expand(items[i].bounds);
+        centroidBounds.Expand(items[i].centroid);
+    }
+    node.leftFirst = first;
+    node.count = count;
+    if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH)
+        return;
+
+    // 축마다 centroid 를 BIN_COUNT 개 구간으로 나누고 SAH 비용이 가장 작은 경계를 고른다
+    // item 을 한 번만 읽도록 세 축의 bin 을 같이 채운다
+    AABB binBounds[3][BIN_COUNT];
+    uint32_t binCounts[3][BIN_COUNT] = {};
+    auto centroidExtent = centroidBounds.max - centroidBounds.min;
+    glm::vec3 binScale(0.0f);
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroidExtent[axis] > 0.0f)
+            binScale[axis] = BIN_COUNT / centroidExtent[axis];
+    }
+    for (uint32_t i = first; i < first + count; i++) {
+        auto& item = items[i];
+        for (int axis = 0; axis < 3; axis++) {
+            int bin = glm::min((int)((item.centroid[axis] - centroidBounds.min[axis]) * binScale[axis]), BIN_COUNT - 1);
+            binCounts[axis][bin]++;
+            binBounds[axis][bin].Expand(item.bounds);
+        }
+    }
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroidExtent[axis] <= 0.0f)
+            continue;
+        // 왼쪽 / 오른쪽 누적 면적을 한 번씩 쓸어서 구한다
+        float leftArea[BIN_COUNT - 1];
+        uint32_t leftCount[BIN_COUNT - 1];
+        AABB accumulated;
+        uint32_t accumulatedCount = 0;
+        for (int bin = 0; bin < BIN_COUNT - 1; bin++) {
+            accumulated.Expand(binBounds[axis][bin]);
+            accumulatedCount += binCounts[axis][bin];
+            leftArea[bin] = SurfaceArea(accumulated);
+            leftCount[bin] = accumulatedCount;
+        }
+        accumulated = AABB();
+        accumulatedCount = 0;
+        for (int bin = BIN_COUNT - 1; bin > 0; bin--) {
+            accumulated.Expand(binBounds[axis][bin]);
+            accumulatedCount += binCounts[axis][bin];
+            if (leftCount[bin - 1] == 0 || accumulatedCount == 0)
+                continue;
+            float cost = leftArea[bin - 1] * leftCount[bin - 1] +
+                SurfaceArea(accumulated) * accumulatedCount;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = bin;
+            }
+        }
+    }
+
+    // 나눌 수 없거나 (centroid 가 모두 같음) 나누는 편이 더 비싸면 leaf 로 둔다
+    float leafCost = SurfaceArea(node.bounds) * count;
+    if (bestAxis < 0 || (bestCost >= leafCost && count <= 4 * MAX_LEAF_SIZE))
+        return;
+
+    float axisMin = centroidBounds.min[bestAxis];
+    float axisScale = binScale[bestAxis];
+    auto middle = std::partition(
+        items.begin() + first, items.begin() + first + count,
+        [&](const BuildItem& item) {
+            int bin = glm::min((int)((item.centroid[bestAxis] - axisMin) * axisScale), BIN_COUNT - 1);
+            return bin < bestSplit;
+        });
+    uint32_t leftCount = (uint32_t)(middle - items.begin()) - first;
+    if (leftCount == 0 || leftCount == count)
+        return;
+
+    uint32_t leftChild = m_nodeCount.fetch_add(2);
+    node.leftFirst = leftChild;
+    node.count = 0;
+
+    uint32_t childFirst[2] = { first, first + leftCount };
+    uint32_t childCount[2] = { leftCount, count - leftCount };
+    if (threadPool && count >= PARALLEL_BUILD_THRESHOLD) {
+        // 두 subtree 는 서로 다른 item 구간과 node 를 쓰므로 동시에 만들어도 된다
+        threadPool->ParallelFor(2, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                BuildNode(leftChild + (uint32_t)i, childFirst[i], childCount[i],
+                    depth + 1, items, threadPool);
+            }
+        });
+    }
+    else {
+        for (int i = 0; i < 2; i++) {
+            BuildNode(leftChild + i, childFirst[i], childCount[i],
+                depth + 1, items, nullptr);
+        }
+    }
+}
+
+void Bvh::Refit(const std::vector<AABB>& bounds) {
+    if (bounds.size() != m_itemBounds.size()) {
+        SPDLOG_ERROR("bvh refit item count mismatch: {} != {}", bounds.size(), m_itemBounds.size());
+        return;
+    }
+    for (size_t i = 0; i < m_itemIndices.size(); i++)
+        m_itemBounds[i] = bounds[m_itemIndices[i]];
+    // 자식은 항상 부모보다 뒤에 할당되므로 역순으로 돌면 자식이 먼저 갱신된다
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        auto& node = m_nodes[i];
+        node.bounds = AABB();
+        if (node.count > 0) {
+            for (uint32_t j = node.leftFirst; j < node.leftFirst + node.count; j++)
+                node.bounds.Expand(m_itemBounds[j]);
+        }
+        else {
+            node.bounds.Expand(m_nodes[node.leftFirst].bounds);
+            node.bounds.Expand(m_nodes[node.leftFirst + 1].bounds);
+        }
+    }
+}
+
+void Bvh::AppendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& result) const {
+    // subtree 의 item 은 m_itemIndices 에서 연속이므로 양 끝 leaf 만 찾으면 된다
+    uint32_t leftmost = nodeIndex;
+    while (m_nodes[leftmost].count == 0)
+        leftmost = m_nodes[leftmost].leftFirst;
+    uint32_t rightmost = nodeIndex;
+    while (m_nodes[rightmost].count == 0)
+        rightmost = m_nodes[rightmost].leftFirst + 1;
+    result.insert(result.end(),
+        m_itemIndices.begin() + m_nodes[leftmost].leftFirst,
+        m_itemIndices.begin() + m_nodes[rightmost].leftFirst + m_nodes[rightmost].count);
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const {
+    // planeMask 의 bit 는 아직 검사해야 하는 평면. 완전히 안쪽인 평면은 자식에서 건너뛴다
+    struct Entry {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+    Entry stack[MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0x3f };
+
+    auto classify = [&](const AABB& box, uint32_t& planeMask) {
+        auto center = box.GetCenter();
+        auto extents = box.GetExtents();
+        for (int p = 0; p < 6; p++) {
+            if (!(planeMask & (1u << p)))
+                continue;
+            auto& plane = frustum.planes[p];
+            float dist = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+            float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+            if (dist + radius < 0.0f)
+                return false;
+            if (dist - radius >= 0.0f)
+                planeMask &= ~(1u << p);
+        }
+        return true;
+    };
+
+    while (stackSize > 0) {
+        auto entry = stack[--stackSize];
+        auto& node = m_nodes[entry.node];
+        uint32_t planeMask = entry.planeMask;
+        if (!classify(node.bounds, planeMask))
+            continue;
+        if (planeMask == 0) {
+            AppendSubtree(entry.node, result);
+            continue;
+        }
+        if (node.count > 0) {
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                uint32_t itemMask = planeMask;
+                if (classify(m_itemBounds[i], itemMask))
+                    result.push_back(m_itemIndices[i]);
+            }
+            continue;
+        }
+        stack[stackSize++] = { node.leftFirst + 1, planeMask };
+        stack[stackSize++] = { node.leftFirst, planeMask };
+    }
+}
+
+void Bvh::QueryAABB(const AABB& box, std::vector<uint32_t>& result) const {
+    uint32_t stack[MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        auto& node = m_nodes[stack[--stackSize]];
+        if (!Overlaps(node.bounds, box))
+            continue;
+        if (node.count > 0) {
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                if (Overlaps(m_itemBounds[i], box))
+                    result.push_back(m_itemIndices[i]);
+            }
+            continue;
+        }
+        stack[stackSize++] = node.leftFirst + 1;
+        stack[stackSize++] = node.leftFirst;
+    }
+}
+
+int Bvh::Raycast(const Ray& ray, float maxDistance, float& hitDistance,
+    const std::function<float(uint32_t item)>& intersect) const {
+    auto invDirection = glm::vec3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    int hitItem = -1;
+    hitDistance = maxDistance;
+
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[MAX_DEPTH + 2];
+    int stackSize = 0;
+    float rootDistance = IntersectRayAABB(ray.origin, invDirection, hitDistance, m_nodes[0].bounds);
+    if (rootDistance == FLT_MAX)
+        return -1;
+    stack[stackSize++] = { 0, rootDistance };
+
+    while (stackSize > 0) {
+        auto entry = stack[--stackSize];
+        // 더 가까운 hit 를 이미 찾았으면 이 node 는 볼 필요가 없다
+        if (entry.distance > hitDistance)
+            continue;
+        auto& node = m_nodes[entry.node];
+        if (node.count > 0) {
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                uint32_t item = m_itemIndices[i];
+                float distance = IntersectRayAABB(ray.origin, invDirection, hitDistance, m_itemBounds[i]);
+                if (distance == FLT_MAX)
+                    continue;
+                if (intersect) {
+                    distance = intersect(item);
+                    if (distance < 0.0f || distance > hitDistance)
+                        continue;
+                }
+                hitDistance = distance;
+                hitItem = (int)item;
+            }
+            continue;
+        }
+
+        // 가까운 자식을 먼저 꺼내도록 먼 쪽을 먼저 넣는다
+        uint32_t near = node.leftFirst;
+        uint32_t far = node.leftFirst + 1;
+        float nearDistance = IntersectRayAABB(ray.origin, invDirection, hitDistance, m_nodes[near].bounds);
+        float farDistance = IntersectRayAABB(ray.origin, invDirection, hitDistance, m_nodes[far].bounds);
+        if (farDistance < nearDistance) {
+            std::swap(near, far);
+            std::swap(nearDistance, farDistance);
+        }
+        if (farDistance != FLT_MAX)
+            stack[stackSize++] = { far, farDistance };
+        if (nearDistance != FLT_MAX)
+            stack[stackSize++] = { near, nearDistance };
+    }
+    return hitItem;
+}
+
+// QueryFrustum 의 item 검사와 같은 기준 (6 평면 모두 완전히 바깥이 아니면 포함)
+static bool OverlapsFrustum(const Frustum& frustum, const AABB& box) {
+    auto center = box.GetCenter();
+    auto extents = box.GetExtents();
+    for (auto& plane: frustum.planes) {
+        float dist = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+        if (dist + radius < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool RunBvhBenchmark(int instanceCount, ThreadPool* threadPool) {
+    if (instanceCount <= 0) {
+        SPDLOG_ERROR("bvh benchmark: invalid instance count {}", instanceCount);
+        return false;
+    }
+    if (!threadPool)
+        threadPool = ThreadPool::GetDefault();
+
+    // 결과를 다시 만들 수 있도록 seed 를 고정한다
+    std::mt19937 random(1234);
+    auto Uniform = [&](float minValue, float maxValue) {
+        return std::uniform_real_distribution<float>(minValue, maxValue)(random);
+    };
+    auto RandomVec3 = [&](float minValue, float maxValue) {
+        return glm::vec3(Uniform(minValue, maxValue), Uniform(minValue, maxValue), Uniform(minValue, maxValue));
+    };
+
+    // instance 밀도가 개수와 상관없이 비슷하도록 장면 크기를 정한다
+    float sceneExtent = 2.0f * cbrtf((float)instanceCount);
+    std::vector<AABB> bounds(instanceCount);
+    for (auto& box: bounds) {
+        auto center = RandomVec3(-sceneExtent, sceneExtent);
+        auto halfSize = RandomVec3(0.1f, 1.0f);
+        box = AABB();
+        box.Expand(center - halfSize);
+        box.Expand(center + halfSize);
+    }
+
+    std::vector<Frustum> frustums;
+    for (int i = 0; i < 64; i++) {
+        auto eye = RandomVec3(-sceneExtent, sceneExtent);
+        auto view = glm::lookAt(eye, eye + RandomVec3(-1.0f, 1.0f) + glm::vec3(0.0f, 0.0f, 0.01f),
+            glm::vec3(0.0f, 1.0f, 0.0f));
+        auto projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, sceneExtent);
+        frustums.push_back(Frustum::FromMatrix(projection * view));
+    }
+    std::vector<AABB> queryBoxes(256);
+    for (auto& box: queryBoxes) {
+        auto center = RandomVec3(-sceneExtent, sceneExtent);
+        auto halfSize = RandomVec3(1.0f, 0.1f * sceneExtent + 1.0f);
+        box = AABB();
+        box.Expand(center - halfSize);
+        box.Expand(center + halfSize);
+    }
+    std::vector<Ray> rays(1024);
+    for (size_t i = 0; i < rays.size(); i++) {
+        rays[i].origin = RandomVec3(-sceneExtent, sceneExtent);
+        rays[i].direction = glm::normalize(RandomVec3(-1.0f, 1.0f) + glm::vec3(0.0f, 0.0f, 0.01f));
+        // 축에 나란한 ray 는 invDirection 이 무한대가 되는 경로를 검사한다
+        if (i % 16 == 0)
+            rays[i].direction = glm::vec3(0.0f, 0.0f, (i % 32 == 0) ? 1.0f : -1.0f);
+    }
+    float maxDistance = 4.0f * sceneExtent;
+
+    auto Elapsed = [](std::chrono::steady_clock::time_point startTime) {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    };
+
+    SPDLOG_INFO("bvh benchmark: {} instances, {} frustums, {} boxes, {} rays ({} threads)",
+        instanceCount, frustums.size(), queryBoxes.size(), rays.size(), threadPool->GetThreadCount() + 1);
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto bvh = Bvh::Create(bounds, threadPool);
+    float buildTime = Elapsed(startTime);
+    if (!bvh)
+        return false;
+    SPDLOG_INFO("  build: {:.2f} ms, {} nodes", buildTime, bvh->GetNodeCount());
+
+    bool success = true;
+    auto RunQueries = [&](const char* phase) {
+        std::vector<uint32_t> result;
+        std::vector<uint32_t> expected;
+
+        // query 마다 결과 순서는 다르므로 정렬해서 집합으로 비교한다
+        float bvhTime = 0.0f;
+        float bruteTime = 0.0f;
+        size_t hitCount = 0;
+        size_t mismatchCount = 0;
+        for (auto& frustum: frustums) {
+            result.clear();
+            startTime = std::chrono::steady_clock::now();
+            bvh->QueryFrustum(frustum, result);
+            bvhTime += Elapsed(startTime);
+            expected.clear();
+            startTime = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < (uint32_t)bounds.size(); i++) {
+                if (OverlapsFrustum(frustum, bounds[i]))
+                    expected.push_back(i);
+            }
+            bruteTime += Elapsed(startTime);
+            std::sort(result.begin(), result.end());
+            hitCount += expected.size();
+            if (result != expected)
+                mismatchCount++;
+        }
+        SPDLOG_INFO("  {} frustum: bvh {:.2f} ms, brute force {:.2f} ms ({:.1f}x), {:.0f} visible/query",
+            phase, bvhTime, bruteTime, bruteTime / glm::max(bvhTime, 1e-3f),
+            (float)hitCount / frustums.size());
+        if (mismatchCount > 0) {
+            SPDLOG_ERROR("bvh test failed: {} frustum queries differ from brute force ({})", mismatchCount, phase);
+            success = false;
+        }
+
+        bvhTime = bruteTime = 0.0f;
+        hitCount = mismatchCount = 0;
+        for (auto& box: queryBoxes) {
+            result.clear();
+            startTime = std::chrono::steady_clock::now();
+            bvh->QueryAABB(box, result);
+            bvhTime += Elapsed(startTime);
+            expected.clear();
+            startTime = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < (uint32_t)bounds.size(); i++) {
+                if (Overlaps(bounds[i], box))
+                    expected.push_back(i);
+            }
+            bruteTime += Elapsed(startTime);
+            std::sort(result.begin(), result.end());
+            hitCount += expected.size();
+            if (result != expected)
+                mismatchCount++;
+        }
+        SPDLOG_INFO("  {} aabb: bvh {:.2f} ms, brute force {:.2f} ms ({:.1f}x), {:.0f} overlaps/query",
+            phase, bvhTime, bruteTime, bruteTime / glm::max(bvhTime, 1e-3f),
+            (float)hitCount / queryBoxes.size());
+        if (mismatchCount > 0) {
+            SPDLOG_ERROR("bvh test failed: {} aabb queries differ from brute force ({})", mismatchCount, phase);
+            success = false;
+        }
+
+        // 거리가 같은 item 이 여럿이면 어느 쪽이든 맞으므로 hit 여부와 거리를 비교한다
+        bvhTime = bruteTime = 0.0f;
+        hitCount = mismatchCount = 0;
+        for (auto& ray: rays) {
+            float hitDistance = 0.0f;
+            startTime = std::chrono::steady_clock::now();
+            int hitItem = bvh->Raycast(ray, maxDistance, hitDistance);
+            bvhTime += Elapsed(startTime);
+            auto invDirection = glm::vec3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+            int expectedItem = -1;
+            float expectedDistance = maxDistance;
+            startTime = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < (uint32_t)bounds.size(); i++) {
+                float distance = IntersectRayAABB(ray.origin, invDirection, maxDistance, bounds[i]);
+                if (distance < expectedDistance || (expectedItem < 0 && distance != FLT_MAX)) {
+                    expectedDistance = distance;
+                    expectedItem = (int)i;
+                }
+            }
+            bruteTime += Elapsed(startTime);
+            if (expectedItem >= 0)
+                hitCount++;
+            if ((hitItem < 0) != (expectedItem < 0) || (hitItem >= 0 && hitDistance != expectedDistance))
+                mismatchCount++;
+        }
+        SPDLOG_INFO("  {} ray: bvh {:.2f} ms, brute force {:.2f} ms ({:.1f}x), {} / {} hit",
+            phase, bvhTime, bruteTime, bruteTime / glm::max(bvhTime, 1e-3f), hitCount, rays.size());
+        if (mismatchCount > 0) {
+            SPDLOG_ERROR("bvh test failed: {} rays differ from brute force ({})", mismatchCount, phase);
+            success = false;
+        }
+    };
+    RunQueries("built");
+
+    // instance 를 조금씩 움직인 뒤 Refit 한 tree 도 같은 결과를 내야 한다
+    for (auto& box: bounds) {
+        auto offset = RandomVec3(-2.0f, 2.0f);
+        box.min += offset;
+        box.max += offset;
+    }
+    startTime = std::chrono::steady_clock::now();
+    bvh->Refit(bounds);
+    SPDLOG_INFO("  refit: {:.2f} ms", Elapsed(startTime));
+    RunQueries("refit");
+
+    if (success)
+        SPDLOG_INFO("bvh test passed");
+    return success;
+}
@@ -0,0 +1,79 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "common.h"
+#include "bounds.h"
+#include "thread_pool.h"
+#include <vector>
+#include <functional>
+#include <atomic>
+
+struct Ray {
+    glm::vec3 origin { glm::vec3(0.0f) };
+    glm::vec3 direction { glm::vec3(0.0f, 0.0f, -1.0f) };
+};
+
+// scene instance 의 world AABB 위에 만드는 CPU 전용 bounding volume hierarchy
+// node 는 32 byte 로 한 배열에 모여 있고, 자식 둘은 항상 이웃한 index 에 놓인다
+// object 가 움직이면 Refit 으로 bounds 만 다시 계산하고, 분포가 크게 바뀌면 다시 Create 한다
+CLASS_PTR(Bvh)
+class Bvh {
+public:
+    // threadPool 이 nullptr 이면 ThreadPool::GetDefault() 를 쓴다
+    static BvhUPtr Create(const std::vector<AABB>& bounds, ThreadPool* threadPool = nullptr);
+
+    // item 수와 순서는 Create 때와 같아야 한다. tree 구조는 유지하고 bounds 만 갱신
+    void Refit(const std::vector<AABB>& bounds);
+
+    // frustum 과 겹칠 수 있는 item index 를 result 뒤에 붙인다
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+    // box 와 겹치는 item index 를 result 뒤에 붙인다 (shadow caster 선택 등)
+    void QueryAABB(const AABB& box, std::vector<uint32_t>& result) const;
+    // 가장 가까운 item 을 찾는다. intersect 는 item 과 ray 의 정확한 교차 거리를 돌려주고
+    // 맞지 않으면 음수를 돌려준다. nullptr 이면 item AABB 까지의 거리를 쓴다
+    int Raycast(const Ray& ray, float maxDistance, float& hitDistance,
+        const std::function<float(uint32_t item)>& intersect = nullptr) const;
+
+    size_t GetItemCount() const { return m_itemIndices.size(); }
+    size_t GetNodeCount() const { return m_nodes.size(); }
+    const AABB& GetBounds() const { return m_nodes[0].bounds; }
+
+private:
+    Bvh() {}
+    bool Build(const std::vector<AABB>& bounds, ThreadPool* threadPool);
+    // build 중에는 index 대신 bounds 까지 같이 들고 다니며 제자리에서 나눈다 (연속 접근)
+    struct BuildItem {
+        AABB bounds;
+        glm::vec3 centroid;
+        uint32_t index;
+    };
+    void BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth,
+        std::vector<BuildItem>& items, ThreadPool* threadPool);
+    void AppendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& result) const;
+
+    struct Node {
+        AABB bounds;
+        // count 가 0 이면 왼쪽 자식 node index (오른쪽은 +1), 아니면 m_itemIndices 의 시작 위치
+        uint32_t leftFirst { 0 };
+        uint32_t count { 0 };
+    };
+    static_assert(sizeof(Node) == 32, "bvh node should stay 32 bytes");
+
+    static const uint32_t MAX_LEAF_SIZE = 4;
+    static const int BIN_COUNT = 16;
+    static const uint32_t PARALLEL_BUILD_THRESHOLD = 4096;
+    // 순회 stack 이 넘치지 않도록 이보다 깊어지면 leaf 로 끝낸다
+    static const int MAX_DEPTH = 48;
+
+    std::vector<Node> m_nodes;
+    // leaf 순서로 정렬된 item index 와 그 bounds
+    std::vector<uint32_t> m_itemIndices;
+    std::vector<AABB> m_itemBounds;
+    std::atomic<uint32_t> m_nodeCount { 0 };
+};
+
+// 임의의 AABB instanceCount 개로 build / refit / query 시간을 재고
+// frustum, AABB, ray query 결과를 전수 검사와 비교한다. 모두 같으면 true
+bool RunBvhBenchmark(int instanceCount, ThreadPool* threadPool = nullptr);
+
+#endif // __BVH_H__
@@ -1,6 +1,19 @@
 #include "context.h"
 #include "image.h"
+#include "ibl_cache.h"
+#include "texture_cache.h"
+#include "profiler.h"
+#include "render_state.h"
 #include <imgui.h>
+#include <chrono>
+#include <filesystem>
+
+// IBL 전처리 텍스처 크기
+static const int HDR_CUBE_MAP_SIZE = 512;
+static const int DIFFUSE_IRRADIANCE_SIZE = 64;
+static const int PRE_FILTERED_SIZE = 128;
+static const int PRE_FILTERED_MIP_LEVELS = 5;
+static const int BRDF_LOOKUP_SIZE = 512;
 
 ContextUPtr Context::Create() {
     auto context = ContextUPtr(new Context());
@@ -35,7 +48,44 @@ void Context::ProcessInput(GLFWwindow* window) {
 void Context::Reshape(int width, int height) {
     m_width = width;
     m_height = height;
-    glViewport(0, 0, m_width, m_height);
+    RenderState::Get()->Viewport(0, 0, m_width, m_height);
+}
+
+void Context::SetCamera(const glm::vec3& position, float yaw, float pitch) {
+	m_cameraPos = position;
+	m_cameraYaw = yaw;
+	m_cameraPitch = pitch;
+}
+
+void Context::PickInstance(double x, double y) {
+	// 마지막으로 그린 frame 의 view projection 으로 cursor 위치의 ray 를 만든다
+	auto ndc = glm::vec2(
+		2.0f * (float)x / (float)m_width - 1.0f,
+		1.0f - 2.0f * (float)y / (float)m_height);
+	auto inverseViewProjection = glm::inverse(m_viewProjection);
+	auto nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+	auto farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	auto rayEnd = glm::vec3(farPoint) / farPoint.w;
+	float maxDistance = glm::length(rayEnd - ray.origin);
+	ray.direction = (rayEnd - ray.origin) / maxDistance;
+
+	// AABB 를 통과한 instance 는 실제 sphere 와 교차 검사
+	float hitDistance = 0.0f;
+	m_pickedInstance = m_sceneBvh->Raycast(ray, maxDistance, hitDistance, [&](uint32_t item) {
+		auto sphere = m_sphere->GetBoundingSphere().Transform(m_sphereInstances[item].modelTransform);
+		auto offset = ray.origin - sphere.center;
+		float b = glm::dot(offset, ray.direction);
+		float c = glm::dot(offset, offset) - sphere.radius * sphere.radius;
+		float discriminant = b * b - c;
+		if (discriminant < 0.0f)
+			return -1.0f;
+		float t = -b - sqrtf(discriminant);
+		return t >= 0.0f ? t : -b + sqrtf(discriminant);
+	});
+	if (m_pickedInstance >= 0)
+		SPDLOG_INFO("picked instance {} at distance {:.2f}", m_pickedInstance, hitDistance);
 }
 
 void Context::MouseMove(double x, double y) {
@@ -58,6 +108,9 @@ void Context::MouseMove(double x, double y) {
 }
 
 void Context::MouseButton(int button, int action, double x, double y) {
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS &&
+		!ImGui::GetIO().WantCaptureMouse)
+		PickInstance(x, y);
 	if (button == GLFW_MOUSE_BUTTON_RIGHT) {
 	    if (action == GLFW_PRESS) {
 			// 마우스 조작 시작 시점에 현재 마우스 커서 위치 저장
@@ -78,11 +131,45 @@ bool Context::Init() {
 	
 	m_box = Mesh::CreateBox();
 	m_plane = Mesh::CreatePlane();
-	m_sphere = Mesh::CreateSphere();
+	// sphere grid 는 static geometry 라 packed vertex 로 bandwidth 를 줄인다
+	m_sphere = Mesh::CreateSphere(16, 32, VertexFormat::Packed);
 
+	// 7x7 sphere grid 를 instance buffer 하나로 그린다
+	auto& sphereInstances = m_sphereInstances;
+	const int sphereCount = 7;
+	const float offset = 1.2f;
+	for (int j = 0; j < sphereCount; j++) {
+	    float y = ((float)j - (float)(sphereCount - 1) * 0.5f) * offset;
+	    for (int i = 0; i < sphereCount; i++) {
+			float x = ((float)i - (float)(sphereCount - 1) * 0.5f) * offset;
+			InstanceData instance;
+			instance.modelTransform =
+				glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+			instance.materialParams = glm::vec4(
+				(float)(i + 1) / (float)sphereCount,
+				(float)(j + 1) / (float)sphereCount, 0.0f, 0.0f);
+			sphereInstances.push_back(instance);
+		}
+	}
+	m_sphereInstanceCount = (uint32_t)sphereInstances.size();
+	// frustum 밖 instance 를 뺀 목록을 매 frame 다시 올린다
+	m_sphereInstanceBuffer = Buffer::CreateWithData(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW,
+		sphereInstances.data(), sizeof(InstanceData), sphereInstances.size());
+	m_sphere->SetInstanceBuffer(m_sphereInstanceBuffer);
+	std::vector<AABB> instanceBounds;
+	instanceBounds.reserve(sphereInstances.size());
+	for (auto& instance: sphereInstances)
+		instanceBounds.push_back(m_sphere->GetBounds().Transform(instance.modelTransform));
+	m_sceneBvh = Bvh::Create(instanceBounds);
+	if (!m_sceneBvh)
+		return false;
 	
+	m_renderQueue = RenderQueue::Create();
+	m_textureStreamer = TextureStreamer::Create();
+	if (!m_textureStreamer)
+		return false;
 	m_simpleProgram = Program::Create("./shader/simple.vs", "./shader/simple.fs");
-	m_pbrProgram = Program::Create("./shader/pbr.vs", "./shader/pbr.fs");
+	m_pbrProgram = Program::Create("./shader/pbr_instanced_packed.vs", "./shader/pbr_instanced.fs");
 	// m_pbrProgram = Program::Create("./shader/pbr_texture.vs", "./shader/pbr_texture.fs");
 	m_sphericalMapProgram = Program::Create("./shader/spherical_map.vs", "./shader/spherical_map.fs");
 	m_skyboxProgram = Program::Create("./shader/skybox_hdr.vs", "./shader/skybox_hdr.fs");
@@ -91,15 +178,123 @@ bool Context::Init() {
 	// m_material.roughness = Texture::CreateFromImage(Image::Load("./image/rustediron2_roughness.png").get());
 	// m_material.metallic = Texture::CreateFromImage(Image::Load("./image/rustediron2_metallic.png").get());
 	// m_material.normal = Texture::CreateFromImage(Image::Load("./image/rustediron2_normal.png").get());
-	m_hdrMap = Texture::CreateFromImage(Image::Load("./image/Alexs_Apt_2k.hdr").get());
+	// SH bake 에 이미지가 필요해서 직접 읽고, 텍스처는 cache 에 등록해 공유한다
+	// --bake-image 로 미리 decode 해 둔 .dds 가 있으면 map 해서 그대로 쓴다
+	const std::string hdrFilename = "./image/Alexs_Apt_2k.hdr";
+	const std::string bakedHdrFilename = "./image/Alexs_Apt_2k.dds";
+	const auto& hdrSourceFilename = std::filesystem::exists(bakedHdrFilename) ?
+		bakedHdrFilename : hdrFilename;
+	auto hdrImage = Image::Load(hdrSourceFilename);
+	if (!hdrImage)
+		return false;
+	m_hdrMap = Texture::CreateFromImage(hdrImage.get());
+	// 다른 곳에서 같은 파일을 Load 하면 찾을 수 있도록 실제로 읽은 파일과 pixel format 으로 등록한다
+	// (.dds 는 RGB9E5 나 float 으로 bake 되어 있을 수 있다)
+	TextureLoadOption hdrOption;
+	if (hdrImage->GetPixelType() == PixelType::Float)
+		hdrOption.hdrFormat = HdrFormat::Float;
+	else if (hdrImage->GetPixelType() == PixelType::RGB9E5)
+		hdrOption.hdrFormat = HdrFormat::RGB9E5;
+	TextureCache::Get()->Insert(hdrSourceFilename, hdrOption, m_hdrMap);
+
+	// diffuse irradiance 를 CPU 에서 SH 로 bake (irradianceMap 대신 쓸 수 있다)
+	auto shStartTime = std::chrono::steady_clock::now();
+	m_shIrradiance = ConvolveSH9Irradiance(
+		ProjectEquirectToSH9(hdrImage.get(), ThreadPool::GetDefault()));
+	SPDLOG_INFO("sh irradiance baked in {:.1f} ms", std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - shStartTime).count());
+	m_pbrProgram->Use();
+	for (size_t i = 0; i < m_shIrradiance.size(); i++)
+		m_pbrProgram->SetUniform(fmt::format("shIrradiance[{}]", i), m_shIrradiance[i]);
  
 	m_lights.push_back({ glm::vec3(5.0f, 5.0f, 6.0f), glm::vec3(40.0f, 40.0f, 40.0f) });
 	m_lights.push_back({ glm::vec3(-4.0f, 5.0f, 7.0f), glm::vec3(40.0f, 40.0f, 40.0f) });
 	m_lights.push_back({ glm::vec3(-4.0f, -6.0f, 8.0f), glm::vec3(40.0f, 40.0f, 40.0f) });
 	m_lights.push_back({ glm::vec3(5.0f, -6.0f, 9.0f), glm::vec3(40.0f, 40.0f, 40.0f) });
 
-	
-	m_hdrCubeMap = CubeTexture::Create(512, 512, GL_RGB16F, GL_FLOAT);
+	m_cameraBuffer = Buffer::CreateWithData(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW,
+		nullptr, sizeof(CameraBlock), 1);
+	m_lightBuffer = Buffer::CreateWithData(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW,
+		nullptr, sizeof(LightBlock), 1);
+	m_cameraBuffer->BindBase(UNIFORM_BINDING_CAMERA);
+	m_lightBuffer->BindBase(UNIFORM_BINDING_LIGHTS);
+
+	m_lightCluster = LightCluster::Create();
+	if (!m_lightCluster)
+		return false;
+	m_simpleColorHandle = m_simpleProgram->GetUniformHandle<glm::vec4>("color");
+	m_simpleTransformHandle = m_simpleProgram->GetUniformHandle<glm::mat4>("transform");
+
+
+	InitIBLMaps(hdrSourceFilename, hdrImage->GetPixelType());
+
+	Framebuffer::BindToDefault();
+	RenderState::Get()->Viewport(0, 0, m_width, m_height);
+
+	return true;
+}
+
+void Context::InitIBLMaps(const std::string& hdrFilename, PixelType hdrPixelType) {
+	const int hdrCubeMapMipLevels = (int)log2f((float)HDR_CUBE_MAP_SIZE) + 1;
+
+	// .hdr 과 bake 한 .dds 는 결과가 조금씩 다르므로 실제로 읽은 파일로 key 를 만든다
+	auto startTime = std::chrono::steady_clock::now();
+	auto cacheKey = IblCache::ComputeKey({
+		hdrFilename,
+		"./shader/spherical_map.vs", "./shader/spherical_map.fs",
+		"./shader/skybox_hdr.vs", "./shader/diffuse_irradiance.fs",
+		"./shader/prefiltered_light.fs",
+		"./shader/brdf_lookup.vs", "./shader/brdf_lookup.fs",
+	}, {
+		HDR_CUBE_MAP_SIZE, DIFFUSE_IRRADIANCE_SIZE,
+		PRE_FILTERED_SIZE, PRE_FILTERED_MIP_LEVELS, BRDF_LOOKUP_SIZE,
+		(int)hdrPixelType,
+	});
+	auto cacheFilename = fmt::format("./cache/ibl_{:016x}.bin", cacheKey);
+
+	auto cache = IblCache::Load(cacheFilename, cacheKey);
+	bool cacheHit = cache && cache->GetEntryCount() == 4;
+	if (cacheHit) {
+		m_hdrCubeMap = cache->CreateCubeTexture(0);
+		m_diffuseIrradianceMap = cache->CreateCubeTexture(1);
+		m_preFilteredMap = cache->CreateCubeTexture(2);
+		m_brdfLookupMap = cache->CreateTexture(3);
+	}
+	else {
+		ComputeIBLMaps();
+		cache = IblCache::Create(cacheKey);
+		cache->AddCubeTexture(m_hdrCubeMap.get(), hdrCubeMapMipLevels);
+		cache->AddCubeTexture(m_diffuseIrradianceMap.get(), 1);
+		cache->AddCubeTexture(m_preFilteredMap.get(), PRE_FILTERED_MIP_LEVELS);
+		cache->AddTexture(m_brdfLookupMap.get());
+		if (cache->Save(cacheFilename))
+			SPDLOG_INFO("saved ibl cache: {}", cacheFilename);
+	}
+
+	auto elapsed = std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - startTime).count();
+	SPDLOG_INFO("ibl maps ready in {:.1f} ms ({})", elapsed,
+		cacheHit ? "warm cache" : "computed");
+}
+
+bool Context::RunSHIrradianceTest() const {
+	// irradianceMap 은 cache 에서 읽었든 새로 그렸든 같은 GL_RGB16F cube map 이다
+	int faceSize = m_diffuseIrradianceMap->GetWidth();
+	std::vector<std::vector<float>> faces(6);
+	for (int face = 0; face < 6; face++) {
+		auto data = m_diffuseIrradianceMap->GetFaceData(face, 0, GL_FLOAT);
+		faces[face].resize((size_t)faceSize * faceSize * 3);
+		if (data.size() != faces[face].size() * sizeof(float)) {
+			SPDLOG_ERROR("sh irradiance test failed: unexpected irradiance map size {}", data.size());
+			return false;
+		}
+		memcpy(faces[face].data(), data.data(), data.size());
+	}
+	return CompareSH9WithCubeMap(m_shIrradiance, faces, faceSize);
+}
+
+void Context::ComputeIBLMaps() {
+	m_hdrCubeMap = CubeTexture::Create(HDR_CUBE_MAP_SIZE, HDR_CUBE_MAP_SIZE, GL_RGB16F, GL_FLOAT);
 	auto cubeFramebuffer = CubeFramebuffer::Create(m_hdrCubeMap);
 	auto projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
 	std::vector<glm::mat4> views = {
@@ -113,7 +308,7 @@ bool Context::Init() {
 	m_sphericalMapProgram->Use();
 	m_sphericalMapProgram->SetUniform("tex", 0);
 	m_hdrMap->Bind();
-	glViewport(0, 0, 512, 512);
+	RenderState::Get()->Viewport(0, 0, HDR_CUBE_MAP_SIZE, HDR_CUBE_MAP_SIZE);
 	for (int i = 0; i < (int)views.size(); i++) {
 		cubeFramebuffer->Bind(i);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -124,14 +319,14 @@ bool Context::Init() {
 
 	m_diffuseIrradianceProgram = Program::Create(
 	  "./shader/skybox_hdr.vs", "./shader/diffuse_irradiance.fs");
-	m_diffuseIrradianceMap = CubeTexture::Create(64, 64, GL_RGB16F, GL_FLOAT);
+	m_diffuseIrradianceMap = CubeTexture::Create(DIFFUSE_IRRADIANCE_SIZE, DIFFUSE_IRRADIANCE_SIZE, GL_RGB16F, GL_FLOAT);
 	cubeFramebuffer = CubeFramebuffer::Create(m_diffuseIrradianceMap);
-	glDepthFunc(GL_LEQUAL);
+	RenderState::Get()->DepthFunc(GL_LEQUAL);
 	m_diffuseIrradianceProgram->Use();
 	m_diffuseIrradianceProgram->SetUniform("projection", projection);
 	m_diffuseIrradianceProgram->SetUniform("cubeMap", 0);
 	m_hdrCubeMap->Bind();
-	glViewport(0, 0, 64, 64);
+	RenderState::Get()->Viewport(0, 0, DIFFUSE_IRRADIANCE_SIZE, DIFFUSE_IRRADIANCE_SIZE);
 	for (int i = 0; i < (int)views.size(); i++) {
 		cubeFramebuffer->Bind(i);
 		glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
@@ -139,12 +334,12 @@ bool Context::Init() {
 		m_diffuseIrradianceProgram->SetUniform("view", views[i]);
 		m_box->Draw(m_diffuseIrradianceProgram.get());
 	}
-	glDepthFunc(GL_LESS);
+	RenderState::Get()->DepthFunc(GL_LESS);
 
-	const uint32_t maxMipLevels = 5;
-	glDepthFunc(GL_LEQUAL);
+	const uint32_t maxMipLevels = PRE_FILTERED_MIP_LEVELS;
+	RenderState::Get()->DepthFunc(GL_LEQUAL);
 	m_preFilteredProgram = Program::Create("./shader/skybox_hdr.vs", "./shader/prefiltered_light.fs");
-	m_preFilteredMap = CubeTexture::Create(128, 128, GL_RGB16F, GL_FLOAT);
+	m_preFilteredMap = CubeTexture::Create(PRE_FILTERED_SIZE, PRE_FILTERED_SIZE, GL_RGB16F, GL_FLOAT);
 	m_preFilteredMap->GenerateMipmap();
 	m_preFilteredProgram->Use();
 	m_preFilteredProgram->SetUniform("projection", projection);
@@ -152,9 +347,9 @@ bool Context::Init() {
 	m_hdrCubeMap->Bind();
 	for (uint32_t mip = 0; mip < maxMipLevels; mip++) {
 	    auto framebuffer = CubeFramebuffer::Create(m_preFilteredMap, mip);
-	    uint32_t mipWidth = 128 >> mip;
-	    uint32_t mipHeight = 128 >> mip;
-	    glViewport(0, 0, mipWidth, mipHeight);
+	    uint32_t mipWidth = PRE_FILTERED_SIZE >> mip;
+	    uint32_t mipHeight = PRE_FILTERED_SIZE >> mip;
+	    RenderState::Get()->Viewport(0, 0, mipWidth, mipHeight);
 
 	    float roughness = (float)mip / (float)(maxMipLevels - 1);
 	    m_preFilteredProgram->SetUniform("roughness", roughness);
@@ -165,29 +360,27 @@ bool Context::Init() {
 			m_box->Draw(m_preFilteredProgram.get());   
 	    }
 	}
-	glDepthFunc(GL_LESS);
+	RenderState::Get()->DepthFunc(GL_LESS);
 
 	m_brdfLookupProgram = Program::Create("./shader/brdf_lookup.vs", "./shader/brdf_lookup.fs");
-	m_brdfLookupMap = Texture::Create(512, 512, GL_RG16F, GL_FLOAT);
+	m_brdfLookupMap = Texture::Create(BRDF_LOOKUP_SIZE, BRDF_LOOKUP_SIZE, GL_RG16F, GL_FLOAT);
 	auto lookupFramebuffer = Framebuffer::Create({ m_brdfLookupMap });
 	lookupFramebuffer->Bind();
-	glViewport(0, 0, 512, 512);
+	RenderState::Get()->Viewport(0, 0, BRDF_LOOKUP_SIZE, BRDF_LOOKUP_SIZE);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	m_brdfLookupProgram->Use();
 	m_brdfLookupProgram->SetUniform("transform", glm::scale(glm::mat4(1.0f), glm::vec3(2.0f, -2.0f, 2.0f)));
 	m_plane->Draw(m_brdfLookupProgram.get());
-
-	Framebuffer::BindToDefault();
-	glViewport(0, 0, m_width, m_height);
-
-	return true;
 }
 
 
 
 
 
+
 void Context::Render() {
+	PROFILE_SCOPE("Context::Render");
+	m_textureStreamer->Update();
 	if (ImGui::Begin("ui window")) {
 	    ImGui::DragFloat3("camera pos", glm::value_ptr(m_cameraPos), 0.01f);
 	    ImGui::DragFloat("camera yaw", &m_cameraYaw, 0.5f);
@@ -205,13 +398,48 @@ void Context::Render() {
 			ImGui::DragFloat3("light.pos", glm::value_ptr(m_lights[lightIndex].position), 0.01f);
 			ImGui::DragFloat3("light.color", glm::value_ptr(m_lights[lightIndex].color), 0.1f);
 		}
+		if (ImGui::CollapsingHeader("clustered lights")) {
+			if (ImGui::SliderInt("count", &m_clusterLightCount, 0, 4096))
+				GenerateClusterLights(m_clusterLightCount);
+			auto& clusterStats = m_lightCluster->GetStats();
+			ImGui::Text("%d visible, %d indices, max %d per cluster, %.2f ms",
+				(int)clusterStats.visibleLightCount, (int)clusterStats.indexCount,
+				(int)clusterStats.maxLightsPerCluster, clusterStats.buildTime);
+		}
 		if (ImGui::CollapsingHeader("material")) {
 			ImGui::ColorEdit3("mat.albedo", glm::value_ptr(m_material.albedo));
 			ImGui::SliderFloat("mat.roughness", &m_material.roughness, 0.0f, 1.0f);
 			ImGui::SliderFloat("mat.metallic", &m_material.metallic, 0.0f, 1.0f);
 			ImGui::SliderFloat("mat.ao", &m_material.ao, 0.0f, 1.0f);
 		}
+		if (m_pickedInstance >= 0) {
+			auto& params = m_sphereInstances[m_pickedInstance].materialParams;
+			ImGui::Text("picked instance %d: roughness %.2f, metallic %.2f",
+				m_pickedInstance, params.x, params.y);
+		}
 		ImGui::Checkbox("use IBL", &m_useIBL);
+		ImGui::Checkbox("use SH irradiance", &m_useSHIrradiance);
+		auto textureCache = TextureCache::Get();
+		ImGui::Text("texture cache: %d alive, %d hits, %d misses",
+			(int)textureCache->GetAliveCount(),
+			(int)textureCache->GetHitCount(),
+			(int)textureCache->GetMissCount());
+		auto& streamStats = m_textureStreamer->GetStats();
+		ImGui::Text("texture streaming: %d decoding, %d uploading, %d done, %.1f MB/s",
+			(int)streamStats.pendingDecodeCount, (int)streamStats.pendingUploadCount,
+			(int)streamStats.completedCount, streamStats.uploadThroughput);
+		auto& queueStats = m_renderQueue->GetStats();
+		ImGui::Text("render queue: %d draws, %d programs (%d unsorted), %d materials, %d meshes",
+			(int)queueStats.drawCount, (int)queueStats.programChangeCount,
+			(int)queueStats.unsortedProgramChangeCount,
+			(int)queueStats.materialChangeCount, (int)queueStats.meshChangeCount);
+		auto renderState = RenderState::Get();
+		ImGui::Text("gl state calls: %d issued, %d elided",
+			(int)renderState->GetIssuedCount(),
+			(int)renderState->GetElidedCount());
+
+		if (auto profiler = Profiler::Get())
+			profiler->DrawImGui();
 
 		float w = ImGui::GetContentRegionAvailWidth();
 		ImGui::Image((ImTextureID)m_brdfLookupMap->Get(), ImVec2(w, w));
@@ -225,66 +453,145 @@ void Context::Render() {
 			glm::radians(m_cameraPitch), glm::vec3(1.0f, 0.0f, 0.0f)) *
 	    glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
 
+	const float farPlane = 150.0f;
 	auto projection = glm::perspective(glm::radians(45.0f),
-		(float)m_width / (float)m_height, 0.01f, 150.0f);
+		(float)m_width / (float)m_height, 0.01f, farPlane);
 	auto view = glm::lookAt(
 		m_cameraPos,
 		m_cameraPos + m_cameraFront,
 		m_cameraUp);
+	m_viewProjection = projection * view;
+	m_renderQueue->Begin(m_cameraPos, farPlane);
+	UpdateUniformBlocks(view, projection);
+
+	{
+		PROFILE_SCOPE("light cluster");
+		m_lightCluster->Build(m_clusterLights, view, glm::radians(45.0f),
+			(float)m_width / (float)m_height, 0.01f, farPlane, ThreadPool::GetDefault());
+	}
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	m_pbrProgram->Use();
-	m_pbrProgram->SetUniform("viewPos", m_cameraPos);
-	m_pbrProgram->SetUniform("material.albedo", m_material.albedo);
-	m_pbrProgram->SetUniform("material.ao", m_material.ao);
-	m_pbrProgram->SetUniform("useIBL", m_useIBL ? 1 : 0);
-	m_pbrProgram->SetUniform("irradianceMap", 0);
-	m_pbrProgram->SetUniform("preFilteredMap", 1);
-	m_pbrProgram->SetUniform("brdfLookupTable", 2);
-	glActiveTexture(GL_TEXTURE0);
-	m_diffuseIrradianceMap->Bind();
-	glActiveTexture(GL_TEXTURE1);
-	m_preFilteredMap->Bind();
-	glActiveTexture(GL_TEXTURE2);
-	m_brdfLookupMap->Bind();
-	glActiveTexture(GL_TEXTURE0);
+	{
+		PROFILE_SCOPE("clear");
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
 
-	for (size_t i = 0; i < m_lights.size(); i++) {
+	{
+		PROFILE_SCOPE("IBL setup");
 		m_pbrProgram->Use();
-	    auto posName = fmt::format("lights[{}].position", i);
-	    auto colorName = fmt::format("lights[{}].color", i);
-	    m_pbrProgram->SetUniform(posName, m_lights[i].position);
-	    m_pbrProgram->SetUniform(colorName, m_lights[i].color);
-		
-		auto lightTransform = projection * view * 
+		m_pbrProgram->SetUniform("material.albedo", m_material.albedo);
+		m_pbrProgram->SetUniform("material.ao", m_material.ao);
+		m_pbrProgram->SetUniform("useIBL", m_useIBL ? 1 : 0);
+		m_pbrProgram->SetUniform("useSHIrradiance", m_useSHIrradiance ? 1 : 0);
+		m_pbrProgram->SetUniform("irradianceMap", 0);
+		m_pbrProgram->SetUniform("preFilteredMap", 1);
+		m_pbrProgram->SetUniform("brdfLookupTable", 2);
+		m_pbrProgram->SetUniform("useClusteredLights", m_clusterLights.empty() ? 0 : 1);
+		m_lightCluster->SetToProgram(m_pbrProgram.get(), m_width, m_height, 4);
+		RenderState::Get()->ActiveTexture(0);
+		m_diffuseIrradianceMap->Bind();
+		RenderState::Get()->ActiveTexture(1);
+		m_preFilteredMap->Bind();
+		RenderState::Get()->ActiveTexture(2);
+		m_brdfLookupMap->Bind();
+		RenderState::Get()->ActiveTexture(0);
+	}
+
+	for (size_t i = 0; i < m_lights.size(); i++) {
+		DrawItem item;
+		item.mesh = m_box.get();
+		item.program = m_simpleProgram.get();
+		item.profileName = "light gizmos";
+		item.transform =
 			glm::translate(glm::mat4(1.0f), m_lights[i].position) *
 			glm::scale(glm::mat4(1.0f), glm::vec3(0.4f));
-		m_simpleProgram->Use();
-		m_simpleProgram->SetUniform("color", glm::vec4(m_lights[i].color, 1.0f));
-		m_simpleProgram->SetUniform("transform", lightTransform);
-		m_box->Draw(m_simpleProgram.get());
+		item.setUniforms = [&, i](const Program* program) {
+			auto lightTransform = projection * view *
+				glm::translate(glm::mat4(1.0f), m_lights[i].position) *
+				glm::scale(glm::mat4(1.0f), glm::vec3(0.4f));
+			program->SetUniform(m_simpleColorHandle, glm::vec4(m_lights[i].color, 1.0f));
+			program->SetUniform(m_simpleTransformHandle, lightTransform);
+		};
+		m_renderQueue->Submit(std::move(item));
 	}
+
 	DrawScene(view, projection, m_pbrProgram.get());
 
-	m_sphericalMapProgram->Use();
-	m_sphericalMapProgram->SetUniform("transform",
-	    projection * view *
-	    glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f)));
-	m_sphericalMapProgram->SetUniform("tex", 0);
-	m_hdrMap->Bind();
-	m_box->Draw(m_sphericalMapProgram.get());
-
-	glDepthFunc(GL_LEQUAL);
-	m_skyboxProgram->Use();
-	m_skyboxProgram->SetUniform("projection", projection);
-	m_skyboxProgram->SetUniform("view", view);
-	m_skyboxProgram->SetUniform("cubeMap", 0);
-	m_skyboxProgram->SetUniform("roughness", m_material.roughness);
-	m_hdrCubeMap->Bind();
-	// m_diffuseIrradianceMap->Bind();
-	// m_preFilteredMap->Bind();
-	m_box->Draw(m_skyboxProgram.get());
-	glDepthFunc(GL_LESS);
+	{
+		DrawItem item;
+		item.mesh = m_box.get();
+		item.program = m_sphericalMapProgram.get();
+		item.profileName = "spherical map";
+		item.transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f));
+		item.setUniforms = [&](const Program* program) {
+			program->SetUniform("transform", projection * view *
+				glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f)));
+			program->SetUniform("tex", 0);
+			RenderState::Get()->ActiveTexture(0);
+			m_hdrMap->Bind();
+		};
+		m_renderQueue->Submit(std::move(item));
+	}
+
+	{
+		m_skyboxProgram->Use();
+		m_skyboxProgram->SetUniform("projection", projection);
+		m_skyboxProgram->SetUniform("view", view);
+		m_skyboxProgram->SetUniform("cubeMap", 0);
+		m_skyboxProgram->SetUniform("roughness", m_material.roughness);
+
+		DrawItem item;
+		item.mesh = m_box.get();
+		item.program = m_skyboxProgram.get();
+		item.pass = RenderPass::Skybox;
+		item.profileName = "skybox";
+		item.setUniforms = [&](const Program* program) {
+			RenderState::Get()->ActiveTexture(0);
+			m_hdrCubeMap->Bind();
+			// m_diffuseIrradianceMap->Bind();
+			// m_preFilteredMap->Bind();
+		};
+		m_renderQueue->Submit(std::move(item));
+	}
+
+	{
+		PROFILE_SCOPE("render queue");
+		m_renderQueue->Flush();
+	}
+}
+
+void Context::UpdateUniformBlocks(const glm::mat4& view, const glm::mat4& projection) {
+	CameraBlock camera;
+	camera.view = view;
+	camera.projection = projection;
+	camera.viewProjection = projection * view;
+	camera.viewPos = glm::vec4(m_cameraPos, 1.0f);
+	m_cameraBuffer->Update(&camera, sizeof(camera));
+
+	// 실제 light 개수만큼만 올리고 lightCount 는 따로 갱신한다
+	int32_t lightCount = (int32_t)std::min(m_lights.size(), MAX_LIGHT_COUNT);
+	std::vector<LightData> lights(lightCount);
+	for (int32_t i = 0; i < lightCount; i++) {
+		lights[i].position = glm::vec4(m_lights[i].position, 1.0f);
+		lights[i].color = glm::vec4(m_lights[i].color, 1.0f);
+	}
+	m_lightBuffer->Update(lights.data(), sizeof(LightData) * lightCount);
+	m_lightBuffer->Update(&lightCount, sizeof(lightCount), offsetof(LightBlock, lightCount));
+}
+
+void Context::GenerateClusterLights(int count) {
+	// 구 grid 주변에 작은 light 를 흩뿌린다
+	m_clusterLights.resize(count);
+	for (auto& light: m_clusterLights) {
+		light.position = glm::vec3(
+			RandomRange(-12.0f, 12.0f),
+			RandomRange(-12.0f, 12.0f),
+			RandomRange(-2.0f, 3.0f));
+		light.color = glm::vec3(
+			RandomRange(0.2f, 1.0f),
+			RandomRange(0.2f, 1.0f),
+			RandomRange(0.2f, 1.0f)) * 2.0f;
+		light.range = RandomRange(1.5f, 3.0f);
+	}
 }
 
 // void Context::DrawScene(const glm::mat4& view, const glm::mat4& projection, const Program* program) {
@@ -293,22 +600,28 @@ void Context::DrawScene(const glm::mat4& view,
 	Program* program) {
 
 	program->Use();
-	
-	const int sphereCount = 7;
-	const float offset = 1.2f;
-	for (int j = 0; j < sphereCount; j++) {
-	    float y = ((float)j - (float)(sphereCount - 1) * 0.5f) * offset;
-	    for (int i = 0; i < sphereCount; i++) {
-			float x = ((float)i - (float)(sphereCount - 1) * 0.5f) * offset;
-			auto modelTransform =
-				glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
-			auto transform = projection * view * modelTransform;
-			program->SetUniform("transform", transform);
-			program->SetUniform("modelTransform", modelTransform);
-			program->SetUniform("material.roughness", (float)(i + 1) / (float)sphereCount);
-			program->SetUniform("material.metallic", (float)(j + 1) / (float)sphereCount);
-			m_sphere->Draw(program);
-			m_sphere->Draw(program);
-		}
+
+	{
+		PROFILE_SCOPE("frustum culling");
+		auto frustum = Frustum::FromMatrix(projection * view);
+		m_visibleInstanceIndices.clear();
+		m_sceneBvh->QueryFrustum(frustum, m_visibleInstanceIndices);
+		m_visibleSphereInstances.clear();
+		for (auto index: m_visibleInstanceIndices)
+			m_visibleSphereInstances.push_back(m_sphereInstances[index]);
+		m_sphereInstanceCount = (uint32_t)m_visibleSphereInstances.size();
+		PROFILE_COUNTER("visible instances", m_sphereInstanceCount);
+		PROFILE_COUNTER("culled instances", m_sphereInstances.size() - m_sphereInstanceCount);
 	}
+	if (m_sphereInstanceCount == 0)
+		return;
+	m_sphereInstanceBuffer->Update(m_visibleSphereInstances.data(),
+		sizeof(InstanceData) * m_sphereInstanceCount);
+
+	DrawItem item;
+	item.mesh = m_sphere.get();
+	item.program = program;
+	item.instanceCount = m_sphereInstanceCount;
+	item.profileName = "DrawScene";
+	m_renderQueue->Submit(std::move(item));
 }
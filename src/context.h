@@ -11,6 +11,12 @@
 #include "model.h"
 #include "framebuffer.h"
 #include "shadow_map.h"
+#include "spherical_harmonics.h"
+#include "render_queue.h"
+#include "uniform_blocks.h"
+#include "light_cluster.h"
+#include "bvh.h"
+#include "texture_streamer.h"
 
 
 CLASS_PTR(Context)
@@ -22,6 +28,10 @@ public:
 	void Reshape(int width, int height);
 	void MouseMove(double x, double y);
 	void MouseButton(int button, int action, double x, double y);
+	// 입력 없이 카메라를 옮길 때 (headless benchmark 의 카메라 경로 등)
+	void SetCamera(const glm::vec3& position, float yaw, float pitch);
+	// CPU 에서 bake 한 SH irradiance 를 GPU 로 만든 irradianceMap 과 여러 방향에서 비교한다
+	bool RunSHIrradianceTest() const;
 	
 	void DrawScene(const glm::mat4& view,
 	    const glm::mat4& projection,
@@ -30,20 +40,50 @@ public:
 private:
 	Context() {}
 	bool Init();
+	// hdrFilename 은 m_hdrMap 을 실제로 읽은 파일 (.hdr 또는 bake 한 .dds)
+	void InitIBLMaps(const std::string& hdrFilename, PixelType hdrPixelType);
+	void ComputeIBLMaps();
 	
 	ProgramUPtr m_simpleProgram;
 	ProgramUPtr m_pbrProgram;
+	RenderQueueUPtr m_renderQueue;
+	TextureStreamerUPtr m_textureStreamer;
 	
 	MeshUPtr m_box;
 	MeshUPtr m_plane;
     MeshUPtr m_sphere;
+	BufferPtr m_sphereInstanceBuffer;
+	// 이번 frame 에 buffer 에 올라간 (보이는) instance 수
+	uint32_t m_sphereInstanceCount { 0 };
+	std::vector<InstanceData> m_sphereInstances;
+	// instance world bounds 위의 BVH. frustum culling 과 mouse picking 에 쓴다
+	BvhUPtr m_sceneBvh;
+	std::vector<uint32_t> m_visibleInstanceIndices;
+	std::vector<InstanceData> m_visibleSphereInstances;
+	int m_pickedInstance { -1 };
+	glm::mat4 m_viewProjection { glm::mat4(1.0f) };
+	void PickInstance(double x, double y);
 
     struct Light {
 	    glm::vec3 position { glm::vec3(0.0f, 0.0f, 0.0f) };
 	    glm::vec3 color { glm::vec3(1.0f, 1.0f, 1.0f) };
 	};
 	std::vector<Light> m_lights;
+	// 모든 program 이 binding point 로 공유하는 per-frame / per-light 데이터
+	BufferUPtr m_cameraBuffer;
+	BufferUPtr m_lightBuffer;
+	void UpdateUniformBlocks(const glm::mat4& view, const glm::mat4& projection);
+
+	// pbr 에 더해지는 다수의 작은 point light, froxel 단위로 나눠서 필요한 것만 계산한다
+	LightClusterUPtr m_lightCluster;
+	std::vector<ClusterLight> m_clusterLights;
+	int m_clusterLightCount { 0 };
+	void GenerateClusterLights(int count);
+	UniformHandle<glm::vec4> m_simpleColorHandle;
+	UniformHandle<glm::mat4> m_simpleTransformHandle;
 	bool m_useIBL { true };
+	bool m_useSHIrradiance { false };
+	SH9Color m_shIrradiance;
 	
 	struct Material {
 	    glm::vec3 albedo { glm::vec3(1.0f, 1.0f, 1.0f) };
@@ -60,7 +100,7 @@ private:
 	// };
 	Material m_material;
 
-	TextureUPtr m_hdrMap;
+	TexturePtr m_hdrMap;
 	ProgramUPtr m_sphericalMapProgram;
 	CubeTexturePtr m_hdrCubeMap;
 	ProgramUPtr m_skyboxProgram;
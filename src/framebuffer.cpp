@@ -1,4 +1,5 @@
 #include "framebuffer.h"
+#include "render_state.h"
 
 FramebufferUPtr Framebuffer::Create(const std::vector<TexturePtr>& colorAttachments) {
     auto framebuffer = FramebufferUPtr(new Framebuffer());
@@ -13,21 +14,22 @@ Framebuffer::~Framebuffer() {
     }
     if (m_framebuffer) {
         glDeleteFramebuffers(1, &m_framebuffer);
+        RenderState::Get()->OnFramebufferDeleted(m_framebuffer);
     }
 }
 
 void Framebuffer::BindToDefault() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderState::Get()->BindFramebuffer(0);
 }
 
 void Framebuffer::Bind() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    RenderState::Get()->BindFramebuffer(m_framebuffer);
 }
 
 bool Framebuffer::InitWithColorAttachments(const std::vector<TexturePtr>& colorAttachments) {
     m_colorAttachments = colorAttachments;
     glGenFramebuffers(1, &m_framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    RenderState::Get()->BindFramebuffer(m_framebuffer);
 
     for (size_t i = 0; i < m_colorAttachments.size(); i++) {
 	    glFramebufferTexture2D(GL_FRAMEBUFFER,
@@ -79,11 +81,12 @@ CubeFramebuffer::~CubeFramebuffer() {
 	}
 	if (m_framebuffer) {
 	    glDeleteFramebuffers(1, &m_framebuffer);
+	    RenderState::Get()->OnFramebufferDeleted(m_framebuffer);
 	}
 }
 
 void CubeFramebuffer::Bind(int cubeIndex) const {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	RenderState::Get()->BindFramebuffer(m_framebuffer);
 	glFramebufferTexture2D(GL_FRAMEBUFFER,
 	    GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeIndex,
 	    m_colorAttachment->Get(), m_mipLevel);
@@ -93,7 +96,7 @@ bool CubeFramebuffer::InitWithColorAttachment(const CubeTexturePtr& colorAttachm
 	m_colorAttachment = colorAttachment;
 	m_mipLevel = mipLevel;
 	glGenFramebuffers(1, &m_framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	RenderState::Get()->BindFramebuffer(m_framebuffer);
 
 	glFramebufferTexture2D(GL_FRAMEBUFFER,
 	    GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X,
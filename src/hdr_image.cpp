@@ -0,0 +1,340 @@
+#include "hdr_image.h"
+#include "simd.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// ryg 의 float_to_half_fast3_rtne 에서 부호 / inf 처리를 뺀 것 (입력은 [0, 65504])
+uint16_t FloatToHalf(float value) {
+    const uint32_t denormMagicBits = 126 << 23;
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    if (bits < (113u << 23)) {
+        // half 의 denormal 범위는 float 덧셈의 반올림으로 mantissa 를 맞춘다
+        float denormMagic;
+        memcpy(&denormMagic, &denormMagicBits, 4);
+        float shifted = value + denormMagic;
+        memcpy(&bits, &shifted, 4);
+        return (uint16_t)(bits - denormMagicBits);
+    }
+    uint32_t mantOdd = (bits >> 13) & 1;
+    bits += ((uint32_t)(15 - 127) << 23) + 0xfff;
+    bits += mantOdd;
+    return (uint16_t)(bits >> 13);
+}
+
+float HalfToFloat(uint16_t value) {
+    const uint32_t shiftedExp = 0x7c00 << 13;
+    uint32_t bits = (uint32_t)(value & 0x7fff) << 13;
+    uint32_t exp = bits & shiftedExp;
+    bits += (127 - 15) << 23;
+    float result;
+    if (exp == shiftedExp) {
+        bits += (128 - 16) << 23;
+        memcpy(&result, &bits, 4);
+    }
+    else if (exp == 0) {
+        bits += 1 << 23;
+        const uint32_t magicBits = 113 << 23;
+        float magic;
+        memcpy(&result, &bits, 4);
+        memcpy(&magic, &magicBits, 4);
+        result -= magic;
+    }
+    else {
+        memcpy(&result, &bits, 4);
+    }
+    return (value & 0x8000) ? -result : result;
+}
+
+const float HALF_MAX = 65504.0f;
+
+// RGBE 의 값은 mantissa * 2^(e - 136)
+// exponent bit 에 e - 9 를 바로 넣어서 ldexp 없이 만든다. e < 10 은 float denormal 이라 0 으로 둔다
+inline float GetRGBEScale(uint8_t exponent) {
+    if (exponent < 10)
+        return 0.0f;
+    uint32_t bits = (uint32_t)(exponent - 9) << 23;
+    float scale;
+    memcpy(&scale, &bits, 4);
+    return scale;
+}
+
+void ConvertRGBEToFloat(const uint8_t* src, float* dst, int width) {
+    for (int x = 0; x < width; x++, src += 4, dst += 3) {
+        float scale = GetRGBEScale(src[3]);
+        dst[0] = src[0] * scale;
+        dst[1] = src[1] * scale;
+        dst[2] = src[2] * scale;
+    }
+}
+
+// RGBE 와 RGB9E5 는 둘 다 공유 exponent 라 정수 연산만으로 옮길 수 있다
+// m * 2^(e - 136) = (m << 1) * 2^(e5 - 24) 이므로 e5 = e - 113
+uint32_t ConvertRGBEToRGB9E5(const uint8_t* rgbe) {
+    int exponent = rgbe[3];
+    if (exponent == 0)
+        return 0;
+    uint32_t r = (uint32_t)rgbe[0] << 1;
+    uint32_t g = (uint32_t)rgbe[1] << 1;
+    uint32_t b = (uint32_t)rgbe[2] << 1;
+    int e5 = exponent - 113;
+    if (e5 < 0) {
+        // 너무 작은 값은 mantissa 를 밀어서 e5 = 0 에 맞춘다
+        int shift = -e5;
+        if (shift > 9)
+            return 0;
+        uint32_t round = 1u << (shift - 1);
+        r = (r + round) >> shift;
+        g = (g + round) >> shift;
+        b = (b + round) >> shift;
+        e5 = 0;
+    }
+    else if (e5 > 31) {
+        // 65408 을 넘는 드문 값은 channel 별로 자르는 float 경로로 보낸다
+        float scale = GetRGBEScale(rgbe[3]);
+        return PackRGB9E5(rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale);
+    }
+    return r | (g << 9) | (b << 18) | ((uint32_t)e5 << 27);
+}
+
+bool ReadHeaderLine(const uint8_t*& cursor, const uint8_t* end, std::string& line) {
+    auto lineEnd = (const uint8_t*)memchr(cursor, '\n', end - cursor);
+    if (!lineEnd)
+        return false;
+    line.assign((const char*)cursor, (const char*)lineEnd);
+    cursor = lineEnd + 1;
+    return true;
+}
+
+// scanline 하나를 RGBE 4 byte pixel 로 푼다. 깨진 data 면 false
+bool DecodeScanline(const uint8_t*& cursor, const uint8_t* end, uint8_t* dst, int width) {
+    if (end - cursor < 4)
+        return false;
+    // 새 RLE: 2, 2, width 상위, width 하위 로 시작하고 channel 별로 따로 압축된다
+    bool newRLE = width >= 8 && width < 0x8000 &&
+        cursor[0] == 2 && cursor[1] == 2 && (cursor[2] & 0x80) == 0;
+    if (newRLE) {
+        if (((cursor[2] << 8) | cursor[3]) != width) {
+            SPDLOG_ERROR("scanline width mismatch: {}", (cursor[2] << 8) | cursor[3]);
+            return false;
+        }
+        cursor += 4;
+        for (int c = 0; c < 4; c++) {
+            int x = 0;
+            while (x < width) {
+                if (cursor >= end)
+                    return false;
+                int count = *cursor++;
+                if (count > 128) {
+                    count -= 128;
+                    if (count > width - x || cursor >= end)
+                        return false;
+                    uint8_t value = *cursor++;
+                    for (int i = 0; i < count; i++, x++)
+                        dst[x * 4 + c] = value;
+                }
+                else {
+                    if (count == 0 || count > width - x || end - cursor < count)
+                        return false;
+                    for (int i = 0; i < count; i++, x++)
+                        dst[x * 4 + c] = *cursor++;
+                }
+            }
+        }
+        return true;
+    }
+
+    // 압축하지 않은 pixel, 또는 (1, 1, 1, n) 으로 앞 pixel 을 반복하는 옛 RLE
+    int shift = 0;
+    int x = 0;
+    while (x < width) {
+        if (end - cursor < 4)
+            return false;
+        if (cursor[0] == 1 && cursor[1] == 1 && cursor[2] == 1) {
+            // 연속한 run 은 8 bit 씩 위 자리를 채운다. 24 bit 를 넘는 길이와 길이 0 은 깨진 파일로 본다
+            if (shift > 16)
+                return false;
+            uint32_t count = (uint32_t)cursor[3] << shift;
+            if (x == 0 || count == 0 || count > (uint32_t)(width - x))
+                return false;
+            for (uint32_t i = 0; i < count; i++, x++)
+                memcpy(dst + x * 4, dst + (x - 1) * 4, 4);
+            shift += 8;
+        }
+        else {
+            memcpy(dst + x * 4, cursor, 4);
+            x++;
+            shift = 0;
+        }
+        cursor += 4;
+    }
+    return true;
+}
+
+} // namespace
+
+ImageUPtr LoadRadianceHDR(const std::string& filepath, HdrFormat format,
+    bool flipVertical, ImageAllocator* allocator) {
+    auto file = MappedFile::Open(filepath);
+    if (!file) {
+        SPDLOG_ERROR("failed to load hdr image: {}", filepath);
+        return nullptr;
+    }
+    const uint8_t* cursor = file->GetData();
+    const uint8_t* end = cursor + file->GetSize();
+
+    std::string line;
+    if (!ReadHeaderLine(cursor, end, line) ||
+        (line.compare(0, 10, "#?RADIANCE") != 0 && line.compare(0, 6, "#?RGBE") != 0)) {
+        SPDLOG_ERROR("not a radiance hdr file: {}", filepath);
+        return nullptr;
+    }
+    // 빈 줄까지가 header
+    while (true) {
+        if (!ReadHeaderLine(cursor, end, line)) {
+            SPDLOG_ERROR("truncated hdr header: {}", filepath);
+            return nullptr;
+        }
+        if (line.empty())
+            break;
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe") {
+            SPDLOG_ERROR("unsupported hdr pixel format: {} ({})", line.substr(7), filepath);
+            return nullptr;
+        }
+    }
+    // 일반적인 "-Y H +X W" (위에서 아래로) 와 "+Y H +X W" (아래에서 위로) 만 받는다
+    char yOrder[3] = {};
+    int width = 0;
+    int height = 0;
+    if (!ReadHeaderLine(cursor, end, line) ||
+        sscanf(line.c_str(), "%2s %d +X %d", yOrder, &height, &width) != 3 ||
+        (strcmp(yOrder, "-Y") != 0 && strcmp(yOrder, "+Y") != 0) ||
+        width <= 0 || height <= 0) {
+        SPDLOG_ERROR("unsupported hdr resolution line: \"{}\" ({})", line, filepath);
+        return nullptr;
+    }
+    bool bottomUp = strcmp(yOrder, "+Y") == 0;
+
+    auto image = format == HdrFormat::RGB9E5 ?
+        Image::CreateRGB9E5(width, height, allocator) :
+        Image::Create(width, height, 3, format == HdrFormat::Half ? 2 : 4, allocator);
+    if (!image)
+        return nullptr;
+
+    std::vector<uint8_t> rgbeRow((size_t)width * 4);
+    std::vector<float> floatRow(format == HdrFormat::Half ? (size_t)width * 3 : 0);
+    size_t rowSize = image->GetRowSize();
+    for (int y = 0; y < height; y++) {
+        if (!DecodeScanline(cursor, end, rgbeRow.data(), width)) {
+            SPDLOG_ERROR("corrupt hdr scanline {}: {}", y, filepath);
+            return nullptr;
+        }
+        // stb 와 같이 flipVertical 이면 파일의 맨 아랫줄이 0 번 row
+        bool reverse = flipVertical != bottomUp;
+        int dstY = reverse ? height - 1 - y : y;
+        uint8_t* dst = image->GetData() + dstY * rowSize;
+        switch (format) {
+            case HdrFormat::Float:
+                ConvertRGBEToFloat(rgbeRow.data(), (float*)dst, width);
+                break;
+            case HdrFormat::Half:
+                ConvertRGBEToFloat(rgbeRow.data(), floatRow.data(), width);
+                ConvertFloatToHalf(floatRow.data(), (uint16_t*)dst, floatRow.size());
+                break;
+            case HdrFormat::RGB9E5:
+                for (int x = 0; x < width; x++) {
+                    uint32_t packed = ConvertRGBEToRGB9E5(rgbeRow.data() + x * 4);
+                    memcpy(dst + x * 4, &packed, 4);
+                }
+                break;
+        }
+    }
+    return std::move(image);
+}
+
+void ConvertFloatToHalf(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+#if USE_SSE
+    // max(x, 0) 은 x 가 NaN 이면 0 을 돌려준다
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 halfMax = _mm_set1_ps(HALF_MAX);
+#if !USE_F16C
+    const __m128i denormMagic = _mm_set1_epi32(126 << 23);
+    const __m128i denormLimit = _mm_set1_epi32(113 << 23);
+    const __m128i bias = _mm_set1_epi32((int)(((uint32_t)(15 - 127) << 23) + 0xfff));
+    const __m128i one = _mm_set1_epi32(1);
+#endif
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), halfMax);
+#if USE_F16C
+        __m128i half = _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+        __m128i bits = _mm_castps_si128(value);
+        __m128i denorm = _mm_sub_epi32(_mm_castps_si128(
+            _mm_add_ps(value, _mm_castsi128_ps(denormMagic))), denormMagic);
+        __m128i mantOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), one);
+        __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, bias), mantOdd), 13);
+        __m128i isDenorm = _mm_cmplt_epi32(bits, denormLimit);
+        __m128i half32 = _mm_or_si128(_mm_and_si128(isDenorm, denorm),
+            _mm_andnot_si128(isDenorm, normal));
+        // 결과는 0x7bff 이하라 signed saturation 에 걸리지 않는다
+        __m128i half = _mm_packs_epi32(half32, half32);
+#endif
+        _mm_storel_epi64((__m128i*)(dst + i), half);
+    }
+#endif
+    for (; i < count; i++) {
+        float value = src[i] > 0.0f ? std::min(src[i], HALF_MAX) : 0.0f;
+        dst[i] = FloatToHalf(value);
+    }
+}
+
+void ConvertHalfToFloat(const uint16_t* src, float* dst, size_t count) {
+    size_t i = 0;
+#if USE_F16C
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(src + i))));
+#endif
+    for (; i < count; i++)
+        dst[i] = HalfToFloat(src[i]);
+}
+
+// EXT_texture_shared_exponent 의 변환 식을 그대로 따른다
+uint32_t PackRGB9E5(float r, float g, float b) {
+    const int mantissaBits = 9;
+    const int expBias = 15;
+    const float sharedExpMax = 65408.0f;  // (511 / 512) * 2^16
+    auto clampChannel = [&](float value) {
+        return value > 0.0f ? std::min(value, sharedExpMax) : 0.0f;
+    };
+    float rc = clampChannel(r);
+    float gc = clampChannel(g);
+    float bc = clampChannel(b);
+    float maxValue = std::max(rc, std::max(gc, bc));
+    if (maxValue == 0.0f)
+        return 0;
+
+    int exp2;
+    std::frexp(maxValue, &exp2);
+    // floor(log2(maxValue)) = exp2 - 1
+    int sharedExp = std::max(-expBias - 1, exp2 - 1) + 1 + expBias;
+    float scale = std::ldexp(1.0f, mantissaBits + expBias - sharedExp);
+    if ((int)std::floor(maxValue * scale + 0.5f) == (1 << mantissaBits)) {
+        sharedExp++;
+        scale *= 0.5f;
+    }
+    uint32_t rm = (uint32_t)std::floor(rc * scale + 0.5f);
+    uint32_t gm = (uint32_t)std::floor(gc * scale + 0.5f);
+    uint32_t bm = (uint32_t)std::floor(bc * scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | ((uint32_t)sharedExp << 27);
+}
+
+glm::vec3 UnpackRGB9E5(uint32_t value) {
+    float scale = std::ldexp(1.0f, (int)(value >> 27) - 24);
+    return glm::vec3(
+        (float)(value & 0x1ff) * scale,
+        (float)((value >> 9) & 0x1ff) * scale,
+        (float)((value >> 18) & 0x1ff) * scale);
+}
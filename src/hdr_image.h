@@ -0,0 +1,27 @@
+#ifndef __HDR_IMAGE_H__
+#define __HDR_IMAGE_H__
+
+#include "image.h"
+
+// .hdr (Radiance RGBE) 을 어떤 pixel 로 풀지
+enum class HdrFormat {
+    Float,      // RGB float, 12 byte / pixel
+    Half,       // RGB half float, 6 byte / pixel
+    RGB9E5,     // 공유 exponent, 4 byte / pixel (GL_RGB9_E5)
+};
+
+// 파일을 map 해서 scanline 하나씩 RLE 를 풀고 바로 format 으로 바꿔 쓴다
+// float 이미지를 중간에 만들지 않으므로 최대 메모리는 결과 이미지 크기 정도다
+// allocator 가 nullptr 이면 ImageAllocator::GetDefault()
+ImageUPtr LoadRadianceHDR(const std::string& filepath, HdrFormat format,
+    bool flipVertical = true, ImageAllocator* allocator = nullptr);
+
+// half float 변환. 음수 / NaN 은 0, half 범위를 넘는 값은 65504 로 자른다
+void ConvertFloatToHalf(const float* src, uint16_t* dst, size_t count);
+void ConvertHalfToFloat(const uint16_t* src, float* dst, size_t count);
+
+// GL_UNSIGNED_INT_5_9_9_9_REV 배치: R 0~8, G 9~17, B 18~26 bit, exponent 27~31 bit
+uint32_t PackRGB9E5(float r, float g, float b);
+glm::vec3 UnpackRGB9E5(uint32_t value);
+
+#endif // __HDR_IMAGE_H__
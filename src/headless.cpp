@@ -0,0 +1,390 @@
+#include "headless.h"
+#include "framebuffer.h"
+#include "profiler.h"
+#include "render_state.h"
+#include "texture_array.h"
+#include "texture_cache.h"
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_opengl3.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+
+// GPU 결과를 기다리며 멈추지 않도록 몇 frame 뒤에 query 결과를 읽는다
+static const int TIMER_QUERY_COUNT = 4;
+
+static bool SavePPM(const std::string& filename, int width, int height) {
+	std::vector<uint8_t> pixels(width * height * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	std::ofstream fout(filename, std::ios::binary);
+	if (!fout.is_open()) {
+		SPDLOG_ERROR("failed to write image: {}", filename);
+		return false;
+	}
+	fout << "P6\n" << width << " " << height << "\n255\n";
+	// GL 은 아래쪽 행부터 읽어 오므로 뒤집어서 쓴다
+	for (int y = height - 1; y >= 0; y--)
+		fout.write((const char*)pixels.data() + y * width * 3, width * 3);
+	return (bool)fout;
+}
+
+bool RunHeadless(Context* context, const HeadlessOption& option) {
+	TexturePtr colorTexture = Texture::Create(option.width, option.height, GL_RGBA);
+	auto framebuffer = Framebuffer::Create({ colorTexture });
+	if (!framebuffer) {
+		SPDLOG_ERROR("failed to create offscreen framebuffer");
+		return false;
+	}
+	framebuffer->Bind();
+	context->Reshape(option.width, option.height);
+
+	ImGuiIO& io = ImGui::GetIO();
+	uint32_t timerQueries[TIMER_QUERY_COUNT];
+	glGenQueries(TIMER_QUERY_COUNT, timerQueries);
+	std::vector<float> cpuTimes(option.frameCount, 0.0f);
+	std::vector<float> gpuTimes(option.frameCount, 0.0f);
+	auto ReadGpuTime = [&](int frame) {
+		uint64_t elapsed = 0;
+		glGetQueryObjectui64v(timerQueries[frame % TIMER_QUERY_COUNT], GL_QUERY_RESULT, &elapsed);
+		gpuTimes[frame] = (float)((double)elapsed * 1e-6);
+	};
+
+	SPDLOG_INFO("headless run: {} frames at {}x{}", option.frameCount, option.width, option.height);
+	for (int frame = 0; frame < option.frameCount; frame++) {
+		if (frame >= TIMER_QUERY_COUNT)
+			ReadGpuTime(frame - TIMER_QUERY_COUNT);
+
+		// 정해진 카메라 경로: 원점을 바라보며 반지름 8 의 원을 한 바퀴 돈다
+		float t = (float)frame / (float)std::max(option.frameCount, 1);
+		float angle = t * 360.0f;
+		context->SetCamera(glm::vec3(
+			8.0f * sinf(glm::radians(angle)), 0.0f, 8.0f * cosf(glm::radians(angle))),
+			angle, 0.0f);
+
+		auto profiler = Profiler::Get();
+		if (profiler)
+			profiler->BeginFrame();
+		RenderState::Get()->BeginFrame();
+		auto startTime = std::chrono::steady_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[frame % TIMER_QUERY_COUNT]);
+
+		io.DisplaySize = ImVec2((float)option.width, (float)option.height);
+		io.DeltaTime = 1.0f / 60.0f;
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui::NewFrame();
+		framebuffer->Bind();
+		context->Render();
+		ImGui::Render();
+		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+		glEndQuery(GL_TIME_ELAPSED);
+		glFlush();
+		cpuTimes[frame] = std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count();
+		if (profiler)
+			profiler->EndFrame();
+	}
+	for (int frame = std::max(option.frameCount - TIMER_QUERY_COUNT, 0); frame < option.frameCount; frame++)
+		ReadGpuTime(frame);
+	glDeleteQueries(TIMER_QUERY_COUNT, timerQueries);
+
+	bool success = true;
+	std::ofstream fout(option.csvFilename);
+	if (fout.is_open()) {
+		fout << "frame,cpu_ms,gpu_ms\n";
+		for (int frame = 0; frame < option.frameCount; frame++)
+			fout << frame << "," << cpuTimes[frame] << "," << gpuTimes[frame] << "\n";
+	}
+	else {
+		SPDLOG_ERROR("failed to write frame timings: {}", option.csvFilename);
+		success = false;
+	}
+
+	auto Percentile = [](std::vector<float> values, float percent) -> float {
+		if (values.empty())
+			return 0.0f;
+		std::sort(values.begin(), values.end());
+		return values[(size_t)(percent * (float)(values.size() - 1))];
+	};
+	SPDLOG_INFO("cpu frame ms: median {:.3f}, p95 {:.3f} / gpu frame ms: median {:.3f}, p95 {:.3f}",
+		Percentile(cpuTimes, 0.5f), Percentile(cpuTimes, 0.95f),
+		Percentile(gpuTimes, 0.5f), Percentile(gpuTimes, 0.95f));
+
+	if (!option.dumpFilename.empty()) {
+		framebuffer->Bind();
+		success = SavePPM(option.dumpFilename, option.width, option.height) && success;
+	}
+	Framebuffer::BindToDefault();
+	return success;
+}
+
+bool RunUniformBenchmark(int frameCount) {
+	auto program = Program::Create("./shader/pbr.vs", "./shader/pbr.fs");
+	if (!program)
+		return false;
+	program->Use();
+
+	const int sphereCount = 7;
+	const float offset = 1.2f;
+	auto view = glm::lookAt(glm::vec3(0.0f, 0.0f, 8.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	auto projection = glm::perspective(glm::radians(45.0f), 940.0f / 560.0f, 0.01f, 100.0f);
+	// sphere 하나에 넣는 uniform 을 mode 별 setter 로 넘긴다
+	auto DrawGrid = [&](auto&& setUniforms) {
+		for (int j = 0; j < sphereCount; j++) {
+			float y = ((float)j - (float)(sphereCount - 1) * 0.5f) * offset;
+			for (int i = 0; i < sphereCount; i++) {
+				float x = ((float)i - (float)(sphereCount - 1) * 0.5f) * offset;
+				auto modelTransform = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+				setUniforms(projection * view * modelTransform, modelTransform,
+					(float)(i + 1) / (float)sphereCount, (float)(j + 1) / (float)sphereCount);
+			}
+		}
+	};
+	auto Measure = [&](const char* mode, auto&& setUniforms) {
+		// 첫 frame 은 driver 쪽 초기화가 섞이므로 버린다
+		DrawGrid(setUniforms);
+		glFinish();
+		auto startTime = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+			DrawGrid(setUniforms);
+		float elapsed = std::chrono::duration<float, std::micro>(
+			std::chrono::steady_clock::now() - startTime).count();
+		glFinish();
+		SPDLOG_INFO("uniform bench {:>8}: {:.2f} us / frame ({} frames)", mode,
+			elapsed / (float)frameCount, frameCount);
+	};
+
+	uint32_t id = program->Get();
+	Measure("driver", [&](const glm::mat4& transform, const glm::mat4& modelTransform,
+		float roughness, float metallic) {
+		// 예전 SetUniform 처럼 매번 std::string 으로 driver 에 location 을 묻는다
+		glUniformMatrix4fv(glGetUniformLocation(id, std::string("transform").c_str()),
+			1, GL_FALSE, glm::value_ptr(transform));
+		glUniformMatrix4fv(glGetUniformLocation(id, std::string("modelTransform").c_str()),
+			1, GL_FALSE, glm::value_ptr(modelTransform));
+		glUniform1f(glGetUniformLocation(id, std::string("material.roughness").c_str()), roughness);
+		glUniform1f(glGetUniformLocation(id, std::string("material.metallic").c_str()), metallic);
+	});
+	Measure("hashed", [&](const glm::mat4& transform, const glm::mat4& modelTransform,
+		float roughness, float metallic) {
+		program->SetUniform("transform", transform);
+		program->SetUniform("modelTransform", modelTransform);
+		program->SetUniform("material.roughness", roughness);
+		program->SetUniform("material.metallic", metallic);
+	});
+	auto transformHandle = program->GetUniformHandle<glm::mat4>("transform");
+	auto modelTransformHandle = program->GetUniformHandle<glm::mat4>("modelTransform");
+	auto roughnessHandle = program->GetUniformHandle<float>("material.roughness");
+	auto metallicHandle = program->GetUniformHandle<float>("material.metallic");
+	Measure("handle", [&](const glm::mat4& transform, const glm::mat4& modelTransform,
+		float roughness, float metallic) {
+		program->SetUniform(transformHandle, transform);
+		program->SetUniform(modelTransformHandle, modelTransform);
+		program->SetUniform(roughnessHandle, roughness);
+		program->SetUniform(metallicHandle, metallic);
+	});
+
+	// table 에 넣은 이름이 driver 가 돌려주는 location 과 같은지 확인한다
+	bool success = true;
+	for (auto name: { "transform", "modelTransform", "material.roughness", "material.metallic",
+		"shIrradiance", "shIrradiance[0]", "shIrradiance[8]" }) {
+		if (program->GetUniformLocation(name) != glGetUniformLocation(id, name)) {
+			SPDLOG_ERROR("uniform location mismatch: {}", name);
+			success = false;
+		}
+	}
+	return success;
+}
+
+bool RunTextureArrayTest(const std::vector<std::string>& imagePaths, const std::string& modelFilename) {
+	auto arrayProgram = Program::Create("./shader/defer_geo.vs", "./shader/defer_geo_array.fs");
+	auto textureProgram = Program::Create("./shader/defer_geo.vs", "./shader/defer_geo.fs");
+	if (!arrayProgram || !textureProgram)
+		return false;
+
+	// 파일 이미지에 atlas 로 들어갈 작은 이미지를 섞는다. channel 수와 크기를 일부러 제각각으로 둔다
+	std::vector<std::string> names;
+	std::vector<std::vector<ImageUPtr>> sources;
+	TextureLoadOption textureOption;
+	for (auto& path: imagePaths) {
+		auto levels = LoadImageLevels(path, textureOption);
+		if (levels.empty())
+			return false;
+		names.push_back(path);
+		sources.push_back(std::move(levels));
+	}
+	std::mt19937 random(11);
+	const int smallSizes[][3] = { { 64, 64, 4 }, { 100, 36, 3 }, { 20, 200, 1 }, { 128, 96, 2 }, { 256, 256, 4 } };
+	for (auto& size: smallSizes) {
+		auto image = Image::Create(size[0], size[1], size[2]);
+		if (!image)
+			return false;
+		// 부드러운 무늬에 잡음을 더해서 filtering 차이가 드러나게 한다
+		for (int y = 0; y < size[1]; y++) {
+			for (int x = 0; x < size[0]; x++) {
+				uint8_t* pixel = image->GetData() + ((size_t)y * size[0] + x) * size[2];
+				for (int c = 0; c < size[2]; c++)
+					pixel[c] = (uint8_t)((x * (c + 1) * 7 + y * 3 + (random() & 15)) & 0xff);
+			}
+		}
+		std::vector<ImageUPtr> levels;
+		auto mipLevels = image->GenerateMipChain(textureOption.GetMipChainOption());
+		levels.push_back(std::move(image));
+		for (auto& level: mipLevels)
+			levels.push_back(std::move(level));
+		names.push_back(fmt::format("synthetic {}x{}x{}", size[0], size[1], size[2]));
+		sources.push_back(std::move(levels));
+	}
+
+	// 같은 mip chain 을 보통 텍스처 (기준) 와 array layer 로 올린다
+	auto manager = TextureArrayManager::Create(textureOption.sRGB);
+	std::vector<TexturePtr> textures;
+	std::vector<uint32_t> handles;
+	std::vector<glm::ivec2> sizes;
+	for (auto& levels: sources) {
+		TexturePtr texture = Texture::CreateFromMipChain(levels, textureOption.sRGB);
+		// array 쪽은 fract 로 반복하므로 기준도 GL_REPEAT 로 맞춘다
+		texture->SetWrap(GL_REPEAT, GL_REPEAT);
+		textures.push_back(texture);
+		sizes.push_back(glm::ivec2(levels[0]->GetWidth(), levels[0]->GetHeight()));
+		handles.push_back(manager->Add(std::move(levels)));
+	}
+	if (!manager->Build())
+		return false;
+	SPDLOG_INFO("texture array test: {} textures -> {} arrays, {} atlas pages",
+		textures.size(), manager->GetArrayCount(), manager->GetAtlasPageCount());
+	for (size_t i = 0; i < handles.size(); i++) {
+		auto& layer = manager->GetLayer(handles[i]);
+		SPDLOG_INFO("  {}: array {}x{} ({} levels), layer {}, scaleOffset ({:.4f}, {:.4f}, {:.4f}, {:.4f})",
+			names[i], layer.array->GetWidth(), layer.array->GetHeight(), layer.array->GetLevelCount(),
+			layer.layer, layer.scaleOffset.x, layer.scaleOffset.y, layer.scaleOffset.z, layer.scaleOffset.w);
+	}
+
+	// defer_geo 의 gAlbedoSpec (diffuse.rgb, specular.r) 을 읽어서 비교한다
+	const int framebufferSize = 2048;
+	std::vector<TexturePtr> attachments;
+	for (int i = 0; i < 3; i++)
+		attachments.push_back(Texture::Create(framebufferSize, framebufferSize, GL_RGBA));
+	auto framebuffer = Framebuffer::Create(attachments);
+	if (!framebuffer)
+		return false;
+	framebuffer->Bind();
+	auto ReadAlbedoSpec = [&](int width, int height) {
+		std::vector<uint8_t> pixels((size_t)width * height * 4);
+		glReadBuffer(GL_COLOR_ATTACHMENT2);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		return pixels;
+	};
+	auto Compare = [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b,
+		int& maxDiff, float& meanDiff) {
+		maxDiff = 0;
+		uint64_t sum = 0;
+		for (size_t i = 0; i < a.size(); i++) {
+			int diff = abs((int)a[i] - (int)b[i]);
+			maxDiff = std::max(maxDiff, diff);
+			sum += diff;
+		}
+		meanDiff = a.empty() ? 0.0f : (float)sum / (float)a.size();
+	};
+
+	// 화면을 덮는 사각형. uv 를 repeat 배로 늘려서 fract 로 감싸는 경로도 그린다
+	auto CreateQuad = [](float repeat) {
+		std::vector<Vertex> vertices = {
+			Vertex { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 0.0f) },
+			Vertex { glm::vec3( 1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(repeat, 0.0f) },
+			Vertex { glm::vec3( 1.0f,  1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(repeat, repeat) },
+			Vertex { glm::vec3(-1.0f,  1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, repeat) },
+		};
+		return Mesh::Create(std::move(vertices), { 0, 1, 2, 2, 3, 0 }, GL_TRIANGLES);
+	};
+	auto DrawQuad = [&](Mesh* quad, Program* program, MaterialPtr material, int width, int height) {
+		RenderState::Get()->Viewport(0, 0, width, height);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		program->Use();
+		program->SetUniform("transform", glm::mat4(1.0f));
+		program->SetUniform("modelTransform", glm::mat4(1.0f));
+		quad->SetMaterial(material);
+		quad->Draw(program);
+		return ReadAlbedoSpec(width, height);
+	};
+
+	bool success = true;
+	// repeat 1 이면 pixel 과 texel 중심이 맞아서 level 0 을 그대로 읽는다. 반올림 차이만 허용
+	// repeat 3 이면 mip level 사이를 읽는다. atlas page 의 mip 은 page 전체에서 만들므로 평균만 본다
+	struct Pass {
+		float repeat;
+		int maxAllowedDiff;
+		float meanAllowedDiff;
+	};
+	for (auto pass: { Pass { 1.0f, 2, 0.5f }, Pass { 3.0f, 255, 2.0f } }) {
+		auto quad = CreateQuad(pass.repeat);
+		for (size_t i = 0; i < handles.size(); i++) {
+			int width = std::min(sizes[i].x, framebufferSize);
+			int height = std::min(sizes[i].y, framebufferSize);
+			auto arrayMaterial = MaterialPtr(Material::Create());
+			arrayMaterial->diffuseLayer = manager->GetLayer(handles[i]);
+			arrayMaterial->specularLayer = manager->GetLayer(handles[i]);
+			auto textureMaterial = MaterialPtr(Material::Create());
+			textureMaterial->diffuse = textures[i];
+			textureMaterial->specular = textures[i];
+			auto arrayPixels = DrawQuad(quad.get(), arrayProgram.get(), arrayMaterial, width, height);
+			auto texturePixels = DrawQuad(quad.get(), textureProgram.get(), textureMaterial, width, height);
+			int maxDiff = 0;
+			float meanDiff = 0.0f;
+			Compare(arrayPixels, texturePixels, maxDiff, meanDiff);
+			bool passed = maxDiff <= pass.maxAllowedDiff && meanDiff <= pass.meanAllowedDiff;
+			SPDLOG_INFO("  repeat {:.0f} {}: max diff {}, mean diff {:.3f}{}", pass.repeat, names[i],
+				maxDiff, meanDiff, passed ? "" : " (FAILED)");
+			success = success && passed;
+		}
+	}
+
+	// model 파일이 있으면 Model::Load 의 두 경로로 읽어서 같은 카메라로 그린 결과를 비교한다
+	if (!modelFilename.empty()) {
+		auto arrayModel = Model::Load(modelFilename, true, true);
+		auto textureModel = Model::Load(modelFilename, true, false);
+		if (!arrayModel || !textureModel || !arrayModel->GetTextureArrays())
+			return false;
+		auto textureArrays = arrayModel->GetTextureArrays();
+		SPDLOG_INFO("  model {}: {} meshes, {} arrays, {} atlas pages", modelFilename,
+			arrayModel->GetMeshCount(), textureArrays->GetArrayCount(), textureArrays->GetAtlasPageCount());
+
+		auto& sphere = arrayModel->GetBoundingSphere();
+		auto view = glm::lookAt(sphere.center + glm::vec3(0.0f, 0.0f, sphere.radius * 2.5f),
+			sphere.center, glm::vec3(0.0f, 1.0f, 0.0f));
+		auto projection = glm::perspective(glm::radians(45.0f), 1.0f,
+			sphere.radius * 0.1f, sphere.radius * 10.0f);
+		const int modelSize = 1024;
+		auto DrawModel = [&](const Model* model, Program* program) {
+			RenderState::Get()->Viewport(0, 0, modelSize, modelSize);
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			program->Use();
+			model->Draw(program, projection * view, glm::mat4(1.0f));
+			return ReadAlbedoSpec(modelSize, modelSize);
+		};
+		int maxDiff = 0;
+		float meanDiff = 0.0f;
+		// material 텍스처는 CLAMP_TO_EDGE, array 는 fract 로 감싸므로 uv 경계의 차이가 있어 평균만 본다
+		Compare(DrawModel(arrayModel.get(), arrayProgram.get()),
+			DrawModel(textureModel.get(), textureProgram.get()), maxDiff, meanDiff);
+		bool passed = meanDiff <= 2.0f;
+		SPDLOG_INFO("  model: max diff {}, mean diff {:.3f}{}", maxDiff, meanDiff, passed ? "" : " (FAILED)");
+		success = success && passed;
+	}
+
+	Framebuffer::BindToDefault();
+	if (success)
+		SPDLOG_INFO("texture array test passed");
+	else
+		SPDLOG_ERROR("texture array test failed: array sampling differs from 2D textures");
+	return success;
+}
@@ -0,0 +1,30 @@
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+#include "common.h"
+#include "context.h"
+
+// 창을 띄우지 않고 정해진 frame 수만큼 그리는 benchmark 모드 설정
+struct HeadlessOption {
+    int frameCount { 300 };
+    int width { WINDOW_WIDTH };
+    int height { WINDOW_HEIGHT };
+    std::string csvFilename { "./frame_timings.csv" };
+    // 비어 있지 않으면 마지막 frame 을 PPM 으로 저장한다
+    std::string dumpFilename;
+};
+
+// offscreen framebuffer 에 카메라를 sphere grid 주위로 한 바퀴 돌리면서 Context::Render 를 반복하고
+// frame 별 CPU / GPU (GL_TIME_ELAPSED) 시간을 CSV 로 남긴다
+bool RunHeadless(Context* context, const HeadlessOption& option);
+
+// 7x7 sphere grid 의 sphere 마다 uniform 4 개를 넣는 CPU 시간을
+// 매번 glGetUniformLocation 을 부르는 방식 / 이름으로 찾는 hash table / UniformHandle 로 비교한다
+bool RunUniformBenchmark(int frameCount);
+
+// 같은 mip chain 을 TextureArrayManager (atlas 포함) 와 보통 2D 텍스처로 올려서
+// defer_geo_array.fs 와 defer_geo.fs 로 그린 gAlbedoSpec 을 비교한다
+// modelFilename 이 있으면 Model::Load 를 useTextureArrays 로 / 없이 읽어서 같은 비교를 한다
+bool RunTextureArrayTest(const std::vector<std::string>& imagePaths, const std::string& modelFilename);
+
+#endif // __HEADLESS_H__
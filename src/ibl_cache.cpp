@@ -0,0 +1,214 @@
+#include "ibl_cache.h"
+#include <fstream>
+#include <filesystem>
+
+static const char IBL_CACHE_MAGIC[4] = { 'I', 'B', 'L', 'C' };
+static const uint32_t IBL_CACHE_VERSION = 1;
+
+struct IblCacheFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct IblCacheEntryHeader {
+    uint32_t target;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t mipLevelCount;
+    int32_t faceCount;
+    uint64_t dataSize;
+};
+
+// FNV-1a 64bit
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    auto bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static size_t GetEntryDataSize(uint32_t format, int width, int height,
+    int mipLevelCount, int faceCount) {
+    size_t size = 0;
+    for (int mip = 0; mip < mipLevelCount; mip++) {
+        size += GetPixelSize(format, GL_HALF_FLOAT) *
+            std::max(width >> mip, 1) * std::max(height >> mip, 1) * faceCount;
+    }
+    return size;
+}
+
+uint64_t IblCache::ComputeKey(
+    const std::vector<std::string>& filenames,
+    const std::vector<int>& parameters) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = HashBytes(hash, &IBL_CACHE_VERSION, sizeof(IBL_CACHE_VERSION));
+    std::vector<char> buffer(1 << 16);
+    for (auto& filename: filenames) {
+        std::ifstream fin(filename, std::ios::binary);
+        if (!fin.is_open()) {
+            SPDLOG_WARN("failed to open file for ibl cache key: {}", filename);
+            continue;
+        }
+        while (fin) {
+            fin.read(buffer.data(), buffer.size());
+            hash = HashBytes(hash, buffer.data(), (size_t)fin.gcount());
+        }
+    }
+    hash = HashBytes(hash, parameters.data(), parameters.size() * sizeof(int));
+    return hash;
+}
+
+IblCacheUPtr IblCache::Create(uint64_t key) {
+    auto cache = IblCacheUPtr(new IblCache());
+    cache->m_key = key;
+    return std::move(cache);
+}
+
+IblCacheUPtr IblCache::Load(const std::string& filename, uint64_t key) {
+    auto cache = IblCacheUPtr(new IblCache());
+    if (!cache->LoadFile(filename, key))
+        return nullptr;
+    return std::move(cache);
+}
+
+bool IblCache::LoadFile(const std::string& filename, uint64_t key) {
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin.is_open())
+        return false;
+
+    IblCacheFileHeader header;
+    fin.read((char*)&header, sizeof(header));
+    if (!fin || memcmp(header.magic, IBL_CACHE_MAGIC, sizeof(IBL_CACHE_MAGIC)) != 0 ||
+        header.version != IBL_CACHE_VERSION) {
+        SPDLOG_WARN("invalid ibl cache file: {}", filename);
+        return false;
+    }
+    if (header.key != key) {
+        SPDLOG_INFO("ibl cache is out of date: {}", filename);
+        return false;
+    }
+
+    m_key = key;
+    m_entries.resize(header.entryCount);
+    for (auto& entry: m_entries) {
+        IblCacheEntryHeader entryHeader;
+        fin.read((char*)&entryHeader, sizeof(entryHeader));
+        if (!fin || entryHeader.dataSize != GetEntryDataSize(entryHeader.format,
+                entryHeader.width, entryHeader.height,
+                entryHeader.mipLevelCount, entryHeader.faceCount)) {
+            SPDLOG_WARN("broken ibl cache file: {}", filename);
+            return false;
+        }
+        entry.target = entryHeader.target;
+        entry.format = entryHeader.format;
+        entry.width = entryHeader.width;
+        entry.height = entryHeader.height;
+        entry.mipLevelCount = entryHeader.mipLevelCount;
+        entry.faceCount = entryHeader.faceCount;
+        entry.data.resize(entryHeader.dataSize);
+        fin.read((char*)entry.data.data(), entry.data.size());
+        if (!fin) {
+            SPDLOG_WARN("truncated ibl cache file: {}", filename);
+            return false;
+        }
+    }
+    return true;
+}
+
+void IblCache::AddCubeTexture(const CubeTexture* texture, int mipLevelCount) {
+    Entry entry;
+    entry.target = GL_TEXTURE_CUBE_MAP;
+    entry.format = texture->GetFormat();
+    entry.width = texture->GetWidth();
+    entry.height = texture->GetHeight();
+    entry.mipLevelCount = mipLevelCount;
+    entry.faceCount = 6;
+    for (int mip = 0; mip < mipLevelCount; mip++) {
+        for (int face = 0; face < 6; face++) {
+            auto data = texture->GetFaceData(face, mip, GL_HALF_FLOAT);
+            entry.data.insert(entry.data.end(), data.begin(), data.end());
+        }
+    }
+    m_entries.push_back(std::move(entry));
+}
+
+void IblCache::AddTexture(const Texture* texture) {
+    Entry entry;
+    entry.target = GL_TEXTURE_2D;
+    entry.format = texture->GetFormat();
+    entry.width = texture->GetWidth();
+    entry.height = texture->GetHeight();
+    entry.data = texture->GetData(0, GL_HALF_FLOAT);
+    m_entries.push_back(std::move(entry));
+}
+
+bool IblCache::Save(const std::string& filename) const {
+    auto dirname = std::filesystem::path(filename).parent_path();
+    std::error_code error;
+    if (!dirname.empty())
+        std::filesystem::create_directories(dirname, error);
+
+    std::ofstream fout(filename, std::ios::binary);
+    if (!fout.is_open()) {
+        SPDLOG_ERROR("failed to write ibl cache: {}", filename);
+        return false;
+    }
+
+    IblCacheFileHeader header;
+    memcpy(header.magic, IBL_CACHE_MAGIC, sizeof(IBL_CACHE_MAGIC));
+    header.version = IBL_CACHE_VERSION;
+    header.key = m_key;
+    header.entryCount = (uint32_t)m_entries.size();
+    header.reserved = 0;
+    fout.write((const char*)&header, sizeof(header));
+
+    for (auto& entry: m_entries) {
+        IblCacheEntryHeader entryHeader;
+        entryHeader.target = entry.target;
+        entryHeader.format = entry.format;
+        entryHeader.width = entry.width;
+        entryHeader.height = entry.height;
+        entryHeader.mipLevelCount = entry.mipLevelCount;
+        entryHeader.faceCount = entry.faceCount;
+        entryHeader.dataSize = entry.data.size();
+        fout.write((const char*)&entryHeader, sizeof(entryHeader));
+        fout.write((const char*)entry.data.data(), entry.data.size());
+    }
+    return (bool)fout;
+}
+
+CubeTextureUPtr IblCache::CreateCubeTexture(int index) const {
+    auto& entry = m_entries[index];
+    if (entry.target != GL_TEXTURE_CUBE_MAP)
+        return nullptr;
+
+    auto texture = CubeTexture::Create(entry.width, entry.height, entry.format, GL_HALF_FLOAT);
+    const uint8_t* data = entry.data.data();
+    for (int mip = 0; mip < entry.mipLevelCount; mip++) {
+        int width = std::max(entry.width >> mip, 1);
+        int height = std::max(entry.height >> mip, 1);
+        size_t faceSize = GetPixelSize(entry.format, GL_HALF_FLOAT) * width * height;
+        for (int face = 0; face < 6; face++) {
+            texture->SetFaceData(face, mip, GL_HALF_FLOAT, data);
+            data += faceSize;
+        }
+    }
+    texture->SetMipLevelCount(entry.mipLevelCount);
+    return std::move(texture);
+}
+
+TextureUPtr IblCache::CreateTexture(int index) const {
+    auto& entry = m_entries[index];
+    if (entry.target != GL_TEXTURE_2D)
+        return nullptr;
+
+    auto texture = Texture::Create(entry.width, entry.height, entry.format, GL_HALF_FLOAT);
+    texture->SetData(0, GL_HALF_FLOAT, entry.data.data());
+    return std::move(texture);
+}
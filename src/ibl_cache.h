@@ -0,0 +1,45 @@
+#ifndef __IBL_CACHE_H__
+#define __IBL_CACHE_H__
+
+#include "texture.h"
+
+// IBL 전처리 결과 (cube map, irradiance, prefiltered, BRDF LUT) 를 파일로 저장해 두고
+// 다음 실행부터는 GPU 계산 없이 바로 텍스처로 올린다
+CLASS_PTR(IblCache)
+class IblCache {
+public:
+    // 입력 파일 내용과 크기 파라미터로 cache key 를 만든다
+    static uint64_t ComputeKey(
+        const std::vector<std::string>& filenames,
+        const std::vector<int>& parameters);
+    static IblCacheUPtr Create(uint64_t key);
+    // 파일이 없거나 key / version 이 다르면 nullptr
+    static IblCacheUPtr Load(const std::string& filename, uint64_t key);
+
+    void AddCubeTexture(const CubeTexture* texture, int mipLevelCount);
+    void AddTexture(const Texture* texture);
+    bool Save(const std::string& filename) const;
+
+    int GetEntryCount() const { return (int)m_entries.size(); }
+    CubeTextureUPtr CreateCubeTexture(int index) const;
+    TextureUPtr CreateTexture(int index) const;
+
+private:
+    IblCache() {}
+    bool LoadFile(const std::string& filename, uint64_t key);
+
+    // 모든 level 은 GL_HALF_FLOAT 로 저장한다 (16F 텍스처와 정확히 같은 값)
+    struct Entry {
+        uint32_t target { GL_TEXTURE_2D };
+        uint32_t format { GL_RGB16F };
+        int width { 0 };
+        int height { 0 };
+        int mipLevelCount { 1 };
+        int faceCount { 1 };
+        std::vector<uint8_t> data;
+    };
+    uint64_t m_key { 0 };
+    std::vector<Entry> m_entries;
+};
+
+#endif // __IBL_CACHE_H__
@@ -1,33 +1,178 @@
 #include "image.h"
+#include "hdr_image.h"
+#include "simd.h"
+#include <fstream>
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <glm/gtc/constants.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// stb 의 모든 allocation 을 decode 중인 thread 의 allocator 로 보낸다
+static thread_local ImageAllocator* t_stbAllocator = nullptr;
+static ImageAllocator* GetStbAllocator() {
+    return t_stbAllocator ? t_stbAllocator : ImageAllocator::GetDefault();
+}
+#define STBI_MALLOC(size) GetStbAllocator()->Allocate(size)
+#define STBI_REALLOC(ptr, size) GetStbAllocator()->Reallocate(ptr, size)
+#define STBI_FREE(ptr) GetStbAllocator()->Free(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-ImageUPtr Image::Load(const std::string& filepath, bool flipVertical) {
+class MallocImageAllocator : public ImageAllocator {
+public:
+    void* Allocate(size_t size) override { return malloc(size); }
+    void* Reallocate(void* ptr, size_t size) override { return realloc(ptr, size); }
+    void Free(void* ptr) override { free(ptr); }
+};
+
+ImageAllocator* ImageAllocator::GetDefault() {
+    static MallocImageAllocator allocator;
+    return &allocator;
+}
+
+ImageArenaUPtr ImageArena::Create(size_t capacity) {
+    auto arena = ImageArenaUPtr(new ImageArena());
+    if (!arena->Init(capacity))
+        return nullptr;
+    return std::move(arena);
+}
+
+ImageArena::~ImageArena() {
+    free(m_memory);
+}
+
+bool ImageArena::Init(size_t capacity) {
+    // malloc 이 16 byte 정렬을 보장하므로 block 도 16 byte 단위로 자른다
+    m_capacity = capacity & ~(size_t)15;
+    m_memory = (uint8_t*)malloc(m_capacity);
+    if (!m_memory) {
+        SPDLOG_ERROR("failed to allocate image arena: {} bytes", capacity);
+        return false;
+    }
+    return true;
+}
+
+void* ImageArena::Allocate(size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t dataOffset = m_top + sizeof(BlockHeader);
+        if (size <= m_capacity && dataOffset <= m_capacity - size) {
+            auto header = (BlockHeader*)(m_memory + m_top);
+            header->size = size;
+            header->prevBlock = m_lastBlock;
+            header->freed = false;
+            m_lastBlock = m_top;
+            m_top = (dataOffset + size + 15) & ~(size_t)15;
+            m_peakSize = std::max(m_peakSize, m_top);
+            return m_memory + dataOffset;
+        }
+        m_fallbackCount++;
+    }
+    return malloc(size);
+}
+
+void* ImageArena::Reallocate(void* ptr, size_t size) {
+    if (!ptr)
+        return Allocate(size);
+    if (!Owns(ptr))
+        return realloc(ptr, size);
+
+    size_t oldSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto header = (BlockHeader*)((uint8_t*)ptr - sizeof(BlockHeader));
+        size_t dataOffset = (uint8_t*)ptr - m_memory;
+        // 맨 위 block 이면 제자리에서 크기만 바꾼다
+        if ((size_t)((uint8_t*)header - m_memory) == m_lastBlock &&
+            size <= m_capacity - dataOffset) {
+            header->size = size;
+            m_top = (dataOffset + size + 15) & ~(size_t)15;
+            m_peakSize = std::max(m_peakSize, m_top);
+            return ptr;
+        }
+        oldSize = header->size;
+    }
+    void* newPtr = Allocate(size);
+    if (!newPtr)
+        return nullptr;
+    memcpy(newPtr, ptr, std::min(oldSize, size));
+    Free(ptr);
+    return newPtr;
+}
+
+void ImageArena::Free(void* ptr) {
+    if (!ptr)
+        return;
+    if (!Owns(ptr)) {
+        free(ptr);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto header = (BlockHeader*)((uint8_t*)ptr - sizeof(BlockHeader));
+    header->freed = true;
+    // 맨 위에서부터 해제된 block 들을 걷어낸다
+    while (m_lastBlock != NO_BLOCK) {
+        auto lastHeader = (BlockHeader*)(m_memory + m_lastBlock);
+        if (!lastHeader->freed)
+            break;
+        m_top = m_lastBlock;
+        m_lastBlock = lastHeader->prevBlock;
+    }
+}
+
+ImageUPtr Image::Load(const std::string& filepath, bool flipVertical,
+    ImageAllocator* allocator) {
+    auto extPos = filepath.find_last_of('.');
+    auto ext = extPos != std::string::npos ? filepath.substr(extPos) : std::string();
+    if (ext == ".dds" || ext == ".DDS") {
+        auto levels = LoadDDS(filepath);
+        if (levels.empty())
+            return nullptr;
+        return std::move(levels[0]);
+    }
+    // RGBE 는 float 대신 half 로 바로 풀어서 메모리와 upload 양을 반으로 줄인다
+    if (ext == ".hdr" || ext == ".HDR")
+        return LoadRadianceHDR(filepath, HdrFormat::Half, flipVertical, allocator);
     auto image = ImageUPtr(new Image());
-    if (!image->LoadWithStb(filepath, flipVertical))
+    if (!image->LoadWithStb(filepath, flipVertical, allocator))
         return nullptr;
     return std::move(image);
 }
 
 Image::~Image() {
-    if (m_data) {
-        stbi_image_free(m_data);
+    // mapping 을 가리키는 경우는 m_mappedFile 이 해제될 때 같이 풀린다
+    if (m_data && m_allocator) {
+        m_allocator->Free(m_data);
     }
 }
 
-bool Image::LoadWithStb(const std::string& filepath, bool flipVertical) {
-    stbi_set_flip_vertically_on_load(flipVertical);
-    auto ext = filepath.substr(filepath.find_last_of('.'));
-	if (ext == ".hdr" || ext == ".HDR") {
-	    m_data = (uint8_t*)stbi_loadf(filepath.c_str(),
-			&m_width, &m_height, &m_channelCount, 0);
-	    m_bytePerChannel = 4;
-	}
-	else {
-		m_data = stbi_load(filepath.c_str(),
-			&m_width, &m_height, &m_channelCount, 0);
-	    m_bytePerChannel = 1;
-	}
+bool Image::LoadWithStb(const std::string& filepath, bool flipVertical,
+    ImageAllocator* allocator) {
+    // stdio 로 한 번 더 복사하지 않고 page cache 를 바로 decode 한다
+    auto file = MappedFile::Open(filepath);
+    if (!file || file->GetSize() > (size_t)INT32_MAX) {
+        SPDLOG_ERROR("failed to load image: {}", filepath);
+        return false;
+    }
+    m_allocator = allocator ? allocator : ImageAllocator::GetDefault();
+    t_stbAllocator = m_allocator;
+    // model 로딩 시 여러 worker 에서 동시에 부르므로 thread 별 설정을 쓴다
+    stbi_set_flip_vertically_on_load_thread(flipVertical);
+	m_data = stbi_load_from_memory(file->GetData(), (int)file->GetSize(),
+		&m_width, &m_height, &m_channelCount, 0);
+	m_bytePerChannel = 1;
+	m_pixelType = PixelType::UInt8;
+    t_stbAllocator = nullptr;
     if (!m_data) {
         SPDLOG_ERROR("failed to load image: {}", filepath);
         return false;
@@ -35,19 +180,35 @@ bool Image::LoadWithStb(const std::string& filepath, bool flipVertical) {
     return true;
 }
 
-ImageUPtr Image::Create(int width, int height, int channelCount, int bytePerChannel) {
+ImageUPtr Image::Create(int width, int height, int channelCount, int bytePerChannel,
+    ImageAllocator* allocator) {
+    auto image = ImageUPtr(new Image());
+    if (!image->Allocate(width, height, channelCount, bytePerChannel, allocator))
+        return nullptr;
+    return std::move(image);
+}
+
+ImageUPtr Image::CreateRGB9E5(int width, int height, ImageAllocator* allocator) {
     auto image = ImageUPtr(new Image());
-    if (!image->Allocate(width, height, channelCount, bytePerChannel))
+    if (!image->Allocate(width, height, 3, 0, allocator))
         return nullptr;
     return std::move(image);
 }
 
-bool Image::Allocate(int width, int height, int channelCount, int bytePerChannel) {
+bool Image::Allocate(int width, int height, int channelCount, int bytePerChannel,
+    ImageAllocator* allocator) {
     m_width = width;
     m_height = height;
     m_channelCount = channelCount;
     m_bytePerChannel = bytePerChannel;
-    m_data = (uint8_t*)malloc(m_width * m_height * m_channelCount * m_bytePerChannel);
+    switch (bytePerChannel) {
+        case 0: m_pixelType = PixelType::RGB9E5; break;
+        case 2: m_pixelType = PixelType::Half; break;
+        case 4: m_pixelType = PixelType::Float; break;
+        default: m_pixelType = PixelType::UInt8; break;
+    }
+    m_allocator = allocator ? allocator : ImageAllocator::GetDefault();
+    m_data = (uint8_t*)m_allocator->Allocate(GetDataSize());
     return m_data ? true : false;
 }
 
@@ -65,6 +226,42 @@ void Image::SetCheckImage(int gridX, int gridY) {
     }
 }
 
+void Image::GetRowAsFloat(int y, float* dst) const {
+    size_t count = (size_t)m_width * m_channelCount;
+    const uint8_t* row = m_data + y * GetRowSize();
+    switch (m_pixelType) {
+        case PixelType::UInt8:
+            for (size_t i = 0; i < count; i++)
+                dst[i] = row[i] * (1.0f / 255.0f);
+            break;
+        case PixelType::Half:
+            ConvertHalfToFloat((const uint16_t*)row, dst, count);
+            break;
+        case PixelType::Float:
+            memcpy(dst, row, count * sizeof(float));
+            break;
+        case PixelType::RGB9E5:
+            for (int x = 0; x < m_width; x++) {
+                uint32_t packed;
+                memcpy(&packed, row + x * 4, 4);
+                auto color = UnpackRGB9E5(packed);
+                dst[x * 3 + 0] = color.r;
+                dst[x * 3 + 1] = color.g;
+                dst[x * 3 + 2] = color.b;
+            }
+            break;
+    }
+}
+
+ImageUPtr Image::ConvertToFloat() const {
+    auto image = Create(m_width, m_height, m_channelCount, 4);
+    if (!image)
+        return nullptr;
+    for (int y = 0; y < m_height; y++)
+        GetRowAsFloat(y, (float*)image->m_data + (size_t)y * m_width * m_channelCount);
+    return std::move(image);
+}
+
 ImageUPtr Image::CreateSingleColorImage(
 	int width, int height, const glm::vec4& color) {
 	glm::vec4 clamped = glm::clamp(color * 255.0f, 0.0f, 255.0f);
@@ -79,4 +276,1042 @@ ImageUPtr Image::CreateSingleColorImage(
 	    memcpy(image->m_data + 4 * i, rgba, 4);
 	}
 	return std::move(image);
-}
\ No newline at end of file
+}
+
+// 8bit sRGB -> linear
+static const float* GetSRGBToLinearTable() {
+	static const auto table = []() {
+		std::array<float, 256> result;
+		for (int i = 0; i < 256; i++) {
+			float value = i / 255.0f;
+			result[i] = value <= 0.04045f ? value / 12.92f :
+				std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+		return result;
+	}();
+	return table.data();
+}
+
+// linear [0, 1] 을 LINEAR_TO_SRGB_TABLE_SIZE 단계로 나눈 8bit sRGB 표
+// 어두운 쪽 기울기가 커도 반올림 오차가 1 code 보다 충분히 작다
+static const int LINEAR_TO_SRGB_TABLE_SIZE = 16384;
+static const uint8_t* GetLinearToSRGBTable() {
+	static const auto table = []() {
+		std::vector<uint8_t> result(LINEAR_TO_SRGB_TABLE_SIZE + 1);
+		for (int i = 0; i <= LINEAR_TO_SRGB_TABLE_SIZE; i++) {
+			float linear = (float)i / LINEAR_TO_SRGB_TABLE_SIZE;
+			float srgb = linear <= 0.0031308f ? linear * 12.92f :
+				1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+			result[i] = (uint8_t)glm::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f);
+		}
+		return result;
+	}();
+	return table.data();
+}
+
+static float Bessel0(float x) {
+	// I0(x) 급수 전개
+	float sum = 1.0f;
+	float term = 1.0f;
+	float halfX = x * 0.5f;
+	for (int k = 1; k < 32; k++) {
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+		if (term < sum * 1e-8f)
+			break;
+	}
+	return sum;
+}
+
+// 2:1 축소용 separable filter. 목적 pixel x 는 원본 2x - firstOffset 부터 tapCount 개를 쓴다
+static const int MAX_MIP_TAP_COUNT = 6;
+struct MipKernel {
+	int tapCount;
+	int firstOffset;
+	float weights[MAX_MIP_TAP_COUNT];
+};
+
+static MipKernel GetMipKernel(MipFilter filter) {
+	MipKernel kernel = {};
+	if (filter == MipFilter::Box) {
+		kernel.tapCount = 2;
+		kernel.firstOffset = 0;
+		kernel.weights[0] = kernel.weights[1] = 0.5f;
+		return kernel;
+	}
+	// 목적 pixel 단위 반경 1.5 의 Kaiser window (alpha 4) 를 씌운 sinc
+	const float alpha = 4.0f;
+	const float halfWidth = 1.5f;
+	kernel.tapCount = 6;
+	kernel.firstOffset = 2;
+	float sum = 0.0f;
+	for (int i = 0; i < 6; i++) {
+		float x = (i - 2.5f) * 0.5f;    // 원본 pixel 중심까지 거리를 목적 pixel 단위로
+		float sinc = std::fabs(x) < 1e-6f ? 1.0f :
+			std::sin(glm::pi<float>() * x) / (glm::pi<float>() * x);
+		float window = x / halfWidth;
+		float kaiser = Bessel0(alpha * std::sqrt(std::max(1.0f - window * window, 0.0f))) /
+			Bessel0(alpha);
+		kernel.weights[i] = sinc * kaiser;
+		sum += kernel.weights[i];
+	}
+	for (int i = 0; i < 6; i++)
+		kernel.weights[i] /= sum;
+	return kernel;
+}
+
+struct MipLevelData {
+	int width { 0 };
+	int height { 0 };
+	std::vector<float> pixels;
+};
+
+// alpha 가 없으면 -1
+static int GetAlphaChannel(int channelCount) {
+	return (channelCount == 2 || channelCount == 4) ? channelCount - 1 : -1;
+}
+
+// dst += weight * src (count 개)
+static void AccumulateRow(float* dst, const float* src, float weight, size_t count) {
+	size_t i = 0;
+#if USE_SSE
+	__m128 w = _mm_set1_ps(weight);
+	for (; i + 4 <= count; i += 4) {
+		__m128 value = _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i)));
+		_mm_storeu_ps(dst + i, value);
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] += weight * src[i];
+}
+
+// 원본 srcY 행을 linear float 로 돌려준다. 변환이 필요하면 buffer 에 채워서 돌려준다
+using MipRowFetcher = std::function<const float*(int srcY, float* buffer)>;
+
+static void DownsampleLevel(int srcWidth, int srcHeight, const MipRowFetcher& fetchRow,
+	MipLevelData& dst, int channelCount, const MipKernel& kernel, ThreadPool* threadPool) {
+	dst.width = std::max(srcWidth / 2, 1);
+	dst.height = std::max(srcHeight / 2, 1);
+	dst.pixels.assign((size_t)dst.width * dst.height * channelCount, 0.0f);
+	size_t srcRowSize = (size_t)srcWidth * channelCount;
+
+	threadPool->ParallelFor(dst.height, [&](size_t begin, size_t end) {
+		std::vector<float> column(srcRowSize);
+		// 연속한 목적 행은 원본 행을 겹쳐 쓰므로 srcY % tapCount 자리에 받아 둔 행을 재사용한다
+		// 한 목적 행이 쓰는 tapCount 개의 연속한 원본 행은 서로 다른 자리에 들어간다
+		std::vector<float> rowBuffers(srcRowSize * kernel.tapCount);
+		int cachedY[MAX_MIP_TAP_COUNT];
+		const float* cachedRows[MAX_MIP_TAP_COUNT] = {};
+		std::fill(cachedY, cachedY + MAX_MIP_TAP_COUNT, -1);
+		for (size_t y = begin; y < end; y++) {
+			// 세로 방향을 먼저 줄인 한 행
+			std::fill(column.begin(), column.end(), 0.0f);
+			for (int t = 0; t < kernel.tapCount; t++) {
+				int srcY = glm::clamp((int)y * 2 - kernel.firstOffset + t, 0, srcHeight - 1);
+				int slot = srcY % kernel.tapCount;
+				if (cachedY[slot] != srcY) {
+					cachedRows[slot] = fetchRow(srcY, rowBuffers.data() + slot * srcRowSize);
+					cachedY[slot] = srcY;
+				}
+				AccumulateRow(column.data(), cachedRows[slot], kernel.weights[t], srcRowSize);
+			}
+
+			float* out = dst.pixels.data() + y * dst.width * channelCount;
+			for (int x = 0; x < dst.width; x++) {
+				int firstX = x * 2 - kernel.firstOffset;
+#if USE_SSE
+				if (channelCount == 4) {
+					__m128 sum = _mm_setzero_ps();
+					for (int t = 0; t < kernel.tapCount; t++) {
+						int srcX = glm::clamp(firstX + t, 0, srcWidth - 1);
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel.weights[t]),
+							_mm_loadu_ps(column.data() + srcX * 4)));
+					}
+					_mm_storeu_ps(out + x * 4, sum);
+					continue;
+				}
+#endif
+				for (int t = 0; t < kernel.tapCount; t++) {
+					int srcX = glm::clamp(firstX + t, 0, srcWidth - 1);
+					for (int c = 0; c < channelCount; c++)
+						out[x * channelCount + c] += kernel.weights[t] * column[srcX * channelCount + c];
+				}
+			}
+		}
+	}, 4);
+}
+
+static float ComputeAlphaCoverage(const MipLevelData& level, int channelCount,
+	int alphaChannel, float cutoff, float scale) {
+	size_t pixelCount = (size_t)level.width * level.height;
+	size_t coveredCount = 0;
+	for (size_t i = 0; i < pixelCount; i++) {
+		if (level.pixels[i * channelCount + alphaChannel] * scale >= cutoff)
+			coveredCount++;
+	}
+	return (float)coveredCount / (float)pixelCount;
+}
+
+// coverage 가 target 이상이 되는 가장 작은 alpha 배율
+static float FindAlphaCoverageScale(const MipLevelData& level, int channelCount,
+	int alphaChannel, float cutoff, float targetCoverage) {
+	float low = 0.0f;
+	float high = 16.0f;
+	for (int i = 0; i < 12; i++) {
+		float middle = (low + high) * 0.5f;
+		if (ComputeAlphaCoverage(level, channelCount, alphaChannel, cutoff, middle) >= targetCoverage)
+			high = middle;
+		else
+			low = middle;
+	}
+	return high;
+}
+
+std::vector<ImageUPtr> Image::GenerateMipChain(const MipChainOption& option,
+	ThreadPool* threadPool) const {
+	std::vector<ImageUPtr> levels;
+	if (!m_data) {
+		SPDLOG_ERROR("can not generate mipmap of empty image");
+		return levels;
+	}
+	if (!threadPool)
+		threadPool = ThreadPool::GetDefault();
+
+	int channelCount = m_channelCount;
+	int alphaChannel = GetAlphaChannel(channelCount);
+	bool sRGB = option.sRGB && m_pixelType == PixelType::UInt8;
+	auto kernel = GetMipKernel(option.filter);
+
+	// level 0 은 float 로 복사하지 않고 필요한 행만 그때그때 linear 로 바꾼다
+	auto srgbToLinear = GetSRGBToLinearTable();
+	MipRowFetcher fetchSourceRow = [&](int srcY, float* buffer) -> const float* {
+		size_t rowSize = (size_t)m_width * channelCount;
+		if (m_pixelType == PixelType::Float)
+			return (const float*)m_data + srcY * rowSize;
+		if (m_pixelType != PixelType::UInt8) {
+			GetRowAsFloat(srcY, buffer);
+			return buffer;
+		}
+		const uint8_t* src = m_data + srcY * rowSize;
+		for (size_t i = 0; i < rowSize; i += channelCount) {
+			for (int c = 0; c < channelCount; c++) {
+				buffer[i + c] = (sRGB && c != alphaChannel) ?
+					srgbToLinear[src[i + c]] : src[i + c] * (1.0f / 255.0f);
+			}
+		}
+		return buffer;
+	};
+
+	bool preserveCoverage = option.preserveAlphaCoverage && alphaChannel >= 0;
+	float targetCoverage = 0.0f;
+	if (preserveCoverage) {
+		std::vector<float> rowBuffer((size_t)m_width * channelCount);
+		size_t coveredCount = 0;
+		for (int y = 0; y < m_height; y++) {
+			const float* row = fetchSourceRow(y, rowBuffer.data());
+			for (int x = 0; x < m_width; x++) {
+				if (row[x * channelCount + alphaChannel] >= option.alphaCutoff)
+					coveredCount++;
+			}
+		}
+		targetCoverage = (float)coveredCount / ((float)m_width * m_height);
+	}
+
+	MipLevelData current;
+	current.width = m_width;
+	current.height = m_height;
+	while (current.width > 1 || current.height > 1) {
+		MipLevelData next;
+		if (levels.empty()) {
+			DownsampleLevel(m_width, m_height, fetchSourceRow, next, channelCount,
+				kernel, threadPool);
+		}
+		else {
+			size_t rowSize = (size_t)current.width * channelCount;
+			DownsampleLevel(current.width, current.height, [&](int srcY, float*) {
+				return (const float*)current.pixels.data() + srcY * rowSize;
+			}, next, channelCount, kernel, threadPool);
+		}
+		float alphaScale = preserveCoverage ?
+			FindAlphaCoverageScale(next, channelCount, alphaChannel, option.alphaCutoff,
+				targetCoverage) : 1.0f;
+
+		auto image = m_pixelType == PixelType::RGB9E5 ?
+			Image::CreateRGB9E5(next.width, next.height) :
+			Image::Create(next.width, next.height, channelCount, m_bytePerChannel);
+		if (!image) {
+			levels.clear();
+			return levels;
+		}
+		// 다음 level 은 배율을 적용하지 않은 float 값에서 만든다
+		threadPool->ParallelFor(next.height, [&](size_t begin, size_t end) {
+			auto linearToSRGB = GetLinearToSRGBTable();
+			size_t rowFloatCount = (size_t)next.width * channelCount;
+			std::vector<float> rowBuffer(rowFloatCount);
+			for (size_t y = begin; y < end; y++) {
+				const float* src = next.pixels.data() + y * rowFloatCount;
+				uint8_t* dst = image->m_data + y * image->GetRowSize();
+				for (size_t i = 0; i < rowFloatCount; i += channelCount) {
+					for (int c = 0; c < channelCount; c++) {
+						bool isAlpha = c == alphaChannel;
+						// Kaiser 의 음수 lobe 때문에 생긴 음수는 0 으로 자른다
+						float value = std::max(src[i + c] * (isAlpha ? alphaScale : 1.0f), 0.0f);
+						if (isAlpha)
+							value = std::min(value, 1.0f);
+						if (m_pixelType != PixelType::UInt8)
+							rowBuffer[i + c] = value;
+						else if (sRGB && !isAlpha)
+							dst[i + c] = linearToSRGB[(int)(std::min(value, 1.0f) *
+								LINEAR_TO_SRGB_TABLE_SIZE + 0.5f)];
+						else
+							dst[i + c] = (uint8_t)(std::min(value, 1.0f) * 255.0f + 0.5f);
+					}
+				}
+				if (m_pixelType == PixelType::Float) {
+					memcpy(dst, rowBuffer.data(), rowFloatCount * sizeof(float));
+				}
+				else if (m_pixelType == PixelType::Half) {
+					ConvertFloatToHalf(rowBuffer.data(), (uint16_t*)dst, rowFloatCount);
+				}
+				else if (m_pixelType == PixelType::RGB9E5) {
+					for (int x = 0; x < next.width; x++) {
+						uint32_t packed = PackRGB9E5(rowBuffer[x * 3], rowBuffer[x * 3 + 1],
+							rowBuffer[x * 3 + 2]);
+						memcpy(dst + x * 4, &packed, 4);
+					}
+				}
+			}
+		}, 16);
+		levels.push_back(std::move(image));
+		current = std::move(next);
+	}
+	return levels;
+}
+
+size_t GetBlockByteSize(BlockFormat format) {
+	switch (format) {
+		case BlockFormat::BC1:
+		case BlockFormat::BC4: return 8;
+		default: return 16;
+	}
+}
+
+const char* GetBlockFormatName(BlockFormat format) {
+	switch (format) {
+		case BlockFormat::BC1: return "BC1";
+		case BlockFormat::BC3: return "BC3";
+		case BlockFormat::BC4: return "BC4";
+		case BlockFormat::BC5: return "BC5";
+		case BlockFormat::BC6H: return "BC6H";
+	}
+	return "unknown";
+}
+
+CompressedImageUPtr CompressedImage::Create(BlockFormat format, int width, int height,
+	int levelCount, bool sRGB) {
+	if (width <= 0 || height <= 0 || levelCount <= 0) {
+		SPDLOG_ERROR("invalid compressed image size: {}x{}, {} levels",
+			width, height, levelCount);
+		return nullptr;
+	}
+	auto image = CompressedImageUPtr(new CompressedImage());
+	image->m_storage.resize(image->SetLayout(format, width, height, levelCount, sRGB));
+	image->m_data = image->m_storage.data();
+	return std::move(image);
+}
+
+size_t CompressedImage::SetLayout(BlockFormat format, int width, int height,
+	int levelCount, bool sRGB) {
+	m_format = format;
+	m_sRGB = sRGB;
+	m_width = width;
+	m_height = height;
+	m_levelOffsets.resize(levelCount);
+	size_t offset = 0;
+	for (int level = 0; level < levelCount; level++) {
+		m_levelOffsets[level] = offset;
+		offset += GetLevelSize(level);
+	}
+	m_dataSize = offset;
+	return offset;
+}
+
+size_t CompressedImage::GetLevelSize(int level) const {
+	size_t blockCountX = (GetWidth(level) + 3) / 4;
+	size_t blockCountY = (GetHeight(level) + 3) / 4;
+	return blockCountX * blockCountY * GetBlockByteSize(m_format);
+}
+
+// DDS 파일 구조: "DDS " | DDSHeader | (DX10 이면) DDSHeaderDX10 | level 0 ... level n-1
+struct DDSPixelFormat {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t bitMask[4];
+};
+
+struct DDSHeader {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DDSPixelFormat pixelFormat;
+	uint32_t caps[4];
+	uint32_t reserved2;
+};
+
+struct DDSHeaderDX10 {
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header must be 20 bytes");
+
+static constexpr uint32_t MakeFourCC(char a, char b, char c, char d) {
+	return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) |
+		((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+static const uint32_t DDS_MAGIC = MakeFourCC('D', 'D', 'S', ' ');
+static const uint32_t DDSD_CAPS = 0x1;
+static const uint32_t DDSD_HEIGHT = 0x2;
+static const uint32_t DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDSD_PITCH = 0x8;
+static const uint32_t DDPF_ALPHAPIXELS = 0x1;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDPF_LUMINANCE = 0x20000;
+static const uint32_t DDSCAPS_COMPLEX = 0x8;
+static const uint32_t DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP = 0x400000;
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+// DXGI_FORMAT 값
+static const uint32_t DXGI_FORMAT_R32G32B32A32_FLOAT = 2;
+static const uint32_t DXGI_FORMAT_R32G32B32_FLOAT = 6;
+static const uint32_t DXGI_FORMAT_R16G16B16A16_FLOAT = 10;
+static const uint32_t DXGI_FORMAT_R32G32_FLOAT = 16;
+static const uint32_t DXGI_FORMAT_R8G8B8A8_UNORM = 28;
+static const uint32_t DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29;
+static const uint32_t DXGI_FORMAT_R32_FLOAT = 41;
+static const uint32_t DXGI_FORMAT_R16G16_FLOAT = 34;
+static const uint32_t DXGI_FORMAT_R8G8_UNORM = 49;
+static const uint32_t DXGI_FORMAT_R16_FLOAT = 54;
+static const uint32_t DXGI_FORMAT_R8_UNORM = 61;
+static const uint32_t DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67;
+static const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+static const uint32_t DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+static const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+static const uint32_t DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+static const uint32_t DXGI_FORMAT_BC4_UNORM = 80;
+static const uint32_t DXGI_FORMAT_BC5_UNORM = 83;
+static const uint32_t DXGI_FORMAT_BC6H_UF16 = 95;
+
+static bool GetBlockFormatFromDXGI(uint32_t dxgiFormat, BlockFormat& format, bool& sRGB) {
+	sRGB = false;
+	switch (dxgiFormat) {
+		case DXGI_FORMAT_BC1_UNORM: format = BlockFormat::BC1; return true;
+		case DXGI_FORMAT_BC1_UNORM_SRGB: format = BlockFormat::BC1; sRGB = true; return true;
+		case DXGI_FORMAT_BC3_UNORM: format = BlockFormat::BC3; return true;
+		case DXGI_FORMAT_BC3_UNORM_SRGB: format = BlockFormat::BC3; sRGB = true; return true;
+		case DXGI_FORMAT_BC4_UNORM: format = BlockFormat::BC4; return true;
+		case DXGI_FORMAT_BC5_UNORM: format = BlockFormat::BC5; return true;
+		case DXGI_FORMAT_BC6H_UF16: format = BlockFormat::BC6H; return true;
+		default: return false;
+	}
+}
+
+static uint32_t GetDXGIFormat(BlockFormat format, bool sRGB) {
+	switch (format) {
+		case BlockFormat::BC1: return sRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case BlockFormat::BC3: return sRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+		case BlockFormat::BC4: return DXGI_FORMAT_BC4_UNORM;
+		case BlockFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+		case BlockFormat::BC6H: return DXGI_FORMAT_BC6H_UF16;
+	}
+	return 0;
+}
+
+// mapping 앞부분의 header 를 읽는다. data 는 info.dataOffset 부터
+struct DDSInfo {
+	DDSHeader header;
+	bool hasDX10;
+	DDSHeaderDX10 dx10;
+	size_t dataOffset;
+	int levelCount;
+};
+
+static bool ReadDDSInfo(const MappedFile* file, const std::string& filepath, DDSInfo& info) {
+	info = {};
+	size_t fileSize = file->GetSize();
+	uint32_t magic = 0;
+	if (fileSize < sizeof(magic) + sizeof(DDSHeader)) {
+		SPDLOG_ERROR("invalid dds: {}", filepath);
+		return false;
+	}
+	memcpy(&magic, file->GetData(), sizeof(magic));
+	memcpy(&info.header, file->GetData() + sizeof(magic), sizeof(DDSHeader));
+	if (magic != DDS_MAGIC || info.header.size != sizeof(DDSHeader)) {
+		SPDLOG_ERROR("invalid dds: {}", filepath);
+		return false;
+	}
+	info.dataOffset = sizeof(magic) + sizeof(DDSHeader);
+	auto& pixelFormat = info.header.pixelFormat;
+	info.hasDX10 = (pixelFormat.flags & DDPF_FOURCC) &&
+		pixelFormat.fourCC == MakeFourCC('D', 'X', '1', '0');
+	if (info.hasDX10) {
+		if (fileSize < info.dataOffset + sizeof(DDSHeaderDX10)) {
+			SPDLOG_ERROR("invalid dds: {}", filepath);
+			return false;
+		}
+		memcpy(&info.dx10, file->GetData() + info.dataOffset, sizeof(DDSHeaderDX10));
+		info.dataOffset += sizeof(DDSHeaderDX10);
+		if (info.dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D || info.dx10.arraySize > 1) {
+			SPDLOG_ERROR("unsupported dds dimension: {}", filepath);
+			return false;
+		}
+	}
+
+	auto& header = info.header;
+	info.levelCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::max((int)header.mipMapCount, 1) : 1;
+	// level 크기가 1x1 보다 작아지는 잘못된 mip 수는 거른다
+	int maxLevelCount = 1;
+	while ((std::max(header.width, header.height) >> maxLevelCount) > 0)
+		maxLevelCount++;
+	if (header.width == 0 || header.height == 0 || header.width > 16384 ||
+		header.height > 16384 || info.levelCount > maxLevelCount) {
+		SPDLOG_ERROR("invalid dds size: {} ({}x{}, {} levels)", filepath,
+			header.width, header.height, info.levelCount);
+		return false;
+	}
+	return true;
+}
+
+// DX10 header 가 없는 예전 FourCC 도 읽는다
+static bool GetDDSBlockFormat(const DDSInfo& info, BlockFormat& format, bool& sRGB) {
+	sRGB = false;
+	if (info.hasDX10)
+		return GetBlockFormatFromDXGI(info.dx10.dxgiFormat, format, sRGB);
+	auto& pixelFormat = info.header.pixelFormat;
+	uint32_t fourCC = (pixelFormat.flags & DDPF_FOURCC) ? pixelFormat.fourCC : 0;
+	if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+		format = BlockFormat::BC1;
+	else if (fourCC == MakeFourCC('D', 'X', 'T', '5'))
+		format = BlockFormat::BC3;
+	else if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U'))
+		format = BlockFormat::BC4;
+	else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U'))
+		format = BlockFormat::BC5;
+	else
+		return false;
+	return true;
+}
+
+// 압축하지 않은 format. byte 순서가 R, G, B, A 인 것만 읽는다
+static bool GetDDSRawFormat(const DDSInfo& info, int& channelCount, int& bytePerChannel) {
+	if (info.hasDX10) {
+		switch (info.dx10.dxgiFormat) {
+			case DXGI_FORMAT_R8_UNORM: channelCount = 1; bytePerChannel = 1; return true;
+			case DXGI_FORMAT_R8G8_UNORM: channelCount = 2; bytePerChannel = 1; return true;
+			case DXGI_FORMAT_R8G8B8A8_UNORM:
+			case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: channelCount = 4; bytePerChannel = 1; return true;
+			case DXGI_FORMAT_R32_FLOAT: channelCount = 1; bytePerChannel = 4; return true;
+			case DXGI_FORMAT_R32G32_FLOAT: channelCount = 2; bytePerChannel = 4; return true;
+			case DXGI_FORMAT_R32G32B32_FLOAT: channelCount = 3; bytePerChannel = 4; return true;
+			case DXGI_FORMAT_R32G32B32A32_FLOAT: channelCount = 4; bytePerChannel = 4; return true;
+			case DXGI_FORMAT_R16_FLOAT: channelCount = 1; bytePerChannel = 2; return true;
+			case DXGI_FORMAT_R16G16_FLOAT: channelCount = 2; bytePerChannel = 2; return true;
+			case DXGI_FORMAT_R16G16B16A16_FLOAT: channelCount = 4; bytePerChannel = 2; return true;
+			// bytePerChannel 0 은 RGB9E5
+			case DXGI_FORMAT_R9G9B9E5_SHAREDEXP: channelCount = 3; bytePerChannel = 0; return true;
+			default: return false;
+		}
+	}
+	// DXGI 에 24bit RGB 가 없어서 RGB8 은 예전 header 로 저장한다
+	auto& pixelFormat = info.header.pixelFormat;
+	bytePerChannel = 1;
+	if ((pixelFormat.flags & DDPF_RGB) && pixelFormat.rgbBitCount == 24 &&
+		pixelFormat.bitMask[0] == 0xff && pixelFormat.bitMask[1] == 0xff00 &&
+		pixelFormat.bitMask[2] == 0xff0000) {
+		channelCount = 3;
+		return true;
+	}
+	if ((pixelFormat.flags & DDPF_RGB) && (pixelFormat.flags & DDPF_ALPHAPIXELS) &&
+		pixelFormat.rgbBitCount == 32 && pixelFormat.bitMask[0] == 0xff &&
+		pixelFormat.bitMask[1] == 0xff00 && pixelFormat.bitMask[2] == 0xff0000 &&
+		pixelFormat.bitMask[3] == 0xff000000) {
+		channelCount = 4;
+		return true;
+	}
+	if ((pixelFormat.flags & DDPF_LUMINANCE) && pixelFormat.rgbBitCount == 8) {
+		channelCount = 1;
+		return true;
+	}
+	return false;
+}
+
+bool IsBlockCompressedDDS(const std::string& filepath) {
+	auto file = MappedFile::Open(filepath);
+	DDSInfo info;
+	if (!file || !ReadDDSInfo(file.get(), filepath, info))
+		return false;
+	BlockFormat format;
+	bool sRGB;
+	return GetDDSBlockFormat(info, format, sRGB);
+}
+
+CompressedImageUPtr CompressedImage::LoadDDS(const std::string& filepath) {
+	// CompressImage 로 만든 이미지처럼 GetData() 로 고칠 수 있게 copy-on-write 로 연다
+	auto file = MappedFile::Open(filepath, true);
+	if (!file)
+		return nullptr;
+	DDSInfo info;
+	if (!ReadDDSInfo(file.get(), filepath, info))
+		return nullptr;
+	BlockFormat format = BlockFormat::BC1;
+	bool sRGB = false;
+	if (!GetDDSBlockFormat(info, format, sRGB)) {
+		SPDLOG_ERROR("unsupported dds format: {}", filepath);
+		return nullptr;
+	}
+
+	auto image = CompressedImageUPtr(new CompressedImage());
+	size_t dataSize = image->SetLayout(format, (int)info.header.width, (int)info.header.height,
+		info.levelCount, sRGB);
+	if (file->GetSize() - info.dataOffset < dataSize) {
+		SPDLOG_ERROR("truncated dds: {}", filepath);
+		return nullptr;
+	}
+	image->m_data = file->GetWritableData() + info.dataOffset;
+	image->m_mappedFile = std::move(file);
+	return std::move(image);
+}
+
+static void WriteDDSHeader(std::ofstream& file, const DDSHeader& header,
+	const DDSHeaderDX10* dx10) {
+	file.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+	file.write((const char*)&header, sizeof(header));
+	if (dx10)
+		file.write((const char*)dx10, sizeof(*dx10));
+}
+
+bool CompressedImage::SaveDDS(const std::string& filepath) const {
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+		DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = (uint32_t)m_height;
+	header.width = (uint32_t)m_width;
+	header.pitchOrLinearSize = (uint32_t)GetLevelSize(0);
+	header.mipMapCount = (uint32_t)GetLevelCount();
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = MakeFourCC('D', 'X', '1', '0');
+	header.caps[0] = DDSCAPS_TEXTURE;
+	if (GetLevelCount() > 1)
+		header.caps[0] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	DDSHeaderDX10 dx10 = {};
+	dx10.dxgiFormat = GetDXGIFormat(m_format, m_sRGB);
+	dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	dx10.arraySize = 1;
+
+	std::ofstream file(filepath, std::ios::binary);
+	WriteDDSHeader(file, header, &dx10);
+	file.write((const char*)m_data, m_dataSize);
+	if (!file) {
+		SPDLOG_ERROR("failed to write dds: {}", filepath);
+		return false;
+	}
+	return true;
+}
+
+std::vector<ImageUPtr> Image::LoadDDS(const std::string& filepath) {
+	std::vector<ImageUPtr> levels;
+	MappedFilePtr file = MappedFile::Open(filepath, true);
+	if (!file)
+		return levels;
+	DDSInfo info;
+	if (!ReadDDSInfo(file.get(), filepath, info))
+		return levels;
+	int channelCount = 0;
+	int bytePerChannel = 0;
+	if (!GetDDSRawFormat(info, channelCount, bytePerChannel)) {
+		SPDLOG_ERROR("unsupported uncompressed dds format: {}", filepath);
+		return levels;
+	}
+
+	size_t offset = info.dataOffset;
+	for (int level = 0; level < info.levelCount; level++) {
+		auto image = ImageUPtr(new Image());
+		image->m_width = std::max((int)info.header.width >> level, 1);
+		image->m_height = std::max((int)info.header.height >> level, 1);
+		image->m_channelCount = channelCount;
+		image->m_bytePerChannel = bytePerChannel;
+		image->m_pixelType = bytePerChannel == 0 ? PixelType::RGB9E5 :
+			bytePerChannel == 2 ? PixelType::Half :
+			bytePerChannel == 4 ? PixelType::Float : PixelType::UInt8;
+		size_t size = image->GetDataSize();
+		if (file->GetSize() - offset < size) {
+			SPDLOG_ERROR("truncated dds: {}", filepath);
+			levels.clear();
+			return levels;
+		}
+		image->m_data = file->GetWritableData() + offset;
+		image->m_mappedFile = file;
+		offset += size;
+		levels.push_back(std::move(image));
+	}
+	return levels;
+}
+
+bool Image::SaveDDS(const std::string& filepath, const std::vector<ImageUPtr>& mipLevels) const {
+	// DXGI 에 RGB half 가 없어서 3 channel half 는 저장할 수 없다
+	if (m_pixelType == PixelType::Half && m_channelCount == 3) {
+		SPDLOG_ERROR("can not save 3 channel half float image as dds: {}", filepath);
+		return false;
+	}
+	for (auto& level: mipLevels) {
+		if (level->m_channelCount != m_channelCount || level->m_pixelType != m_pixelType) {
+			SPDLOG_ERROR("mip level format mismatch: {}", filepath);
+			return false;
+		}
+	}
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+		DDSD_MIPMAPCOUNT | DDSD_PITCH;
+	header.height = (uint32_t)m_height;
+	header.width = (uint32_t)m_width;
+	header.pitchOrLinearSize = (uint32_t)GetRowSize();
+	header.mipMapCount = (uint32_t)mipLevels.size() + 1;
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.caps[0] = DDSCAPS_TEXTURE;
+	if (!mipLevels.empty())
+		header.caps[0] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	DDSHeaderDX10 dx10 = {};
+	dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	dx10.arraySize = 1;
+	bool useDX10 = true;
+	if (m_pixelType == PixelType::UInt8 && m_channelCount == 3) {
+		header.pixelFormat.flags = DDPF_RGB;
+		header.pixelFormat.rgbBitCount = 24;
+		header.pixelFormat.bitMask[0] = 0xff;
+		header.pixelFormat.bitMask[1] = 0xff00;
+		header.pixelFormat.bitMask[2] = 0xff0000;
+		useDX10 = false;
+	}
+	else {
+		static const uint32_t unormFormats[] = { DXGI_FORMAT_R8_UNORM, DXGI_FORMAT_R8G8_UNORM,
+			0, DXGI_FORMAT_R8G8B8A8_UNORM };
+		static const uint32_t floatFormats[] = { DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32G32_FLOAT,
+			DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT };
+		static const uint32_t halfFormats[] = { DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16G16_FLOAT,
+			0, DXGI_FORMAT_R16G16B16A16_FLOAT };
+		header.pixelFormat.flags = DDPF_FOURCC;
+		header.pixelFormat.fourCC = MakeFourCC('D', 'X', '1', '0');
+		switch (m_pixelType) {
+			case PixelType::UInt8: dx10.dxgiFormat = unormFormats[m_channelCount - 1]; break;
+			case PixelType::Half: dx10.dxgiFormat = halfFormats[m_channelCount - 1]; break;
+			case PixelType::Float: dx10.dxgiFormat = floatFormats[m_channelCount - 1]; break;
+			case PixelType::RGB9E5: dx10.dxgiFormat = DXGI_FORMAT_R9G9B9E5_SHAREDEXP; break;
+		}
+	}
+
+	std::ofstream file(filepath, std::ios::binary);
+	WriteDDSHeader(file, header, useDX10 ? &dx10 : nullptr);
+	file.write((const char*)m_data, GetDataSize());
+	for (auto& level: mipLevels)
+		file.write((const char*)level->m_data, level->GetDataSize());
+	if (!file) {
+		SPDLOG_ERROR("failed to write dds: {}", filepath);
+		return false;
+	}
+	return true;
+}
+
+// process 의 최대 resident memory (byte)
+static size_t GetPeakResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+bool RunImageLoadBenchmark(const std::string& mode, const std::vector<std::string>& filepaths,
+	size_t arenaCapacity) {
+	bool mapped = mode == "mmap";
+	// hdr-* 는 .hdr 을 지정한 pixel format 으로 풀 때의 시간과 메모리를 비교한다
+	bool hdr = mode.compare(0, 4, "hdr-") == 0;
+	HdrFormat hdrFormat = HdrFormat::Float;
+	ImageArenaUPtr arena;
+	if (mode == "arena") {
+		arena = ImageArena::Create(arenaCapacity);
+		if (!arena)
+			return false;
+	}
+	else if (mode == "hdr-half") {
+		hdrFormat = HdrFormat::Half;
+	}
+	else if (mode == "hdr-rgb9e5") {
+		hdrFormat = HdrFormat::RGB9E5;
+	}
+	else if (mode != "stb" && mode != "hdr-float" && !mapped) {
+		SPDLOG_ERROR("unknown image load benchmark mode: {}", mode);
+		return false;
+	}
+
+	size_t startPeak = GetPeakResidentMemory();
+	float totalTime = 0.0f;
+	size_t totalSize = 0;
+	SPDLOG_INFO("image load benchmark: {}", mode);
+	for (auto& filepath: filepaths) {
+		auto path = filepath;
+		if (mapped)
+			path = filepath.substr(0, filepath.find_last_of('.')) + ".dds";
+		auto startTime = std::chrono::steady_clock::now();
+		auto image = hdr ? LoadRadianceHDR(path, hdrFormat) : Image::Load(path, true, arena.get());
+		if (!image) {
+			if (mapped)
+				SPDLOG_ERROR("run --bake-image {} {} first", filepath, path);
+			return false;
+		}
+		// upload 처럼 pixel 을 한 번 다 읽어야 mapping 의 page fault 까지 시간에 들어간다
+		uint64_t checksum = 0;
+		const uint8_t* data = image->GetData();
+		size_t size = image->GetDataSize();
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t value;
+			memcpy(&value, data + i, 8);
+			checksum += value;
+		}
+		for (; i < size; i++)
+			checksum += data[i];
+		float elapsed = std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count();
+		totalTime += elapsed;
+		totalSize += size;
+		SPDLOG_INFO("  {}: {}x{}x{} ({} byte/pixel), {:.2f} ms, checksum {:016x}",
+			path, image->GetWidth(), image->GetHeight(), image->GetChannelCount(),
+			image->GetPixelSize(), elapsed, checksum);
+	}
+
+	size_t peak = GetPeakResidentMemory();
+	SPDLOG_INFO("  total {} files, {:.1f} MB pixels, {:.2f} ms, peak RSS {:.1f} MB (+{:.1f} MB while loading)",
+		filepaths.size(), totalSize / (1024.0f * 1024.0f), totalTime,
+		peak / (1024.0f * 1024.0f), (peak - startPeak) / (1024.0f * 1024.0f));
+	if (arena) {
+		SPDLOG_INFO("  arena peak {:.1f} MB of {:.1f} MB, {} malloc fallbacks",
+			arena->GetPeakSize() / (1024.0f * 1024.0f),
+			arena->GetCapacity() / (1024.0f * 1024.0f), arena->GetFallbackCount());
+	}
+	return true;
+}
+
+bool RunMipChainTest() {
+	bool success = true;
+	auto Check = [&](bool condition, const std::string& message) {
+		if (!condition) {
+			SPDLOG_ERROR("mip chain test failed: {}", message);
+			success = false;
+		}
+	};
+	std::mt19937 random(5);
+
+	// 1. box: level n 의 pixel 은 level 0 의 2^n x 2^n block 평균을 한 번만 반올림한 값이어야 한다
+	// (높이가 먼저 1 이 되면 그 뒤로는 같은 행을 두 번 더하므로 block 높이는 원본 높이에서 멈춘다)
+	// channel 4 는 SSE 경로, 나머지는 scalar 경로를 탄다
+	for (int channelCount: { 1, 3, 4 }) {
+		const int width = 64;
+		const int height = 16;
+		auto image = Image::Create(width, height, channelCount);
+		for (size_t i = 0; i < image->GetDataSize(); i++)
+			image->GetData()[i] = (uint8_t)random();
+		auto levels = image->GenerateMipChain();
+		Check(levels.size() == 6, fmt::format("box {} channels: {} levels", channelCount, levels.size()));
+		int wrongCount = 0;
+		for (size_t n = 0; n < levels.size(); n++) {
+			int blockWidth = 2 << n;
+			int blockHeight = std::min(blockWidth, height);
+			auto& level = levels[n];
+			for (int y = 0; y < level->GetHeight(); y++) {
+				for (int x = 0; x < level->GetWidth(); x++) {
+					for (int c = 0; c < channelCount; c++) {
+						uint64_t sum = 0;
+						for (int by = 0; by < blockHeight; by++) {
+							for (int bx = 0; bx < blockWidth; bx++) {
+								sum += image->GetData()[(((size_t)y * blockHeight + by) * width +
+									x * blockWidth + bx) * channelCount + c];
+							}
+						}
+						double average = (double)sum / (blockWidth * blockHeight);
+						int value = level->GetData()[((size_t)y * level->GetWidth() + x) * channelCount + c];
+						// 평균이 정확히 .5 면 float 반올림 방향이 달라도 된다
+						bool tie = fabs(average - floor(average) - 0.5) < 1e-6;
+						int expected = (int)floor(average + 0.5);
+						if (value != expected && !(tie && value == expected - 1))
+							wrongCount++;
+					}
+				}
+			}
+		}
+		Check(wrongCount == 0, fmt::format("box {} channels: {} values differ from the block average",
+			channelCount, wrongCount));
+	}
+
+	// 2. Kaiser: weight 합이 1 이므로 평평한 이미지는 가장자리까지 모든 level 에서 그대로 남는다
+	// 2 의 거듭제곱이 아닌 크기로 홀수 폭 / clamp 경로도 지나게 한다
+	for (bool sRGB: { false, true }) {
+		const uint8_t color[4] = { 0, 77, 200, 255 };
+		auto image = Image::Create(37, 23, 4);
+		for (size_t i = 0; i < image->GetDataSize(); i++)
+			image->GetData()[i] = color[i % 4];
+		MipChainOption option;
+		option.filter = MipFilter::Kaiser;
+		option.sRGB = sRGB;
+		auto levels = image->GenerateMipChain(option);
+		Check(!levels.empty() && levels.back()->GetWidth() == 1 && levels.back()->GetHeight() == 1,
+			"kaiser chain does not end at 1x1");
+		int wrongCount = 0;
+		for (auto& level: levels) {
+			for (size_t i = 0; i < level->GetDataSize(); i++) {
+				if (level->GetData()[i] != color[i % 4])
+					wrongCount++;
+			}
+		}
+		Check(wrongCount == 0, fmt::format("kaiser{} flat image changed in {} values",
+			sRGB ? " sRGB" : "", wrongCount));
+	}
+
+	// 3. sRGB: 0 / 255 checker 를 linear 로 평균하면 0.5 -> sRGB 188 (gamma 공간 평균이면 128)
+	// 0 / 255 는 decode 를 빼먹어도 같은 값이라 64 / 192 checker 도 식으로 계산한 값과 비교한다
+	auto SRGBToLinear = [](double value) {
+		value /= 255.0;
+		return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+	};
+	auto LinearToSRGB = [](double value) {
+		value = value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+		return (int)floor(value * 255.0 + 0.5);
+	};
+	for (auto checker: { std::make_pair(0, 255), std::make_pair(64, 192) }) {
+		int expected = LinearToSRGB((SRGBToLinear(checker.first) + SRGBToLinear(checker.second)) * 0.5);
+		int expectedAlpha = (checker.first + checker.second + 1) / 2;
+		auto image = Image::Create(32, 32, 4);
+		for (int y = 0; y < 32; y++) {
+			for (int x = 0; x < 32; x++) {
+				uint8_t value = (uint8_t)(((x + y) & 1) ? checker.second : checker.first);
+				uint8_t* pixel = image->GetData() + ((size_t)y * 32 + x) * 4;
+				pixel[0] = pixel[1] = pixel[2] = value;
+				pixel[3] = value;
+			}
+		}
+		MipChainOption option;
+		option.sRGB = true;
+		auto levels = image->GenerateMipChain(option);
+		int wrongCount = 0;
+		for (auto& level: levels) {
+			for (size_t i = 0; i < level->GetDataSize(); i++) {
+				// alpha 는 sRGB 변환 없이 평균한다
+				if (level->GetData()[i] != ((i % 4 == 3) ? expectedAlpha : expected))
+					wrongCount++;
+			}
+		}
+		Check(checker.first != 0 || expected == 188, fmt::format("0 / 255 checker reference {}", expected));
+		Check(!levels.empty() && wrongCount == 0,
+			fmt::format("sRGB {} / {} checker: {} values differ from {} (alpha {})",
+				checker.first, checker.second, wrongCount, expected, expectedAlpha));
+	}
+
+	// 4. alpha coverage: 가장자리가 부드러운 가는 풀잎 모양 alpha 는 그냥 줄이면 멀리서 얇아진다
+	// 보존하면 cutoff 이상 비율이 level 0 과 1% 안에서 같아야 한다 (256 pixel 이상인 level 만)
+	{
+		const int size = 256;
+		auto image = Image::Create(size, size, 4);
+		memset(image->GetData(), 0, image->GetDataSize());
+		std::vector<float> alpha((size_t)size * size, 0.0f);
+		auto Uniform = [&](float minValue, float maxValue) {
+			return std::uniform_real_distribution<float>(minValue, maxValue)(random);
+		};
+		for (int blade = 0; blade < 50; blade++) {
+			float root = Uniform(0.0f, (float)size);
+			int top = (int)Uniform(0.0f, size * 0.5f);
+			float halfWidth = Uniform(0.7f, 2.5f);
+			float lean = Uniform(-0.3f, 0.3f);
+			for (int y = top; y < size; y++) {
+				// 끝으로 갈수록 가늘어지고, 1 pixel 폭으로 anti-aliasing 된 가장자리
+				float width = halfWidth * std::min(1.0f, 4.0f * (y - top) / (size - top));
+				float center = root + lean * (size - y);
+				for (int x = (int)floorf(center - width - 2.0f); x <= (int)(center + width + 2.0f); x++) {
+					float value = glm::clamp(width + 0.5f - fabsf(x + 0.5f - center), 0.0f, 1.0f);
+					float& dst = alpha[(size_t)y * size + (x % size + size) % size];
+					dst = std::max(dst, value);
+				}
+			}
+		}
+		for (size_t i = 0; i < alpha.size(); i++) {
+			image->GetData()[i * 4 + 1] = 180;
+			image->GetData()[i * 4 + 3] = (uint8_t)(alpha[i] * 255.0f + 0.5f);
+		}
+		auto Coverage = [](const Image* level, float cutoff) {
+			size_t pixelCount = (size_t)level->GetWidth() * level->GetHeight();
+			size_t coveredCount = 0;
+			for (size_t i = 0; i < pixelCount; i++) {
+				if (level->GetData()[i * 4 + 3] / 255.0f >= cutoff)
+					coveredCount++;
+			}
+			return (float)coveredCount / (float)pixelCount;
+		};
+		for (auto filter: { MipFilter::Box, MipFilter::Kaiser }) {
+			const char* filterName = filter == MipFilter::Box ? "box" : "kaiser";
+			MipChainOption option;
+			option.filter = filter;
+			option.preserveAlphaCoverage = true;
+			float target = Coverage(image.get(), option.alphaCutoff);
+			auto levels = image->GenerateMipChain(option);
+			option.preserveAlphaCoverage = false;
+			auto plainLevels = image->GenerateMipChain(option);
+			float maxError = 0.0f;
+			float maxPlainError = 0.0f;
+			for (size_t n = 0; n < levels.size(); n++) {
+				if (levels[n]->GetWidth() * levels[n]->GetHeight() < 256)
+					break;
+				maxError = std::max(maxError, fabsf(Coverage(levels[n].get(), option.alphaCutoff) - target));
+				maxPlainError = std::max(maxPlainError,
+					fabsf(Coverage(plainLevels[n].get(), option.alphaCutoff) - target));
+			}
+			SPDLOG_INFO("  {} alpha coverage {:.3f}: max error {:.4f} (without preserving {:.4f})",
+				filterName, target, maxError, maxPlainError);
+			Check(maxError <= 0.01f, fmt::format("{} alpha coverage error {:.4f}", filterName, maxError));
+			// 보존하지 않아도 그대로면 이 이미지로는 검사가 의미 없다
+			Check(maxPlainError > 0.03f, fmt::format("{} coverage test image is too easy", filterName));
+		}
+	}
+
+	if (success)
+		SPDLOG_INFO("mip chain test passed");
+	return success;
+}
@@ -2,32 +2,219 @@
 #define __IMAGE_H__
 
 #include "common.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+enum class MipFilter {
+    Box,        // 2x2 평균
+    Kaiser,     // Kaiser window sinc 6 tap, 더 선명하다
+};
+
+struct MipChainOption {
+    MipFilter filter { MipFilter::Box };
+    // 8bit color channel 을 sRGB 로 보고 linear 공간에서 filtering 한다 (alpha 는 그대로)
+    bool sRGB { false };
+    // alpha test 하는 텍스처 (grass.png 등) 가 멀리서 사라지지 않도록
+    // level 마다 alphaCutoff 이상인 pixel 비율을 level 0 과 같게 alpha 를 늘린다
+    bool preserveAlphaCoverage { false };
+    float alphaCutoff { 0.5f };
+};
+
+// Image pixel 메모리를 받아 오는 곳. 기본은 malloc / realloc / free
+// stb 가 decode 중에 쓰는 임시 buffer 도 같은 allocator 에서 받는다
+class ImageAllocator {
+public:
+    static ImageAllocator* GetDefault();
+    virtual ~ImageAllocator() {}
+
+    virtual void* Allocate(size_t size) = 0;
+    // ptr 이 nullptr 이면 Allocate 와 같다
+    virtual void* Reallocate(void* ptr, size_t size) = 0;
+    virtual void Free(void* ptr) = 0;
+};
+
+// 미리 잡아 둔 한 덩어리를 앞에서부터 잘라 주는 allocator
+// - 마지막 block 은 제자리에서 늘이고 줄인다 (stb 의 zlib buffer 처럼 realloc 으로 자라는 경우)
+// - 맨 위 block 들이 해제되면 그만큼 되돌아가서, 이미지를 하나씩 읽고 버리는 동안 같은 메모리를 재사용한다
+// - 남은 공간이 모자라면 malloc 으로 넘긴다
+// 여러 worker 에서 같이 써도 된다. 이 arena 로 만든 Image 보다 오래 살아야 한다
+CLASS_PTR(ImageArena)
+class ImageArena : public ImageAllocator {
+public:
+    static ImageArenaUPtr Create(size_t capacity);
+    ~ImageArena() override;
+
+    void* Allocate(size_t size) override;
+    void* Reallocate(void* ptr, size_t size) override;
+    void Free(void* ptr) override;
+
+    size_t GetCapacity() const { return m_capacity; }
+    size_t GetUsedSize() const { return m_top; }
+    size_t GetPeakSize() const { return m_peakSize; }
+    // 공간이 모자라 malloc 으로 넘긴 횟수
+    size_t GetFallbackCount() const { return m_fallbackCount; }
+
+private:
+    ImageArena() {}
+    bool Init(size_t capacity);
+    bool Owns(const void* ptr) const {
+        return ptr >= m_memory && ptr < m_memory + m_capacity;
+    }
+
+    // 각 block 앞에 붙는 header. data 가 16 byte 정렬되도록 크기를 맞춘다
+    struct alignas(16) BlockHeader {
+        size_t size;
+        size_t prevBlock;    // 바로 아래 block 의 header 위치
+        bool freed;
+    };
+    static const size_t NO_BLOCK = (size_t)-1;
+
+    std::mutex m_mutex;
+    uint8_t* m_memory { nullptr };
+    size_t m_capacity { 0 };
+    size_t m_top { 0 };
+    size_t m_lastBlock { NO_BLOCK };
+    size_t m_peakSize { 0 };
+    size_t m_fallbackCount { 0 };
+};
+
+// pixel 저장 방식. Create 는 bytePerChannel 로 정한다 (1 = UInt8, 2 = Half, 4 = Float)
+enum class PixelType {
+    UInt8,
+    Half,
+    Float,
+    RGB9E5,     // RGB 가 exponent 를 공유하는 32bit packed pixel, channel 단위 크기가 없다
+};
 
 CLASS_PTR(Image)
 class Image {
 public:
-    static ImageUPtr Load(const std::string& filepath, bool flipVertical = true);
-    static ImageUPtr Create(int width, int height, int channelCount = 4, int bytePerChannel = 1);
+    // .dds 는 LoadDDS 의 level 0 을 돌려준다 (flipVertical 무시)
+    // 그 외에는 파일을 map 해서 stb 로 decode 한다. allocator 가 nullptr 이면 ImageAllocator::GetDefault()
+    static ImageUPtr Load(const std::string& filepath, bool flipVertical = true,
+        ImageAllocator* allocator = nullptr);
+    // 압축하지 않은 DDS 를 map 해서 pixel 을 복사하지 않고 그대로 가리킨다 ([0] 이 원본, 나머지는 mip level)
+    // copy-on-write mapping 이라 GetData() 로 고쳐도 파일은 바뀌지 않는다
+    // SaveDDS 로 저장한 8bit / float 1~4 channel 만 읽는다
+    static std::vector<ImageUPtr> LoadDDS(const std::string& filepath);
+    static ImageUPtr Create(int width, int height, int channelCount = 4, int bytePerChannel = 1,
+        ImageAllocator* allocator = nullptr);
+    // channel 수는 3, GetBytePerChannel() 은 0 이다
+    static ImageUPtr CreateRGB9E5(int width, int height, ImageAllocator* allocator = nullptr);
     static ImageUPtr CreateSingleColorImage(int width, int height, const glm::vec4& color);
     ~Image();
 
+    // 이 이미지를 level 0 으로, mipLevels 를 그 다음 level 로 저장한다
+    bool SaveDDS(const std::string& filepath, const std::vector<ImageUPtr>& mipLevels = {}) const;
+
     const uint8_t* GetData() const { return m_data; }
+    uint8_t* GetData() { return m_data; }
     int GetWidth() const { return m_width; }
     int GetHeight() const { return m_height; }
     int GetChannelCount() const { return m_channelCount; }
     int GetBytePerChannel() const { return m_bytePerChannel; }
+    PixelType GetPixelType() const { return m_pixelType; }
+    size_t GetPixelSize() const {
+        return m_pixelType == PixelType::RGB9E5 ? 4 : (size_t)m_channelCount * m_bytePerChannel;
+    }
+    size_t GetRowSize() const { return (size_t)m_width * GetPixelSize(); }
+    size_t GetDataSize() const { return GetRowSize() * m_height; }
+    // pixel 이 파일 mapping 을 가리키고 있는지
+    bool IsMapped() const { return m_mappedFile != nullptr; }
 
     void SetCheckImage(int gridX, int gridY);
 
+    // y 행을 pixel 당 channel 수만큼의 float 로 풀어서 dst 에 쓴다 (8bit 는 /255, sRGB 변환 없음)
+    void GetRowAsFloat(int y, float* dst) const;
+    // half / RGB9E5 등을 float 이미지로 바꾼다 (float 만 받는 offline 도구용)
+    ImageUPtr ConvertToFloat() const;
+
+    // level 1 부터 1x1 까지의 mip level 을 CPU 에서 만든다 (이 이미지가 level 0)
+    // 이전 level 을 float 로 들고 다음 level 을 만들어 양자화 오차가 쌓이지 않는다
+    // 행 단위로 threadPool 에 나눠서 처리한다 (nullptr 이면 ThreadPool::GetDefault())
+    std::vector<ImageUPtr> GenerateMipChain(const MipChainOption& option = {},
+        ThreadPool* threadPool = nullptr) const;
+
 private:
     Image() {};
-    bool LoadWithStb(const std::string& filepath, bool flipVertical);
-    bool Allocate(int width, int height, int channelCount, int bytePerChannel);
+    bool LoadWithStb(const std::string& filepath, bool flipVertical, ImageAllocator* allocator);
+    bool Allocate(int width, int height, int channelCount, int bytePerChannel,
+        ImageAllocator* allocator);
     int m_width { 0 };
     int m_height { 0 };
     int m_channelCount { 0 };
     int m_bytePerChannel { 1 };
+    PixelType m_pixelType { PixelType::UInt8 };
+    uint8_t* m_data { nullptr };
+    // m_data 를 해제할 allocator, mapping 을 가리키면 nullptr
+    ImageAllocator* m_allocator { nullptr };
+    // 같은 DDS 의 level 들이 하나의 mapping 을 나눠 쓴다
+    MappedFilePtr m_mappedFile;
+};
+
+// 4x4 pixel 단위 GPU block 압축 format
+enum class BlockFormat : uint32_t {
+    BC1,        // RGB, 8 byte
+    BC3,        // RGBA, 16 byte
+    BC4,        // R, 8 byte
+    BC5,        // RG, 16 byte (normal map)
+    BC6H,       // RGB half float (unsigned), 16 byte
+};
+size_t GetBlockByteSize(BlockFormat format);
+const char* GetBlockFormatName(BlockFormat format);
+
+// DDS 가 block 압축 format 인지 header 만 보고 판단한다
+bool IsBlockCompressedDDS(const std::string& filepath);
+
+// block 압축된 mip chain. DDS (DX10 header) 로 읽고 쓴다
+CLASS_PTR(CompressedImage)
+class CompressedImage {
+public:
+    static CompressedImageUPtr Create(BlockFormat format, int width, int height,
+        int levelCount, bool sRGB = false);
+    // 파일을 map 해서 block data 를 복사하지 않고 그대로 가리킨다
+    static CompressedImageUPtr LoadDDS(const std::string& filepath);
+    bool SaveDDS(const std::string& filepath) const;
+
+    BlockFormat GetFormat() const { return m_format; }
+    bool IsSRGB() const { return m_sRGB; }
+    int GetLevelCount() const { return (int)m_levelOffsets.size(); }
+    int GetWidth(int level = 0) const { return std::max(m_width >> level, 1); }
+    int GetHeight(int level = 0) const { return std::max(m_height >> level, 1); }
+    const uint8_t* GetData(int level) const { return m_data + m_levelOffsets[level]; }
+    uint8_t* GetData(int level) { return m_data + m_levelOffsets[level]; }
+    size_t GetLevelSize(int level) const;
+    size_t GetDataSize() const { return m_dataSize; }
+
+private:
+    CompressedImage() {}
+    // level 배치를 정하고 전체 data 크기를 돌려준다
+    size_t SetLayout(BlockFormat format, int width, int height, int levelCount, bool sRGB);
+
+    BlockFormat m_format { BlockFormat::BC1 };
+    bool m_sRGB { false };
+    int m_width { 0 };
+    int m_height { 0 };
+    std::vector<size_t> m_levelOffsets;
+    // Create 로 만들면 m_storage, LoadDDS 로 읽으면 m_mappedFile 을 가리킨다
     uint8_t* m_data { nullptr };
+    size_t m_dataSize { 0 };
+    std::vector<uint8_t> m_storage;
+    MappedFileUPtr m_mappedFile;
 };
 
+// 이미지 loading 방식별 시간과 최대 resident memory 를 log 로 남긴다
+// mode: stb (malloc), arena (ImageArena), mmap (같은 이름의 --bake-image .dds 를 map)
+//       hdr-float / hdr-half / hdr-rgb9e5 (.hdr 을 LoadRadianceHDR 로 해당 format 으로 decode)
+// 최대 RSS 는 process 전체 값이라 mode 하나당 process 하나로 실행해서 비교한다
+bool RunImageLoadBenchmark(const std::string& mode, const std::vector<std::string>& filepaths,
+    size_t arenaCapacity = 64 << 20);
+
+// GenerateMipChain 의 box 평균, Kaiser 의 평평한 이미지 보존, sRGB checker 평균 (188),
+// alpha coverage 보존 (1% 이내) 을 검사한다. GL context 없이 동작
+bool RunMipChainTest();
+
 #endif // __IMAGE_H__
\ No newline at end of file
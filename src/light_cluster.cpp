@@ -0,0 +1,416 @@
+#include "light_cluster.h"
+#include "render_state.h"
+#include "simd.h"
+#include <cfloat>
+#include <chrono>
+#include <random>
+
+LightClusterUPtr LightCluster::Create(int gridX, int gridY, int gridZ) {
+    auto cluster = LightClusterUPtr(new LightCluster());
+    if (!cluster->Init(gridX, gridY, gridZ))
+        return nullptr;
+    return std::move(cluster);
+}
+
+float LightCluster::ComputeLightRadius(const glm::vec3& color, float range, float threshold) {
+    // 1 / (kc + kl * d + kq * d^2) * intensity == threshold 인 d
+    auto coeff = GetAttenuationCoeff(range);
+    float intensity = glm::max(color.r, glm::max(color.g, color.b));
+    float target = intensity / threshold;
+    if (target <= coeff.x)
+        return 0.0f;
+    if (coeff.z > 0.0f) {
+        float discriminant = coeff.y * coeff.y - 4.0f * coeff.z * (coeff.x - target);
+        return (-coeff.y + sqrtf(discriminant)) / (2.0f * coeff.z);
+    }
+    if (coeff.y > 0.0f)
+        return (target - coeff.x) / coeff.y;
+    return range;
+}
+
+bool LightCluster::Init(int gridX, int gridY, int gridZ) {
+    if (!InitGrid(gridX, gridY, gridZ))
+        return false;
+    m_lightTexture = BufferTexture::Create(GL_RGBA32F);
+    m_gridTexture = BufferTexture::Create(GL_RG32UI);
+    m_indexTexture = BufferTexture::Create(GL_R32UI);
+    return true;
+}
+
+bool LightCluster::InitGrid(int gridX, int gridY, int gridZ) {
+    if (gridX <= 0 || gridY <= 0 || gridZ <= 0) {
+        SPDLOG_ERROR("invalid light cluster grid: {}x{}x{}", gridX, gridY, gridZ);
+        return false;
+    }
+    m_gridX = gridX;
+    m_gridY = gridY;
+    m_gridZ = gridZ;
+    // SSE 로 x 방향 tile 4개씩 검사하므로 4의 배수로 맞춘다
+    m_paddedGridX = (gridX + 3) & ~3;
+
+    m_sliceCounts.resize(gridZ);
+    m_sliceIndices.resize(gridZ);
+    return true;
+}
+
+void LightCluster::UpdateClusterBounds(float fovy, float aspect, float nearPlane, float farPlane) {
+    m_fovy = fovy;
+    m_aspect = aspect;
+    m_nearPlane = nearPlane;
+    m_farPlane = farPlane;
+    m_tanHalfY = tanf(fovy * 0.5f);
+    m_tanHalfX = m_tanHalfY * aspect;
+
+    // depth 는 near ~ far 를 지수 간격으로 나눈다 (가까운 쪽 slice 가 얇다)
+    m_sliceDepth.resize(m_gridZ + 1);
+    for (int k = 0; k <= m_gridZ; k++)
+        m_sliceDepth[k] = nearPlane * powf(farPlane / nearPlane, (float)k / (float)m_gridZ);
+
+    m_tileMinX.assign(m_gridZ * m_paddedGridX, FLT_MAX);
+    m_tileMaxX.assign(m_gridZ * m_paddedGridX, -FLT_MAX);
+    m_tileMinY.resize(m_gridZ * m_gridY);
+    m_tileMaxY.resize(m_gridZ * m_gridY);
+    for (int k = 0; k < m_gridZ; k++) {
+        float depthNear = m_sliceDepth[k];
+        float depthFar = m_sliceDepth[k + 1];
+        for (int i = 0; i < m_gridX; i++) {
+            float ndcMin = 2.0f * i / m_gridX - 1.0f;
+            float ndcMax = 2.0f * (i + 1) / m_gridX - 1.0f;
+            m_tileMinX[k * m_paddedGridX + i] = glm::min(ndcMin * depthNear, ndcMin * depthFar) * m_tanHalfX;
+            m_tileMaxX[k * m_paddedGridX + i] = glm::max(ndcMax * depthNear, ndcMax * depthFar) * m_tanHalfX;
+        }
+        for (int j = 0; j < m_gridY; j++) {
+            float ndcMin = 2.0f * j / m_gridY - 1.0f;
+            float ndcMax = 2.0f * (j + 1) / m_gridY - 1.0f;
+            m_tileMinY[k * m_gridY + j] = glm::min(ndcMin * depthNear, ndcMin * depthFar) * m_tanHalfY;
+            m_tileMaxY[k * m_gridY + j] = glm::max(ndcMax * depthNear, ndcMax * depthFar) * m_tanHalfY;
+        }
+    }
+}
+
+void LightCluster::AssignSlice(int slice,
+    std::vector<uint32_t>& counts, std::vector<uint32_t>& indices) const {
+    int tileCount = m_gridX * m_gridY;
+    counts.assign(tileCount, 0);
+    indices.clear();
+
+    float depthNear = m_sliceDepth[slice];
+    float depthFar = m_sliceDepth[slice + 1];
+    const float* minX = m_tileMinX.data() + slice * m_paddedGridX;
+    const float* maxX = m_tileMaxX.data() + slice * m_paddedGridX;
+    const float* minY = m_tileMinY.data() + slice * m_gridY;
+    const float* maxY = m_tileMaxY.data() + slice * m_gridY;
+
+    std::vector<uint32_t> hitTiles;
+    std::vector<uint32_t> hitLights;
+    for (uint32_t lightIndex = 0; lightIndex < (uint32_t)m_lightBounds.size(); lightIndex++) {
+        auto& bounds = m_lightBounds[lightIndex];
+        if (slice < bounds.firstSlice || slice > bounds.lastSlice)
+            continue;
+        auto center = bounds.viewPos;
+        float radius = bounds.radius;
+        float radius2 = radius * radius;
+        float dz = glm::max(depthNear - center.z, 0.0f) + glm::max(center.z - depthFar, 0.0f);
+        float dz2 = dz * dz;
+        if (dz2 > radius2)
+            continue;
+
+        // slice 안에 걸친 sphere AABB 를 투영해서 검사할 tile 범위를 좁힌다
+        float depth0 = glm::max(center.z - radius, depthNear);
+        float depth1 = glm::min(center.z + radius, depthFar);
+        float x0 = center.x - radius;
+        float x1 = center.x + radius;
+        float y0 = center.y - radius;
+        float y1 = center.y + radius;
+        float ndcX0 = glm::min(x0 / depth0, x0 / depth1) / m_tanHalfX;
+        float ndcX1 = glm::max(x1 / depth0, x1 / depth1) / m_tanHalfX;
+        float ndcY0 = glm::min(y0 / depth0, y0 / depth1) / m_tanHalfY;
+        float ndcY1 = glm::max(y1 / depth0, y1 / depth1) / m_tanHalfY;
+        if (ndcX1 < -1.0f || ndcX0 > 1.0f || ndcY1 < -1.0f || ndcY0 > 1.0f)
+            continue;
+        int i0 = glm::clamp((int)floorf((ndcX0 * 0.5f + 0.5f) * m_gridX), 0, m_gridX - 1);
+        int i1 = glm::clamp((int)floorf((ndcX1 * 0.5f + 0.5f) * m_gridX), 0, m_gridX - 1);
+        int j0 = glm::clamp((int)floorf((ndcY0 * 0.5f + 0.5f) * m_gridY), 0, m_gridY - 1);
+        int j1 = glm::clamp((int)floorf((ndcY1 * 0.5f + 0.5f) * m_gridY), 0, m_gridY - 1);
+
+        for (int j = j0; j <= j1; j++) {
+            float dy = glm::max(minY[j] - center.y, 0.0f) + glm::max(center.y - maxY[j], 0.0f);
+            float dyz2 = dy * dy + dz2;
+            if (dyz2 > radius2)
+                continue;
+            int i = i0;
+#if USE_SSE
+            // x 방향 tile 4개의 sphere-AABB 거리를 한 번에 계산
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 centerX = _mm_set1_ps(center.x);
+            const __m128 remain = _mm_set1_ps(radius2 - dyz2);
+            for (i = i0 & ~3; i <= i1; i += 4) {
+                __m128 dx = _mm_add_ps(
+                    _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX + i), centerX), zero),
+                    _mm_max_ps(_mm_sub_ps(centerX, _mm_loadu_ps(maxX + i)), zero));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), remain));
+                for (int lane = 0; lane < 4; lane++) {
+                    int tile = i + lane;
+                    if (!(mask & (1 << lane)) || tile < i0 || tile > i1)
+                        continue;
+                    hitTiles.push_back(j * m_gridX + tile);
+                    hitLights.push_back(lightIndex);
+                    counts[j * m_gridX + tile]++;
+                }
+            }
+#endif
+            for (; i <= i1; i++) {
+                float dx = glm::max(minX[i] - center.x, 0.0f) + glm::max(center.x - maxX[i], 0.0f);
+                if (dx * dx + dyz2 > radius2)
+                    continue;
+                hitTiles.push_back(j * m_gridX + i);
+                hitLights.push_back(lightIndex);
+                counts[j * m_gridX + i]++;
+            }
+        }
+    }
+
+    // tile 순서로 counting sort (tile 안에서는 light index 순서가 유지된다)
+    std::vector<uint32_t> offsets(tileCount);
+    uint32_t offset = 0;
+    for (int t = 0; t < tileCount; t++) {
+        offsets[t] = offset;
+        offset += counts[t];
+    }
+    indices.resize(hitLights.size());
+    for (size_t h = 0; h < hitLights.size(); h++)
+        indices[offsets[hitTiles[h]]++] = hitLights[h];
+}
+
+void LightCluster::Build(const std::vector<ClusterLight>& lights, const glm::mat4& view,
+    float fovy, float aspect, float nearPlane, float farPlane, ThreadPool* threadPool) {
+    auto startTime = std::chrono::steady_clock::now();
+    AssignLights(lights, view, fovy, aspect, nearPlane, farPlane, threadPool);
+
+    m_lightTexture->SetData(m_lightData.data(), m_lightData.size() * sizeof(glm::vec4));
+    m_gridTexture->SetData(m_grid.data(), m_grid.size() * sizeof(glm::uvec2));
+    m_indexTexture->SetData(m_indices.data(), m_indices.size() * sizeof(uint32_t));
+
+    m_stats.buildTime = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void LightCluster::AssignLights(const std::vector<ClusterLight>& lights, const glm::mat4& view,
+    float fovy, float aspect, float nearPlane, float farPlane, ThreadPool* threadPool) {
+    if (fovy != m_fovy || aspect != m_aspect ||
+        nearPlane != m_nearPlane || farPlane != m_farPlane)
+        UpdateClusterBounds(fovy, aspect, nearPlane, farPlane);
+
+    auto parallelFor = [threadPool](size_t count,
+        const std::function<void(size_t, size_t)>& func, size_t batchSize) {
+        if (threadPool)
+            threadPool->ParallelFor(count, func, batchSize);
+        else
+            func(0, count);
+    };
+
+    // light 마다 반경, view 공간 위치, 걸치는 slice 범위
+    float sliceScale = m_gridZ / logf(farPlane / nearPlane);
+    auto sliceOf = [&](float depth) {
+        return glm::clamp((int)floorf(logf(depth / nearPlane) * sliceScale), 0, m_gridZ - 1);
+    };
+    m_lightBounds.resize(lights.size());
+    m_lightData.resize(lights.size() * 3);
+    parallelFor(lights.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            auto& light = lights[i];
+            float radius = ComputeLightRadius(light.color, light.range);
+            m_lightData[i * 3 + 0] = glm::vec4(light.position, radius);
+            m_lightData[i * 3 + 1] = glm::vec4(light.color, 0.0f);
+            m_lightData[i * 3 + 2] = glm::vec4(GetAttenuationCoeff(light.range), 0.0f);
+
+            auto& bounds = m_lightBounds[i];
+            bounds.viewPos = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            bounds.viewPos.z = -bounds.viewPos.z;
+            bounds.radius = radius;
+            float depth0 = bounds.viewPos.z - radius;
+            float depth1 = bounds.viewPos.z + radius;
+            if (radius <= 0.0f || depth1 < nearPlane || depth0 > farPlane) {
+                bounds.firstSlice = 1;
+                bounds.lastSlice = 0;
+                continue;
+            }
+            bounds.firstSlice = sliceOf(glm::max(depth0, nearPlane));
+            bounds.lastSlice = sliceOf(glm::min(depth1, farPlane));
+        }
+    }, 256);
+
+    // slice 별로 독립적으로 목록을 만든다
+    parallelFor(m_gridZ, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++)
+            AssignSlice((int)k, m_sliceCounts[k], m_sliceIndices[k]);
+    }, 1);
+
+    // slice 결과를 이어 붙여 cluster 별 (offset, count) 로 정리
+    int tileCount = m_gridX * m_gridY;
+    m_grid.resize(tileCount * m_gridZ);
+    m_indices.clear();
+    uint32_t maxLightsPerCluster = 0;
+    for (int k = 0; k < m_gridZ; k++) {
+        uint32_t offset = (uint32_t)m_indices.size();
+        for (int t = 0; t < tileCount; t++) {
+            uint32_t count = m_sliceCounts[k][t];
+            m_grid[k * tileCount + t] = glm::uvec2(offset, count);
+            offset += count;
+            maxLightsPerCluster = glm::max(maxLightsPerCluster, count);
+        }
+        m_indices.insert(m_indices.end(), m_sliceIndices[k].begin(), m_sliceIndices[k].end());
+    }
+
+    std::vector<uint8_t> visible(lights.size(), 0);
+    for (auto index: m_indices)
+        visible[index] = 1;
+
+    m_stats.lightCount = (uint32_t)lights.size();
+    m_stats.visibleLightCount = 0;
+    for (auto v: visible)
+        m_stats.visibleLightCount += v;
+    m_stats.indexCount = (uint32_t)m_indices.size();
+    m_stats.maxLightsPerCluster = maxLightsPerCluster;
+}
+
+void LightCluster::SetToProgram(const Program* program,
+    int width, int height, uint32_t firstUnit) const {
+    // slice = log(depth) * scale + bias
+    float logRatio = logf(m_farPlane / m_nearPlane);
+    float depthScale = m_gridZ / logRatio;
+    float depthBias = -m_gridZ * logf(m_nearPlane) / logRatio;
+
+    program->SetUniform("clusterLights", (int)firstUnit);
+    program->SetUniform("clusterGrid", (int)firstUnit + 1);
+    program->SetUniform("clusterLightIndices", (int)firstUnit + 2);
+    program->SetUniform("clusterGridSize", glm::vec3(m_gridX, m_gridY, m_gridZ));
+    program->SetUniform("clusterScreenSize", glm::vec2(width, height));
+    program->SetUniform("clusterDepthParams", glm::vec2(depthScale, depthBias));
+
+    auto renderState = RenderState::Get();
+    renderState->ActiveTexture(firstUnit);
+    m_lightTexture->Bind();
+    renderState->ActiveTexture(firstUnit + 1);
+    m_gridTexture->Bind();
+    renderState->ActiveTexture(firstUnit + 2);
+    m_indexTexture->Bind();
+    renderState->ActiveTexture(0);
+}
+
+bool LightCluster::RunClusterTest() {
+    bool success = true;
+    auto Check = [&](bool condition, const std::string& message) {
+        if (!condition) {
+            SPDLOG_ERROR("light cluster test failed: {}", message);
+            success = false;
+        }
+    };
+
+    std::mt19937 random(2024);
+    auto Uniform = [&](float minValue, float maxValue) {
+        return std::uniform_real_distribution<float>(minValue, maxValue)(random);
+    };
+
+    // 기본 grid 와, x 가 4 의 배수가 아니라 SSE tile 검사 뒤에 scalar 가 남는 grid
+    struct Setup {
+        glm::ivec3 grid;
+        float fovy;
+        float aspect;
+        float nearPlane;
+        float farPlane;
+    };
+    const Setup setups[] = {
+        { glm::ivec3(16, 9, 24), glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f },
+        { glm::ivec3(7, 5, 11), glm::radians(70.0f), 1.0f, 0.5f, 40.0f },
+    };
+    for (auto& setup: setups) {
+        auto cluster = LightClusterUPtr(new LightCluster());
+        auto threadedCluster = LightClusterUPtr(new LightCluster());
+        if (!cluster->InitGrid(setup.grid.x, setup.grid.y, setup.grid.z) ||
+            !threadedCluster->InitGrid(setup.grid.x, setup.grid.y, setup.grid.z))
+            return false;
+
+        // 원점이 아닌 곳에서 비스듬히 보는 카메라. light 는 frustum 주변에 흩뿌린다 (일부는 밖)
+        auto eye = glm::vec3(Uniform(-5.0f, 5.0f), Uniform(-5.0f, 5.0f), Uniform(-5.0f, 5.0f));
+        auto forward = glm::normalize(glm::vec3(Uniform(-1.0f, 1.0f), Uniform(-0.5f, 0.5f), -1.0f));
+        auto view = glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+        auto inverseView = glm::inverse(view);
+        float tanHalfY = tanf(setup.fovy * 0.5f);
+        float tanHalfX = tanHalfY * setup.aspect;
+        auto RandomViewPoint = [&](float depth, float spread) {
+            return glm::vec3(Uniform(-spread, spread) * depth * tanHalfX,
+                Uniform(-spread, spread) * depth * tanHalfY, -depth);
+        };
+
+        std::vector<ClusterLight> lights(600);
+        for (auto& light: lights) {
+            float depth = Uniform(-2.0f, setup.farPlane * 1.1f);
+            light.position = glm::vec3(inverseView * glm::vec4(RandomViewPoint(depth, 1.3f), 1.0f));
+            light.color = glm::vec3(Uniform(0.0f, 1.0f), Uniform(0.0f, 1.0f), Uniform(0.0f, 1.0f));
+            light.range = Uniform(1.0f, setup.farPlane * 0.3f);
+        }
+        cluster->AssignLights(lights, view, setup.fovy, setup.aspect,
+            setup.nearPlane, setup.farPlane, nullptr);
+        threadedCluster->AssignLights(lights, view, setup.fovy, setup.aspect,
+            setup.nearPlane, setup.farPlane, ThreadPool::GetDefault());
+        Check(cluster->m_grid == threadedCluster->m_grid && cluster->m_indices == threadedCluster->m_indices,
+            "thread pool build differs from single thread build");
+
+        // shader 와 같은 방식으로 view 공간 점의 cluster 를 찾는다
+        std::vector<glm::vec3> lightViewPos(lights.size());
+        std::vector<float> lightRadius(lights.size());
+        for (size_t l = 0; l < lights.size(); l++) {
+            lightViewPos[l] = glm::vec3(view * glm::vec4(lights[l].position, 1.0f));
+            lightRadius[l] = ComputeLightRadius(lights[l].color, lights[l].range);
+        }
+        int tileCount = setup.grid.x * setup.grid.y;
+        float sliceScale = setup.grid.z / logf(setup.farPlane / setup.nearPlane);
+        size_t pointCount = 0;
+        size_t affectingCount = 0;
+        size_t listedCount = 0;
+        size_t missingCount = 0;
+        std::vector<uint8_t> listed(lights.size());
+        for (int p = 0; p < 20000; p++) {
+            float depth = setup.nearPlane * powf(setup.farPlane / setup.nearPlane, Uniform(0.0f, 1.0f));
+            auto point = RandomViewPoint(depth, 1.0f);
+            int i = glm::clamp((int)floorf((point.x / (depth * tanHalfX) * 0.5f + 0.5f) * setup.grid.x),
+                0, setup.grid.x - 1);
+            int j = glm::clamp((int)floorf((point.y / (depth * tanHalfY) * 0.5f + 0.5f) * setup.grid.y),
+                0, setup.grid.y - 1);
+            int k = glm::clamp((int)floorf(logf(depth / setup.nearPlane) * sliceScale), 0, setup.grid.z - 1);
+            auto range = cluster->m_grid[k * tileCount + j * setup.grid.x + i];
+
+            std::fill(listed.begin(), listed.end(), 0);
+            for (uint32_t n = 0; n < range.y; n++) {
+                uint32_t index = cluster->m_indices[range.x + n];
+                Check(index < lights.size() && !listed[index],
+                    fmt::format("cluster ({}, {}, {}) has a bad or duplicated light {}", i, j, k, index));
+                if (index < lights.size())
+                    listed[index] = 1;
+            }
+            // 경계에 딱 붙은 경우는 반올림 차이로 보고 반경을 아주 조금 줄여서 검사한다
+            for (size_t l = 0; l < lights.size(); l++) {
+                float radius = lightRadius[l] * 0.9999f;
+                auto offset = point - lightViewPos[l];
+                if (glm::dot(offset, offset) >= radius * radius)
+                    continue;
+                affectingCount++;
+                if (!listed[l])
+                    missingCount++;
+            }
+            listedCount += range.y;
+            pointCount++;
+        }
+        SPDLOG_INFO("  grid {}x{}x{}: {} points, {} visible lights, {} light hits, {} listed, {} missing",
+            setup.grid.x, setup.grid.y, setup.grid.z, pointCount, cluster->m_stats.visibleLightCount,
+            affectingCount, listedCount, missingCount);
+        Check(missingCount == 0, fmt::format("{} light hits missing from the cluster lists", missingCount));
+        // 점이 대부분 light 밖에 있으면 검사가 의미 없다
+        Check(affectingCount > pointCount, "too few light hits to test");
+    }
+
+    if (success)
+        SPDLOG_INFO("light cluster test passed");
+    return success;
+}
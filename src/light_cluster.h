@@ -0,0 +1,104 @@
+#ifndef __LIGHT_CLUSTER_H__
+#define __LIGHT_CLUSTER_H__
+
+#include "common.h"
+#include "texture.h"
+#include "program.h"
+#include "thread_pool.h"
+#include <vector>
+
+struct ClusterLight {
+    glm::vec3 position { glm::vec3(0.0f) };
+    glm::vec3 color { glm::vec3(1.0f) };
+    // GetAttenuationCoeff 에 넘기는 거리
+    float range { 10.0f };
+};
+
+struct LightClusterStats {
+    uint32_t lightCount { 0 };
+    uint32_t visibleLightCount { 0 };
+    uint32_t indexCount { 0 };
+    uint32_t maxLightsPerCluster { 0 };
+    float buildTime { 0.0f };   // ms
+};
+
+// view frustum 을 화면 tile x 지수 간격 depth slice 의 froxel 로 나누고
+// 각 froxel 에 영향을 주는 light 목록을 CPU 에서 만들어 texture buffer 로 올린다
+// shader 쪽은 defer_light.fs / pbr_instanced.fs 의 clusterLights 관련 부분
+CLASS_PTR(LightCluster)
+class LightCluster {
+public:
+    static LightClusterUPtr Create(int gridX = 16, int gridY = 9, int gridZ = 24);
+
+    // 감쇠 계수로 계산한 밝기가 threshold 아래로 떨어지는 거리
+    static float ComputeLightRadius(const glm::vec3& color, float range,
+        float threshold = 5.0f / 256.0f);
+
+    // view 공간 기준 perspective frustum (fovy 는 radian)
+    void Build(const std::vector<ClusterLight>& lights, const glm::mat4& view,
+        float fovy, float aspect, float nearPlane, float farPlane,
+        ThreadPool* threadPool = nullptr);
+
+    // firstUnit 부터 texture unit 3개를 쓴다
+    void SetToProgram(const Program* program, int width, int height, uint32_t firstUnit) const;
+
+    const LightClusterStats& GetStats() const { return m_stats; }
+    glm::ivec3 GetGridSize() const { return glm::ivec3(m_gridX, m_gridY, m_gridZ); }
+
+    // 임의의 light / view 공간 점에 대해 점에 닿는 light 가 모두 그 점의 cluster 목록에 있는지
+    // 전수 검사와 비교한다. texture buffer 는 만들지 않으므로 GL context 없이 동작
+    static bool RunClusterTest();
+
+private:
+    LightCluster() {}
+    bool Init(int gridX, int gridY, int gridZ);
+    bool InitGrid(int gridX, int gridY, int gridZ);
+    // Build 에서 texture buffer 업로드를 뺀 부분 (m_grid / m_indices / m_stats 를 채운다)
+    void AssignLights(const std::vector<ClusterLight>& lights, const glm::mat4& view,
+        float fovy, float aspect, float nearPlane, float farPlane, ThreadPool* threadPool);
+    void UpdateClusterBounds(float fovy, float aspect, float nearPlane, float farPlane);
+    void AssignSlice(int slice, std::vector<uint32_t>& counts, std::vector<uint32_t>& indices) const;
+
+    int m_gridX { 16 };
+    int m_gridY { 9 };
+    int m_gridZ { 24 };
+    int m_paddedGridX { 16 };
+
+    // frustum 이 바뀔 때만 다시 계산하는 froxel 경계 (view 공간, z 는 양수 depth)
+    float m_fovy { 0.0f };
+    float m_aspect { 0.0f };
+    float m_nearPlane { 0.0f };
+    float m_farPlane { 0.0f };
+    float m_tanHalfX { 0.0f };
+    float m_tanHalfY { 0.0f };
+    std::vector<float> m_sliceDepth;        // gridZ + 1
+    std::vector<float> m_tileMinX;          // [slice][paddedGridX]
+    std::vector<float> m_tileMaxX;
+    std::vector<float> m_tileMinY;          // [slice][gridY]
+    std::vector<float> m_tileMaxY;
+
+    // Build 중간 결과
+    struct LightBounds {
+        glm::vec3 viewPos;
+        float radius;
+        int firstSlice;
+        int lastSlice;
+    };
+    std::vector<LightBounds> m_lightBounds;
+    std::vector<std::vector<uint32_t>> m_sliceCounts;
+    std::vector<std::vector<uint32_t>> m_sliceIndices;
+
+    // texel 3개 / light: (position, radius), (color, 0), (kc, kl, kq, 0)
+    std::vector<glm::vec4> m_lightData;
+    // cluster 마다 (offset, count)
+    std::vector<glm::uvec2> m_grid;
+    std::vector<uint32_t> m_indices;
+
+    BufferTextureUPtr m_lightTexture;
+    BufferTextureUPtr m_gridTexture;
+    BufferTextureUPtr m_indexTexture;
+
+    LightClusterStats m_stats;
+};
+
+#endif // __LIGHT_CLUSTER_H__
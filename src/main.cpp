@@ -1,4 +1,14 @@
 #include "context.h"
+#include "model.h"
+#include "headless.h"
+#include "profiler.h"
+#include "render_state.h"
+#include "texture_compression.h"
+#include "hdr_image.h"
+#include "mesh_optimizer.h"
+#include "vertex_packing.h"
+#include "bvh.h"
+#include "texture_atlas.h"
 
 #include <spdlog/spdlog.h>
 #include <glad/glad.h>
@@ -17,6 +27,226 @@ int main(int argc, const char** argv) {
     // 시작을 알리는 로그
     SPDLOG_INFO("Start program");
 
+    // --bake <src> <dst>: assimp 로 모델을 읽어 baked 파일로 저장만 하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--bake") {
+        if (argc < 4) {
+            SPDLOG_ERROR("usage: {} --bake <model file> <baked file>", argv[0]);
+            return -1;
+        }
+        return Model::Bake(argv[2], argv[3]) ? 0 : -1;
+    }
+
+    // --compress <src> <dst.dds> [bc1|bc3|bc4|bc5|bc6h] [--srgb] [--fast] [--no-mipmap]
+    //     [--kaiser] [--alpha-coverage]
+    // 이미지를 block 압축한 mip chain 을 DDS 로 저장하고 종료
+    // TextureLoadOption 기본값과 같게 상하를 뒤집어서 저장한다
+    if (argc >= 2 && std::string(argv[1]) == "--compress") {
+        if (argc < 4) {
+            SPDLOG_ERROR("usage: {} --compress <image file> <dds file> "
+                "[bc1|bc3|bc4|bc5|bc6h] [--srgb] [--fast] [--no-mipmap] [--kaiser] [--alpha-coverage]",
+                argv[0]);
+            return -1;
+        }
+        auto image = Image::Load(argv[2]);
+        if (!image)
+            return -1;
+        BlockCompressionOption option;
+        if (image->GetPixelType() != PixelType::UInt8)
+            option.format = BlockFormat::BC6H;
+        else if (image->GetChannelCount() == 4)
+            option.format = BlockFormat::BC3;
+        for (int i = 4; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "bc1") option.format = BlockFormat::BC1;
+            else if (arg == "bc3") option.format = BlockFormat::BC3;
+            else if (arg == "bc4") option.format = BlockFormat::BC4;
+            else if (arg == "bc5") option.format = BlockFormat::BC5;
+            else if (arg == "bc6h") option.format = BlockFormat::BC6H;
+            else if (arg == "--srgb") option.sRGB = true;
+            else if (arg == "--fast") option.highQuality = false;
+            else if (arg == "--no-mipmap") option.generateMipmap = false;
+            else if (arg == "--kaiser") option.mipOption.filter = MipFilter::Kaiser;
+            else if (arg == "--alpha-coverage") option.mipOption.preserveAlphaCoverage = true;
+            else SPDLOG_WARN("unknown argument: {}", arg);
+        }
+        auto compressedImage = CompressImage(image.get(), option);
+        if (!compressedImage || !compressedImage->SaveDDS(argv[3]))
+            return -1;
+        SPDLOG_INFO("compressed {} -> {} ({}, {} levels, {} bytes)", argv[2], argv[3],
+            GetBlockFormatName(option.format), compressedImage->GetLevelCount(),
+            compressedImage->GetDataSize());
+        return 0;
+    }
+
+    // --bake-image <src> <dst.dds> [--no-mipmap] [--srgb] [--kaiser] [--alpha-coverage] [--float]
+    // 이미지를 decode 해서 mip chain 과 함께 압축하지 않은 DDS 로 저장하고 종료
+    // 실행 중에는 decode 없이 map 해서 그대로 올린다 (--compress 처럼 상하를 뒤집어서 저장)
+    // .hdr 은 RGBE 를 손실 없이 옮길 수 있는 RGB9E5 로, --float 이면 RGB float 으로 저장한다
+    if (argc >= 2 && std::string(argv[1]) == "--bake-image") {
+        if (argc < 4) {
+            SPDLOG_ERROR("usage: {} --bake-image <image file> <dds file> "
+                "[--no-mipmap] [--srgb] [--kaiser] [--alpha-coverage] [--float]", argv[0]);
+            return -1;
+        }
+        bool generateMipmap = true;
+        MipChainOption mipOption;
+        HdrFormat hdrFormat = HdrFormat::RGB9E5;
+        for (int i = 4; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--no-mipmap") generateMipmap = false;
+            else if (arg == "--srgb") mipOption.sRGB = true;
+            else if (arg == "--kaiser") mipOption.filter = MipFilter::Kaiser;
+            else if (arg == "--alpha-coverage") mipOption.preserveAlphaCoverage = true;
+            else if (arg == "--float") hdrFormat = HdrFormat::Float;
+            else SPDLOG_WARN("unknown argument: {}", arg);
+        }
+        std::string srcPath = argv[2];
+        bool hdr = srcPath.size() > 4 &&
+            (srcPath.compare(srcPath.size() - 4, 4, ".hdr") == 0 ||
+            srcPath.compare(srcPath.size() - 4, 4, ".HDR") == 0);
+        auto image = hdr ? LoadRadianceHDR(srcPath, hdrFormat) : Image::Load(srcPath);
+        if (!image)
+            return -1;
+        std::vector<ImageUPtr> mipLevels;
+        if (generateMipmap)
+            mipLevels = image->GenerateMipChain(mipOption);
+        if (!image->SaveDDS(argv[3], mipLevels))
+            return -1;
+        SPDLOG_INFO("baked {} -> {} ({}x{}, {} levels)", argv[2], argv[3],
+            image->GetWidth(), image->GetHeight(), mipLevels.size() + 1);
+        return 0;
+    }
+
+    // --image-load-bench <stb|arena|mmap|hdr-float|hdr-half|hdr-rgb9e5> <image files...>
+    // loading 방식별 시간과 최대 RSS 를 출력하고 종료 (mode 마다 따로 실행해서 비교)
+    if (argc >= 2 && std::string(argv[1]) == "--image-load-bench") {
+        if (argc < 4) {
+            SPDLOG_ERROR("usage: {} --image-load-bench "
+                "<stb|arena|mmap|hdr-float|hdr-half|hdr-rgb9e5> <image files...>", argv[0]);
+            return -1;
+        }
+        std::vector<std::string> filepaths(argv + 3, argv + argc);
+        return RunImageLoadBenchmark(argv[2], filepaths) ? 0 : -1;
+    }
+
+    // --model-load-bench <mesh count> <vertex count> [image files...]
+    // 가짜 mesh 와 텍스처를 thread 수를 바꿔 가며 loading 하는 CPU 시간을 출력하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--model-load-bench") {
+        if (argc < 4) {
+            SPDLOG_ERROR("usage: {} --model-load-bench <mesh count> <vertex count> [image files...]",
+                argv[0]);
+            return -1;
+        }
+        std::vector<std::string> imagePaths(argv + 4, argv + argc);
+        return Model::RunLoadBenchmark(atoi(argv[2]), atoi(argv[3]), imagePaths) ? 0 : -1;
+    }
+
+    // --mesh-optimizer-test: GL 없이 mesh 최적화 결과를 검사하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--mesh-optimizer-test")
+        return RunMeshOptimizerTest() ? 0 : -1;
+
+    // --vertex-packing-test: PackedVertex encode / decode 오차를 검사하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--vertex-packing-test")
+        return RunVertexPackingTest() ? 0 : -1;
+
+    // --tangent-bench [triangle count]: ComputeTangents 를 scalar 기준 구현과 비교하고 시간을 출력하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--tangent-bench")
+        return Mesh::RunTangentBenchmark(argc >= 3 ? atoi(argv[2]) : 1000000) ? 0 : -1;
+
+    // --bvh-bench [instance count]: bvh query 를 전수 검사와 비교하고 시간을 출력하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--bvh-bench")
+        return RunBvhBenchmark(argc >= 3 ? atoi(argv[2]) : 100000) ? 0 : -1;
+
+    // --frustum-cull-test: BoundsBatch::Cull 의 SIMD 경로를 scalar 기준과 비교하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--frustum-cull-test")
+        return RunFrustumCullTest() ? 0 : -1;
+
+    // --light-cluster-test: LightCluster 의 cluster 목록을 light / 점 전수 검사와 비교하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--light-cluster-test")
+        return LightCluster::RunClusterTest() ? 0 : -1;
+
+    // --scene-graph-test: SceneGraph 의 부분 갱신을 전체 재계산과 비교하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--scene-graph-test")
+        return SceneGraph::RunUpdateTest() ? 0 : -1;
+
+    // --texture-atlas-test: GL 없이 atlas packing 결과를 검사하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--texture-atlas-test")
+        return RunTextureAtlasTest() ? 0 : -1;
+
+    // --mip-chain-test: GL 없이 GenerateMipChain 결과를 검사하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--mip-chain-test")
+        return RunMipChainTest() ? 0 : -1;
+
+    // --compress-bench <image>: format / 품질별 PSNR 과 압축 속도를 출력하고 종료
+    if (argc >= 2 && std::string(argv[1]) == "--compress-bench") {
+        if (argc < 3) {
+            SPDLOG_ERROR("usage: {} --compress-bench <image file>", argv[0]);
+            return -1;
+        }
+        return RunCompressionBenchmark(argv[2]) ? 0 : -1;
+    }
+
+    // --headless [--frames N] [--csv file] [--dump file.ppm] [--gl-api native|egl|osmesa]
+    // 창을 보이지 않게 띄우고 offscreen 으로 정해진 frame 만큼만 그린다
+    // --uniform-bench [--frames N]: headless 로 띄워 uniform 설정 방식별 CPU 시간을 출력하고 종료
+    // --sh-irradiance-test: headless 로 띄워 SH irradiance 를 irradianceMap 과 비교하고 종료
+    // --texture-array-test [--model file] [image files...]: headless 로 띄워 texture array / atlas 로
+    // 그린 결과를 보통 2D 텍스처로 그린 결과와 비교하고 종료
+    bool headless = false;
+    bool uniformBench = false;
+    bool shIrradianceTest = false;
+    bool textureArrayTest = false;
+    std::vector<std::string> textureArrayImages;
+    std::string textureArrayModel;
+    HeadlessOption headlessOption;
+    int contextCreationApi = GLFW_NATIVE_CONTEXT_API;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            headless = true;
+        }
+        else if (arg == "--uniform-bench") {
+            headless = true;
+            uniformBench = true;
+        }
+        else if (arg == "--sh-irradiance-test") {
+            headless = true;
+            shIrradianceTest = true;
+        }
+        else if (arg == "--texture-array-test") {
+            headless = true;
+            textureArrayTest = true;
+        }
+        else if (arg == "--model" && hasValue) {
+            textureArrayModel = argv[++i];
+        }
+        else if (arg == "--frames" && hasValue) {
+            headlessOption.frameCount = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--csv" && hasValue) {
+            headlessOption.csvFilename = argv[++i];
+        }
+        else if (arg == "--dump" && hasValue) {
+            headlessOption.dumpFilename = argv[++i];
+        }
+        else if (arg == "--gl-api" && hasValue) {
+            std::string api = argv[++i];
+            if (api == "egl")
+                contextCreationApi = GLFW_EGL_CONTEXT_API;
+            else if (api == "osmesa")
+                contextCreationApi = GLFW_OSMESA_CONTEXT_API;
+            else if (api != "native")
+                SPDLOG_WARN("unknown gl api: {}, use native", api);
+        }
+        else if (textureArrayTest && arg.rfind("--", 0) != 0) {
+            textureArrayImages.push_back(arg);
+        }
+        else {
+            SPDLOG_WARN("unknown argument: {}", arg);
+        }
+    }
+
      // glfw 라이브러리 초기화, 실패하면 에러 출력후 종료
     SPDLOG_INFO("Initialize glfw");
     if (!glfwInit()) {
@@ -32,6 +262,10 @@ int main(int argc, const char** argv) {
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     // MSAA 멀티 샘플링
     // glfwWindowHint(GLFW_SAMPLES, 4);
+    // GPU 가 없는 머신에서는 osmesa (llvmpipe) 로 context 를 만든다
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextCreationApi);
+    if (headless)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // glfw 윈도우 생성, 실패하면 에러 출력후 종료
     SPDLOG_INFO("Create glfw window");
@@ -62,6 +296,7 @@ int main(int argc, const char** argv) {
     ImGui_ImplOpenGL3_CreateFontsTexture();
     ImGui_ImplOpenGL3_CreateDeviceObjects();
 
+    auto profiler = Profiler::Create();
     auto context = Context::Create();
     if (!context) {
         SPDLOG_ERROR("failed to create context");
@@ -70,6 +305,22 @@ int main(int argc, const char** argv) {
     }
     glfwSetWindowUserPointer(window, context.get());
 
+    if (headless) {
+        bool success = uniformBench ? RunUniformBenchmark(headlessOption.frameCount) :
+            shIrradianceTest ? context->RunSHIrradianceTest() :
+            textureArrayTest ? RunTextureArrayTest(textureArrayImages, textureArrayModel) :
+            RunHeadless(context.get(), headlessOption);
+        context.reset();
+        profiler.reset();
+        ImGui_ImplOpenGL3_DestroyFontsTexture();
+        ImGui_ImplOpenGL3_DestroyDeviceObjects();
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext(imguiContext);
+        glfwTerminate();
+        return success ? 0 : -1;
+    }
+
     OnFramebufferSizeChange(window, WINDOW_WIDTH, WINDOW_HEIGHT);
     glfwSetFramebufferSizeCallback(window, OnFramebufferSizeChange);
     glfwSetKeyCallback(window, OnKeyEvent);
@@ -81,6 +332,8 @@ int main(int argc, const char** argv) {
     // glfw 루프 실행, 윈도우 close 버튼을 누르면 정상 종료
     SPDLOG_INFO("Start main loop");
     while (!glfwWindowShouldClose(window)) {
+        profiler->BeginFrame();
+        RenderState::Get()->BeginFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
@@ -89,12 +342,17 @@ int main(int argc, const char** argv) {
 
         context->Render();
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            PROFILE_SCOPE("ImGui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        profiler->EndFrame();
         glfwSwapBuffers(window);
     }
     // context = nullptr;
     context.reset();
+    profiler.reset();
 
     ImGui_ImplOpenGL3_DestroyFontsTexture();
     ImGui_ImplOpenGL3_DestroyDeviceObjects();
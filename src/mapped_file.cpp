@@ -0,0 +1,93 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFileUPtr MappedFile::Open(const std::string& filename, bool copyOnWrite) {
+    auto mappedFile = MappedFileUPtr(new MappedFile());
+    if (!mappedFile->Map(filename, copyOnWrite))
+        return nullptr;
+    return std::move(mappedFile);
+}
+
+#ifdef _WIN32
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file && m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+}
+
+bool MappedFile::Map(const std::string& filename, bool copyOnWrite) {
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        SPDLOG_ERROR("failed to open file: {}", filename);
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+        SPDLOG_ERROR("failed to map empty file: {}", filename);
+        return false;
+    }
+    m_size = (size_t)fileSize.QuadPart;
+    m_mapping = CreateFileMappingA(m_file, nullptr,
+        copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        SPDLOG_ERROR("failed to map file: {}", filename);
+        return false;
+    }
+    m_data = (const uint8_t*)MapViewOfFile(m_mapping,
+        copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        SPDLOG_ERROR("failed to map file: {}", filename);
+        return false;
+    }
+    m_copyOnWrite = copyOnWrite;
+    return true;
+}
+
+#else
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        munmap((void*)m_data, m_size);
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+bool MappedFile::Map(const std::string& filename, bool copyOnWrite) {
+    m_fd = open(filename.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        SPDLOG_ERROR("failed to open file: {}", filename);
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(m_fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        SPDLOG_ERROR("failed to map empty file: {}", filename);
+        return false;
+    }
+    m_size = (size_t)fileStat.st_size;
+    int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* data = mmap(nullptr, m_size, protection, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED) {
+        SPDLOG_ERROR("failed to map file: {}", filename);
+        return false;
+    }
+    m_data = (const uint8_t*)data;
+    m_copyOnWrite = copyOnWrite;
+    return true;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include "common.h"
+
+// 읽기 전용 memory mapped file. 객체가 살아있는 동안 GetData() 포인터가 유효하다
+CLASS_PTR(MappedFile)
+class MappedFile {
+public:
+    // copyOnWrite 이면 mapping 에 써도 되고, 쓴 page 만 process 전용으로 복사된다
+    // (파일에는 반영되지 않는다)
+    static MappedFileUPtr Open(const std::string& filename, bool copyOnWrite = false);
+    ~MappedFile();
+
+    const uint8_t* GetData() const { return m_data; }
+    // copyOnWrite 로 열지 않았으면 nullptr
+    uint8_t* GetWritableData() const { return m_copyOnWrite ? (uint8_t*)m_data : nullptr; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    MappedFile() {}
+    bool Map(const std::string& filename, bool copyOnWrite);
+
+    const uint8_t* m_data { nullptr };
+    size_t m_size { 0 };
+    bool m_copyOnWrite { false };
+#ifdef _WIN32
+    void* m_file { nullptr };
+    void* m_mapping { nullptr };
+#else
+    int m_fd { -1 };
+#endif
+};
+
+#endif // __MAPPED_FILE_H__
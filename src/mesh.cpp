@@ -1,40 +1,117 @@
 #include "mesh.h"
+#include "render_state.h"
+#include "vertex_packing.h"
+#include "simd.h"
+#include <cmath>
+#include <chrono>
 
-MeshUPtr Mesh::Create(const std::vector<Vertex>& vertices,
-    const std::vector<uint32_t>& indices, uint32_t primitiveType) {
+MeshUPtr Mesh::Create(std::vector<Vertex> vertices,
+    const std::vector<uint32_t>& indices, uint32_t primitiveType,
+	bool computeTangents, VertexFormat vertexFormat) {
+
+	if (computeTangents && primitiveType == GL_TRIANGLES) {
+	    ComputeTangents(vertices, indices);
+	}
+	return Create(vertices.data(), vertices.size(),
+		indices.data(), indices.size(), primitiveType, vertexFormat);
+}
+
+MeshUPtr Mesh::Create(const Vertex* vertices, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, uint32_t primitiveType,
+	VertexFormat vertexFormat) {
 
 	auto mesh = MeshUPtr(new Mesh());
-	mesh->Init(vertices, indices, primitiveType);
+	mesh->Init(vertices, vertexCount, indices, indexCount, primitiveType, vertexFormat);
 
 	return std::move(mesh);
 }
 
-void Mesh::Init(const std::vector<Vertex>& vertices,
-    const std::vector<uint32_t>& indices, uint32_t primitiveType) {
-
-	if (primitiveType == GL_TRIANGLES) {
-	    ComputeTangents(const_cast<std::vector<Vertex>&>(vertices), indices);
-	}
+void Mesh::Init(const Vertex* vertices, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, uint32_t primitiveType,
+	VertexFormat vertexFormat) {
 
+	m_primitiveType = primitiveType;
+	m_vertexFormat = vertexFormat;
+	ComputeBounds(vertices, vertexCount, sizeof(Vertex), m_bounds, m_boundingSphere);
 	m_vertexLayout = VertexLayout::Create();
-	m_vertexBuffer = Buffer::CreateWithData(GL_ARRAY_BUFFER, GL_STATIC_DRAW,
-	    vertices.data(), sizeof(Vertex), vertices.size());
+	if (vertexFormat == VertexFormat::Packed) {
+		std::vector<PackedVertex> packedVertices;
+		PackVertices(vertices, vertexCount, packedVertices, m_positionOffset, m_positionScale);
+		m_vertexBuffer = Buffer::CreateWithData(GL_ARRAY_BUFFER, GL_STATIC_DRAW,
+		    packedVertices.data(), sizeof(PackedVertex), packedVertices.size());
+		m_vertexLayout->SetAttrib(0, 4, GL_UNSIGNED_SHORT, true, sizeof(PackedVertex), 0);
+		m_vertexLayout->SetAttrib(1, 2, GL_SHORT, true, sizeof(PackedVertex), offsetof(PackedVertex, normal));
+		m_vertexLayout->SetAttrib(2, 2, GL_HALF_FLOAT, false, sizeof(PackedVertex), offsetof(PackedVertex, texCoord));
+		m_vertexLayout->SetAttrib(3, 2, GL_SHORT, true, sizeof(PackedVertex), offsetof(PackedVertex, tangent));
+
+		SPDLOG_INFO("packed {} vertices ({} -> {} bytes)",
+			vertexCount, vertexCount * sizeof(Vertex), vertexCount * sizeof(PackedVertex));
+	}
+	else {
+		m_vertexBuffer = Buffer::CreateWithData(GL_ARRAY_BUFFER, GL_STATIC_DRAW,
+		    vertices, sizeof(Vertex), vertexCount);
+		m_vertexLayout->SetAttrib(0, 3, GL_FLOAT, false, sizeof(Vertex), 0);
+		m_vertexLayout->SetAttrib(1, 3, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, normal));
+		m_vertexLayout->SetAttrib(2, 2, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, texCoord));
+		m_vertexLayout->SetAttrib(3, 4, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, tangent));
+	}
 	m_indexBuffer = Buffer::CreateWithData(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW,
-	    indices.data(), sizeof(uint32_t), indices.size());
-	m_vertexLayout->SetAttrib(0, 3, GL_FLOAT, false, sizeof(Vertex), 0);
-	m_vertexLayout->SetAttrib(1, 3, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, normal));
-	m_vertexLayout->SetAttrib(2, 2, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, texCoord));
-	m_vertexLayout->SetAttrib(3, 3, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, tangent));
+	    indices, sizeof(uint32_t), indexCount);
+}
+
+void Mesh::SetVertexFormatToProgram(const Program* program) const {
+	if (m_vertexFormat == VertexFormat::Packed) {
+		program->SetUniform("positionOffset", m_positionOffset);
+		program->SetUniform("positionScale", m_positionScale);
+	}
 }
 
 void Mesh::Draw(const Program* program) const {
-	m_vertexLayout->Bind();
     if (m_material) {
 	    m_material->SetToProgram(program);
 	}
+	DrawGeometry(program);
+}
+
+void Mesh::DrawInstanced(const Program* program, uint32_t instanceCount) const {
+	if (m_material) {
+	    m_material->SetToProgram(program);
+	}
+	DrawGeometryInstanced(program, instanceCount);
+}
+
+void Mesh::SetInstanceBuffer(BufferPtr instanceBuffer) {
+	m_instanceBuffer = instanceBuffer;
+	m_vertexLayout->Bind();
+	m_instanceBuffer->Bind();
+	// mat4 attribute 는 vec4 4개의 location 을 차지한다
+	for (uint32_t i = 0; i < 4; i++) {
+		m_vertexLayout->SetAttrib(4 + i, 4, GL_FLOAT, false, sizeof(InstanceData),
+			offsetof(InstanceData, modelTransform) + sizeof(glm::vec4) * i);
+		m_vertexLayout->SetAttribDivisor(4 + i, 1);
+	}
+	m_vertexLayout->SetAttrib(8, 4, GL_FLOAT, false, sizeof(InstanceData),
+		offsetof(InstanceData, materialParams));
+	m_vertexLayout->SetAttribDivisor(8, 1);
+}
+
+void Mesh::DrawGeometry(const Program* program) const {
+	m_vertexLayout->Bind();
+	SetVertexFormatToProgram(program);
 	glDrawElements(m_primitiveType, m_indexBuffer->GetCount(), GL_UNSIGNED_INT, 0);
 }
 
+void Mesh::DrawGeometryInstanced(const Program* program, uint32_t instanceCount) const {
+	if (!m_instanceBuffer) {
+		SPDLOG_ERROR("instanced draw without instance buffer");
+		return;
+	}
+	m_vertexLayout->Bind();
+	SetVertexFormatToProgram(program);
+	glDrawElementsInstanced(m_primitiveType, m_indexBuffer->GetCount(),
+		GL_UNSIGNED_INT, 0, instanceCount);
+}
+
 MeshUPtr Mesh::CreateBox() {
     std::vector<Vertex> vertices = {
         Vertex { glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec2(0.0f, 0.0f) },
@@ -77,7 +154,7 @@ MeshUPtr Mesh::CreateBox() {
         20, 22, 21, 22, 20, 23,
     };
 
-    return Create(vertices, indices, GL_TRIANGLES);
+    return Create(std::move(vertices), indices, GL_TRIANGLES);
 }
 
 MeshUPtr Mesh::CreatePlane() {
@@ -92,10 +169,11 @@ MeshUPtr Mesh::CreatePlane() {
 		0,  1,  2,  2,  3,  0,
 	};
 
-	return Create(vertices, indices, GL_TRIANGLES);
+	return Create(std::move(vertices), indices, GL_TRIANGLES);
 }
 
-MeshUPtr Mesh::CreateSphere(uint32_t latiSegmentCount, uint32_t longiSegmentCount) {
+MeshUPtr Mesh::CreateSphere(uint32_t latiSegmentCount, uint32_t longiSegmentCount,
+	VertexFormat vertexFormat) {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
 	
@@ -115,7 +193,7 @@ MeshUPtr Mesh::CreateSphere(uint32_t latiSegmentCount, uint32_t longiSegmentCoun
 				cosPhi * cosTheta, sinPhi, -cosPhi * sinTheta);
       
 			vertices[i * circleVertCount + j] = Vertex {
-		        point * 0.5f, point, glm::vec2(u, v), glm::vec3(0.0f)
+		        point * 0.5f, point, glm::vec2(u, v), glm::vec4(0.0f)
 			};
 	    }
 	}
@@ -134,76 +212,323 @@ MeshUPtr Mesh::CreateSphere(uint32_t latiSegmentCount, uint32_t longiSegmentCoun
 		}
 	}
 
-	return Create(vertices, indices, GL_TRIANGLES);
+	return Create(std::move(vertices), indices, GL_TRIANGLES, true, vertexFormat);
 }
 
 void Material::SetToProgram(const Program* program) const {
 	int textureCount = 0;
-	if (diffuse) {
-	    glActiveTexture(GL_TEXTURE0 + textureCount);
+	// array 를 쓰는 shader 는 material.diffuseArray / specularArray 를 받는다 (defer_geo_array.fs)
+	if (diffuseLayer.IsValid()) {
+	    RenderState::Get()->ActiveTexture(textureCount);
+	    program->SetUniform("material.diffuseArray", textureCount);
+	    program->SetUniform("material.diffuseLayer", diffuseLayer.layer);
+	    program->SetUniform("material.diffuseScaleOffset", diffuseLayer.scaleOffset);
+	    diffuseLayer.array->Bind();
+	    textureCount++;
+	}
+	if (specularLayer.IsValid()) {
+	    RenderState::Get()->ActiveTexture(textureCount);
+	    program->SetUniform("material.specularArray", textureCount);
+	    program->SetUniform("material.specularLayer", specularLayer.layer);
+	    program->SetUniform("material.specularScaleOffset", specularLayer.scaleOffset);
+	    specularLayer.array->Bind();
+	    textureCount++;
+	}
+	if (diffuse && !diffuseLayer.IsValid()) {
+	    RenderState::Get()->ActiveTexture(textureCount);
 	    program->SetUniform("material.diffuse", textureCount);
 	    diffuse->Bind();
 	    textureCount++;
 	}
-	if (specular) {
-	    glActiveTexture(GL_TEXTURE0 + textureCount);
+	if (specular && !specularLayer.IsValid()) {
+	    RenderState::Get()->ActiveTexture(textureCount);
 	    program->SetUniform("material.specular", textureCount);
 	    specular->Bind();
 	    textureCount++;
 	}
-	glActiveTexture(GL_TEXTURE0);
+	RenderState::Get()->ActiveTexture(0);
 	program->SetUniform("material.shininess", shininess);
 }
 
+// triangle 하나의 uv 방향 tangent / bitangent (정규화 전)
+static void ComputeTriangleTangent(const Vertex* vertices, const uint32_t* triangle,
+	glm::vec3& tangent, glm::vec3& bitangent) {
+	auto& v0 = vertices[triangle[0]];
+	auto& v1 = vertices[triangle[1]];
+	auto& v2 = vertices[triangle[2]];
+	auto edge1 = v1.position - v0.position;
+	auto edge2 = v2.position - v0.position;
+	auto deltaUV1 = v1.texCoord - v0.texCoord;
+	auto deltaUV2 = v2.texCoord - v0.texCoord;
+	float det = (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
+	if (det != 0.0f) {
+		auto invDet = 1.0f / det;
+		tangent = invDet * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+		bitangent = invDet * (deltaUV1.x * edge2 - deltaUV2.x * edge1);
+	}
+	else {
+		tangent = glm::vec3(0.0f, 0.0f, 0.0f);
+		bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+}
+
+#if USE_SSE
+// triangle 4개를 SoA 로 모아서 한 번에 계산한다
+static void ComputeTriangleTangents4(const Vertex* vertices, const uint32_t* triangles,
+	glm::vec3* tangents, glm::vec3* bitangents) {
+	alignas(16) float position[3][3][4];
+	alignas(16) float texCoord[3][2][4];
+	for (int lane = 0; lane < 4; lane++) {
+		for (int corner = 0; corner < 3; corner++) {
+			auto& v = vertices[triangles[lane * 3 + corner]];
+			position[corner][0][lane] = v.position.x;
+			position[corner][1][lane] = v.position.y;
+			position[corner][2][lane] = v.position.z;
+			texCoord[corner][0][lane] = v.texCoord.x;
+			texCoord[corner][1][lane] = v.texCoord.y;
+		}
+	}
+
+	__m128 du1 = _mm_sub_ps(_mm_load_ps(texCoord[1][0]), _mm_load_ps(texCoord[0][0]));
+	__m128 dv1 = _mm_sub_ps(_mm_load_ps(texCoord[1][1]), _mm_load_ps(texCoord[0][1]));
+	__m128 du2 = _mm_sub_ps(_mm_load_ps(texCoord[2][0]), _mm_load_ps(texCoord[0][0]));
+	__m128 dv2 = _mm_sub_ps(_mm_load_ps(texCoord[2][1]), _mm_load_ps(texCoord[0][1]));
+	__m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+	// det 이 0 인 triangle 은 기여하지 않도록 0 으로 만든다
+	__m128 valid = _mm_cmpneq_ps(det, _mm_setzero_ps());
+	__m128 invDet = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), det));
+
+	alignas(16) float tangent[3][4];
+	alignas(16) float bitangent[3][4];
+	for (int k = 0; k < 3; k++) {
+		__m128 p0 = _mm_load_ps(position[0][k]);
+		__m128 edge1 = _mm_sub_ps(_mm_load_ps(position[1][k]), p0);
+		__m128 edge2 = _mm_sub_ps(_mm_load_ps(position[2][k]), p0);
+		_mm_store_ps(tangent[k], _mm_mul_ps(invDet,
+			_mm_sub_ps(_mm_mul_ps(dv2, edge1), _mm_mul_ps(dv1, edge2))));
+		_mm_store_ps(bitangent[k], _mm_mul_ps(invDet,
+			_mm_sub_ps(_mm_mul_ps(du1, edge2), _mm_mul_ps(du2, edge1))));
+	}
+	for (int lane = 0; lane < 4; lane++) {
+		tangents[lane] = glm::vec3(tangent[0][lane], tangent[1][lane], tangent[2][lane]);
+		bitangents[lane] = glm::vec3(bitangent[0][lane], bitangent[1][lane], bitangent[2][lane]);
+	}
+}
+#endif
+
 void Mesh::ComputeTangents(
 	std::vector<Vertex>& vertices,
 	const std::vector<uint32_t>& indices) {
+	ComputeTangents(vertices.data(), vertices.size(), indices.data(), indices.size());
+}
 
-	auto compute = [](
-	    const glm::vec3& pos1, const glm::vec3& pos2, const glm::vec3& pos3,
-	    const glm::vec2& uv1, const glm::vec2& uv2, const glm::vec2& uv3)
-	    -> glm::vec3 {
-	
-	    auto edge1 = pos2 - pos1;
-	    auto edge2 = pos3 - pos1;
-	    auto deltaUV1 = uv2 - uv1;
-	    auto deltaUV2 = uv3 - uv1;
-	    float det = (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-	    if (det != 0.0f) {
-			auto invDet = 1.0f / det;
-			return invDet * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
-	    }
-	    else {
-			return glm::vec3(0.0f, 0.0f, 0.0f);
+void Mesh::ComputeTangents(Vertex* vertices, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, ThreadPool* threadPool) {
+	static const size_t TRIANGLE_BATCH_SIZE = 4096;
+	static const size_t VERTEX_BATCH_SIZE = 4096;
+	if (!threadPool)
+		threadPool = ThreadPool::GetDefault();
+	size_t triangleCount = indexCount / 3;
+
+	// 1. triangle 별 tangent / bitangent
+	std::vector<glm::vec3> triangleTangents(triangleCount);
+	std::vector<glm::vec3> triangleBitangents(triangleCount);
+	threadPool->ParallelFor(triangleCount, [&](size_t begin, size_t end) {
+		size_t i = begin;
+#if USE_SSE
+		for (; i + 4 <= end; i += 4) {
+			ComputeTriangleTangents4(vertices, indices + 3 * i,
+				&triangleTangents[i], &triangleBitangents[i]);
 		}
-	};
+#endif
+		for (; i < end; i++) {
+			ComputeTriangleTangent(vertices, indices + 3 * i,
+				triangleTangents[i], triangleBitangents[i]);
+		}
+	}, TRIANGLE_BATCH_SIZE);
 
-	// initialize
-	std::vector<glm::vec3> tangents;
-	tangents.resize(vertices.size());
-	memset(tangents.data(), 0, tangents.size() * sizeof(glm::vec3));
-	
-	// accumulate triangle tangents to each vertex
-	for (size_t i = 0; i < indices.size(); i += 3) {
-	    auto v1 = indices[i  ];
-	    auto v2 = indices[i+1];
-	    auto v3 = indices[i+2];
-	
-	    tangents[v1] += compute(
-			vertices[v1].position, vertices[v2].position, vertices[v3].position,
-			vertices[v1].texCoord, vertices[v2].texCoord, vertices[v3].texCoord);
+	// 2. vertex -> triangle 인접 리스트 (CSR). vertex 마다 자기 triangle 만 모으므로 쓰기 충돌이 없다
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (size_t i = 0; i < vertexCount; i++)
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
 
-	    tangents[v2] = compute(
-			vertices[v2].position, vertices[v3].position, vertices[v1].position,
-			vertices[v2].texCoord, vertices[v3].texCoord, vertices[v1].texCoord);
+	// 3. vertex 별로 모은 뒤 normal 에 대해 Gram-Schmidt 직교화, w 에 handedness 저장
+	threadPool->ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			glm::vec3 tangent(0.0f, 0.0f, 0.0f);
+			glm::vec3 bitangent(0.0f, 0.0f, 0.0f);
+			for (uint32_t j = adjacencyOffsets[i]; j < adjacencyOffsets[i + 1]; j++) {
+				tangent += triangleTangents[adjacency[j]];
+				bitangent += triangleBitangents[adjacency[j]];
+			}
 
-	    tangents[v3] = compute(
-			vertices[v3].position, vertices[v1].position, vertices[v2].position,
-			vertices[v3].texCoord, vertices[v1].texCoord, vertices[v2].texCoord);
+			auto& normal = vertices[i].normal;
+			tangent -= normal * glm::dot(normal, tangent);
+			float length = glm::length(tangent);
+			if (length > 1e-8f) {
+				tangent /= length;
+			}
+			else {
+				// uv 가 없거나 퇴화된 경우 normal 에 수직인 아무 방향이나 쓴다
+				tangent = fabsf(normal.x) < 0.9f ?
+					glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				tangent = glm::normalize(tangent - normal * glm::dot(normal, tangent));
+			}
+			float handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+			vertices[i].tangent = glm::vec4(tangent, handedness);
+		}
+	}, VERTEX_BATCH_SIZE);
+}
+
+bool Mesh::RunTangentBenchmark(int triangleCount) {
+	if (triangleCount < 8) {
+		SPDLOG_ERROR("tangent benchmark: invalid triangle count {}", triangleCount);
+		return false;
 	}
-	
-	// normalize
+	// 서로 떨어진 grid 두 장. 오른쪽은 u 를 뒤집어서 (mirrored uv) handedness 가 -1 이 된다
+	// seam 에서 vertex 를 공유하지 않아야 두 방향이 섞여 0 이 되는 vertex 가 생기지 않는다
+	uint32_t gridSize = (uint32_t)sqrtf((float)triangleCount / 4.0f) + 1;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	vertices.reserve(gridSize * gridSize * 2 + 3);
+	indices.reserve((gridSize - 1) * (gridSize - 1) * 12 + 3);
+	for (int patch = 0; patch < 2; patch++) {
+		uint32_t base = (uint32_t)vertices.size();
+		float offsetX = patch * (float)gridSize;
+		for (uint32_t y = 0; y < gridSize; y++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				float px = offsetX + (float)x;
+				float py = (float)y;
+				// 휘어진 면이라 normal 과 uv 방향이 vertex 마다 달라진다
+				float z = 3.0f * sinf(px * 0.05f) * cosf(py * 0.07f);
+				float dzdx = 0.15f * cosf(px * 0.05f) * cosf(py * 0.07f);
+				float dzdy = -0.21f * sinf(px * 0.05f) * sinf(py * 0.07f);
+				Vertex v;
+				v.position = glm::vec3(px, py, z);
+				v.normal = glm::normalize(glm::vec3(-dzdx, -dzdy, 1.0f));
+				float u = (float)x / (float)(gridSize - 1);
+				v.texCoord = glm::vec2(patch == 0 ? u : 1.0f - u, (float)y / (float)(gridSize - 1));
+				v.tangent = glm::vec4(0.0f);
+				vertices.push_back(v);
+			}
+		}
+		for (uint32_t y = 0; y + 1 < gridSize; y++) {
+			for (uint32_t x = 0; x + 1 < gridSize; x++) {
+				uint32_t i = base + y * gridSize + x;
+				indices.insert(indices.end(), { i, i + 1, i + 1 + gridSize, i, i + 1 + gridSize, i + gridSize });
+			}
+		}
+	}
+	// uv 가 모두 같은 triangle 은 tangent 가 정의되지 않는다 (SIMD 의 det == 0 경로)
+	for (int i = 0; i < 3; i++) {
+		Vertex v;
+		v.position = glm::vec3((float)i, 0.0f, -10.0f);
+		v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+		v.texCoord = glm::vec2(0.5f, 0.5f);
+		v.tangent = glm::vec4(0.0f);
+		indices.push_back((uint32_t)vertices.size());
+		vertices.push_back(v);
+	}
+	size_t actualTriangleCount = indices.size() / 3;
+
+	// 기준 구현: triangle 마다 세 vertex 에 double 로 바로 더하는 단순한 방식
+	auto referenceStartTime = std::chrono::steady_clock::now();
+	std::vector<glm::dvec3> referenceTangents(vertices.size(), glm::dvec3(0.0));
+	std::vector<glm::dvec3> referenceBitangents(vertices.size(), glm::dvec3(0.0));
+	for (size_t i = 0; i < actualTriangleCount; i++) {
+		const uint32_t* triangle = &indices[i * 3];
+		glm::dvec3 p0(vertices[triangle[0]].position);
+		glm::dvec3 edge1 = glm::dvec3(vertices[triangle[1]].position) - p0;
+		glm::dvec3 edge2 = glm::dvec3(vertices[triangle[2]].position) - p0;
+		glm::dvec2 uv0(vertices[triangle[0]].texCoord);
+		glm::dvec2 deltaUV1 = glm::dvec2(vertices[triangle[1]].texCoord) - uv0;
+		glm::dvec2 deltaUV2 = glm::dvec2(vertices[triangle[2]].texCoord) - uv0;
+		double det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+		if (det == 0.0)
+			continue;
+		auto tangent = (deltaUV2.y * edge1 - deltaUV1.y * edge2) / det;
+		auto bitangent = (deltaUV1.x * edge2 - deltaUV2.x * edge1) / det;
+		for (int corner = 0; corner < 3; corner++) {
+			referenceTangents[triangle[corner]] += tangent;
+			referenceBitangents[triangle[corner]] += bitangent;
+		}
+	}
+	float referenceTime = std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - referenceStartTime).count();
+
+	const int runCount = 5;
+	float bestTime = FLT_MAX;
+	float totalTime = 0.0f;
+	std::vector<Vertex> result;
+	for (int run = 0; run < runCount; run++) {
+		result = vertices;
+		auto startTime = std::chrono::steady_clock::now();
+		ComputeTangents(result.data(), result.size(), indices.data(), indices.size());
+		float elapsed = std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count();
+		bestTime = glm::min(bestTime, elapsed);
+		totalTime += elapsed;
+	}
+	SPDLOG_INFO("tangent benchmark: {} triangles, {} vertices ({} threads)",
+		actualTriangleCount, vertices.size(), ThreadPool::GetDefault()->GetThreadCount() + 1);
+	SPDLOG_INFO("  ComputeTangents: best {:.2f} ms, average {:.2f} ms over {} runs",
+		bestTime, totalTime / runCount, runCount);
+	SPDLOG_INFO("  scalar reference accumulation: {:.2f} ms", referenceTime);
+
+	// 직교화한 방향과 handedness 를 비교한다. 기여가 없는 vertex 는 fallback 방향끼리 비교한다
+	size_t directionMismatchCount = 0;
+	size_t handednessMismatchCount = 0;
+	size_t mirroredCount = 0;
+	float minDot = 1.0f;
 	for (size_t i = 0; i < vertices.size(); i++) {
-	    vertices[i].tangent = glm::normalize(tangents[i]);
+		glm::dvec3 normal(vertices[i].normal);
+		auto tangent = referenceTangents[i] - normal * glm::dot(normal, referenceTangents[i]);
+		double length = glm::length(tangent);
+		glm::vec3 expected;
+		if (length > 1e-8) {
+			expected = glm::vec3(tangent / length);
+		}
+		else {
+			auto& n = vertices[i].normal;
+			expected = fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			expected = glm::normalize(expected - n * glm::dot(n, expected));
+		}
+		float expectedHandedness = glm::dot(glm::cross(normal, glm::dvec3(expected)),
+			referenceBitangents[i]) < 0.0 ? -1.0f : 1.0f;
+		auto& actual = result[i].tangent;
+		float dot = glm::dot(glm::vec3(actual), expected);
+		minDot = glm::min(minDot, dot);
+		if (dot < 0.9999f)
+			directionMismatchCount++;
+		if (actual.w != expectedHandedness)
+			handednessMismatchCount++;
+		if (actual.w < 0.0f)
+			mirroredCount++;
 	}
-}
\ No newline at end of file
+	// 오른쪽 grid 의 vertex 는 모두, 나머지는 하나도 mirrored 면 안 된다
+	size_t expectedMirroredCount = gridSize * gridSize;
+	SPDLOG_INFO("  min dot with reference {:.6f}, {} mirrored vertices (expected {})",
+		minDot, mirroredCount, expectedMirroredCount);
+
+	bool success = true;
+	if (directionMismatchCount > 0) {
+		SPDLOG_ERROR("tangent test failed: {} tangents differ from reference", directionMismatchCount);
+		success = false;
+	}
+	if (handednessMismatchCount > 0 || mirroredCount != expectedMirroredCount) {
+		SPDLOG_ERROR("tangent test failed: {} handedness differ from reference, {} mirrored",
+			handednessMismatchCount, mirroredCount);
+		success = false;
+	}
+	if (success)
+		SPDLOG_INFO("tangent test passed");
+	return success;
+}
@@ -5,13 +5,31 @@
 #include "buffer.h"
 #include "vertex_layout.h"
 #include "texture.h"
+#include "texture_array.h"
 #include "program.h"
+#include "thread_pool.h"
+#include "bounds.h"
 
 struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec2 texCoord;
-	glm::vec3 tangent;
+	// w: bitangent = cross(normal, tangent.xyz) * w
+	glm::vec4 tangent;
+};
+
+// instanced draw 에서 instance 마다 넘기는 attribute
+// location 4~7: model transform, location 8: material parameter (x: roughness, y: metallic)
+struct InstanceData {
+	glm::mat4 modelTransform;
+	glm::vec4 materialParams;
+};
+
+// GPU 에 올릴 vertex layout
+// Packed: vertex_packing.h 의 PackedVertex (20 byte), shader 에서 positionOffset / positionScale 로 복원
+enum class VertexFormat {
+	Float,
+	Packed,
 };
 
 CLASS_PTR(Material);
@@ -22,6 +40,10 @@ public:
     }
     TexturePtr diffuse;
     TexturePtr specular;
+    // TextureArrayManager 로 올린 경우 diffuse / specular 대신 쓴다
+    // 같은 array 를 쓰는 material 끼리는 bind 없이 layer / scaleOffset uniform 만 바뀐다
+    TextureLayer diffuseLayer;
+    TextureLayer specularLayer;
     float shininess { 32.0f };
 
 	void SetToProgram(const Program* program) const;
@@ -33,15 +55,25 @@ private:
 CLASS_PTR(Mesh);
 class Mesh {
 public:
+	// computeTangents 가 false 면 vertices 의 tangent 를 그대로 올린다
 	static MeshUPtr Create(
-	    const std::vector<Vertex>& vertices,
+	    std::vector<Vertex> vertices,
 	    const std::vector<uint32_t>& indices,
-	    uint32_t primitiveType);
+	    uint32_t primitiveType,
+	    bool computeTangents = true,
+	    VertexFormat vertexFormat = VertexFormat::Float);
+	// 이미 tangent 까지 계산된 데이터 (예: memory mapped 파일) 를 복사 없이 그대로 올린다
+	static MeshUPtr Create(
+	    const Vertex* vertices, size_t vertexCount,
+	    const uint32_t* indices, size_t indexCount,
+	    uint32_t primitiveType,
+	    VertexFormat vertexFormat = VertexFormat::Float);
 	static MeshUPtr CreateBox();
 	static MeshUPtr CreatePlane();
 	static MeshUPtr CreateSphere(
 		uint32_t latiSegmentCount = 16,
-		uint32_t longiSegmentCount = 32);
+		uint32_t longiSegmentCount = 32,
+		VertexFormat vertexFormat = VertexFormat::Float);
 
 	const VertexLayout* GetVertexLayout() const { return m_vertexLayout.get(); }
 	BufferPtr GetVertexBuffer() const { return m_vertexBuffer; }
@@ -50,21 +82,52 @@ public:
 	void SetMaterial(MaterialPtr material) { m_material = material; }
 	MaterialPtr GetMaterial() const { return m_material; }
 
+	VertexFormat GetVertexFormat() const { return m_vertexFormat; }
+	const glm::vec3& GetPositionOffset() const { return m_positionOffset; }
+	const glm::vec3& GetPositionScale() const { return m_positionScale; }
+
+	// 생성 시 vertex position 으로 계산한 local 공간 bounds
+	const AABB& GetBounds() const { return m_bounds; }
+	const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+
+	// InstanceData 배열을 담은 buffer 를 VAO 의 location 4~8 에 한 번만 연결해 둔다
+	// mesh 하나에 instance buffer 하나. 내용은 Buffer::Update 로 바꾼다
+	void SetInstanceBuffer(BufferPtr instanceBuffer);
+	BufferPtr GetInstanceBuffer() const { return m_instanceBuffer; }
+
 	void Draw(const Program* program) const;
+	// SetInstanceBuffer 로 연결한 buffer 의 앞 instanceCount 개를 그린다
+	void DrawInstanced(const Program* program, uint32_t instanceCount) const;
+	// material 은 건드리지 않고 그린다 (RenderQueue 처럼 material 을 따로 관리할 때)
+	void DrawGeometry(const Program* program) const;
+	void DrawGeometryInstanced(const Program* program, uint32_t instanceCount) const;
 
 	static void ComputeTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	// threadPool 이 nullptr 이면 ThreadPool::GetDefault() 를 쓴다
+	static void ComputeTangents(Vertex* vertices, size_t vertexCount,
+		const uint32_t* indices, size_t indexCount, ThreadPool* threadPool = nullptr);
+	// triangleCount 개 정도의 grid 로 ComputeTangents 시간을 재고 triangle 마다 바로 더하는
+	// scalar 기준 구현과 방향 / handedness (tangent.w) 를 비교한다. GL context 없이 동작
+	static bool RunTangentBenchmark(int triangleCount);
 
 private:
 	Mesh() {}
 	void Init(
-		const std::vector<Vertex>& vertices,
-		const std::vector<uint32_t>& indices,
-		uint32_t primitiveType);
+		const Vertex* vertices, size_t vertexCount,
+		const uint32_t* indices, size_t indexCount,
+		uint32_t primitiveType, VertexFormat vertexFormat);
+	void SetVertexFormatToProgram(const Program* program) const;
 
 	uint32_t m_primitiveType { GL_TRIANGLES };
+	VertexFormat m_vertexFormat { VertexFormat::Float };
+	glm::vec3 m_positionOffset { 0.0f };
+	glm::vec3 m_positionScale { 1.0f };
+	AABB m_bounds;
+	BoundingSphere m_boundingSphere;
 	VertexLayoutUPtr m_vertexLayout;
 	BufferPtr m_vertexBuffer;
 	BufferPtr m_indexBuffer;
+	BufferPtr m_instanceBuffer;
 
 	MaterialPtr m_material;
 };
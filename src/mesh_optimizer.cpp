@@ -0,0 +1,409 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <array>
+#include <random>
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+	size_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStatistics stats;
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// 마지막으로 cache 에 들어간 시점만 기록하면 FIFO cache 를 흉내낼 수 있다
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; i++) {
+		auto index = indices[i];
+		if (timestamp - cacheTimestamps[index] > cacheSize) {
+			cacheTimestamps[index] = timestamp++;
+			stats.transformedVertexCount++;
+		}
+	}
+
+	stats.acmr = (float)stats.transformedVertexCount / (float)(indexCount / 3);
+	stats.atvr = (float)stats.transformedVertexCount / (float)vertexCount;
+	return stats;
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" 의 score 함수
+static const int FORSYTH_CACHE_SIZE = 32;
+static const int FORSYTH_MAX_VALENCE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+struct ForsythScoreTable {
+	float cache[FORSYTH_CACHE_SIZE];
+	float valence[FORSYTH_MAX_VALENCE + 1];
+
+	ForsythScoreTable() {
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+			if (i < 3) {
+				cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else {
+				float scaler = 1.0f / (float)(FORSYTH_CACHE_SIZE - 3);
+				cache[i] = powf(1.0f - (float)(i - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+		valence[0] = 0.0f;
+		for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+			valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	float GetScore(int cachePosition, uint32_t remainingTriangles) const {
+		if (remainingTriangles == 0)
+			return -1.0f;
+		float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+		return score + valence[std::min(remainingTriangles, (uint32_t)FORSYTH_MAX_VALENCE)];
+	}
+};
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	static const ForsythScoreTable scoreTable;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// vertex -> triangle 인접 리스트 (CSR)
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remaining[i];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		vertexScores[i] = scoreTable.GetScore(-1, remaining[i]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t bestTriangle = 0;
+	for (size_t i = 0; i < triangleCount; i++) {
+		triangleScores[i] = vertexScores[indices[3*i]] +
+			vertexScores[indices[3*i+1]] + vertexScores[indices[3*i+2]];
+		if (triangleScores[i] > triangleScores[bestTriangle])
+			bestTriangle = (uint32_t)i;
+	}
+
+	std::vector<uint32_t> output(triangleCount * 3);
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t inputCursor = 0;
+
+	for (size_t outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++) {
+		if (bestTriangle == UINT32_MAX) {
+			// cache 주변에 남은 triangle 이 없으면 입력 순서대로 다음 triangle 을 고른다
+			while (emitted[inputCursor])
+				inputCursor++;
+			bestTriangle = (uint32_t)inputCursor;
+		}
+
+		const uint32_t* triangle = indices + 3 * bestTriangle;
+		output[3*outputTriangle  ] = triangle[0];
+		output[3*outputTriangle+1] = triangle[1];
+		output[3*outputTriangle+2] = triangle[2];
+		emitted[bestTriangle] = true;
+
+		// 그린 triangle 을 각 vertex 의 인접 리스트에서 뺀다
+		for (int k = 0; k < 3; k++) {
+			auto v = triangle[k];
+			auto begin = adjacency.begin() + adjacencyOffsets[v];
+			auto end = begin + remaining[v];
+			auto it = std::find(begin, end, bestTriangle);
+			std::iter_swap(it, end - 1);
+			remaining[v]--;
+		}
+
+		// 방금 쓴 vertex 를 cache 앞으로 옮기고 나머지는 한 칸씩 밀어낸다
+		int newCacheCount = 0;
+		for (int k = 0; k < 3; k++)
+			newCache[newCacheCount++] = triangle[k];
+		for (int k = 0; k < cacheCount; k++) {
+			auto v = cache[k];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache[newCacheCount++] = v;
+		}
+		// cache 에서 밀려난 vertex 도 score 가 바뀌므로 같이 갱신한다
+		for (int k = 0; k < newCacheCount; k++) {
+			auto v = newCache[k];
+			int position = k < FORSYTH_CACHE_SIZE ? k : -1;
+			cachePositions[v] = position;
+			vertexScores[v] = scoreTable.GetScore(position, remaining[v]);
+		}
+		std::copy(newCache, newCache + std::min(newCacheCount, FORSYTH_CACHE_SIZE), cache);
+		cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+
+		bestTriangle = UINT32_MAX;
+		float bestScore = -1.0f;
+		for (int k = 0; k < newCacheCount; k++) {
+			auto v = newCache[k];
+			for (uint32_t j = 0; j < remaining[v]; j++) {
+				auto t = adjacency[adjacencyOffsets[v] + j];
+				float score = vertexScores[indices[3*t]] +
+					vertexScores[indices[3*t+1]] + vertexScores[indices[3*t+2]];
+				triangleScores[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+	const Vertex* vertices, size_t vertexCount, float threshold) {
+	static const uint32_t CACHE_SIZE = 16;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t timestamp = CACHE_SIZE + 1;
+	auto UpdateCache = [&](size_t triangle) -> uint32_t {
+		uint32_t missCount = 0;
+		for (int k = 0; k < 3; k++) {
+			auto index = indices[3 * triangle + k];
+			if (timestamp - cacheTimestamps[index] > CACHE_SIZE) {
+				cacheTimestamps[index] = timestamp++;
+				missCount++;
+			}
+		}
+		return missCount;
+	};
+	auto ResetCache = [&]() {
+		timestamp += CACHE_SIZE + 1;
+	};
+
+	// 세 vertex 가 모두 cache miss 인 곳은 cache 가 사실상 비워진 곳이라 자유롭게 자를 수 있다 (hard boundary)
+	std::vector<size_t> hardBoundaries;
+	for (size_t i = 0; i < triangleCount; i++) {
+		if (UpdateCache(i) == 3)
+			hardBoundaries.push_back(i);
+	}
+	if (hardBoundaries.empty() || hardBoundaries.front() != 0)
+		hardBoundaries.insert(hardBoundaries.begin(), 0);
+	hardBoundaries.push_back(triangleCount);
+
+	// hard cluster 안에서 ACMR 이 threshold 배 이내로 유지되는 한 더 잘게 자른다 (soft boundary)
+	std::vector<size_t> clusterStarts;
+	for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+		size_t begin = hardBoundaries[c];
+		size_t end = hardBoundaries[c + 1];
+
+		ResetCache();
+		uint32_t clusterMissCount = 0;
+		for (size_t i = begin; i < end; i++)
+			clusterMissCount += UpdateCache(i);
+		float targetAcmr = threshold * (float)clusterMissCount / (float)(end - begin);
+
+		ResetCache();
+		size_t start = begin;
+		uint32_t missCount = 0;
+		clusterStarts.push_back(begin);
+		for (size_t i = begin; i < end; i++) {
+			missCount += UpdateCache(i);
+			float acmr = (float)missCount / (float)(i + 1 - start);
+			if (acmr <= targetAcmr && i + 1 < end) {
+				start = i + 1;
+				missCount = 0;
+				clusterStarts.push_back(start);
+				ResetCache();
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	// mesh 중심에서 멀고 바깥을 향하는 cluster 일수록 다른 cluster 를 가릴 가능성이 높으므로 먼저 그린다
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> clusterCenters(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> clusterAreas(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++) {
+		for (size_t i = clusterStarts[c]; i < clusterStarts[c + 1]; i++) {
+			auto& p0 = vertices[indices[3*i  ]].position;
+			auto& p1 = vertices[indices[3*i+1]].position;
+			auto& p2 = vertices[indices[3*i+2]].position;
+			auto normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			clusterCenters[c] += (p0 + p1 + p2) * (area / 3.0f);
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+		}
+		meshCenter += clusterCenters[c];
+		meshArea += clusterAreas[c];
+		if (clusterAreas[c] > 0.0f)
+			clusterCenters[c] /= clusterAreas[c];
+	}
+	if (meshArea > 0.0f)
+		meshCenter /= meshArea;
+
+	std::vector<float> clusterSortKeys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++) {
+		float normalLength = glm::length(clusterNormals[c]);
+		if (normalLength > 0.0f)
+			clusterSortKeys[c] = glm::dot(clusterCenters[c] - meshCenter,
+				clusterNormals[c] / normalLength);
+	}
+
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) {
+		return clusterSortKeys[a] > clusterSortKeys[b];
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (auto c: clusterOrder) {
+		output.insert(output.end(), indices + 3 * clusterStarts[c],
+			indices + 3 * clusterStarts[c + 1]);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> newVertices;
+	newVertices.reserve(vertices.size());
+	for (auto& index: indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = (uint32_t)newVertices.size();
+			newVertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(newVertices);
+	return vertices.size();
+}
+
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+	OptimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+	OptimizeVertexFetch(vertices, indices);
+}
+
+bool RunMeshOptimizerTest() {
+	bool success = true;
+	auto Check = [&](bool condition, const std::string& message) {
+		if (!condition) {
+			SPDLOG_ERROR("mesh optimizer test failed: {}", message);
+			success = false;
+		}
+	};
+
+	// 1. 손으로 셀 수 있는 입력: 모서리를 공유하는 triangle 2 개는 vertex 4 개만 변환한다
+	{
+		uint32_t quad[] = { 0, 1, 2, 2, 1, 3 };
+		auto stats = AnalyzeVertexCache(quad, 6, 4);
+		Check(stats.transformedVertexCount == 4 && stats.acmr == 2.0f && stats.atvr == 1.0f,
+			fmt::format("quad: {} transformed, ACMR {}, ATVR {}",
+				stats.transformedVertexCount, stats.acmr, stats.atvr));
+		// cache 가 3 이면 두 번째 triangle 의 2, 1 은 남아 있고 네 번째 vertex 0 은 밀려난다
+		uint32_t evict[] = { 0, 1, 2, 2, 1, 3, 3, 1, 0 };
+		stats = AnalyzeVertexCache(evict, 9, 4, 3);
+		Check(stats.transformedVertexCount == 5,
+			fmt::format("FIFO eviction: {} transformed, expected 5", stats.transformedVertexCount));
+	}
+
+	// 2. 64x64 grid 의 triangle 순서를 섞은 뒤 최적화한다
+	// texCoord.x 에 원래 vertex 번호를 넣어서 재배치 후에도 triangle 을 추적한다
+	const uint32_t gridSize = 64;
+	std::vector<Vertex> vertices(gridSize * gridSize);
+	for (uint32_t y = 0; y < gridSize; y++) {
+		for (uint32_t x = 0; x < gridSize; x++) {
+			auto& v = vertices[y * gridSize + x];
+			v.position = glm::vec3((float)x, (float)y, sinf((float)x * 0.3f) * cosf((float)y * 0.2f));
+			v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			v.texCoord = glm::vec2((float)(y * gridSize + x), 0.0f);
+			v.tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (uint32_t y = 0; y + 1 < gridSize; y++) {
+		for (uint32_t x = 0; x + 1 < gridSize; x++) {
+			uint32_t i = y * gridSize + x;
+			triangles.push_back({ i, i + 1, i + 1 + gridSize });
+			triangles.push_back({ i, i + 1 + gridSize, i + gridSize });
+		}
+	}
+	std::mt19937 random(1234);
+	std::shuffle(triangles.begin(), triangles.end(), random);
+	std::vector<uint32_t> indices;
+	for (auto& triangle: triangles)
+		indices.insert(indices.end(), triangle.begin(), triangle.end());
+	// 2 개는 아무 triangle 도 쓰지 않는 vertex 로 남긴다
+	vertices.push_back(vertices[0]);
+	vertices.push_back(vertices[1]);
+
+	// winding 을 유지한 채 가장 작은 번호가 앞에 오도록 돌린 triangle 목록 (정렬해서 비교)
+	auto CanonicalTriangles = [](const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+		std::vector<std::array<uint32_t, 3>> result;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			std::array<uint32_t, 3> ids;
+			for (int k = 0; k < 3; k++)
+				ids[k] = (uint32_t)vertices[indices[i + k]].texCoord.x;
+			auto first = std::min_element(ids.begin(), ids.end()) - ids.begin();
+			std::rotate(ids.begin(), ids.begin() + first, ids.end());
+			result.push_back(ids);
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	};
+	auto originalTriangles = CanonicalTriangles(vertices, indices);
+	auto before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+	// vertex cache 단계만 돌려도 index 는 순서만 바뀐다
+	auto cacheIndices = indices;
+	OptimizeVertexCache(cacheIndices.data(), cacheIndices.size(), vertices.size());
+	Check(CanonicalTriangles(vertices, cacheIndices) == originalTriangles,
+		"OptimizeVertexCache changed the triangle set");
+	auto cacheStats = AnalyzeVertexCache(cacheIndices.data(), cacheIndices.size(), vertices.size());
+
+	auto optimizedVertices = vertices;
+	auto optimizedIndices = indices;
+	OptimizeMesh(optimizedVertices, optimizedIndices);
+	auto after = AnalyzeVertexCache(optimizedIndices.data(), optimizedIndices.size(),
+		optimizedVertices.size());
+	Check(CanonicalTriangles(optimizedVertices, optimizedIndices) == originalTriangles,
+		"OptimizeMesh changed the triangle set or winding");
+	// Forsyth 로 정렬한 grid 는 ACMR 0.8 아래로 내려가야 한다 (섞인 상태는 약 3)
+	Check(cacheStats.acmr < 0.8f, fmt::format("vertex cache ACMR {:.3f} >= 0.8", cacheStats.acmr));
+	// overdraw 단계는 threshold (5%) 까지만 ACMR 을 잃을 수 있다
+	Check(after.acmr <= cacheStats.acmr * 1.05f + 1e-4f,
+		fmt::format("overdraw ordering ACMR {:.3f} > {:.3f} * 1.05", after.acmr, cacheStats.acmr));
+
+	// vertex fetch: 쓰이지 않는 vertex 는 빠지고 처음 참조되는 순서대로 번호가 붙는다
+	Check(optimizedVertices.size() == gridSize * gridSize,
+		fmt::format("{} vertices left, expected {}", optimizedVertices.size(), gridSize * gridSize));
+	uint32_t nextIndex = 0;
+	bool fetchOrdered = true;
+	for (auto index: optimizedIndices) {
+		if (index == nextIndex)
+			nextIndex++;
+		else if (index > nextIndex)
+			fetchOrdered = false;
+	}
+	Check(fetchOrdered && nextIndex == optimizedVertices.size(), "vertices are not in first-use order");
+
+	SPDLOG_INFO("mesh optimizer test: {} triangles, ACMR {:.3f} -> {:.3f} (cache) -> {:.3f} (overdraw), "
+		"ATVR {:.3f} -> {:.3f}: {}", triangles.size(), before.acmr, cacheStats.acmr, after.acmr,
+		before.atvr, after.atvr, success ? "passed" : "FAILED");
+	return success;
+}
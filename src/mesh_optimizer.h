@@ -0,0 +1,39 @@
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+
+#include "common.h"
+#include "mesh.h"
+#include <vector>
+
+// GL 없이 동작하는 triangle list index/vertex 재배치 함수 모음
+
+// FIFO post-transform cache 시뮬레이션 결과
+// acmr: triangle 당 vertex shader 실행 수 (0.5 ~ 3), atvr: vertex 당 실행 수 (1 이 최적)
+struct VertexCacheStatistics {
+    uint32_t transformedVertexCount { 0 };
+    float acmr { 0.0f };
+    float atvr { 0.0f };
+};
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+    size_t vertexCount, uint32_t cacheSize = 16);
+
+// Forsyth 방식의 vertex cache 최적화. indices 를 제자리에서 재배치한다
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// vertex cache 최적화가 끝난 indices 를 cluster 로 나누고 바깥을 향하는 cluster 부터 그리도록 정렬한다
+// threshold 는 cluster 를 잘게 나누면서 허용할 ACMR 증가 비율
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+    const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+// 처음 참조되는 순서대로 vertex 를 재배치하고 쓰이지 않는 vertex 는 버린다
+// 남은 vertex 개수를 반환
+size_t OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// 위 세 단계를 순서대로 적용한다
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// 알려진 입력으로 cache 통계와 최적화 결과 (triangle 보존, ACMR 개선, fetch 순서) 를 검사한다
+// 실패한 항목을 로그로 남기고 false 를 반환한다
+bool RunMeshOptimizerTest();
+
+#endif // __MESH_OPTIMIZER_H__
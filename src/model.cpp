@@ -1,13 +1,234 @@
 #include "model.h"
+#include "texture_cache.h"
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include <chrono>
+#include <map>
+#include <fstream>
+#include <functional>
+#include <cstring>
+#include <filesystem>
+#include <cmath>
 
-ModelUPtr Model::Load(const std::string& filename) {
+// baked model 파일 구조
+// header | materials | meshes | nodes | node mesh indices | strings | vertex/index data
+// 모든 section 은 16 byte 정렬이라 mapping 된 메모리를 그대로 Vertex 배열로 쓸 수 있다
+static const char BAKED_MODEL_MAGIC[4] = { 'O', 'G', 'L', 'M' };
+static const uint32_t BAKED_MODEL_VERSION = 3;
+static const uint32_t BAKED_MODEL_NO_STRING = 0xffffffff;
+
+struct BakedModelHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t materialCount;
+    uint32_t meshCount;
+    uint32_t nodeCount;
+    uint32_t nodeMeshIndexCount;
+    uint32_t reserved;
+    uint64_t materialOffset;
+    uint64_t meshOffset;
+    uint64_t nodeOffset;
+    uint64_t nodeMeshIndexOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+};
+
+struct BakedMaterial {
+    uint32_t diffusePath;
+    uint32_t specularPath;
+};
+
+struct BakedMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t materialIndex;
+    uint32_t reserved;
+};
+
+// parent 가 항상 child 보다 앞에 오는 depth first 순서
+struct BakedNode {
+    float transform[16];
+    int32_t parent;
+    uint32_t firstMeshIndex;
+    uint32_t meshIndexCount;
+    uint32_t name;
+};
+
+static uint64_t AlignOffset(uint64_t offset) {
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+// assimp 는 row major
+static glm::mat4 ToGlmMatrix(const aiMatrix4x4& m) {
+    float transform[16] = {
+        m.a1, m.b1, m.c1, m.d1,
+        m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3,
+        m.a4, m.b4, m.c4, m.d4,
+    };
+    return glm::make_mat4(transform);
+}
+
+ModelUPtr Model::Load(const std::string& filename, bool optimizeMeshes,
+	bool useTextureArrays, TextureStreamer* textureStreamer) {
+	auto model = ModelUPtr(new Model());
+	if (!model->LoadByAssimp(filename, optimizeMeshes, useTextureArrays, textureStreamer))
+		return nullptr;
+	return std::move(model);
+}
+
+ModelUPtr Model::LoadBaked(const std::string& filename, bool useTextureArrays,
+	TextureStreamer* textureStreamer) {
 	auto model = ModelUPtr(new Model());
-	if (!model->LoadByAssimp(filename))
+	if (!model->LoadFromBakedFile(filename, useTextureArrays, textureStreamer))
 		return nullptr;
 	return std::move(model);
 }
 
-bool Model::LoadByAssimp(const std::string& filename) {
+std::vector<Model::MaterialData> Model::ProcessMaterials(const aiScene* scene) {
+	auto GetTexturePath = [](aiMaterial* material, aiTextureType type) -> std::string {
+		if (material->GetTextureCount(type) <= 0)
+			return std::string();
+		aiString filepath;
+		material->GetTexture(type, 0, &filepath);
+		return filepath.C_Str();
+	};
+
+	std::vector<MaterialData> materials(scene->mNumMaterials);
+	for (uint32_t i = 0; i < scene->mNumMaterials; i++) {
+		materials[i].diffusePath = GetTexturePath(scene->mMaterials[i], aiTextureType_DIFFUSE);
+		materials[i].specularPath = GetTexturePath(scene->mMaterials[i], aiTextureType_SPECULAR);
+	}
+	return materials;
+}
+
+void Model::CreateMaterials(const std::string& dirname,
+	const std::vector<MaterialData>& materials, bool useTextureArrays,
+	TextureStreamer* textureStreamer, const std::function<void()>& overlappedWork) {
+	auto threadPool = ThreadPool::GetDefault();
+
+	// 같은 파일은 한 번만 decode 하고, 이미 만들어진 텍스처는 cache 에서 가져온다
+	auto textureCache = TextureCache::Get();
+	TextureLoadOption textureOption;
+	std::map<std::string, TexturePtr> textures;
+	// decode 와 mip chain 생성을 worker 에서 한다. [0] 이 원본 level
+	std::map<std::string, std::future<std::vector<ImageUPtr>>> imageFutures;
+	size_t streamedCount = 0;
+	for (auto& material: materials) {
+		for (auto& relativePath: { material.diffusePath, material.specularPath }) {
+			if (relativePath.empty())
+				continue;
+			auto path = fmt::format("{}/{}", dirname, relativePath);
+			if (textures.find(path) != textures.end() ||
+				imageFutures.find(path) != imageFutures.end())
+				continue;
+			// array 에는 압축하지 않은 level 을 올리므로 cache 와 block 압축 .dds 를 건너뛴다
+			if (useTextureArrays) {
+				imageFutures[path] = threadPool->Submit([path, textureOption]() {
+					return LoadImageLevels(path, textureOption);
+				});
+				continue;
+			}
+			// streamer 는 압축하지 않은 row 를 PBO 로 올리므로 .dds 대신 원본을 읽는다
+			// cache 조회와 등록도 streamer 가 한다
+			if (textureStreamer) {
+				textures[path] = textureStreamer->Load(path, textureOption);
+				streamedCount++;
+				continue;
+			}
+			// --compress / --bake-image 로 만들어 둔 같은 이름의 .dds 가 있으면 decode 없이 그것을 올린다
+			// 실제로 올릴 파일로 cache 를 한 번만 찾아서 텍스처 하나에 hit / miss 가 하나만 세지게 한다
+			auto sourcePath = path;
+			auto extPos = path.find_last_of('.');
+			if (extPos != std::string::npos && extPos > path.find_last_of('/')) {
+				auto compressedPath = path.substr(0, extPos) + ".dds";
+				if (compressedPath != path && std::filesystem::exists(compressedPath))
+					sourcePath = compressedPath;
+			}
+			auto texture = textureCache->Find(sourcePath, textureOption);
+			if (!texture && sourcePath != path)
+				texture = textureCache->LoadMissing(sourcePath, textureOption);
+			if (texture) {
+				textures[path] = texture;
+				continue;
+			}
+			imageFutures[path] = threadPool->Submit([path, textureOption]() {
+				return LoadImageLevels(path, textureOption);
+			});
+		}
+	}
+
+	overlappedWork();
+
+	if (useTextureArrays) {
+		// 없는 텍스처는 흰색 (diffuse) / 검은색 (specular) layer 로 채워서 shader 를 하나로 쓴다
+		m_textureArrays = TextureArrayManager::Create(textureOption.sRGB);
+		std::map<std::string, uint32_t> handles;
+		for (auto& [path, future]: imageFutures) {
+			auto levels = future.get();
+			if (!levels.empty())
+				handles[path] = m_textureArrays->Add(std::move(levels));
+		}
+		std::vector<ImageUPtr> whiteLevels;
+		whiteLevels.push_back(Image::CreateSingleColorImage(4, 4, glm::vec4(1.0f)));
+		auto whiteHandle = m_textureArrays->Add(std::move(whiteLevels));
+		std::vector<ImageUPtr> blackLevels;
+		blackLevels.push_back(Image::CreateSingleColorImage(4, 4, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+		auto blackHandle = m_textureArrays->Add(std::move(blackLevels));
+		if (!m_textureArrays->Build()) {
+			SPDLOG_ERROR("failed to build texture arrays: {}", dirname);
+			m_textureArrays.reset();
+			return;
+		}
+
+		auto GetLayer = [&](const std::string& relativePath, uint32_t defaultHandle) {
+			auto it = relativePath.empty() ? handles.end() :
+				handles.find(fmt::format("{}/{}", dirname, relativePath));
+			return m_textureArrays->GetLayer(it != handles.end() ? it->second : defaultHandle);
+		};
+		for (auto& material: materials) {
+			auto glMaterial = Material::Create();
+			glMaterial->diffuseLayer = GetLayer(material.diffusePath, whiteHandle);
+			glMaterial->specularLayer = GetLayer(material.specularPath, blackHandle);
+			m_materials.push_back(std::move(glMaterial));
+		}
+		SPDLOG_INFO("created {} materials ({} textures in {} arrays)",
+			m_materials.size(), handles.size(), m_textureArrays->GetArrayCount());
+		return;
+	}
+	for (auto& [path, future]: imageFutures) {
+		auto levels = future.get();
+		if (levels.empty()) {
+			textures[path] = nullptr;
+			continue;
+		}
+		TexturePtr texture = Texture::CreateFromMipChain(levels, textureOption.sRGB);
+		textureCache->Insert(path, textureOption, texture);
+		textures[path] = texture;
+	}
+
+	auto GetTexture = [&](const std::string& relativePath) -> TexturePtr {
+		if (relativePath.empty())
+			return nullptr;
+		return textures[fmt::format("{}/{}", dirname, relativePath)];
+	};
+	for (auto& material: materials) {
+		auto glMaterial = Material::Create();
+		glMaterial->diffuse = GetTexture(material.diffusePath);
+		glMaterial->specular = GetTexture(material.specularPath);
+		m_materials.push_back(std::move(glMaterial));
+	}
+	SPDLOG_INFO("created {} materials ({} textures, {} decoded, {} streaming)",
+		m_materials.size(), textures.size(), imageFutures.size(), streamedCount);
+}
+
+bool Model::LoadByAssimp(const std::string& filename, bool optimizeMeshes,
+	bool useTextureArrays, TextureStreamer* textureStreamer) {
+	auto startTime = std::chrono::steady_clock::now();
+
 	Assimp::Importer importer;
 	auto scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_FlipUVs);
 
@@ -16,56 +237,302 @@ bool Model::LoadByAssimp(const std::string& filename) {
 		return false;
 	}
 
+	// 이미지 decode 와 mesh 변환은 worker 에서, GL 업로드는 이 thread 에서만 한다
+	auto threadPool = ThreadPool::GetDefault();
 	auto dirname = filename.substr(0, filename.find_last_of("/"));
-	auto LoadTexture = [&](aiMaterial* material, aiTextureType type) -> TexturePtr {
-		if (material->GetTextureCount(type) <= 0)
-			return nullptr;
-		aiString filepath;
-		material->GetTexture(type, 0, &filepath);
-		auto image = Image::Load(fmt::format("{}/{}", dirname, filepath.C_Str()));
-		if (!image)
-			return nullptr;
-		return Texture::CreateFromImage(image.get());
+
+	std::vector<const aiMesh*> meshes;
+	m_sceneGraph = SceneGraph::Create();
+	ProcessNode(scene->mRootNode, SceneGraph::NO_PARENT, scene, meshes);
+	m_sceneGraph->UpdateWorldTransforms();
+	std::vector<MeshData> meshData(meshes.size());
+	CreateMaterials(dirname, ProcessMaterials(scene), useTextureArrays, textureStreamer, [&]() {
+		threadPool->ParallelFor(meshes.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				meshData[i] = ProcessMesh(meshes[i], optimizeMeshes);
+		});
+	});
+
+	for (auto& data: meshData) {
+		auto glMesh = Mesh::Create(std::move(data.vertices), data.indices, GL_TRIANGLES, false);
+		if (data.materialIndex < m_materials.size())
+			glMesh->SetMaterial(m_materials[data.materialIndex]);
+		m_meshes.push_back(std::move(glMesh));
+	}
+
+	UpdateBounds();
+	SPDLOG_INFO("loaded model: {} ({} meshes, {} threads) in {:.1f} ms",
+		filename, m_meshes.size(), threadPool->GetThreadCount() + 1,
+		std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count());
+	return true;
+}
+
+bool Model::Bake(const std::string& filename, const std::string& bakedFilename,
+	bool optimizeMeshes) {
+	auto startTime = std::chrono::steady_clock::now();
+
+	Assimp::Importer importer;
+	auto scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_FlipUVs);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		SPDLOG_ERROR("failed to load model: {}", filename);
+		return false;
+	}
+
+	std::vector<MeshData> meshData(scene->mNumMeshes);
+	ThreadPool::GetDefault()->ParallelFor(scene->mNumMeshes, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			meshData[i] = ProcessMesh(scene->mMeshes[i], optimizeMeshes);
+	});
+
+	std::string strings;
+	auto AddString = [&](const std::string& str) -> uint32_t {
+		if (str.empty())
+			return BAKED_MODEL_NO_STRING;
+		auto offset = (uint32_t)strings.size();
+		strings += str;
+		strings.push_back('\0');
+		return offset;
 	};
+	std::vector<BakedNode> nodes;
+	std::vector<uint32_t> nodeMeshIndices;
+	std::function<void(const aiNode*, int32_t)> CollectNode =
+		[&](const aiNode* node, int32_t parent) {
+		BakedNode bakedNode = {};
+		auto transform = ToGlmMatrix(node->mTransformation);
+		memcpy(bakedNode.transform, glm::value_ptr(transform), sizeof(bakedNode.transform));
+		bakedNode.parent = parent;
+		bakedNode.name = AddString(node->mName.C_Str());
+		bakedNode.firstMeshIndex = (uint32_t)nodeMeshIndices.size();
+		bakedNode.meshIndexCount = node->mNumMeshes;
+		for (uint32_t i = 0; i < node->mNumMeshes; i++)
+			nodeMeshIndices.push_back(node->mMeshes[i]);
 
-	for (uint32_t i = 0; i < scene->mNumMaterials; i++) {
-		auto material = scene->mMaterials[i];
-		auto glMaterial = Material::Create();
-		glMaterial->diffuse = LoadTexture(material, aiTextureType_DIFFUSE);
-		glMaterial->specular = LoadTexture(material, aiTextureType_SPECULAR);
-		m_materials.push_back(std::move(glMaterial));
+		int32_t nodeIndex = (int32_t)nodes.size();
+		nodes.push_back(bakedNode);
+		for (uint32_t i = 0; i < node->mNumChildren; i++)
+			CollectNode(node->mChildren[i], nodeIndex);
+	};
+	CollectNode(scene->mRootNode, -1);
+
+	std::vector<BakedMaterial> materials;
+	for (auto& material: ProcessMaterials(scene))
+		materials.push_back({ AddString(material.diffusePath), AddString(material.specularPath) });
+
+	BakedModelHeader header = {};
+	memcpy(header.magic, BAKED_MODEL_MAGIC, sizeof(BAKED_MODEL_MAGIC));
+	header.version = BAKED_MODEL_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.materialCount = (uint32_t)materials.size();
+	header.meshCount = (uint32_t)meshData.size();
+	header.nodeCount = (uint32_t)nodes.size();
+	header.nodeMeshIndexCount = (uint32_t)nodeMeshIndices.size();
+	header.materialOffset = AlignOffset(sizeof(BakedModelHeader));
+	header.meshOffset = AlignOffset(header.materialOffset + sizeof(BakedMaterial) * materials.size());
+	header.nodeOffset = AlignOffset(header.meshOffset + sizeof(BakedMesh) * meshData.size());
+	header.nodeMeshIndexOffset = AlignOffset(header.nodeOffset + sizeof(BakedNode) * nodes.size());
+	header.stringOffset = AlignOffset(header.nodeMeshIndexOffset + sizeof(uint32_t) * nodeMeshIndices.size());
+	header.stringSize = strings.size();
+
+	std::vector<BakedMesh> meshes(meshData.size());
+	uint64_t dataOffset = AlignOffset(header.stringOffset + header.stringSize);
+	for (size_t i = 0; i < meshData.size(); i++) {
+		meshes[i] = {};
+		meshes[i].vertexOffset = dataOffset;
+		meshes[i].vertexCount = (uint32_t)meshData[i].vertices.size();
+		dataOffset = AlignOffset(dataOffset + sizeof(Vertex) * meshes[i].vertexCount);
+		meshes[i].indexOffset = dataOffset;
+		meshes[i].indexCount = (uint32_t)meshData[i].indices.size();
+		dataOffset = AlignOffset(dataOffset + sizeof(uint32_t) * meshes[i].indexCount);
+		meshes[i].materialIndex = meshData[i].materialIndex;
+	}
+
+	std::ofstream fout(bakedFilename, std::ios::binary);
+	if (!fout.is_open()) {
+		SPDLOG_ERROR("failed to write baked model: {}", bakedFilename);
+		return false;
+	}
+	auto Write = [&](uint64_t offset, const void* data, size_t size) {
+		static const char zeros[16] = {};
+		uint64_t position = (uint64_t)fout.tellp();
+		fout.write(zeros, offset - position);
+		fout.write((const char*)data, size);
+	};
+	Write(0, &header, sizeof(header));
+	Write(header.materialOffset, materials.data(), sizeof(BakedMaterial) * materials.size());
+	Write(header.meshOffset, meshes.data(), sizeof(BakedMesh) * meshes.size());
+	Write(header.nodeOffset, nodes.data(), sizeof(BakedNode) * nodes.size());
+	Write(header.nodeMeshIndexOffset, nodeMeshIndices.data(), sizeof(uint32_t) * nodeMeshIndices.size());
+	Write(header.stringOffset, strings.data(), strings.size());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		Write(meshes[i].vertexOffset, meshData[i].vertices.data(),
+			sizeof(Vertex) * meshData[i].vertices.size());
+		Write(meshes[i].indexOffset, meshData[i].indices.data(),
+			sizeof(uint32_t) * meshData[i].indices.size());
+	}
+	if (!fout) {
+		SPDLOG_ERROR("failed to write baked model: {}", bakedFilename);
+		return false;
+	}
+
+	SPDLOG_INFO("baked model: {} -> {} ({} meshes, {} nodes) in {:.1f} ms",
+		filename, bakedFilename, meshes.size(), nodes.size(),
+		std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count());
+	return true;
+}
+
+bool Model::LoadFromBakedFile(const std::string& filename, bool useTextureArrays,
+	TextureStreamer* textureStreamer) {
+	auto startTime = std::chrono::steady_clock::now();
+
+	auto file = MappedFile::Open(filename);
+	if (!file)
+		return false;
+	const uint8_t* data = file->GetData();
+	size_t size = file->GetSize();
+
+	auto header = (const BakedModelHeader*)data;
+	if (size < sizeof(BakedModelHeader) ||
+		memcmp(header->magic, BAKED_MODEL_MAGIC, sizeof(BAKED_MODEL_MAGIC)) != 0) {
+		SPDLOG_ERROR("invalid baked model: {}", filename);
+		return false;
+	}
+	if (header->version != BAKED_MODEL_VERSION || header->vertexStride != sizeof(Vertex)) {
+		SPDLOG_ERROR("baked model version mismatch, please bake again: {}", filename);
+		return false;
+	}
+	auto IsInRange = [size](uint64_t offset, uint64_t count, uint64_t stride) {
+		return offset <= size && count <= (size - offset) / stride;
+	};
+	if (!IsInRange(header->materialOffset, header->materialCount, sizeof(BakedMaterial)) ||
+		!IsInRange(header->meshOffset, header->meshCount, sizeof(BakedMesh)) ||
+		!IsInRange(header->nodeOffset, header->nodeCount, sizeof(BakedNode)) ||
+		!IsInRange(header->nodeMeshIndexOffset, header->nodeMeshIndexCount, sizeof(uint32_t)) ||
+		!IsInRange(header->stringOffset, header->stringSize, 1)) {
+		SPDLOG_ERROR("broken baked model: {}", filename);
+		return false;
+	}
+	auto bakedMaterials = (const BakedMaterial*)(data + header->materialOffset);
+	auto bakedMeshes = (const BakedMesh*)(data + header->meshOffset);
+	auto bakedNodes = (const BakedNode*)(data + header->nodeOffset);
+	auto nodeMeshIndices = (const uint32_t*)(data + header->nodeMeshIndexOffset);
+	auto strings = (const char*)(data + header->stringOffset);
+
+	for (uint32_t i = 0; i < header->meshCount; i++) {
+		auto& mesh = bakedMeshes[i];
+		if (!IsInRange(mesh.vertexOffset, mesh.vertexCount, sizeof(Vertex)) ||
+			!IsInRange(mesh.indexOffset, mesh.indexCount, sizeof(uint32_t))) {
+			SPDLOG_ERROR("broken baked model: {}", filename);
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->nodeCount; i++) {
+		auto& node = bakedNodes[i];
+		// parent 는 항상 앞쪽 node 여야 scene graph 를 한 번에 만들 수 있다
+		if (node.firstMeshIndex > header->nodeMeshIndexCount ||
+			node.meshIndexCount > header->nodeMeshIndexCount - node.firstMeshIndex ||
+			node.parent >= (int32_t)i) {
+			SPDLOG_ERROR("broken baked model: {}", filename);
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->nodeMeshIndexCount; i++) {
+		if (nodeMeshIndices[i] >= header->meshCount) {
+			SPDLOG_ERROR("broken baked model: {}", filename);
+			return false;
+		}
+	}
+
+	auto GetString = [&](uint32_t offset) -> std::string {
+		if (offset == BAKED_MODEL_NO_STRING || offset >= header->stringSize)
+			return std::string();
+		return std::string(strings + offset,
+			strnlen(strings + offset, header->stringSize - offset));
+	};
+	std::vector<MaterialData> materials(header->materialCount);
+	for (uint32_t i = 0; i < header->materialCount; i++) {
+		materials[i].diffusePath = GetString(bakedMaterials[i].diffusePath);
+		materials[i].specularPath = GetString(bakedMaterials[i].specularPath);
+	}
+
+	// 텍스처 decode 를 기다리는 동안 mapping 된 메모리에서 바로 mesh 를 올린다
+	std::vector<MeshPtr> meshes(header->meshCount);
+	auto dirname = filename.substr(0, filename.find_last_of("/"));
+	CreateMaterials(dirname, materials, useTextureArrays, textureStreamer, [&]() {
+		for (uint32_t i = 0; i < header->meshCount; i++) {
+			auto& mesh = bakedMeshes[i];
+			meshes[i] = Mesh::Create(
+				(const Vertex*)(data + mesh.vertexOffset), mesh.vertexCount,
+				(const uint32_t*)(data + mesh.indexOffset), mesh.indexCount,
+				GL_TRIANGLES);
+		}
+	});
+	for (uint32_t i = 0; i < header->meshCount; i++) {
+		if (bakedMeshes[i].materialIndex < m_materials.size())
+			meshes[i]->SetMaterial(m_materials[bakedMeshes[i].materialIndex]);
+	}
+
+	m_sceneGraph = SceneGraph::Create();
+	m_sceneGraph->Reserve(header->nodeCount);
+	for (uint32_t i = 0; i < header->nodeCount; i++) {
+		auto& node = bakedNodes[i];
+		auto nodeIndex = m_sceneGraph->AddNode(
+			node.parent < 0 ? SceneGraph::NO_PARENT : (uint32_t)node.parent,
+			glm::make_mat4(node.transform), GetString(node.name));
+		for (uint32_t j = 0; j < node.meshIndexCount; j++) {
+			m_meshes.push_back(meshes[nodeMeshIndices[node.firstMeshIndex + j]]);
+			m_meshNodes.push_back(nodeIndex);
+		}
 	}
+	m_sceneGraph->UpdateWorldTransforms();
 
-	ProcessNode(scene->mRootNode, scene);
+	UpdateBounds();
+	SPDLOG_INFO("loaded baked model: {} ({} meshes) in {:.1f} ms",
+		filename, m_meshes.size(),
+		std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count());
 	return true;
 }
 
-void Model::ProcessNode(aiNode* node, const aiScene* scene) {
+void Model::ProcessNode(const aiNode* node, uint32_t parent, const aiScene* scene,
+	std::vector<const aiMesh*>& meshes) {
+	// depth first 로 추가하므로 parent 가 항상 child 보다 앞에 온다
+	auto nodeIndex = m_sceneGraph->AddNode(parent,
+		ToGlmMatrix(node->mTransformation), node->mName.C_Str());
 	for (uint32_t i = 0; i < node->mNumMeshes; i++) {
 	    auto meshIndex = node->mMeshes[i];
-	    auto mesh = scene->mMeshes[meshIndex];
-	    ProcessMesh(mesh, scene);
+	    meshes.push_back(scene->mMeshes[meshIndex]);
+	    m_meshNodes.push_back(nodeIndex);
 	}
 
 	for (uint32_t i = 0; i < node->mNumChildren; i++) {
-	    ProcessNode(node->mChildren[i], scene);
+	    ProcessNode(node->mChildren[i], nodeIndex, scene, meshes);
 	}
 }
 
-void Model::ProcessMesh(aiMesh* mesh, const aiScene* scene) {
+Model::MeshData Model::ProcessMesh(const aiMesh* mesh, bool optimize, ThreadPool* threadPool) {
 	SPDLOG_INFO("process mesh: {}, #vert: {}, #face: {}",
 		mesh->mName.C_Str(), mesh->mNumVertices, mesh->mNumFaces);
 
-	std::vector<Vertex> vertices;
+	MeshData data;
+	auto& vertices = data.vertices;
 	vertices.resize(mesh->mNumVertices);
 	for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
 	    auto& v = vertices[i];
 	    v.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
 		v.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-	    v.texCoord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+		if (mesh->mTextureCoords[0])
+		    v.texCoord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+		if (mesh->HasTangentsAndBitangents()) {
+			auto tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+			auto bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+			float handedness = glm::dot(glm::cross(v.normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+			v.tangent = glm::vec4(tangent, handedness);
+		}
 	}
 
-	std::vector<uint32_t> indices;
+	auto& indices = data.indices;
 	indices.resize(mesh->mNumFaces * 3);
 	for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
 	    indices[3*i  ] = mesh->mFaces[i].mIndices[0];
@@ -73,15 +540,213 @@ void Model::ProcessMesh(aiMesh* mesh, const aiScene* scene) {
 	    indices[3*i+2] = mesh->mFaces[i].mIndices[2];
 	}
 
-	auto glMesh = Mesh::Create(vertices, indices, GL_TRIANGLES);
-	if (mesh->mMaterialIndex >= 0)
-		glMesh->SetMaterial(m_materials[mesh->mMaterialIndex]);
+	// 원본에 tangent 가 있으면 그대로 쓴다
+	if (!mesh->HasTangentsAndBitangents())
+		Mesh::ComputeTangents(vertices.data(), vertices.size(),
+			indices.data(), indices.size(), threadPool);
 
-	m_meshes.push_back(std::move(glMesh));
+	if (optimize && !indices.empty()) {
+		auto before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		OptimizeMesh(vertices, indices);
+		auto after = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		SPDLOG_INFO("optimize mesh: {}, ACMR: {:.3f} -> {:.3f}, ATVR: {:.3f} -> {:.3f}",
+			mesh->mName.C_Str(), before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+	data.materialIndex = mesh->mMaterialIndex;
+	return data;
 }
 
-void Model::Draw(const Program* program) const {
-	for (auto& mesh: m_meshes) {
-	    mesh->Draw(program);
+bool Model::RunLoadBenchmark(int meshCount, int vertexCount,
+	const std::vector<std::string>& imagePaths) {
+	if (meshCount <= 0 || vertexCount < 16) {
+		SPDLOG_ERROR("invalid model load benchmark: {} meshes, {} vertices", meshCount, vertexCount);
+		return false;
+	}
+
+	// uv sphere 를 조금씩 옮겨 가며 만든다. tangent 는 비워 둬서 ComputeTangents 까지 돈다
+	uint32_t latiCount = std::max((uint32_t)std::sqrt((float)vertexCount * 0.5f), 2u);
+	uint32_t longiCount = latiCount * 2;
+	uint32_t circleCount = longiCount + 1;
+	std::vector<std::unique_ptr<aiMesh>> meshes;
+	for (int m = 0; m < meshCount; m++) {
+		auto mesh = std::make_unique<aiMesh>();
+		mesh->mName = aiString(fmt::format("synthetic{}", m));
+		mesh->mNumVertices = (latiCount + 1) * circleCount;
+		mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+		mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+		mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+		mesh->mNumUVComponents[0] = 2;
+		for (uint32_t i = 0; i <= latiCount; i++) {
+			float v = (float)i / (float)latiCount;
+			float phi = (v - 0.5f) * glm::pi<float>();
+			for (uint32_t j = 0; j <= longiCount; j++) {
+				float u = (float)j / (float)longiCount;
+				float theta = u * glm::pi<float>() * 2.0f;
+				aiVector3D normal(cosf(phi) * cosf(theta), sinf(phi), -cosf(phi) * sinf(theta));
+				uint32_t index = i * circleCount + j;
+				mesh->mVertices[index] = normal * 0.5f + aiVector3D((float)m, 0.0f, 0.0f);
+				mesh->mNormals[index] = normal;
+				mesh->mTextureCoords[0][index] = aiVector3D(u, v, 0.0f);
+			}
+		}
+		mesh->mNumFaces = latiCount * longiCount * 2;
+		mesh->mFaces = new aiFace[mesh->mNumFaces];
+		for (uint32_t i = 0; i < latiCount; i++) {
+			for (uint32_t j = 0; j < longiCount; j++) {
+				uint32_t vertexOffset = i * circleCount + j;
+				uint32_t corners[2][3] = {
+					{ vertexOffset, vertexOffset + 1, vertexOffset + 1 + circleCount },
+					{ vertexOffset, vertexOffset + 1 + circleCount, vertexOffset + circleCount },
+				};
+				for (int k = 0; k < 2; k++) {
+					auto& face = mesh->mFaces[(i * longiCount + j) * 2 + k];
+					face.mNumIndices = 3;
+					face.mIndices = new unsigned int[3];
+					memcpy(face.mIndices, corners[k], sizeof(corners[k]));
+				}
+			}
+		}
+		meshes.push_back(std::move(mesh));
 	}
-}
\ No newline at end of file
+
+	struct Result {
+		std::vector<MeshData> meshData;
+		std::vector<std::vector<ImageUPtr>> images;
+	};
+	TextureLoadOption textureOption;
+	// 예전 LoadByAssimp 처럼 텍스처를 하나씩 decode 한 뒤 mesh 를 하나씩 변환한다
+	// (mip chain / tangent 안쪽의 ParallelFor 는 그대로 pool 을 쓴다)
+	auto RunSequential = [&](ThreadPool* threadPool) {
+		Result result;
+		for (auto& path: imagePaths)
+			result.images.push_back(LoadImageLevels(path, textureOption, nullptr, threadPool));
+		for (auto& mesh: meshes)
+			result.meshData.push_back(ProcessMesh(mesh.get(), true, threadPool));
+		return result;
+	};
+	// CreateMaterials / LoadByAssimp 와 같은 모양: decode 를 worker 에 넘기고 mesh 변환과 겹친다
+	auto RunPipelined = [&](ThreadPool* threadPool) {
+		Result result;
+		std::vector<std::future<std::vector<ImageUPtr>>> imageFutures;
+		for (auto& path: imagePaths) {
+			imageFutures.push_back(threadPool->Submit([&, path]() {
+				return LoadImageLevels(path, textureOption, nullptr, threadPool);
+			}));
+		}
+		result.meshData.resize(meshes.size());
+		threadPool->ParallelFor(meshes.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				result.meshData[i] = ProcessMesh(meshes[i].get(), true, threadPool);
+		});
+		for (auto& future: imageFutures)
+			result.images.push_back(future.get());
+		return result;
+	};
+	auto Measure = [](auto&& run) {
+		auto startTime = std::chrono::steady_clock::now();
+		auto result = run();
+		float elapsed = std::chrono::duration<float, std::milli>(
+			std::chrono::steady_clock::now() - startTime).count();
+		return std::make_pair(std::move(result), elapsed);
+	};
+	// 같은 입력이면 thread 수와 상관없이 같은 결과가 나와야 한다
+	auto IsSameResult = [](const Result& a, const Result& b) {
+		if (a.meshData.size() != b.meshData.size() || a.images.size() != b.images.size())
+			return false;
+		for (size_t i = 0; i < a.meshData.size(); i++) {
+			auto& va = a.meshData[i].vertices;
+			auto& vb = b.meshData[i].vertices;
+			if (a.meshData[i].indices != b.meshData[i].indices || va.size() != vb.size() ||
+				memcmp(va.data(), vb.data(), sizeof(Vertex) * va.size()) != 0)
+				return false;
+		}
+		for (size_t i = 0; i < a.images.size(); i++) {
+			if (a.images[i].size() != b.images[i].size())
+				return false;
+			for (size_t level = 0; level < a.images[i].size(); level++) {
+				auto& ia = a.images[i][level];
+				auto& ib = b.images[i][level];
+				if (ia->GetDataSize() != ib->GetDataSize() ||
+					memcmp(ia->GetData(), ib->GetData(), ia->GetDataSize()) != 0)
+					return false;
+			}
+		}
+		return true;
+	};
+
+	uint32_t maxWorkerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	std::vector<uint32_t> workerCounts;
+	for (uint32_t count = 1; count < maxWorkerCount; count *= 2)
+		workerCounts.push_back(count);
+	workerCounts.push_back(maxWorkerCount);
+
+	SPDLOG_INFO("model load benchmark: {} meshes x {} vertices, {} textures",
+		meshCount, meshes[0]->mNumVertices, imagePaths.size());
+	// mesh 마다 찍는 로그가 시간에 섞이지 않게 잠시 끈다
+	auto logLevel = spdlog::get_level();
+	spdlog::set_level(spdlog::level::warn);
+	bool success = true;
+	std::vector<std::pair<std::string, float>> timings;
+	Result reference;
+	for (auto workerCount: workerCounts) {
+		auto threadPool = ThreadPool::Create(workerCount);
+		auto [sequential, sequentialTime] = Measure([&]() { return RunSequential(threadPool.get()); });
+		auto [pipelined, pipelinedTime] = Measure([&]() { return RunPipelined(threadPool.get()); });
+		if (reference.meshData.empty())
+			reference = std::move(sequential);
+		else if (!IsSameResult(reference, sequential))
+			success = false;
+		if (!IsSameResult(reference, pipelined))
+			success = false;
+		timings.push_back({ fmt::format("{} threads sequential", workerCount + 1), sequentialTime });
+		timings.push_back({ fmt::format("{} threads pipelined", workerCount + 1), pipelinedTime });
+	}
+	spdlog::set_level(logLevel);
+
+	for (auto& [name, elapsed]: timings) {
+		SPDLOG_INFO("  {:>24}: {:8.1f} ms ({:.2f}x)", name, elapsed, timings[0].second / elapsed);
+	}
+	if (!success)
+		SPDLOG_ERROR("model load benchmark: results differ between thread counts");
+	return success;
+}
+
+size_t Model::Draw(const Program* program, const glm::mat4& viewProjection,
+	const glm::mat4& modelTransform) const {
+	// bounds 를 옮기는 대신 frustum 을 model 공간으로 가져와서 검사한다
+	auto frustum = Frustum::FromMatrix(viewProjection * modelTransform);
+	size_t visibleCount = m_meshBounds.Cull(frustum, m_meshVisible);
+	for (size_t i = 0; i < m_meshes.size(); i++) {
+		if (!m_meshVisible[i])
+			continue;
+		auto meshTransform = modelTransform * GetMeshTransform((int)i);
+		program->SetUniform("transform", viewProjection * meshTransform);
+		program->SetUniform("modelTransform", meshTransform);
+		m_meshes[i]->Draw(program);
+	}
+	return visibleCount;
+}
+
+size_t Model::UpdateTransforms() {
+	if (!m_sceneGraph->IsDirty())
+		return 0;
+	size_t changedCount = m_sceneGraph->UpdateWorldTransforms();
+	if (changedCount > 0)
+		UpdateBounds();
+	return changedCount;
+}
+
+void Model::UpdateBounds() {
+	m_bounds = AABB();
+	m_boundingSphere = BoundingSphere();
+	m_meshBounds.Clear();
+	m_meshBounds.Reserve(m_meshes.size());
+	for (size_t i = 0; i < m_meshes.size(); i++) {
+		auto& transform = GetMeshTransform((int)i);
+		auto bounds = m_meshes[i]->GetBounds().Transform(transform);
+		auto sphere = m_meshes[i]->GetBoundingSphere().Transform(transform);
+		m_bounds.Expand(bounds);
+		m_boundingSphere = MergeBoundingSphere(m_boundingSphere, sphere);
+		m_meshBounds.Add(bounds, sphere);
+	}
+}
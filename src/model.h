@@ -3,6 +3,11 @@
 
 #include "common.h"
 #include "mesh.h"
+#include "texture_array.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "scene_graph.h"
+#include <functional>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -11,20 +16,94 @@
 CLASS_PTR(Model);
 class Model {
 public:
-    static ModelUPtr Load(const std::string& filename);
+    // optimizeMeshes 가 true 면 vertex cache / overdraw / vertex fetch 순서로 재배치한다
+    // useTextureArrays 면 material 텍스처를 TextureArrayManager 의 layer 로 올린다
+    // (defer_geo_array.fs 처럼 sampler2DArray 를 받는 shader 로 그린다)
+    // textureStreamer 가 있으면 material 에 placeholder 텍스처를 바로 연결하고
+    // 실제 이미지는 textureStreamer->Update 에서 frame 마다 나눠 올린다 (texture array 에는 쓰지 않음)
+    static ModelUPtr Load(const std::string& filename, bool optimizeMeshes = true,
+        bool useTextureArrays = false, TextureStreamer* textureStreamer = nullptr);
+    // assimp 로 읽어 변환까지 끝낸 결과를 baked 파일로 저장한다. GL context 없이 동작
+    static bool Bake(const std::string& filename, const std::string& bakedFilename,
+        bool optimizeMeshes = true);
+    // baked 파일을 memory map 해서 assimp 없이 바로 업로드한다
+    static ModelUPtr LoadBaked(const std::string& filename, bool useTextureArrays = false,
+        TextureStreamer* textureStreamer = nullptr);
+    // vertexCount 개짜리 가짜 mesh meshCount 개와 imagePaths 텍스처를 읽는 CPU 단계
+    // (이미지 decode + mip chain, vertex 변환 + tangent + 최적화) 를 하나씩 처리할 때와
+    // worker 수를 늘려 가며 pipeline 으로 처리할 때의 시간을 비교한다. GL context 없이 동작
+    static bool RunLoadBenchmark(int meshCount, int vertexCount,
+        const std::vector<std::string>& imagePaths);
 
     int GetMeshCount() const { return (int)m_meshes.size(); }
     MeshPtr GetMesh(int index) const { return m_meshes[index]; }
-    void Draw(const Program* program) const;
+    // 각 mesh 가 붙은 node 의 model 공간 transform
+    const glm::mat4& GetMeshTransform(int index) const {
+        return m_sceneGraph->GetWorldTransform(m_meshNodes[index]);
+    }
+    // mesh 마다 node transform 을 곱한 transform / modelTransform uniform 을 설정해서 그린다
+    // frustum 밖의 mesh 는 건너뛰고 그린 mesh 수를 돌려준다
+    size_t Draw(const Program* program, const glm::mat4& viewProjection,
+        const glm::mat4& modelTransform) const;
+
+    // node 의 local transform 을 바꾼 뒤에는 UpdateTransforms 를 불러야 반영된다
+    SceneGraph* GetSceneGraph() const { return m_sceneGraph.get(); }
+    // dirty subtree 의 world transform 과 bounds 를 갱신하고 바뀐 node 수를 돌려준다
+    size_t UpdateTransforms();
+
+    // 모든 mesh 를 감싸는 model 공간 bounds
+    const AABB& GetBounds() const { return m_bounds; }
+    const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+
+    // useTextureArrays 로 읽지 않았으면 nullptr
+    const TextureArrayManager* GetTextureArrays() const { return m_textureArrays.get(); }
 
 private:
     Model() {}
-    bool LoadByAssimp(const std::string& filename);
-    void ProcessMesh(aiMesh* mesh, const aiScene* scene);
-    void ProcessNode(aiNode* node, const aiScene* scene);
-        
+    bool LoadByAssimp(const std::string& filename, bool optimizeMeshes, bool useTextureArrays,
+        TextureStreamer* textureStreamer);
+    bool LoadFromBakedFile(const std::string& filename, bool useTextureArrays,
+        TextureStreamer* textureStreamer);
+    void UpdateBounds();
+    // node 를 scene graph 에 추가하고 node 가 참조하는 mesh 를 meshes 뒤에 붙인다
+    void ProcessNode(const aiNode* node, uint32_t parent, const aiScene* scene,
+        std::vector<const aiMesh*>& meshes);
+
+    // GL 없이 worker thread 에서 만드는 mesh 데이터
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        uint32_t materialIndex { 0 };
+    };
+    // threadPool 이 nullptr 이면 ThreadPool::GetDefault() 를 쓴다
+    static MeshData ProcessMesh(const aiMesh* mesh, bool optimize, ThreadPool* threadPool = nullptr);
+
+    // material 이 참조하는 텍스처 경로 (모델 파일 위치 기준 상대 경로)
+    struct MaterialData {
+        std::string diffusePath;
+        std::string specularPath;
+    };
+    static std::vector<MaterialData> ProcessMaterials(const aiScene* scene);
+    // 텍스처를 worker 에서 decode 하는 동안 호출 thread 에서 overlappedWork 를 실행한 뒤
+    // GL 텍스처 (useTextureArrays 면 texture array) 와 material 을 만든다
+    // textureStreamer 가 있으면 decode 와 upload 를 streamer 에 맡긴다
+    void CreateMaterials(const std::string& dirname,
+        const std::vector<MaterialData>& materials, bool useTextureArrays,
+        TextureStreamer* textureStreamer, const std::function<void()>& overlappedWork);
+
+    // m_meshes[i] 는 node m_meshNodes[i] 에 붙어 있다 (여러 node 가 같은 mesh 를 공유할 수 있음)
     std::vector<MeshPtr> m_meshes;
+    std::vector<uint32_t> m_meshNodes;
+    SceneGraphUPtr m_sceneGraph;
     std::vector<MaterialPtr> m_materials;
+    // useTextureArrays 로 읽었을 때 array 와 layer 정보
+    TextureArrayManagerUPtr m_textureArrays;
+
+    // node transform 을 적용한 model 공간 bounds
+    AABB m_bounds;
+    BoundingSphere m_boundingSphere;
+    BoundsBatch m_meshBounds;
+    mutable std::vector<uint8_t> m_meshVisible;
 };
 
-#endif // __MODEL_H__
\ No newline at end of file
+#endif // __MODEL_H__
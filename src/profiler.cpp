@@ -0,0 +1,223 @@
+#include "profiler.h"
+#include <imgui.h>
+#include <fstream>
+
+Profiler* Profiler::s_instance = nullptr;
+
+ProfilerUPtr Profiler::Create() {
+	auto profiler = ProfilerUPtr(new Profiler());
+	s_instance = profiler.get();
+	return std::move(profiler);
+}
+
+Profiler::~Profiler() {
+	for (auto& slot: m_slots) {
+		if (!slot.queries.empty())
+			glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+	}
+	if (s_instance == this)
+		s_instance = nullptr;
+}
+
+void Profiler::BeginFrame() {
+	auto& slot = m_slots[m_frameIndex % FRAME_SLOT_COUNT];
+	if (slot.pending)
+		ResolveFrame((int)(m_frameIndex % FRAME_SLOT_COUNT));
+
+	slot.frame.frameIndex = m_frameIndex;
+	slot.frame.cpuStart = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - m_startTime).count();
+	slot.frame.scopes.clear();
+	slot.frame.counters.clear();
+	slot.usedQueryCount = 0;
+	slot.lastIssuedQuery = -1;
+	m_openScopes.clear();
+	m_inFrame = true;
+	BeginScope("frame");
+}
+
+void Profiler::EndFrame() {
+	if (!m_inFrame)
+		return;
+	while (!m_openScopes.empty())
+		EndScope();
+	m_slots[m_frameIndex % FRAME_SLOT_COUNT].pending = true;
+	m_inFrame = false;
+	m_frameIndex++;
+}
+
+void Profiler::BeginScope(const char* name) {
+	if (!m_inFrame)
+		return;
+	auto& slot = m_slots[m_frameIndex % FRAME_SLOT_COUNT];
+	// scope 하나에 timestamp query 두 개 (시작, 끝)
+	if (slot.usedQueryCount + 2 > slot.queries.size()) {
+		size_t oldCount = slot.queries.size();
+		slot.queries.resize(std::max<size_t>(oldCount * 2, 32));
+		glGenQueries((GLsizei)(slot.queries.size() - oldCount), slot.queries.data() + oldCount);
+	}
+
+	Scope scope;
+	scope.name = name;
+	scope.depth = (int)m_openScopes.size();
+	scope.cpuBegin = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - m_startTime).count() - slot.frame.cpuStart;
+	glQueryCounter(slot.queries[slot.usedQueryCount], GL_TIMESTAMP);
+	slot.lastIssuedQuery = (int)slot.usedQueryCount;
+	slot.usedQueryCount += 2;
+
+	m_openScopes.push_back((int)slot.frame.scopes.size());
+	slot.frame.scopes.push_back(scope);
+}
+
+void Profiler::EndScope() {
+	if (!m_inFrame || m_openScopes.empty())
+		return;
+	auto& slot = m_slots[m_frameIndex % FRAME_SLOT_COUNT];
+	int scopeIndex = m_openScopes.back();
+	m_openScopes.pop_back();
+
+	slot.frame.scopes[scopeIndex].cpuEnd = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - m_startTime).count() - slot.frame.cpuStart;
+	glQueryCounter(slot.queries[scopeIndex * 2 + 1], GL_TIMESTAMP);
+	slot.lastIssuedQuery = scopeIndex * 2 + 1;
+}
+
+void Profiler::SetCounter(const char* name, double value) {
+	if (!m_inFrame)
+		return;
+	auto& counters = m_slots[m_frameIndex % FRAME_SLOT_COUNT].frame.counters;
+	for (auto& counter: counters) {
+		if (counter.name == name) {
+			counter.value = value;
+			return;
+		}
+	}
+	counters.push_back({ name, value });
+}
+
+void Profiler::ResolveFrame(int slotIndex) {
+	auto& slot = m_slots[slotIndex];
+	slot.pending = false;
+
+	// 마지막으로 찍은 query 가 준비됐으면 앞의 것도 모두 준비된 것. 아직이면 기다리지 않고 GPU 값은 버린다
+	// (queries[usedQueryCount - 1] 은 마지막에 시작한 scope 의 끝이라 root "frame" 의 끝보다 먼저 찍힌다)
+	GLint available = 0;
+	if (slot.lastIssuedQuery >= 0)
+		glGetQueryObjectiv(slot.queries[slot.lastIssuedQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available) {
+		uint64_t frameBegin = 0;
+		for (size_t i = 0; i < slot.frame.scopes.size(); i++) {
+			uint64_t begin = 0, end = 0;
+			glGetQueryObjectui64v(slot.queries[i * 2], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(slot.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+			if (i == 0)
+				frameBegin = begin;
+			slot.frame.scopes[i].gpuBegin = (double)(begin - frameBegin) * 1e-6;
+			slot.frame.scopes[i].gpuEnd = (double)(end - frameBegin) * 1e-6;
+		}
+	}
+
+	if (m_paused)
+		return;
+	m_lastFrame = slot.frame;
+	if (m_history.size() >= HISTORY_FRAME_COUNT)
+		m_history.erase(m_history.begin());
+	m_history.push_back(slot.frame);
+}
+
+void Profiler::DrawImGui() {
+	if (!ImGui::CollapsingHeader("profiler"))
+		return;
+
+	ImGui::Checkbox("pause", &m_paused);
+	ImGui::SameLine();
+	if (ImGui::Button("save chrome trace"))
+		SaveChromeTrace("./profile_trace.json");
+	if (m_lastFrame.scopes.empty())
+		return;
+
+	auto& root = m_lastFrame.scopes[0];
+	double cpuFrameTime = root.cpuEnd - root.cpuBegin;
+	double gpuFrameTime = root.gpuEnd - root.gpuBegin;
+	ImGui::Text("frame %d  cpu %.3f ms  gpu %.3f ms",
+		(int)m_lastFrame.frameIndex, cpuFrameTime, root.gpuBegin >= 0.0 ? gpuFrameTime : 0.0);
+
+	for (auto& counter: m_lastFrame.counters)
+		ImGui::Text("%s: %g", counter.name, counter.value);
+
+	int maxDepth = 0;
+	for (auto& scope: m_lastFrame.scopes)
+		maxDepth = std::max(maxDepth, scope.depth);
+
+	// 위: CPU, 아래: GPU. 가로축은 각 timeline 의 frame 길이에 맞춘다
+	const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+	float width = ImGui::GetContentRegionAvailWidth();
+	auto DrawTimeline = [&](const char* label, bool gpu, double frameTime) {
+		ImGui::Text("%s", label);
+		auto origin = ImGui::GetCursorScreenPos();
+		float height = rowHeight * (float)(maxDepth + 1);
+		ImGui::InvisibleButton(label, ImVec2(width, height));
+		if (frameTime <= 0.0)
+			return;
+
+		auto drawList = ImGui::GetWindowDrawList();
+		auto mousePos = ImGui::GetIO().MousePos;
+		for (auto& scope: m_lastFrame.scopes) {
+			double begin = gpu ? scope.gpuBegin : scope.cpuBegin;
+			double end = gpu ? scope.gpuEnd : scope.cpuEnd;
+			if (begin < 0.0)
+				continue;
+			ImVec2 min(origin.x + (float)(begin / frameTime) * width,
+				origin.y + rowHeight * (float)scope.depth);
+			ImVec2 max(std::max(origin.x + (float)(end / frameTime) * width, min.x + 1.0f),
+				min.y + rowHeight - 1.0f);
+			float hue = 0.6f - 0.12f * (float)scope.depth;
+			drawList->AddRectFilled(min, max,
+				ImColor::HSV(hue < 0.0f ? hue + 1.0f : hue, 0.6f, 0.8f));
+			if (ImGui::CalcTextSize(scope.name).x < max.x - min.x - 4.0f)
+				drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32_WHITE, scope.name);
+			if (mousePos.x >= min.x && mousePos.x < max.x && mousePos.y >= min.y && mousePos.y < max.y)
+				ImGui::SetTooltip("%s\n%.3f ms", scope.name, end - begin);
+		}
+	};
+	DrawTimeline("cpu", false, cpuFrameTime);
+	if (root.gpuBegin >= 0.0)
+		DrawTimeline("gpu", true, gpuFrameTime);
+}
+
+bool Profiler::SaveChromeTrace(const std::string& filename) const {
+	std::ofstream fout(filename);
+	if (!fout.is_open()) {
+		SPDLOG_ERROR("failed to write chrome trace: {}", filename);
+		return false;
+	}
+
+	// tid 0: CPU, tid 1: GPU. GPU 구간은 해당 frame 의 CPU 시작 시각에 맞춰 놓는다
+	fout << "{\"traceEvents\":[\n";
+	bool first = true;
+	auto WriteEvent = [&](const char* name, int tid, double begin, double end) {
+		fout << (first ? "" : ",\n")
+			<< fmt::format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				name, tid, begin * 1000.0, (end - begin) * 1000.0);
+		first = false;
+	};
+	for (auto& frame: m_history) {
+		for (auto& scope: frame.scopes) {
+			WriteEvent(scope.name, 0, frame.cpuStart + scope.cpuBegin, frame.cpuStart + scope.cpuEnd);
+			if (scope.gpuBegin >= 0.0)
+				WriteEvent(scope.name, 1, frame.cpuStart + scope.gpuBegin, frame.cpuStart + scope.gpuEnd);
+		}
+		// counter 는 별도 track 의 그래프로 보인다
+		for (auto& counter: frame.counters) {
+			fout << (first ? "" : ",\n")
+				<< fmt::format("{{\"name\":\"{}\",\"ph\":\"C\",\"pid\":0,\"ts\":{:.3f},\"args\":{{\"value\":{}}}}}",
+					counter.name, frame.cpuStart * 1000.0, counter.value);
+			first = false;
+		}
+	}
+	fout << "\n],\n\"displayTimeUnit\":\"ms\"}\n";
+
+	SPDLOG_INFO("saved chrome trace: {} ({} frames)", filename, m_history.size());
+	return (bool)fout;
+}
@@ -0,0 +1,100 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "common.h"
+#include <vector>
+#include <chrono>
+
+// frame 단위 CPU / GPU 구간 측정기
+// GL_TIME_ELAPSED 는 중첩할 수 없으므로 구간 시작 / 끝에 GL_TIMESTAMP 를 찍는다
+// 결과는 두 frame 뒤에 읽어서 GPU 를 기다리지 않는다
+CLASS_PTR(Profiler)
+class Profiler {
+public:
+    // 만든 instance 가 Get() 으로 노출된다. GL context 가 살아 있을 때 해제해야 한다
+    static ProfilerUPtr Create();
+    static Profiler* Get() { return s_instance; }
+    ~Profiler();
+
+    void BeginFrame();
+    void EndFrame();
+    // name 은 string literal 처럼 프로그램 내내 살아있는 문자열이어야 한다
+    void BeginScope(const char* name);
+    void EndScope();
+    // 이번 frame 의 값 (draw 수, culling 결과 등). name 은 BeginScope 와 같은 조건
+    void SetCounter(const char* name, double value);
+
+    // 마지막으로 결과가 나온 frame 을 flame graph 로 그린다
+    void DrawImGui();
+    // 최근 frame 들을 chrome://tracing (Perfetto) 에서 열 수 있는 JSON 으로 저장
+    bool SaveChromeTrace(const std::string& filename) const;
+
+private:
+    Profiler() {}
+    void ResolveFrame(int slot);
+
+    struct Scope {
+        const char* name { nullptr };
+        int depth { 0 };
+        // frame 시작 기준 ms, GPU 값은 결과를 못 받았으면 음수
+        double cpuBegin { 0.0 };
+        double cpuEnd { 0.0 };
+        double gpuBegin { -1.0 };
+        double gpuEnd { -1.0 };
+    };
+    struct Counter {
+        const char* name { nullptr };
+        double value { 0.0 };
+    };
+    struct Frame {
+        uint64_t frameIndex { 0 };
+        double cpuStart { 0.0 };
+        std::vector<Scope> scopes;
+        std::vector<Counter> counters;
+    };
+    struct FrameSlot {
+        Frame frame;
+        std::vector<uint32_t> queries;
+        uint32_t usedQueryCount { 0 };
+        // 마지막으로 glQueryCounter 를 부른 query. frame 끝 ("frame" scope 의 끝) 이 가장 늦다
+        int lastIssuedQuery { -1 };
+        bool pending { false };
+    };
+
+    static Profiler* s_instance;
+    static const int FRAME_SLOT_COUNT = 2;
+    static const size_t HISTORY_FRAME_COUNT = 240;
+
+    std::chrono::steady_clock::time_point m_startTime { std::chrono::steady_clock::now() };
+    FrameSlot m_slots[FRAME_SLOT_COUNT];
+    uint64_t m_frameIndex { 0 };
+    bool m_inFrame { false };
+    std::vector<int> m_openScopes;
+    std::vector<Frame> m_history;
+    Frame m_lastFrame;
+    bool m_paused { false };
+};
+
+// scope 를 벗어날 때 자동으로 EndScope 를 호출한다
+class ProfileScope {
+public:
+    ProfileScope(const char* name) : m_profiler(Profiler::Get()) {
+        if (m_profiler)
+            m_profiler->BeginScope(name);
+    }
+    ~ProfileScope() {
+        if (m_profiler)
+            m_profiler->EndScope();
+    }
+private:
+    Profiler* m_profiler;
+};
+
+#define PROFILE_SCOPE_CONCAT_IMPL(a, b) a ## b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_CONCAT(profileScope, __LINE__)(name)
+
+#define PROFILE_COUNTER(name, value) \
+    do { if (auto profiler = Profiler::Get()) profiler->SetCounter(name, (double)(value)); } while (0)
+
+#endif // __PROFILER_H__
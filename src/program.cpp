@@ -1,4 +1,6 @@
 #include "program.h"
+#include "render_state.h"
+#include "uniform_blocks.h"
 
 ProgramUPtr Program::Create(const std::vector<ShaderPtr>& shaders) {
     auto program = ProgramUPtr(new Program());
@@ -20,6 +22,7 @@ ProgramUPtr Program::Create(
 Program::~Program() {
   if (m_program) {
     glDeleteProgram(m_program);
+    RenderState::Get()->OnProgramDeleted(m_program);
   }
 }
 
@@ -38,39 +41,171 @@ bool Program::Link(
         SPDLOG_ERROR("failed to link program: {}", infoLog);
         return false;
     }
+    CacheUniformLocations();
+    if (!BindUniformBlocks())
+        return false;
+    return true;
+}
+
+bool Program::BindUniformBlocks() {
+    int blockCount = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    char nameBuffer[256];
+    for (int i = 0; i < blockCount; i++) {
+        int length = 0;
+        glGetActiveUniformBlockName(m_program, i, sizeof(nameBuffer), &length, nameBuffer);
+        std::string_view name(nameBuffer, length);
+        int binding = GetUniformBlockBinding(name);
+        if (binding < 0) {
+            SPDLOG_WARN("unknown uniform block: {}", name);
+            continue;
+        }
+
+        // C++ 구조체보다 큰 block 이 선언되어 있으면 link 단계에서 바로 잡아낸다
+        // (끝의 padding 은 driver 마다 다르게 보고하므로 크기가 작은 쪽은 허용)
+        int dataSize = 0;
+        glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+        if ((size_t)dataSize > GetUniformBlockSize(binding)) {
+            SPDLOG_ERROR("uniform block {} size mismatch: shader {}, cpu {}",
+                name, dataSize, GetUniformBlockSize(binding));
+            return false;
+        }
+        glUniformBlockBinding(m_program, i, binding);
+    }
     return true;
 }
 
+void Program::CacheUniformLocations() {
+    int uniformCount = 0;
+    int maxNameLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    // 배열은 원소 수만큼 이름이 늘어나므로 먼저 모두 모은 뒤 table 크기를 정한다
+    std::vector<std::pair<std::string, int>> locations;
+    std::vector<char> nameBuffer(maxNameLength + 1);
+    for (int i = 0; i < uniformCount; i++) {
+        int length = 0;
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_program, i, (GLsizei)nameBuffer.size(),
+            &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+        int location = glGetUniformLocation(m_program, name.c_str());
+        // uniform block 안의 변수는 location 이 없다
+        if (location < 0)
+            continue;
+        locations.push_back({ name, location });
+
+        // "lights[0]" 같은 기본 타입 배열은 "lights" 와 나머지 원소 이름으로도 찾을 수 있게 등록
+        const std::string arraySuffix = "[0]";
+        if (name.size() > arraySuffix.size() &&
+            name.compare(name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0) {
+            auto baseName = name.substr(0, name.size() - arraySuffix.size());
+            locations.push_back({ baseName, location });
+            for (int j = 1; j < size; j++) {
+                auto elementName = fmt::format("{}[{}]", baseName, j);
+                locations.push_back({ elementName,
+                    glGetUniformLocation(m_program, elementName.c_str()) });
+            }
+        }
+    }
+
+    // load factor 가 0.5 를 넘지 않게 잡는다
+    size_t capacity = 16;
+    while (capacity < locations.size() * 2)
+        capacity <<= 1;
+    m_uniforms.clear();
+    m_uniforms.resize(capacity);
+    for (auto& [name, location]: locations)
+        InsertUniformLocation(name, location);
+}
+
+void Program::InsertUniformLocation(const std::string& name, int location) {
+    size_t hash = std::hash<std::string_view>()(name);
+    size_t mask = m_uniforms.size() - 1;
+    // table 이 가득 차도 끝나도록 capacity 번까지만 찾는다
+    for (size_t step = 0, i = hash & mask; step < m_uniforms.size(); step++, i = (i + 1) & mask) {
+        auto& entry = m_uniforms[i];
+        if (entry.name.empty() || entry.name == name) {
+            entry.hash = hash;
+            entry.location = location;
+            entry.name = name;
+            return;
+        }
+    }
+    SPDLOG_ERROR("uniform location table is full: {}", name);
+}
+
+int Program::GetUniformLocation(std::string_view name) const {
+    if (m_uniforms.empty())
+        return -1;
+    size_t hash = std::hash<std::string_view>()(name);
+    size_t mask = m_uniforms.size() - 1;
+    for (size_t step = 0, i = hash & mask; step < m_uniforms.size(); step++, i = (i + 1) & mask) {
+        auto& entry = m_uniforms[i];
+        if (entry.name.empty())
+            return -1;
+        if (entry.hash == hash && entry.name == name)
+            return entry.location;
+    }
+    return -1;
+}
+
 void Program::Use(){
-    glUseProgram(m_program);
+    RenderState::Get()->UseProgram(m_program);
 }
 
 void Program::SetUniform(const std::string& name, int value) const {
-    auto loc = glGetUniformLocation(m_program, name.c_str());
+    auto loc = GetUniformLocation(name);
     glUniform1i(loc, value);
 }
 
 void Program::SetUniform(const std::string& name, float value) const {
-    auto loc = glGetUniformLocation(m_program, name.c_str());
+    auto loc = GetUniformLocation(name);
     glUniform1f(loc, value);
 }
 
 void Program::SetUniform(const std::string& name, const glm::vec2& value) const {
-    auto loc = glGetUniformLocation(m_program, name.c_str());
+    auto loc = GetUniformLocation(name);
     glUniform2fv(loc, 1, glm::value_ptr(value));
 }
 
 void Program::SetUniform(const std::string& name, const glm::vec3& value) const {
-    auto loc = glGetUniformLocation(m_program, name.c_str());
+    auto loc = GetUniformLocation(name);
     glUniform3fv(loc, 1, glm::value_ptr(value));
 }
 
 void Program::SetUniform(const std::string& name,const glm::vec4& value) const {
-	auto loc = glGetUniformLocation(m_program, name.c_str());
+	auto loc = GetUniformLocation(name);
 	glUniform4fv(loc, 1, glm::value_ptr(value));
 }
 
 void Program::SetUniform(const std::string& name, const glm::mat4& value) const {
-    auto loc = glGetUniformLocation(m_program, name.c_str());
+    auto loc = GetUniformLocation(name);
     glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Program::SetUniform(UniformHandle<int> handle, int value) const {
+    glUniform1i(handle.location, value);
+}
+
+void Program::SetUniform(UniformHandle<float> handle, float value) const {
+    glUniform1f(handle.location, value);
+}
+
+void Program::SetUniform(UniformHandle<glm::vec2> handle, const glm::vec2& value) const {
+    glUniform2fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void Program::SetUniform(UniformHandle<glm::vec3> handle, const glm::vec3& value) const {
+    glUniform3fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void Program::SetUniform(UniformHandle<glm::vec4> handle, const glm::vec4& value) const {
+    glUniform4fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void Program::SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4& value) const {
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
 }
\ No newline at end of file
@@ -3,6 +3,15 @@
 
 #include "common.h"
 #include "shader.h"
+#include <string_view>
+
+// Link 시점에 해석해 둔 uniform location
+// 타입을 같이 들고 있어서 SetUniform 오버로드가 잘못 골라지는 일을 막는다
+template <typename T>
+struct UniformHandle {
+    int location { -1 };
+    bool IsValid() const { return location >= 0; }
+};
 
 CLASS_PTR(Program)
 class Program {
@@ -16,6 +25,12 @@ public:
     uint32_t Get() const { return m_program; }
     void Use();
 
+    int GetUniformLocation(std::string_view name) const;
+    template <typename T>
+    UniformHandle<T> GetUniformHandle(std::string_view name) const {
+        return UniformHandle<T> { GetUniformLocation(name) };
+    }
+
     void SetUniform(const std::string& name, int value) const;
     void SetUniform(const std::string& name, float value) const;
     void SetUniform(const std::string& name, const glm::vec2& value) const;
@@ -23,10 +38,29 @@ public:
     void SetUniform(const std::string& name, const glm::vec4& value) const;
     void SetUniform(const std::string& name, const glm::mat4& value) const;
 
+    void SetUniform(UniformHandle<int> handle, int value) const;
+    void SetUniform(UniformHandle<float> handle, float value) const;
+    void SetUniform(UniformHandle<glm::vec2> handle, const glm::vec2& value) const;
+    void SetUniform(UniformHandle<glm::vec3> handle, const glm::vec3& value) const;
+    void SetUniform(UniformHandle<glm::vec4> handle, const glm::vec4& value) const;
+    void SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4& value) const;
+
 private:
     Program() {}
     bool Link(const std::vector<ShaderPtr>& shaders);
+    void CacheUniformLocations();
+    bool BindUniformBlocks();
+    void InsertUniformLocation(const std::string& name, int location);
+
     uint32_t m_program { 0 };
+
+    // active uniform 이름 -> location, open addressing 방식의 flat hash table
+    struct UniformEntry {
+        size_t hash { 0 };
+        int location { -1 };
+        std::string name;
+    };
+    std::vector<UniformEntry> m_uniforms;
 };
 
-#endif // __PROGRAM_H__
\ No newline at end of file
+#endif // __PROGRAM_H__
@@ -0,0 +1,175 @@
+#include "render_queue.h"
+#include "render_state.h"
+#include "profiler.h"
+#include <algorithm>
+
+static const int DEPTH_BIT_COUNT = 24;
+static const int PROGRAM_BIT_COUNT = 10;
+static const int MATERIAL_BIT_COUNT = 12;
+static const int MESH_BIT_COUNT = 12;
+
+RenderQueueUPtr RenderQueue::Create() {
+	return RenderQueueUPtr(new RenderQueue());
+}
+
+void RenderQueue::Begin(const glm::vec3& cameraPos, float farPlane) {
+	m_cameraPos = cameraPos;
+	m_farPlane = farPlane;
+	m_items.clear();
+	m_programIds.clear();
+	m_materialIds.clear();
+	m_meshIds.clear();
+}
+
+void RenderQueue::Submit(DrawItem item) {
+	if (!item.mesh || !item.program)
+		return;
+	if (!item.material)
+		item.material = item.mesh->GetMaterial().get();
+	m_items.push_back(std::move(item));
+}
+
+uint32_t RenderQueue::GetDenseId(std::unordered_map<const void*, uint32_t>& ids,
+	const void* pointer, uint32_t bitCount) {
+	// 포인터를 이번 frame 에 처음 나온 순서대로 작은 번호로 바꾼다. 넘치면 겹칠 뿐 결과는 틀리지 않는다
+	if (!pointer)
+		return 0;
+	auto result = ids.emplace(pointer, (uint32_t)ids.size() + 1);
+	return result.first->second & ((1u << bitCount) - 1);
+}
+
+uint64_t RenderQueue::MakeKey(const DrawItem& item) {
+	uint64_t program = GetDenseId(m_programIds, item.program, PROGRAM_BIT_COUNT);
+	uint64_t material = GetDenseId(m_materialIds, item.material, MATERIAL_BIT_COUNT);
+	uint64_t mesh = GetDenseId(m_meshIds, item.mesh, MESH_BIT_COUNT);
+
+	const uint64_t maxDepth = (1ull << DEPTH_BIT_COUNT) - 1;
+	float distance = glm::length(glm::vec3(item.transform[3]) - m_cameraPos);
+	float normalizedDepth = std::min(std::max(distance / m_farPlane, 0.0f), 1.0f);
+	uint64_t depth = (uint64_t)(normalizedDepth * (float)maxDepth);
+
+	uint64_t key = (uint64_t)item.pass << 62;
+	if (item.pass == RenderPass::Transparent) {
+		key |= (maxDepth - depth) << 38;
+		key |= program << 28;
+		key |= material << 16;
+		key |= mesh << 4;
+	}
+	else {
+		key |= program << 52;
+		key |= material << 40;
+		key |= mesh << 28;
+		key |= depth << 4;
+	}
+	return key;
+}
+
+void RenderQueue::ApplyPassState(RenderPass pass) {
+	auto renderState = RenderState::Get();
+	switch (pass) {
+	case RenderPass::Opaque:
+		renderState->DepthFunc(GL_LESS);
+		break;
+	case RenderPass::Skybox:
+		// 깊이 1.0 에 그려지므로 같은 값도 통과시킨다
+		renderState->DepthFunc(GL_LEQUAL);
+		break;
+	case RenderPass::Transparent:
+		renderState->DepthFunc(GL_LESS);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthMask(GL_FALSE);
+		break;
+	}
+}
+
+void RenderQueue::ResetPassState() {
+	RenderState::Get()->DepthFunc(GL_LESS);
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+}
+
+void RenderQueue::Flush() {
+	m_stats = RenderQueueStats();
+	if (m_items.empty())
+		return;
+
+	m_entries.resize(m_items.size());
+	for (size_t i = 0; i < m_items.size(); i++) {
+		m_entries[i].key = MakeKey(m_items[i]);
+		m_entries[i].index = (uint32_t)i;
+		if (i == 0 || m_items[i].program != m_items[i - 1].program)
+			m_stats.unsortedProgramChangeCount++;
+	}
+	RadixSort(m_entries, m_sortBuffer);
+
+	const DrawItem* last = nullptr;
+	auto profiler = Profiler::Get();
+	bool scopeOpen = false;
+	for (auto& entry: m_entries) {
+		auto& item = m_items[entry.index];
+		if (!last || item.pass != last->pass)
+			ApplyPassState(item.pass);
+		// submit 하는 쪽이 아니라 실제로 그리는 여기서 pass 별 CPU / GPU 시간을 잰다
+		if (profiler && (!last || item.profileName != last->profileName)) {
+			if (scopeOpen)
+				profiler->EndScope();
+			scopeOpen = item.profileName != nullptr;
+			if (scopeOpen)
+				profiler->BeginScope(item.profileName);
+		}
+
+		bool programChanged = !last || item.program != last->program;
+		if (programChanged) {
+			item.program->Use();
+			m_stats.programChangeCount++;
+		}
+		// material uniform 은 program 마다 따로 있으므로 program 이 바뀌면 다시 설정한다
+		if (programChanged || item.material != last->material) {
+			if (item.material)
+				item.material->SetToProgram(item.program);
+			m_stats.materialChangeCount++;
+		}
+		if (!last || item.mesh != last->mesh)
+			m_stats.meshChangeCount++;
+
+		if (item.setUniforms)
+			item.setUniforms(item.program);
+		if (item.instanceCount > 0)
+			item.mesh->DrawGeometryInstanced(item.program, item.instanceCount);
+		else
+			item.mesh->DrawGeometry(item.program);
+		m_stats.drawCount++;
+		last = &item;
+	}
+	if (scopeOpen)
+		profiler->EndScope();
+	ResetPassState();
+
+	m_items.clear();
+	m_programIds.clear();
+	m_materialIds.clear();
+	m_meshIds.clear();
+}
+
+// 8bit 씩 LSD radix sort. 모든 key 의 해당 byte 가 같으면 그 자리는 건너뛴다
+void RenderQueue::RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& buffer) {
+	buffer.resize(entries.size());
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t counts[256] = {};
+		for (auto& entry: entries)
+			counts[(entry.key >> shift) & 0xff]++;
+		if (counts[(entries[0].key >> shift) & 0xff] == entries.size())
+			continue;
+
+		size_t offset = 0;
+		for (int i = 0; i < 256; i++) {
+			size_t count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+		for (auto& entry: entries)
+			buffer[counts[(entry.key >> shift) & 0xff]++] = entry;
+		entries.swap(buffer);
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef __RENDER_QUEUE_H__
+#define __RENDER_QUEUE_H__
+
+#include "common.h"
+#include "mesh.h"
+#include "program.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// 그리는 순서. key 의 최상위 bit 라서 pass 순서대로 그려진다
+enum class RenderPass : uint8_t {
+    Opaque = 0,
+    Skybox = 1,
+    Transparent = 2,
+};
+
+struct DrawItem {
+    const Mesh* mesh { nullptr };
+    Program* program { nullptr };
+    // nullptr 이면 mesh 의 material 을 쓴다
+    const Material* material { nullptr };
+    // 정렬에 쓰는 위치는 transform 의 translation
+    glm::mat4 transform { glm::mat4(1.0f) };
+    RenderPass pass { RenderPass::Opaque };
+    // 0 보다 크면 Mesh::SetInstanceBuffer 로 연결한 buffer 로 instanced draw
+    uint32_t instanceCount { 0 };
+    // 물체마다 다른 uniform / texture 설정. program 공통 값은 submit 전에 미리 설정해 둔다
+    std::function<void(const Program* program)> setUniforms;
+    // Flush 에서 이 이름의 PROFILE_SCOPE 안에서 그린다. 정렬 후 이웃한 같은 이름은 한 scope 로 묶인다
+    // Profiler::BeginScope 처럼 string literal 이어야 한다
+    const char* profileName { nullptr };
+};
+
+struct RenderQueueStats {
+    uint32_t drawCount { 0 };
+    uint32_t programChangeCount { 0 };
+    uint32_t materialChangeCount { 0 };
+    uint32_t meshChangeCount { 0 };
+    // 정렬하지 않고 제출 순서대로 그렸을 때의 program 변경 횟수 (비교용)
+    uint32_t unsortedProgramChangeCount { 0 };
+};
+
+// 제출된 draw 를 64bit key 로 radix sort 해서 state 변경이 적은 순서로 그린다
+// opaque / skybox: [pass 2][program 10][material 12][mesh 12][depth 24] - state 우선, 같은 state 안에서는 앞에서 뒤로
+// transparent:     [pass 2][far-to-near depth 24][program 10][material 12][mesh 12] - 뒤에서 앞으로
+CLASS_PTR(RenderQueue)
+class RenderQueue {
+public:
+    static RenderQueueUPtr Create();
+
+    // depth 는 cameraPos 로부터 거리를 farPlane 으로 나눠 양자화한다
+    void Begin(const glm::vec3& cameraPos, float farPlane);
+    void Submit(DrawItem item);
+    // 정렬 후 그리고 비운다. 실제 GL draw 가 여기서 일어나므로 pass 별 시간은 DrawItem::profileName 으로 잰다
+    void Flush();
+
+    const RenderQueueStats& GetStats() const { return m_stats; }
+
+private:
+    RenderQueue() {}
+    uint64_t MakeKey(const DrawItem& item);
+    static uint32_t GetDenseId(std::unordered_map<const void*, uint32_t>& ids,
+        const void* pointer, uint32_t bitCount);
+    void ApplyPassState(RenderPass pass);
+    void ResetPassState();
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+    static void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& buffer);
+
+    glm::vec3 m_cameraPos { 0.0f };
+    float m_farPlane { 100.0f };
+    std::vector<DrawItem> m_items;
+    std::vector<SortEntry> m_entries;
+    std::vector<SortEntry> m_sortBuffer;
+    std::unordered_map<const void*, uint32_t> m_programIds;
+    std::unordered_map<const void*, uint32_t> m_materialIds;
+    std::unordered_map<const void*, uint32_t> m_meshIds;
+    RenderQueueStats m_stats;
+};
+
+#endif // __RENDER_QUEUE_H__
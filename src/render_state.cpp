@@ -0,0 +1,128 @@
+#include "render_state.h"
+
+RenderState* RenderState::Get() {
+	static RenderState renderState;
+	return &renderState;
+}
+
+void RenderState::UseProgram(uint32_t program) {
+	if (Check(m_program == program))
+		return;
+	glUseProgram(program);
+	m_program = program;
+}
+
+void RenderState::BindVertexArray(uint32_t vertexArray) {
+	if (Check(m_vertexArray == vertexArray))
+		return;
+	glBindVertexArray(vertexArray);
+	m_vertexArray = vertexArray;
+}
+
+void RenderState::ActiveTexture(uint32_t unit) {
+	if (Check(m_activeTextureUnit == unit))
+		return;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	m_activeTextureUnit = unit;
+}
+
+int RenderState::GetTextureTargetIndex(uint32_t target) const {
+	switch (target) {
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_CUBE_MAP: return 1;
+	case GL_TEXTURE_2D_ARRAY: return 2;
+	case GL_TEXTURE_BUFFER: return 3;
+	default: return -1;
+	}
+}
+
+void RenderState::BindTexture(uint32_t target, uint32_t texture) {
+	int targetIndex = GetTextureTargetIndex(target);
+	if (m_activeTextureUnit >= MAX_TEXTURE_UNIT_COUNT || targetIndex < 0) {
+		// 추적하지 않는 unit / target 은 그대로 호출
+		m_issuedCount++;
+		glBindTexture(target, texture);
+		return;
+	}
+	auto& bound = m_textures[m_activeTextureUnit][targetIndex];
+	if (Check(bound == texture))
+		return;
+	glBindTexture(target, texture);
+	bound = texture;
+}
+
+void RenderState::BindTexture(uint32_t unit, uint32_t target, uint32_t texture) {
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void RenderState::BindFramebuffer(uint32_t framebuffer) {
+	if (Check(m_framebuffer == framebuffer))
+		return;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	m_framebuffer = framebuffer;
+}
+
+void RenderState::Viewport(int x, int y, int width, int height) {
+	if (Check(m_viewport[0] == x && m_viewport[1] == y &&
+		m_viewport[2] == width && m_viewport[3] == height))
+		return;
+	glViewport(x, y, width, height);
+	m_viewport[0] = x;
+	m_viewport[1] = y;
+	m_viewport[2] = width;
+	m_viewport[3] = height;
+}
+
+void RenderState::DepthFunc(uint32_t func) {
+	if (Check(m_depthFunc == func))
+		return;
+	glDepthFunc(func);
+	m_depthFunc = func;
+}
+
+void RenderState::OnProgramDeleted(uint32_t program) {
+	if (m_program == program)
+		m_program = UNKNOWN;
+}
+
+void RenderState::OnVertexArrayDeleted(uint32_t vertexArray) {
+	// 지금 bind 된 VAO 를 지우면 0 이 bind 된다
+	if (m_vertexArray == vertexArray)
+		m_vertexArray = 0;
+}
+
+void RenderState::OnTextureDeleted(uint32_t texture) {
+	// 지워진 texture 는 모든 unit 에서 0 으로 풀린다
+	for (auto& unit: m_textures) {
+		for (auto& bound: unit) {
+			if (bound == texture)
+				bound = 0;
+		}
+	}
+}
+
+void RenderState::OnFramebufferDeleted(uint32_t framebuffer) {
+	if (m_framebuffer == framebuffer)
+		m_framebuffer = 0;
+}
+
+void RenderState::Invalidate() {
+	m_program = UNKNOWN;
+	m_vertexArray = UNKNOWN;
+	m_activeTextureUnit = UNKNOWN;
+	for (auto& unit: m_textures) {
+		for (auto& bound: unit)
+			bound = UNKNOWN;
+	}
+	m_framebuffer = UNKNOWN;
+	m_viewport[0] = m_viewport[1] = m_viewport[2] = m_viewport[3] = -1;
+	m_depthFunc = UNKNOWN;
+}
+
+void RenderState::BeginFrame() {
+	m_lastIssuedCount = m_issuedCount;
+	m_lastElidedCount = m_elidedCount;
+	m_issuedCount = 0;
+	m_elidedCount = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef __RENDER_STATE_H__
+#define __RENDER_STATE_H__
+
+#include "common.h"
+
+// 현재 GL context 에 bind 된 상태를 기억해서 같은 값을 다시 설정하는 driver 호출을 건너뛴다
+// program / VAO / texture / framebuffer 를 바꾸는 wrapper 는 모두 이 class 를 거쳐야 한다
+// GL 상태를 직접 바꾸는 외부 코드를 호출한 뒤에는 Invalidate() 를 부른다
+// (ImGui OpenGL3 backend 는 그리고 나서 상태를 되돌려 놓으므로 필요 없다)
+class RenderState {
+public:
+    static RenderState* Get();
+
+    void UseProgram(uint32_t program);
+    void BindVertexArray(uint32_t vertexArray);
+    // unit 은 GL_TEXTURE0 기준 번호
+    void ActiveTexture(uint32_t unit);
+    // 현재 active unit 에 bind
+    void BindTexture(uint32_t target, uint32_t texture);
+    void BindTexture(uint32_t unit, uint32_t target, uint32_t texture);
+    void BindFramebuffer(uint32_t framebuffer);
+    void Viewport(int x, int y, int width, int height);
+    void DepthFunc(uint32_t func);
+
+    // 지워진 object 가 cache 에 남아 있으면 같은 이름이 재사용될 때 bind 를 건너뛰게 되므로 비운다
+    void OnProgramDeleted(uint32_t program);
+    void OnVertexArrayDeleted(uint32_t vertexArray);
+    void OnTextureDeleted(uint32_t texture);
+    void OnFramebufferDeleted(uint32_t framebuffer);
+    void Invalidate();
+
+    // frame 마다 호출. 직전 frame 의 호출 / 생략 횟수를 남겨 둔다
+    void BeginFrame();
+    uint32_t GetIssuedCount() const { return m_lastIssuedCount; }
+    uint32_t GetElidedCount() const { return m_lastElidedCount; }
+
+private:
+    RenderState() { Invalidate(); }
+    bool Check(bool redundant) {
+        if (redundant)
+            m_elidedCount++;
+        else
+            m_issuedCount++;
+        return redundant;
+    }
+    int GetTextureTargetIndex(uint32_t target) const;
+
+    static const uint32_t UNKNOWN = 0xffffffff;
+    static const int MAX_TEXTURE_UNIT_COUNT = 32;
+    static const int TEXTURE_TARGET_COUNT = 4;
+
+    uint32_t m_program;
+    uint32_t m_vertexArray;
+    uint32_t m_activeTextureUnit;
+    uint32_t m_textures[MAX_TEXTURE_UNIT_COUNT][TEXTURE_TARGET_COUNT];
+    uint32_t m_framebuffer;
+    int m_viewport[4];
+    uint32_t m_depthFunc;
+
+    uint32_t m_issuedCount { 0 };
+    uint32_t m_elidedCount { 0 };
+    uint32_t m_lastIssuedCount { 0 };
+    uint32_t m_lastElidedCount { 0 };
+};
+
+#endif // __RENDER_STATE_H__
@@ -0,0 +1,195 @@
+#include "scene_graph.h"
+#include <algorithm>
+#include <random>
+
+SceneGraphUPtr SceneGraph::Create() {
+    return SceneGraphUPtr(new SceneGraph());
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4& localTransform,
+    const std::string& name) {
+    auto node = (uint32_t)m_parents.size();
+    if (parent != NO_PARENT && parent >= node) {
+        SPDLOG_ERROR("invalid parent node {} for node {}", parent, node);
+        parent = NO_PARENT;
+    }
+    m_parents.push_back(parent);
+    m_localTransforms.push_back(localTransform);
+    m_worldTransforms.push_back(localTransform);
+    m_dirty.push_back(1);
+    m_changed.push_back(0);
+    m_names.push_back(name);
+    m_firstDirty = std::min(m_firstDirty, (size_t)node);
+    return node;
+}
+
+void SceneGraph::Clear() {
+    m_parents.clear();
+    m_localTransforms.clear();
+    m_worldTransforms.clear();
+    m_dirty.clear();
+    m_changed.clear();
+    m_names.clear();
+    m_firstDirty = 0;
+    m_firstChanged = 0;
+}
+
+void SceneGraph::Reserve(size_t nodeCount) {
+    m_parents.reserve(nodeCount);
+    m_localTransforms.reserve(nodeCount);
+    m_worldTransforms.reserve(nodeCount);
+    m_dirty.reserve(nodeCount);
+    m_changed.reserve(nodeCount);
+    m_names.reserve(nodeCount);
+}
+
+uint32_t SceneGraph::FindNode(const std::string& name) const {
+    auto it = std::find(m_names.begin(), m_names.end(), name);
+    return it != m_names.end() ? (uint32_t)(it - m_names.begin()) : NO_PARENT;
+}
+
+void SceneGraph::SetLocalTransform(uint32_t node, const glm::mat4& transform) {
+    m_localTransforms[node] = transform;
+    m_dirty[node] = 1;
+    m_firstDirty = std::min(m_firstDirty, (size_t)node);
+}
+
+size_t SceneGraph::UpdateWorldTransforms() {
+    size_t nodeCount = m_parents.size();
+    // 지난 갱신의 changed 표시는 그때 훑은 범위에만 있다
+    std::fill(m_changed.begin() + std::min(m_firstChanged, nodeCount), m_changed.end(), 0);
+    if (m_firstDirty >= nodeCount) {
+        m_firstChanged = nodeCount;
+        return 0;
+    }
+
+    // parent 가 항상 앞에 있으므로 parent 의 changed 가 이미 정해져 있다
+    size_t updateCount = 0;
+    for (size_t i = m_firstDirty; i < nodeCount; i++) {
+        auto parent = m_parents[i];
+        bool parentChanged = parent != NO_PARENT && m_changed[parent];
+        if (!m_dirty[i] && !parentChanged)
+            continue;
+        m_worldTransforms[i] = parent != NO_PARENT ?
+            m_worldTransforms[parent] * m_localTransforms[i] : m_localTransforms[i];
+        m_dirty[i] = 0;
+        m_changed[i] = 1;
+        updateCount++;
+    }
+    m_firstChanged = m_firstDirty;
+    m_firstDirty = nodeCount;
+    return updateCount;
+}
+
+bool SceneGraph::RunUpdateTest() {
+    bool success = true;
+    auto Check = [&](bool condition, const std::string& message) {
+        if (!condition) {
+            SPDLOG_ERROR("scene graph test failed: {}", message);
+            success = false;
+        }
+    };
+
+    std::mt19937 random(99);
+    auto Uniform = [&](float minValue, float maxValue) {
+        return std::uniform_real_distribution<float>(minValue, maxValue)(random);
+    };
+    auto RandomIndex = [&](size_t count) {
+        return (uint32_t)std::uniform_int_distribution<size_t>(0, count - 1)(random);
+    };
+    // 회전 / scale 이 섞인 affine transform (전체 재계산과 같은 순서로 곱하므로 값이 정확히 같아야 한다)
+    auto RandomTransform = [&]() {
+        glm::mat4 transform(1.0f);
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++)
+                transform[col][row] = (col == row ? 1.0f : 0.0f) + Uniform(-0.3f, 0.3f);
+            transform[3][col] = Uniform(-5.0f, 5.0f);
+        }
+        return transform;
+    };
+    // 가까운 앞쪽 node 를 parent 로 골라서 깊이가 수십 단계인 subtree 가 생기게 한다
+    // 가끔 root 를 새로 만들어 서로 관계없는 tree 도 섞는다
+    auto graph = SceneGraph::Create();
+    auto AddRandomNode = [&]() {
+        size_t count = graph->GetNodeCount();
+        uint32_t parent = NO_PARENT;
+        if (count > 0 && random() % 64 != 0)
+            parent = (uint32_t)(count - 1 - std::min<size_t>(RandomIndex(8), count - 1));
+        if (count > 0 && random() % 4 == 0)
+            parent = RandomIndex(count);
+        return graph->AddNode(parent, RandomTransform());
+    };
+    for (int i = 0; i < 2000; i++)
+        AddRandomNode();
+
+    std::vector<glm::mat4> expected;
+    std::vector<uint8_t> expectedChanged;
+    auto Verify = [&](const std::string& phase, size_t updateCount) {
+        size_t nodeCount = graph->GetNodeCount();
+        expected.resize(nodeCount);
+        size_t expectedCount = 0;
+        size_t wrongTransformCount = 0;
+        size_t wrongChangedCount = 0;
+        for (size_t i = 0; i < nodeCount; i++) {
+            auto parent = graph->GetParent((uint32_t)i);
+            expected[i] = parent != NO_PARENT ?
+                expected[parent] * graph->GetLocalTransform((uint32_t)i) : graph->GetLocalTransform((uint32_t)i);
+            for (int col = 0; col < 4; col++) {
+                if (expected[i][col] != graph->GetWorldTransform((uint32_t)i)[col]) {
+                    wrongTransformCount++;
+                    break;
+                }
+            }
+            // 수정한 node 와 그 자손만 바뀌고, 나머지 (형제 subtree 포함) 는 건너뛴다
+            if (parent != NO_PARENT && expectedChanged[parent])
+                expectedChanged[i] = 1;
+            expectedCount += expectedChanged[i];
+            if (graph->IsWorldTransformChanged((uint32_t)i) != (expectedChanged[i] != 0))
+                wrongChangedCount++;
+        }
+        Check(wrongTransformCount == 0, fmt::format("{}: {} world transforms differ from a full recompute",
+            phase, wrongTransformCount));
+        Check(wrongChangedCount == 0, fmt::format("{}: {} nodes have a wrong changed flag",
+            phase, wrongChangedCount));
+        Check(updateCount == expectedCount, fmt::format("{}: updated {} nodes, expected {}",
+            phase, updateCount, expectedCount));
+        Check(!graph->IsDirty(), fmt::format("{}: still dirty after update", phase));
+    };
+
+    // 처음에는 모든 node 가 새로 추가되어 dirty 다
+    expectedChanged.assign(graph->GetNodeCount(), 1);
+    Verify("initial", graph->UpdateWorldTransforms());
+
+    size_t totalUpdateCount = 0;
+    for (int round = 0; round < 300; round++) {
+        expectedChanged.assign(graph->GetNodeCount(), 0);
+        // 0 개 (갱신 없음) 부터 몇 개까지 수정한다. 같은 node 를 두 번, 같은 값으로 다시 쓰는 경우도 섞는다
+        int editCount = round % 7;
+        for (int e = 0; e < editCount; e++) {
+            uint32_t node = RandomIndex(graph->GetNodeCount());
+            if (random() % 5 == 0)
+                graph->SetLocalTransform(node, graph->GetLocalTransform(node));
+            else
+                graph->SetLocalTransform(node, RandomTransform());
+            expectedChanged[node] = 1;
+        }
+        // 가끔 node 를 추가한다 (새 node 는 dirty)
+        if (round % 10 == 9) {
+            for (int n = 0; n < 3; n++) {
+                expectedChanged.push_back(1);
+                AddRandomNode();
+            }
+        }
+        Check(graph->IsDirty() == (editCount > 0 || round % 10 == 9),
+            fmt::format("round {}: wrong dirty state before update", round));
+        size_t updateCount = graph->UpdateWorldTransforms();
+        totalUpdateCount += updateCount;
+        Verify(fmt::format("round {}", round), updateCount);
+    }
+
+    SPDLOG_INFO("scene graph test: {} nodes, 300 rounds, {:.1f} nodes updated per round",
+        graph->GetNodeCount(), totalUpdateCount / 300.0f);
+    if (success)
+        SPDLOG_INFO("scene graph test passed");
+    return success;
+}
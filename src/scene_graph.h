@@ -0,0 +1,62 @@
+#ifndef __SCENE_GRAPH_H__
+#define __SCENE_GRAPH_H__
+
+#include "common.h"
+#include <vector>
+
+// node 의 local transform 을 유지하는 transform hierarchy
+// node 는 parent 가 항상 child 보다 앞에 오는 순서로 한 배열에 저장되어
+// world transform 갱신이 앞에서부터 한 번 훑는 것으로 끝난다
+// SetLocalTransform 으로 바뀐 node 와 그 subtree 만 다시 계산한다
+CLASS_PTR(SceneGraph)
+class SceneGraph {
+public:
+    static const uint32_t NO_PARENT = 0xffffffff;
+
+    static SceneGraphUPtr Create();
+
+    // parent 는 이미 추가된 node 이거나 NO_PARENT 여야 한다. 새 node index 를 돌려준다
+    uint32_t AddNode(uint32_t parent, const glm::mat4& localTransform,
+        const std::string& name = std::string());
+    void Clear();
+    void Reserve(size_t nodeCount);
+
+    size_t GetNodeCount() const { return m_parents.size(); }
+    uint32_t GetParent(uint32_t node) const { return m_parents[node]; }
+    const std::string& GetName(uint32_t node) const { return m_names[node]; }
+    // 같은 이름이 여럿이면 가장 앞의 node, 없으면 NO_PARENT
+    uint32_t FindNode(const std::string& name) const;
+
+    const glm::mat4& GetLocalTransform(uint32_t node) const { return m_localTransforms[node]; }
+    void SetLocalTransform(uint32_t node, const glm::mat4& transform);
+    // 마지막 UpdateWorldTransforms 시점의 값
+    const glm::mat4& GetWorldTransform(uint32_t node) const { return m_worldTransforms[node]; }
+
+    bool IsDirty() const { return m_firstDirty < m_parents.size(); }
+    // dirty node 의 subtree 만 다시 계산하고 world transform 이 바뀐 node 수를 돌려준다
+    size_t UpdateWorldTransforms();
+    // 마지막 UpdateWorldTransforms 에서 world transform 이 바뀌었는지
+    bool IsWorldTransformChanged(uint32_t node) const { return m_changed[node] != 0; }
+
+    // 임의의 tree 에 local transform 수정 / node 추가를 반복하면서 매번 전체를 다시 계산한 값과
+    // world transform, 갱신 수, changed 표시 (수정한 node 의 subtree 만) 를 비교한다
+    static bool RunUpdateTest();
+
+private:
+    SceneGraph() {}
+
+    // 갱신에 쓰는 값끼리 따로 모아둔다 (SoA)
+    std::vector<uint32_t> m_parents;
+    std::vector<glm::mat4> m_localTransforms;
+    std::vector<glm::mat4> m_worldTransforms;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint8_t> m_changed;
+    std::vector<std::string> m_names;
+
+    // 이 index 앞쪽은 dirty 가 없어서 갱신할 때 건너뛴다
+    size_t m_firstDirty { 0 };
+    // 지난 갱신에서 m_changed 를 채우기 시작한 위치
+    size_t m_firstChanged { 0 };
+};
+
+#endif // __SCENE_GRAPH_H__
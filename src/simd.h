@@ -0,0 +1,26 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+// x86 에서는 SSE 경로를 쓰고, 그 외 (Apple Silicon 등) 에서는 scalar 경로로 빌드된다
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE 1
+#include <immintrin.h>
+#else
+#define USE_SSE 0
+#endif
+
+// 8 개씩 처리하는 경로는 -mavx 등으로 AVX 가 켜져 있을 때만 쓴다
+#if USE_SSE && defined(__AVX__)
+#define USE_AVX 1
+#else
+#define USE_AVX 0
+#endif
+
+// half float 변환 명령 (F16C) 은 Ivy Bridge 이후, AVX2 가 켜져 있으면 항상 있다
+#if USE_SSE && (defined(__F16C__) || defined(__AVX2__))
+#define USE_F16C 1
+#else
+#define USE_F16C 0
+#endif
+
+#endif // __SIMD_H__
@@ -0,0 +1,334 @@
+#include "spherical_harmonics.h"
+#include "simd.h"
+
+static const float SH_C0 = 0.282095f;
+static const float SH_C1 = 0.488603f;
+static const float SH_C2 = 1.092548f;
+static const float SH_C3 = 0.315392f;
+static const float SH_C4 = 0.546274f;
+
+static void EvaluateBasis(const glm::vec3& dir, float* basis) {
+    basis[0] = SH_C0;
+    basis[1] = SH_C1 * dir.y;
+    basis[2] = SH_C1 * dir.z;
+    basis[3] = SH_C1 * dir.x;
+    basis[4] = SH_C2 * dir.x * dir.y;
+    basis[5] = SH_C2 * dir.y * dir.z;
+    basis[6] = SH_C3 * (3.0f * dir.z * dir.z - 1.0f);
+    basis[7] = SH_C2 * dir.x * dir.z;
+    basis[8] = SH_C4 * (dir.x * dir.x - dir.y * dir.y);
+}
+
+// row 하나를 RGB float 배열로 얻는다. 이미 RGB float 이면 복사하지 않는다
+static const float* GetRowColor(const Image* image, int y, std::vector<float>& buffer) {
+    int width = image->GetWidth();
+    int channelCount = image->GetChannelCount();
+    auto pixelType = image->GetPixelType();
+    if (channelCount == 3 && pixelType == PixelType::Float)
+        return (const float*)image->GetData() + (size_t)y * width * 3;
+    // half / RGB9E5 는 Image 의 변환을 쓴다
+    if (pixelType == PixelType::Half || pixelType == PixelType::RGB9E5) {
+        if (channelCount == 3) {
+            image->GetRowAsFloat(y, buffer.data());
+            return buffer.data();
+        }
+        std::vector<float> row((size_t)width * channelCount);
+        image->GetRowAsFloat(y, row.data());
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++)
+                buffer[x * 3 + c] = row[(size_t)x * channelCount + std::min(c, channelCount - 1)];
+        }
+        return buffer.data();
+    }
+
+    size_t rowOffset = (size_t)y * width * channelCount;
+    for (int x = 0; x < width; x++) {
+        for (int c = 0; c < 3; c++) {
+            int channel = std::min(c, channelCount - 1);
+            size_t index = rowOffset + (size_t)x * channelCount + channel;
+            buffer[x * 3 + c] = image->GetBytePerChannel() == 4 ?
+                ((const float*)image->GetData())[index] :
+                image->GetData()[index] / 255.0f;
+        }
+    }
+    return buffer.data();
+}
+
+#if USE_SSE
+static float HorizontalSum(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+    return _mm_cvtss_f32(sums);
+}
+#endif
+
+// 위도가 같은 row 하나의 (basis * color) 합을 sums[basis * 3 + channel] 에 더한다
+static void AccumulateRow(const float* color,
+    const float* cosPhi, const float* sinPhi, int width,
+    float cosLatitude, float dirY, float* sums) {
+    int x = 0;
+#if USE_SSE
+    __m128 acc[27];
+    for (int k = 0; k < 27; k++)
+        acc[k] = _mm_setzero_ps();
+    const __m128 vy = _mm_set1_ps(dirY);
+    const __m128 vcos = _mm_set1_ps(cosLatitude);
+    const __m128 c0 = _mm_set1_ps(SH_C0);
+    const __m128 c1 = _mm_set1_ps(SH_C1);
+    const __m128 c2 = _mm_set1_ps(SH_C2);
+    const __m128 c3 = _mm_set1_ps(SH_C3);
+    const __m128 c4 = _mm_set1_ps(SH_C4);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; x + 4 <= width; x += 4) {
+        __m128 vx = _mm_mul_ps(vcos, _mm_loadu_ps(cosPhi + x));
+        __m128 vz = _mm_mul_ps(vcos, _mm_loadu_ps(sinPhi + x));
+        const float* c = color + x * 3;
+        __m128 rgb[3] = {
+            _mm_setr_ps(c[0], c[3], c[6], c[9]),
+            _mm_setr_ps(c[1], c[4], c[7], c[10]),
+            _mm_setr_ps(c[2], c[5], c[8], c[11]),
+        };
+        __m128 basis[9] = {
+            c0,
+            _mm_mul_ps(c1, vy),
+            _mm_mul_ps(c1, vz),
+            _mm_mul_ps(c1, vx),
+            _mm_mul_ps(c2, _mm_mul_ps(vx, vy)),
+            _mm_mul_ps(c2, _mm_mul_ps(vy, vz)),
+            _mm_mul_ps(c3, _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(vz, vz)), one)),
+            _mm_mul_ps(c2, _mm_mul_ps(vx, vz)),
+            _mm_mul_ps(c4, _mm_sub_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy))),
+        };
+        for (int k = 0; k < 9; k++) {
+            for (int ch = 0; ch < 3; ch++)
+                acc[k * 3 + ch] = _mm_add_ps(acc[k * 3 + ch], _mm_mul_ps(basis[k], rgb[ch]));
+        }
+    }
+    for (int k = 0; k < 27; k++)
+        sums[k] += HorizontalSum(acc[k]);
+#endif
+    for (; x < width; x++) {
+        float basis[9];
+        EvaluateBasis(glm::vec3(cosLatitude * cosPhi[x], dirY, cosLatitude * sinPhi[x]), basis);
+        for (int k = 0; k < 9; k++) {
+            for (int ch = 0; ch < 3; ch++)
+                sums[k * 3 + ch] += basis[k] * color[x * 3 + ch];
+        }
+    }
+}
+
+SH9Color ProjectEquirectToSH9(const Image* image, ThreadPool* threadPool) {
+    const float pi = glm::pi<float>();
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+
+    // spherical_map.fs: u = atan(z, x) / 2PI + 0.5, v = asin(y) / PI + 0.5
+    std::vector<float> cosPhi(width);
+    std::vector<float> sinPhi(width);
+    for (int x = 0; x < width; x++) {
+        float phi = (((float)x + 0.5f) / (float)width - 0.5f) * 2.0f * pi;
+        cosPhi[x] = cosf(phi);
+        sinPhi[x] = sinf(phi);
+    }
+
+    // row 단위 합을 따로 저장했다가 순서대로 더해서 thread 수와 상관없이 같은 결과가 나오게 한다
+    std::vector<std::array<double, 27>> rowSums(height);
+    threadPool->ParallelFor(height, [&](size_t begin, size_t end) {
+        std::vector<float> rowBuffer(width * 3);
+        for (size_t y = begin; y < end; y++) {
+            const float* color = GetRowColor(image, (int)y, rowBuffer);
+            float latitude = (((float)y + 0.5f) / (float)height - 0.5f) * pi;
+            float cosLatitude = cosf(latitude);
+            float dirY = sinf(latitude);
+            // 픽셀 하나가 차지하는 solid angle
+            float weight = cosLatitude * (pi / (float)height) * (2.0f * pi / (float)width);
+
+            float sums[27] = {};
+            AccumulateRow(color, cosPhi.data(), sinPhi.data(), width,
+                cosLatitude, dirY, sums);
+            for (int k = 0; k < 27; k++)
+                rowSums[y][k] = (double)sums[k] * weight;
+        }
+    }, 16);
+
+    std::array<double, 27> total = {};
+    for (auto& row: rowSums) {
+        for (int k = 0; k < 27; k++)
+            total[k] += row[k];
+    }
+
+    SH9Color result;
+    for (int k = 0; k < 9; k++)
+        result[k] = glm::vec3((float)total[k * 3], (float)total[k * 3 + 1], (float)total[k * 3 + 2]);
+    return result;
+}
+
+SH9Color ConvolveSH9Irradiance(const SH9Color& radiance) {
+    // cosine lobe 의 band 별 계수 (PI, 2PI/3, PI/4) 를 PI 로 나눈 값
+    const float bandScale[9] = {
+        1.0f,
+        2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f,
+        0.25f, 0.25f, 0.25f, 0.25f, 0.25f,
+    };
+    SH9Color irradiance;
+    for (int k = 0; k < 9; k++)
+        irradiance[k] = radiance[k] * bandScale[k];
+    return irradiance;
+}
+
+glm::vec3 EvaluateSH9(const SH9Color& coeffs, const glm::vec3& dir) {
+    float basis[9];
+    EvaluateBasis(dir, basis);
+    glm::vec3 result(0.0f);
+    for (int k = 0; k < 9; k++)
+        result += coeffs[k] * basis[k];
+    return result;
+}
+
+// GL cube map 의 face / texel 중심 방향 (s, t 는 [-1, 1], t 는 glGetTexImage 의 행 방향)
+static glm::vec3 GetCubeMapDirection(int face, float s, float t) {
+    switch (face) {
+        case 0: return glm::vec3(1.0f, -t, -s);
+        case 1: return glm::vec3(-1.0f, -t, s);
+        case 2: return glm::vec3(s, 1.0f, t);
+        case 3: return glm::vec3(s, -1.0f, -t);
+        case 4: return glm::vec3(s, -t, 1.0f);
+        default: return glm::vec3(-s, -t, -1.0f);
+    }
+}
+
+SH9Color ProjectCubeMapToSH9(const std::vector<std::vector<float>>& faces, int faceSize) {
+    std::array<double, 27> total = {};
+    for (int face = 0; face < 6; face++) {
+        for (int y = 0; y < faceSize; y++) {
+            for (int x = 0; x < faceSize; x++) {
+                float s = ((float)x + 0.5f) / (float)faceSize * 2.0f - 1.0f;
+                float t = ((float)y + 0.5f) / (float)faceSize * 2.0f - 1.0f;
+                // texel 이 차지하는 solid angle
+                float weight = 4.0f / ((float)faceSize * faceSize *
+                    powf(1.0f + s * s + t * t, 1.5f));
+                float basis[9];
+                EvaluateBasis(glm::normalize(GetCubeMapDirection(face, s, t)), basis);
+                const float* color = faces[face].data() + ((size_t)y * faceSize + x) * 3;
+                for (int k = 0; k < 9; k++) {
+                    for (int c = 0; c < 3; c++)
+                        total[k * 3 + c] += (double)color[c] * basis[k] * weight;
+                }
+            }
+        }
+    }
+    SH9Color result;
+    for (int k = 0; k < 9; k++)
+        result[k] = glm::vec3((float)total[k * 3], (float)total[k * 3 + 1], (float)total[k * 3 + 2]);
+    return result;
+}
+
+glm::vec3 SampleCubeMap(const std::vector<std::vector<float>>& faces, int faceSize,
+    const glm::vec3& dir) {
+    // major axis 로 face 를 고르고 GetCubeMapDirection 을 거꾸로 풀어서 s, t 를 구한다
+    auto absDir = glm::abs(dir);
+    int face = 0;
+    float s = 0.0f;
+    float t = 0.0f;
+    if (absDir.x >= absDir.y && absDir.x >= absDir.z) {
+        face = dir.x > 0.0f ? 0 : 1;
+        s = (dir.x > 0.0f ? -dir.z : dir.z) / absDir.x;
+        t = -dir.y / absDir.x;
+    }
+    else if (absDir.y >= absDir.z) {
+        face = dir.y > 0.0f ? 2 : 3;
+        s = dir.x / absDir.y;
+        t = (dir.y > 0.0f ? dir.z : -dir.z) / absDir.y;
+    }
+    else {
+        face = dir.z > 0.0f ? 4 : 5;
+        s = (dir.z > 0.0f ? dir.x : -dir.x) / absDir.z;
+        t = -dir.y / absDir.z;
+    }
+    float fx = glm::clamp((s * 0.5f + 0.5f) * faceSize - 0.5f, 0.0f, (float)faceSize - 1.0f);
+    float fy = glm::clamp((t * 0.5f + 0.5f) * faceSize - 0.5f, 0.0f, (float)faceSize - 1.0f);
+    int x0 = (int)fx;
+    int y0 = (int)fy;
+    int x1 = std::min(x0 + 1, faceSize - 1);
+    int y1 = std::min(y0 + 1, faceSize - 1);
+    auto Texel = [&](int x, int y) {
+        const float* texel = faces[face].data() + ((size_t)y * faceSize + x) * 3;
+        return glm::vec3(texel[0], texel[1], texel[2]);
+    };
+    return glm::mix(glm::mix(Texel(x0, y0), Texel(x1, y0), fx - x0),
+        glm::mix(Texel(x0, y1), Texel(x1, y1), fx - x0), fy - y0);
+}
+
+bool CompareSH9WithCubeMap(const SH9Color& irradiance,
+    const std::vector<std::vector<float>>& faces, int faceSize) {
+    // 구 위에 고르게 퍼진 방향 (Fibonacci) 과 축 / 모서리 / 꼭짓점 방향 26 개
+    std::vector<glm::vec3> directions;
+    const int fibonacciCount = 256;
+    for (int i = 0; i < fibonacciCount; i++) {
+        float y = 1.0f - 2.0f * ((float)i + 0.5f) / fibonacciCount;
+        float radius = sqrtf(std::max(1.0f - y * y, 0.0f));
+        float angle = (float)i * 2.39996323f;
+        directions.push_back(glm::vec3(radius * cosf(angle), y, radius * sinf(angle)));
+    }
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int z = -1; z <= 1; z++) {
+                if (x != 0 || y != 0 || z != 0)
+                    directions.push_back(glm::normalize(glm::vec3(x, y, z)));
+            }
+        }
+    }
+
+    // 오차는 평균 irradiance 크기에 대한 비율로 본다 (어두운 방향에서 상대 오차가 튀지 않게)
+    auto projected = ProjectCubeMapToSH9(faces, faceSize);
+    std::vector<glm::vec3> mapValues;
+    float meanValue = 0.0f;
+    for (auto& dir: directions) {
+        mapValues.push_back(SampleCubeMap(faces, faceSize, dir));
+        meanValue += (mapValues.back().r + mapValues.back().g + mapValues.back().b) / 3.0f;
+    }
+    meanValue /= (float)directions.size();
+    if (!(meanValue > 0.0f)) {
+        SPDLOG_ERROR("sh irradiance test failed: irradiance map is empty");
+        return false;
+    }
+
+    float maxProjectedError = 0.0f;
+    float maxDirectError = 0.0f;
+    float meanDirectError = 0.0f;
+    for (size_t i = 0; i < directions.size(); i++) {
+        auto sh = EvaluateSH9(irradiance, directions[i]);
+        auto projectedError = glm::abs(sh - EvaluateSH9(projected, directions[i])) / meanValue;
+        auto directError = glm::abs(sh - mapValues[i]) / meanValue;
+        maxProjectedError = std::max(maxProjectedError,
+            std::max(projectedError.r, std::max(projectedError.g, projectedError.b)));
+        float error = std::max(directError.r, std::max(directError.g, directError.b));
+        maxDirectError = std::max(maxDirectError, error);
+        meanDirectError += error;
+    }
+    meanDirectError /= (float)directions.size();
+    SPDLOG_INFO("sh irradiance vs cube map ({} directions, mean {:.4f}): "
+        "L2 projection max error {:.2f}%, sampled mean error {:.2f}% (max {:.2f}%)",
+        directions.size(), meanValue, maxProjectedError * 100.0f,
+        meanDirectError * 100.0f, maxDirectError * 100.0f);
+
+    // L2 (9 계수) 로 projection 한 map 은 같은 환경의 같은 band 라서 적분 오차만 남는다
+    // 직접 읽은 값과는 L2 에서 잘린 고주파 (밝은 광원) 만큼 차이가 나므로 평균만 느슨하게 본다
+    bool success = true;
+    if (maxProjectedError > 0.03f) {
+        SPDLOG_ERROR("sh irradiance test failed: L2 projection of the cube map differs by {:.2f}%",
+            maxProjectedError * 100.0f);
+        success = false;
+    }
+    if (meanDirectError > 0.15f) {
+        SPDLOG_ERROR("sh irradiance test failed: cube map differs by {:.2f}% on average",
+            meanDirectError * 100.0f);
+        success = false;
+    }
+    if (success)
+        SPDLOG_INFO("sh irradiance test passed");
+    return success;
+}
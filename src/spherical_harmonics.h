@@ -0,0 +1,32 @@
+#ifndef __SPHERICAL_HARMONICS_H__
+#define __SPHERICAL_HARMONICS_H__
+
+#include "common.h"
+#include "image.h"
+#include "thread_pool.h"
+#include <array>
+
+// L2 (9 계수) real spherical harmonics
+using SH9Color = std::array<glm::vec3, 9>;
+
+// equirectangular 이미지 (spherical_map.fs 와 같은 uv 매핑) 를 radiance SH 로 projection
+// GPU 없이 돌아가므로 headless 환경에서도 irradiance 를 bake 할 수 있다
+SH9Color ProjectEquirectToSH9(const Image* image, ThreadPool* threadPool);
+
+// radiance SH 를 cosine lobe 로 convolution 하고 1/PI 를 곱해
+// diffuse_irradiance.fs 의 결과와 같은 스케일의 irradiance SH 로 만든다
+SH9Color ConvolveSH9Irradiance(const SH9Color& radiance);
+
+glm::vec3 EvaluateSH9(const SH9Color& coeffs, const glm::vec3& dir);
+
+// faces 는 GL cube map face 순서 (+X, -X, +Y, -Y, +Z, -Z) 의 RGB float (glGetTexImage 결과)
+SH9Color ProjectCubeMapToSH9(const std::vector<std::vector<float>>& faces, int faceSize);
+// dir 방향을 bilinear 로 읽는다 (face 경계는 clamp)
+glm::vec3 SampleCubeMap(const std::vector<std::vector<float>>& faces, int faceSize,
+    const glm::vec3& dir);
+// irradiance SH 를 diffuse irradiance cube map 과 여러 방향에서 비교한다
+// cube map 을 L2 로 projection 한 값과는 거의 같아야 하고, 직접 읽은 값과는 평균만 본다
+bool CompareSH9WithCubeMap(const SH9Color& irradiance,
+    const std::vector<std::vector<float>>& faces, int faceSize);
+
+#endif // __SPHERICAL_HARMONICS_H__
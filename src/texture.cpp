@@ -1,4 +1,5 @@
 #include "texture.h"
+#include "render_state.h"
 
 TextureUPtr Texture::Create(int width, int height, uint32_t format, uint32_t type) {
   auto texture = TextureUPtr(new Texture());
@@ -8,21 +9,54 @@ TextureUPtr Texture::Create(int width, int height, uint32_t format, uint32_t typ
   return std::move(texture);
 }
 
-TextureUPtr Texture::CreateFromImage(const Image* image) {
+TextureUPtr Texture::CreateFromImage(const Image* image,
+    bool sRGB, bool generateMipmap) {
+    std::vector<const Image*> levels = { image };
+    std::vector<ImageUPtr> mipLevels;
+    if (generateMipmap) {
+        MipChainOption option;
+        option.sRGB = sRGB;
+        mipLevels = image->GenerateMipChain(option);
+        for (auto& level: mipLevels)
+            levels.push_back(level.get());
+    }
     auto texture = TextureUPtr(new Texture());
     texture->CreateTexture();
-    texture->SetTextureFromImage(image);
+    texture->SetTextureFromImages(levels, sRGB);
+    return std::move(texture);
+}
+
+TextureUPtr Texture::CreateFromMipChain(const std::vector<ImageUPtr>& levels, bool sRGB) {
+    if (levels.empty() || !levels[0]) {
+        SPDLOG_ERROR("empty mip chain");
+        return nullptr;
+    }
+    std::vector<const Image*> images;
+    for (auto& level: levels)
+        images.push_back(level.get());
+    auto texture = TextureUPtr(new Texture());
+    texture->CreateTexture();
+    texture->SetTextureFromImages(images, sRGB);
+    return std::move(texture);
+}
+
+TextureUPtr Texture::CreateFromCompressedImage(const CompressedImage* image) {
+    auto texture = TextureUPtr(new Texture());
+    texture->CreateTexture();
+    if (!texture->SetTextureFromCompressedImage(image))
+        return nullptr;
     return std::move(texture);
 }
 
 Texture::~Texture() {
     if (m_texture) {
         glDeleteTextures(1, &m_texture);
+        RenderState::Get()->OnTextureDeleted(m_texture);
     }
 }
 
 void Texture::Bind() const {
-    glBindTexture(GL_TEXTURE_2D, m_texture);
+    RenderState::Get()->BindTexture(GL_TEXTURE_2D, m_texture);
 }
 
 void Texture::SetFilter(uint32_t minFilter, uint32_t magFilter) const {
@@ -46,7 +80,8 @@ static GLenum GetImageFormat(uint32_t internalFormat) {
 	}
 	else if (internalFormat == GL_RGB ||
 	    internalFormat == GL_RGB16F ||
-	    internalFormat == GL_RGB32F) {
+	    internalFormat == GL_RGB32F ||
+	    internalFormat == GL_RGB9_E5) {
 	    imageFormat = GL_RGB;
 	}
 	else if (internalFormat == GL_RG ||
@@ -63,6 +98,47 @@ static GLenum GetImageFormat(uint32_t internalFormat) {
 	return imageFormat;
 }
 
+size_t GetPixelSize(uint32_t internalFormat, uint32_t type) {
+	size_t channelCount = 4;
+	switch (GetImageFormat(internalFormat)) {
+		default: break;
+		case GL_DEPTH_COMPONENT:
+		case GL_RED: channelCount = 1; break;
+		case GL_RG: channelCount = 2; break;
+		case GL_RGB: channelCount = 3; break;
+	}
+	size_t bytePerChannel = 1;
+	switch (type) {
+		default: break;
+		case GL_HALF_FLOAT: bytePerChannel = 2; break;
+		case GL_FLOAT: bytePerChannel = 4; break;
+		// 세 channel 이 32bit 하나에 들어 있다
+		case GL_UNSIGNED_INT_5_9_9_9_REV: return 4;
+	}
+	return channelCount * bytePerChannel;
+}
+
+std::vector<uint8_t> Texture::GetData(int mipLevel, uint32_t type) const {
+	int width = std::max(m_width >> mipLevel, 1);
+	int height = std::max(m_height >> mipLevel, 1);
+	std::vector<uint8_t> data(GetPixelSize(m_format, type) * width * height);
+	Bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, mipLevel, GetImageFormat(m_format), type, data.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	return data;
+}
+
+void Texture::SetData(int mipLevel, uint32_t type, const void* data) const {
+	int width = std::max(m_width >> mipLevel, 1);
+	int height = std::max(m_height >> mipLevel, 1);
+	Bind();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, mipLevel, m_format, width, height, 0,
+		GetImageFormat(m_format), type, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 void Texture::SetTextureFormat(int width, int height, uint32_t format, uint32_t type) {
     m_width = width;
     m_height = height;
@@ -86,36 +162,120 @@ void Texture::CreateTexture() {
     SetWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
 }
 
-void Texture::SetTextureFromImage(const Image* image) {
-    GLenum format = GL_RGBA;
+ImageTextureFormat GetImageTextureFormat(const Image* image, bool sRGB) {
+    ImageTextureFormat result;
     switch (image->GetChannelCount()) {
         default: break;
-        case 1: format = GL_RED; break;
-        case 2: format = GL_RG; break;
-        case 3: format = GL_RGB; break;
+        case 1: result.format = GL_RED; break;
+        case 2: result.format = GL_RG; break;
+        case 3: result.format = GL_RGB; break;
     }
-    
-    m_width = image->GetWidth();
-    m_height = image->GetHeight();
-    m_format = format;
-    m_type = GL_UNSIGNED_BYTE;
-    if (image->GetBytePerChannel() == 4) {
-	    m_type = GL_FLOAT;
+    result.internalFormat = result.format;
+    auto pixelType = image->GetPixelType();
+    if (sRGB && pixelType == PixelType::UInt8) {
+        if (image->GetChannelCount() == 3)
+            result.internalFormat = GL_SRGB8;
+        else if (image->GetChannelCount() == 4)
+            result.internalFormat = GL_SRGB8_ALPHA8;
+    }
+    if (pixelType == PixelType::Float || pixelType == PixelType::Half) {
+	    // half 이미지는 GPU 에서 변환하지 않고 그대로 올라간다
+	    result.type = pixelType == PixelType::Float ? GL_FLOAT : GL_HALF_FLOAT;
 	    switch (image->GetChannelCount()) {
 			default: break;
-			case 1: m_format = GL_R16F; break;
-			case 2: m_format = GL_RG16F; break;
-			case 3: m_format = GL_RGB16F; break;
-			case 4: m_format = GL_RGBA16F; break;
+			case 1: result.internalFormat = GL_R16F; break;
+			case 2: result.internalFormat = GL_RG16F; break;
+			case 3: result.internalFormat = GL_RGB16F; break;
+			case 4: result.internalFormat = GL_RGBA16F; break;
 	    }
 	}
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, m_format,
-        m_width, m_height, 0,
-        format, m_type,
-        image->GetData());
+    else if (pixelType == PixelType::RGB9E5) {
+        result.type = GL_UNSIGNED_INT_5_9_9_9_REV;
+        result.internalFormat = GL_RGB9_E5;
+    }
+    return result;
+}
+
+void Texture::Swap(Texture& other) {
+    std::swap(m_texture, other.m_texture);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_format, other.m_format);
+    std::swap(m_type, other.m_type);
+}
+
+void Texture::SetTextureFromImages(const std::vector<const Image*>& levels, bool sRGB) {
+    auto image = levels[0];
+    auto textureFormat = GetImageTextureFormat(image, sRGB);
+    GLenum format = textureFormat.format;
+    m_width = image->GetWidth();
+    m_height = image->GetHeight();
+    m_format = textureFormat.internalFormat;
+    m_type = textureFormat.type;
+
+    // mip level 은 너비가 홀수가 되기 쉬워서 행 정렬을 끈다
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < levels.size(); level++) {
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level, m_format,
+            levels[level]->GetWidth(), levels[level]->GetHeight(), 0,
+            format, m_type,
+            levels[level]->GetData());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    if (levels.size() == 1 && (m_width > 1 || m_height > 1))
+        SetFilter(GL_LINEAR, GL_LINEAR);
+}
+
+// S3TC / BPTC 는 GL 3.3 core 가 아니라 glad 헤더에 없을 수 있다
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#endif
+
+uint32_t GetCompressedTextureFormat(BlockFormat format, bool sRGB) {
+    switch (format) {
+        case BlockFormat::BC1:
+            return sRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3:
+            return sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+        case BlockFormat::BC6H: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+    }
+    return 0;
+}
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+bool Texture::SetTextureFromCompressedImage(const CompressedImage* image) {
+    m_width = image->GetWidth();
+    m_height = image->GetHeight();
+    m_format = GetCompressedTextureFormat(image->GetFormat(), image->IsSRGB());
+    m_type = GL_UNSIGNED_BYTE;
+
+    // 확장이 없는 driver 는 GL_INVALID_ENUM 을 내므로 업로드 결과로 지원 여부를 판단한다
+    while (glGetError() != GL_NO_ERROR) {}
+    for (int level = 0; level < image->GetLevelCount(); level++) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, m_format,
+            image->GetWidth(level), image->GetHeight(level), 0,
+            (GLsizei)image->GetLevelSize(level), image->GetData(level));
+    }
+    if (glGetError() != GL_NO_ERROR) {
+        SPDLOG_ERROR("failed to upload {} texture, not supported by driver?",
+            GetBlockFormatName(image->GetFormat()));
+        return false;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image->GetLevelCount() - 1);
+    if (image->GetLevelCount() == 1)
+        SetFilter(GL_LINEAR, GL_LINEAR);
+    return true;
 }
 
 CubeTextureUPtr CubeTexture::CreateFromImages(const std::vector<Image*>& images) {
@@ -134,11 +294,12 @@ CubeTextureUPtr CubeTexture::Create(int width, int height, uint32_t format, uint
 CubeTexture::~CubeTexture() {
 	if (m_texture) {
 	    glDeleteTextures(1, &m_texture);
+	    RenderState::Get()->OnTextureDeleted(m_texture);
   }
 }
 
 void CubeTexture::Bind() const {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture);    
+	RenderState::Get()->BindTexture(GL_TEXTURE_CUBE_MAP, m_texture);
 }
 
 bool CubeTexture::InitFromImages(const std::vector<Image*>& images) {
@@ -153,18 +314,13 @@ bool CubeTexture::InitFromImages(const std::vector<Image*>& images) {
 
 	m_width = images[0]->GetWidth();
 	m_height = images[0]->GetHeight();
-	m_type = images[0]->GetBytePerChannel() == 4 ? GL_FLOAT : GL_UNSIGNED_BYTE;
-	m_format = images[0]->GetBytePerChannel() == 4 ? GL_RGB16F : GL_RGB;
+	auto textureFormat = GetImageTextureFormat(images[0], false);
+	m_type = textureFormat.type;
+	m_format = images[0]->GetPixelType() == PixelType::UInt8 ? GL_RGB : textureFormat.internalFormat;
 
 	for (uint32_t i = 0; i < (uint32_t)images.size(); i++) {
 	    auto image = images[i];
-	    GLenum format = GL_RGBA;
-	    switch (image->GetChannelCount()) {
-	        default: break;
-	        case 1: format = GL_RED; break;
-	        case 2: format = GL_RG; break;
-	        case 3: format = GL_RGB; break;
-	    }
+	    GLenum format = GetImageTextureFormat(image, false).format;
 		
 	    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, m_format,
 			m_width, m_height, 0,
@@ -202,4 +358,76 @@ void CubeTexture::GenerateMipmap() const {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-}
\ No newline at end of file
+}
+
+void CubeTexture::SetMipLevelCount(int mipLevelCount) const {
+	Bind();
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipLevelCount - 1);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+		mipLevelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+}
+
+std::vector<uint8_t> CubeTexture::GetFaceData(int face, int mipLevel, uint32_t type) const {
+	int width = std::max(m_width >> mipLevel, 1);
+	int height = std::max(m_height >> mipLevel, 1);
+	std::vector<uint8_t> data(GetPixelSize(m_format, type) * width * height);
+	Bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mipLevel,
+		GetImageFormat(m_format), type, data.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	return data;
+}
+
+void CubeTexture::SetFaceData(int face, int mipLevel, uint32_t type, const void* data) const {
+	int width = std::max(m_width >> mipLevel, 1);
+	int height = std::max(m_height >> mipLevel, 1);
+	Bind();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mipLevel, m_format,
+		width, height, 0, GetImageFormat(m_format), type, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+BufferTextureUPtr BufferTexture::Create(uint32_t format) {
+    auto texture = BufferTextureUPtr(new BufferTexture());
+    texture->Init(format);
+    return std::move(texture);
+}
+
+BufferTexture::~BufferTexture() {
+    if (m_texture) {
+        glDeleteTextures(1, &m_texture);
+        RenderState::Get()->OnTextureDeleted(m_texture);
+    }
+    if (m_buffer)
+        glDeleteBuffers(1, &m_buffer);
+}
+
+void BufferTexture::Bind() const {
+    RenderState::Get()->BindTexture(GL_TEXTURE_BUFFER, m_texture);
+}
+
+void BufferTexture::Init(uint32_t format) {
+    m_format = format;
+    glGenTextures(1, &m_texture);
+    glGenBuffers(1, &m_buffer);
+}
+
+void BufferTexture::SetData(const void* data, size_t size) {
+    // 빈 buffer 를 붙이면 texelFetch 결과가 정의되지 않으므로 최소 크기는 잡아 둔다
+    size_t storageSize = std::max<size_t>(size, 16);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+    if (storageSize > m_capacity) {
+        m_capacity = std::max(storageSize, m_capacity * 3 / 2);
+        glBufferData(GL_TEXTURE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+        Bind();
+        glTexBuffer(GL_TEXTURE_BUFFER, m_format, m_buffer);
+    }
+    else {
+        // 이전 frame 이 아직 읽고 있을 수 있으므로 orphaning 후 다시 채운다
+        glBufferData(GL_TEXTURE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+    }
+    if (data && size > 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
@@ -3,11 +3,33 @@
 
 #include "image.h"
 
+// internal format / type 에 맞는 pixel 하나의 byte 수
+size_t GetPixelSize(uint32_t internalFormat, uint32_t type);
+
+// Image 를 그대로 올릴 때 쓰는 internal format, pixel format, type
+struct ImageTextureFormat {
+    uint32_t internalFormat { GL_RGBA };
+    uint32_t format { GL_RGBA };
+    uint32_t type { GL_UNSIGNED_BYTE };
+};
+ImageTextureFormat GetImageTextureFormat(const Image* image, bool sRGB);
+
+// block 압축 format 의 GL internal format
+uint32_t GetCompressedTextureFormat(BlockFormat format, bool sRGB);
+
 CLASS_PTR(Texture)
 class Texture {
 public:
     static TextureUPtr Create(int width, int height, uint32_t format, uint32_t type = GL_UNSIGNED_BYTE);
-    static TextureUPtr CreateFromImage(const Image* image);
+    // sRGB 이면 8bit 이미지를 GL_SRGB8(_ALPHA8) 로 올린다
+    // generateMipmap 이면 Image::GenerateMipChain (box filter) 으로 만든 level 을 같이 올린다
+    static TextureUPtr CreateFromImage(const Image* image,
+        bool sRGB = false, bool generateMipmap = true);
+    // levels[0] 이 원본, 나머지는 미리 만든 mip level (worker thread 에서 GenerateMipChain 등)
+    static TextureUPtr CreateFromMipChain(const std::vector<ImageUPtr>& levels, bool sRGB = false);
+    // 미리 만든 mip chain 을 glCompressedTexImage2D 로 그대로 올린다
+    // driver 가 format 을 지원하지 않으면 nullptr
+    static TextureUPtr CreateFromCompressedImage(const CompressedImage* image);
     ~Texture();
 
     const uint32_t Get() const { return m_texture; }
@@ -16,15 +38,24 @@ public:
     void SetWrap(uint32_t sWrap, uint32_t tWrap) const;
     void SetBorderColor(const glm::vec4& color) const;
 
+    // GPU 와 CPU 사이로 level 하나의 pixel data 를 옮긴다
+    std::vector<uint8_t> GetData(int mipLevel, uint32_t type) const;
+    void SetData(int mipLevel, uint32_t type, const void* data) const;
+
     int GetWidth() const { return m_width; }
     int GetHeight() const { return m_height; }
     uint32_t GetFormat() const { return m_format; }
     uint32_t GetType() const { return m_type; }
+
+    // GL 객체와 크기/format 을 맞바꾼다
+    // 다른 곳에서 들고 있는 TexturePtr 를 그대로 둔 채 내용을 교체할 때 쓴다
+    void Swap(Texture& other);
     
 private:
     Texture() {}
     void CreateTexture();
-    void SetTextureFromImage(const Image* image);
+    void SetTextureFromImages(const std::vector<const Image*>& levels, bool sRGB);
+    bool SetTextureFromCompressedImage(const CompressedImage* image);
     void SetTextureFormat(int width, int height, uint32_t format, uint32_t type);
 
     uint32_t m_texture { 0 };
@@ -50,6 +81,10 @@ public:
 	uint32_t GetType() const { return m_type; }
 
     void GenerateMipmap() const;
+    void SetMipLevelCount(int mipLevelCount) const;
+
+    std::vector<uint8_t> GetFaceData(int face, int mipLevel, uint32_t type) const;
+    void SetFaceData(int face, int mipLevel, uint32_t type, const void* data) const;
  
 private:
 	CubeTexture() {}
@@ -63,4 +98,30 @@ private:
 	uint32_t m_type { GL_UNSIGNED_BYTE };
 };
 
+// GL_TEXTURE_BUFFER 로 shader 에서 texelFetch 하는 1차원 데이터
+// 크기가 매 frame 바뀌는 데이터를 위해 필요할 때만 storage 를 키운다
+CLASS_PTR(BufferTexture)
+class BufferTexture {
+public:
+    // format 은 GL_RGBA32F, GL_R32UI 같은 sized internal format
+    static BufferTextureUPtr Create(uint32_t format);
+    ~BufferTexture();
+
+    const uint32_t Get() const { return m_texture; }
+    void Bind() const;
+    void SetData(const void* data, size_t size);
+
+    uint32_t GetFormat() const { return m_format; }
+    size_t GetCapacity() const { return m_capacity; }
+
+private:
+    BufferTexture() {}
+    void Init(uint32_t format);
+
+    uint32_t m_texture { 0 };
+    uint32_t m_buffer { 0 };
+    uint32_t m_format { GL_RGBA32F };
+    size_t m_capacity { 0 };
+};
+
 #endif // __TEXTURE_H__
\ No newline at end of file
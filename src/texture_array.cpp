@@ -0,0 +1,202 @@
+#include "texture_array.h"
+#include "render_state.h"
+#include <map>
+#include <tuple>
+
+TextureArrayUPtr TextureArray::Create(int width, int height, int layerCount, int levelCount,
+    const ImageTextureFormat& format) {
+    if (width <= 0 || height <= 0 || layerCount <= 0 || levelCount <= 0) {
+        SPDLOG_ERROR("invalid texture array: {}x{}, {} layers, {} levels",
+            width, height, layerCount, levelCount);
+        return nullptr;
+    }
+    auto textureArray = TextureArrayUPtr(new TextureArray());
+    textureArray->Init(width, height, layerCount, levelCount, format);
+    return std::move(textureArray);
+}
+
+TextureArray::~TextureArray() {
+    if (m_texture) {
+        glDeleteTextures(1, &m_texture);
+        RenderState::Get()->OnTextureDeleted(m_texture);
+    }
+}
+
+void TextureArray::Bind() const {
+    RenderState::Get()->BindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+}
+
+void TextureArray::Init(int width, int height, int layerCount, int levelCount,
+    const ImageTextureFormat& format) {
+    m_width = width;
+    m_height = height;
+    m_layerCount = layerCount;
+    m_levelCount = levelCount;
+    m_format = format;
+
+    glGenTextures(1, &m_texture);
+    Bind();
+    for (int level = 0; level < levelCount; level++) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format.internalFormat,
+            std::max(width >> level, 1), std::max(height >> level, 1), layerCount, 0,
+            format.format, format.type, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+        levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+bool TextureArray::SetLayer(int layer, const std::vector<const Image*>& levels) {
+    if (layer < 0 || layer >= m_layerCount || levels.size() > (size_t)m_levelCount) {
+        SPDLOG_ERROR("texture array layer {} out of range ({} layers, {} levels)",
+            layer, m_layerCount, m_levelCount);
+        return false;
+    }
+    for (size_t level = 0; level < levels.size(); level++) {
+        if (levels[level]->GetWidth() != std::max(m_width >> level, 1) ||
+            levels[level]->GetHeight() != std::max(m_height >> level, 1)) {
+            SPDLOG_ERROR("texture array level {} size mismatch: {}x{}", level,
+                levels[level]->GetWidth(), levels[level]->GetHeight());
+            return false;
+        }
+    }
+    Bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < levels.size(); level++) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, layer,
+            levels[level]->GetWidth(), levels[level]->GetHeight(), 1,
+            m_format.format, m_format.type, levels[level]->GetData());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return true;
+}
+
+TextureArrayManagerUPtr TextureArrayManager::Create(bool sRGB,
+    int atlasMaxSize, int atlasPageSize) {
+    auto manager = TextureArrayManagerUPtr(new TextureArrayManager());
+    manager->Init(sRGB, atlasMaxSize, atlasPageSize);
+    return std::move(manager);
+}
+
+void TextureArrayManager::Init(bool sRGB, int atlasMaxSize, int atlasPageSize) {
+    m_sRGB = sRGB;
+    m_atlasMaxSize = atlasMaxSize;
+    m_atlasPageSize = atlasPageSize;
+}
+
+uint32_t TextureArrayManager::Add(std::vector<ImageUPtr> levels) {
+    auto handle = (uint32_t)m_layers.size();
+    m_layers.push_back(TextureLayer());
+    m_pending.push_back(std::move(levels));
+    return handle;
+}
+
+bool TextureArrayManager::Build() {
+    // 한 layer 에 들어갈 mip chain 과 그 layer 를 쓰는 handle 들
+    struct LayerSource {
+        std::vector<const Image*> levels;
+        std::vector<std::pair<uint32_t, glm::vec4>> users;
+    };
+    // [width, height, level 수, internal format, format, type] 가 같으면 한 array 에 들어간다
+    using GroupKey = std::tuple<int, int, size_t, uint32_t, uint32_t, uint32_t>;
+    std::map<GroupKey, std::vector<LayerSource>> groups;
+    auto AddSource = [&](LayerSource source) {
+        auto image = source.levels[0];
+        auto format = GetImageTextureFormat(image, m_sRGB);
+        GroupKey key(image->GetWidth(), image->GetHeight(), source.levels.size(),
+            format.internalFormat, format.format, format.type);
+        groups[key].push_back(std::move(source));
+    };
+
+    // 작은 8bit 텍스처는 atlas 로 모은다
+    std::vector<const Image*> atlasImages;
+    std::vector<uint32_t> atlasHandles;
+    size_t textureCount = 0;
+    for (uint32_t handle = 0; handle < (uint32_t)m_pending.size(); handle++) {
+        auto& levels = m_pending[handle];
+        if (levels.empty() || !levels[0])
+            continue;
+        textureCount++;
+        auto image = levels[0].get();
+        if (image->GetPixelType() == PixelType::UInt8 &&
+            std::max(image->GetWidth(), image->GetHeight()) <= m_atlasMaxSize) {
+            atlasImages.push_back(image);
+            atlasHandles.push_back(handle);
+            continue;
+        }
+        LayerSource source;
+        for (auto& level: levels)
+            source.levels.push_back(level.get());
+        source.users.push_back({ handle, glm::vec4(1.0f, 1.0f, 0.0f, 0.0f) });
+        AddSource(std::move(source));
+    }
+
+    TextureAtlasUPtr atlas;
+    std::vector<std::vector<ImageUPtr>> pageMipLevels;
+    if (!atlasImages.empty()) {
+        atlas = TextureAtlas::Create(m_atlasPageSize);
+        std::vector<AtlasEntry> entries;
+        if (!atlas || !atlas->Pack(atlasImages, entries))
+            return false;
+        MipChainOption mipOption;
+        mipOption.sRGB = m_sRGB;
+        auto& pages = atlas->GetPages();
+        std::vector<LayerSource> pageSources(pages.size());
+        pageMipLevels.resize(pages.size());
+        for (size_t page = 0; page < pages.size(); page++) {
+            // padding 을 넘어서 줄인 level 은 이웃 이미지와 섞이므로 버린다
+            pageMipLevels[page] = pages[page]->GenerateMipChain(mipOption);
+            pageMipLevels[page].resize(std::min(pageMipLevels[page].size(),
+                (size_t)atlas->GetLevelCount() - 1));
+            pageSources[page].levels.push_back(pages[page].get());
+            for (auto& level: pageMipLevels[page])
+                pageSources[page].levels.push_back(level.get());
+        }
+        for (size_t i = 0; i < entries.size(); i++)
+            pageSources[entries[i].page].users.push_back({ atlasHandles[i], entries[i].scaleOffset });
+        for (auto& source: pageSources)
+            AddSource(std::move(source));
+        m_atlasPageCount += pages.size();
+    }
+
+    size_t arrayCount = m_arrays.size();
+    GLint maxLayerCount = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayerCount);
+    size_t layerCount = 0;
+    for (auto& [key, sources]: groups) {
+        // driver 한계를 넘으면 array 를 나눈다
+        for (size_t first = 0; first < sources.size(); first += (size_t)maxLayerCount) {
+            size_t count = std::min(sources.size() - first, (size_t)maxLayerCount);
+            auto image = sources[first].levels[0];
+            TextureArrayPtr textureArray = TextureArray::Create(image->GetWidth(), image->GetHeight(),
+                (int)count, (int)sources[first].levels.size(),
+                GetImageTextureFormat(image, m_sRGB));
+            if (!textureArray)
+                return false;
+            for (size_t i = 0; i < count; i++) {
+                auto& source = sources[first + i];
+                if (!textureArray->SetLayer((int)i, source.levels))
+                    return false;
+                for (auto& [handle, scaleOffset]: source.users) {
+                    auto& layer = m_layers[handle];
+                    layer.array = textureArray;
+                    layer.layer = (int)i;
+                    layer.scaleOffset = scaleOffset;
+                }
+            }
+            layerCount += count;
+            m_arrays.push_back(std::move(textureArray));
+        }
+    }
+
+    SPDLOG_INFO("texture arrays: {} textures -> {} arrays, {} layers ({} atlas pages, {:.0f}% used)",
+        textureCount, m_arrays.size() - arrayCount, layerCount,
+        atlas ? atlas->GetPages().size() : 0, atlas ? atlas->GetOccupancy() * 100.0f : 0.0f);
+    // handle 이 index 이므로 지우지 않고 비워 둔다. 다시 Build 하면 새로 Add 한 것만 올라간다
+    for (auto& levels: m_pending)
+        levels.clear();
+    return true;
+}
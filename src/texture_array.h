@@ -0,0 +1,86 @@
+#ifndef __TEXTURE_ARRAY_H__
+#define __TEXTURE_ARRAY_H__
+
+#include "texture.h"
+#include "texture_atlas.h"
+
+// layer 마다 크기 / format 이 같은 GL_TEXTURE_2D_ARRAY
+CLASS_PTR(TextureArray)
+class TextureArray {
+public:
+    // levelCount 개 mip level 의 storage 를 모든 layer 에 잡아 둔다
+    static TextureArrayUPtr Create(int width, int height, int layerCount, int levelCount,
+        const ImageTextureFormat& format);
+    ~TextureArray();
+
+    const uint32_t Get() const { return m_texture; }
+    void Bind() const;
+    // levels[i] 를 layer 의 mip level i 로 올린다. 크기가 맞지 않으면 false
+    bool SetLayer(int layer, const std::vector<const Image*>& levels);
+
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    int GetLayerCount() const { return m_layerCount; }
+    int GetLevelCount() const { return m_levelCount; }
+    const ImageTextureFormat& GetFormat() const { return m_format; }
+
+private:
+    TextureArray() {}
+    void Init(int width, int height, int layerCount, int levelCount,
+        const ImageTextureFormat& format);
+
+    uint32_t m_texture { 0 };
+    int m_width { 0 };
+    int m_height { 0 };
+    int m_layerCount { 0 };
+    int m_levelCount { 0 };
+    ImageTextureFormat m_format;
+};
+
+// material 이 참조하는 array 의 layer 하나
+// atlas 에 들어간 작은 텍스처는 scaleOffset 으로 page 안의 영역을 가리킨다
+// manager 가 먼저 사라져도 array 는 쓰는 material 이 있는 동안 남는다
+struct TextureLayer {
+    TextureArrayPtr array;
+    int layer { 0 };
+    glm::vec4 scaleOffset { 1.0f, 1.0f, 0.0f, 0.0f };
+
+    bool IsValid() const { return array != nullptr; }
+};
+
+// 크기 / format / mip level 수가 같은 텍스처를 GL_TEXTURE_2D_ARRAY 하나의 layer 로 묶는다
+// atlasMaxSize 이하의 8bit 텍스처는 TextureAtlas 로 page 에 모은 뒤 page 를 layer 로 올린다
+// 같은 array 를 쓰는 mesh 는 텍스처를 다시 bind 하지 않고 layer / scaleOffset uniform 만 바꿔서 그린다
+// Add 로 이미지를 모두 모은 뒤 Build 를 한 번 부른다 (GL context thread)
+CLASS_PTR(TextureArrayManager)
+class TextureArrayManager {
+public:
+    // atlasMaxSize 가 0 이면 atlas 를 쓰지 않는다
+    static TextureArrayManagerUPtr Create(bool sRGB = false,
+        int atlasMaxSize = 256, int atlasPageSize = 2048);
+
+    // levels[0] 이 원본, 나머지는 mip level. Build 할 때까지 이미지를 들고 있는다
+    // 돌려준 handle 로 Build 뒤에 GetLayer 를 부른다
+    uint32_t Add(std::vector<ImageUPtr> levels);
+    // 모은 이미지를 array 로 올리고 CPU 쪽 이미지를 해제한다
+    bool Build();
+
+    const TextureLayer& GetLayer(uint32_t handle) const { return m_layers[handle]; }
+    size_t GetArrayCount() const { return m_arrays.size(); }
+    TextureArrayPtr GetArray(size_t index) const { return m_arrays[index]; }
+    size_t GetAtlasPageCount() const { return m_atlasPageCount; }
+
+private:
+    TextureArrayManager() {}
+    void Init(bool sRGB, int atlasMaxSize, int atlasPageSize);
+
+    bool m_sRGB { false };
+    int m_atlasMaxSize { 0 };
+    int m_atlasPageSize { 0 };
+    std::vector<std::vector<ImageUPtr>> m_pending;
+    std::vector<TextureLayer> m_layers;
+    std::vector<TextureArrayPtr> m_arrays;
+    size_t m_atlasPageCount { 0 };
+};
+
+#endif // __TEXTURE_ARRAY_H__
@@ -0,0 +1,257 @@
+#include "texture_atlas.h"
+#include <cstring>
+#include <random>
+
+// imgui 는 stb_rect_pack 을 static 으로 넣으므로 여기서 따로 구현을 만든다
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imstb_rectpack.h>
+
+TextureAtlasUPtr TextureAtlas::Create(int pageSize, int padding) {
+    auto atlas = TextureAtlasUPtr(new TextureAtlas());
+    if (!atlas->Init(pageSize, padding))
+        return nullptr;
+    return std::move(atlas);
+}
+
+bool TextureAtlas::Init(int pageSize, int padding) {
+    // stb_rect_pack 의 좌표는 unsigned short
+    if (pageSize <= 0 || pageSize > 0xffff || padding < 0) {
+        SPDLOG_ERROR("invalid texture atlas size: {} (padding {})", pageSize, padding);
+        return false;
+    }
+    m_pageSize = pageSize;
+    m_padding = padding;
+    // 위치와 크기를 alignment 의 배수로 맞추면 level (levelCount - 1) 까지
+    // 한 texel 이 두 이미지에 걸치지 않는다
+    m_alignment = 1;
+    m_levelCount = 1;
+    while (m_alignment * 2 <= padding) {
+        m_alignment *= 2;
+        m_levelCount++;
+    }
+    return true;
+}
+
+// (x, y) 에 padding 을 포함한 width x height 영역을 채운다. padding 은 반대쪽 가장자리로 감싼다
+static void CopyToPage(const Image* image, Image* page, int x, int y,
+    int width, int height, int padding) {
+    int srcWidth = image->GetWidth();
+    int srcHeight = image->GetHeight();
+    int channelCount = image->GetChannelCount();
+    const uint8_t* src = image->GetData();
+    for (int row = 0; row < height; row++) {
+        int srcY = ((row - padding) % srcHeight + srcHeight) % srcHeight;
+        const uint8_t* srcRow = src + (size_t)srcY * srcWidth * channelCount;
+        uint8_t* dst = page->GetData() + ((size_t)(y + row) * page->GetWidth() + x) * 4;
+        for (int column = 0; column < width; column++, dst += 4) {
+            int srcX = ((column - padding) % srcWidth + srcWidth) % srcWidth;
+            const uint8_t* pixel = srcRow + (size_t)srcX * channelCount;
+            // GL_RED / GL_RG / GL_RGB 로 올렸을 때와 같은 값이 나오게 채운다
+            switch (channelCount) {
+                case 1: dst[0] = pixel[0]; dst[1] = 0; dst[2] = 0; dst[3] = 255; break;
+                case 2: dst[0] = pixel[0]; dst[1] = pixel[1]; dst[2] = 0; dst[3] = 255; break;
+                case 3: dst[0] = pixel[0]; dst[1] = pixel[1]; dst[2] = pixel[2]; dst[3] = 255; break;
+                default: memcpy(dst, pixel, 4); break;
+            }
+        }
+    }
+}
+
+bool TextureAtlas::Pack(const std::vector<const Image*>& images, std::vector<AtlasEntry>& entries) {
+    auto AlignSize = [this](int size) {
+        return (size + 2 * m_padding + m_alignment - 1) / m_alignment * m_alignment;
+    };
+    std::vector<stbrp_rect> pending;
+    pending.reserve(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        auto image = images[i];
+        if (!image || image->GetPixelType() != PixelType::UInt8) {
+            SPDLOG_ERROR("texture atlas only accepts 8bit images");
+            return false;
+        }
+        stbrp_rect rect = {};
+        rect.id = (int)i;
+        rect.w = (stbrp_coord)AlignSize(image->GetWidth());
+        rect.h = (stbrp_coord)AlignSize(image->GetHeight());
+        if (AlignSize(image->GetWidth()) > m_pageSize || AlignSize(image->GetHeight()) > m_pageSize) {
+            SPDLOG_ERROR("image {}x{} does not fit in {} atlas page",
+                image->GetWidth(), image->GetHeight(), m_pageSize);
+            return false;
+        }
+        pending.push_back(rect);
+    }
+
+    entries.assign(images.size(), AtlasEntry());
+    std::vector<stbrp_node> nodes(m_pageSize);
+    float invPageSize = 1.0f / (float)m_pageSize;
+    while (!pending.empty()) {
+        stbrp_context context;
+        stbrp_init_target(&context, m_pageSize, m_pageSize, nodes.data(), (int)nodes.size());
+        stbrp_pack_rects(&context, pending.data(), (int)pending.size());
+
+        auto page = Image::Create(m_pageSize, m_pageSize, 4);
+        if (!page)
+            return false;
+        memset(page->GetData(), 0, page->GetDataSize());
+        int pageIndex = (int)m_pages.size();
+        std::vector<stbrp_rect> remain;
+        for (auto& rect: pending) {
+            if (!rect.was_packed) {
+                remain.push_back(rect);
+                continue;
+            }
+            auto image = images[rect.id];
+            CopyToPage(image, page.get(), rect.x, rect.y, rect.w, rect.h, m_padding);
+            auto& entry = entries[rect.id];
+            entry.page = pageIndex;
+            entry.x = rect.x + m_padding;
+            entry.y = rect.y + m_padding;
+            entry.width = image->GetWidth();
+            entry.height = image->GetHeight();
+            entry.scaleOffset = glm::vec4(
+                entry.width * invPageSize, entry.height * invPageSize,
+                entry.x * invPageSize, entry.y * invPageSize);
+            m_usedArea += (size_t)entry.width * entry.height;
+        }
+        // 크기는 미리 확인했으므로 빈 page 에는 최소 하나가 들어간다
+        if (remain.size() == pending.size()) {
+            SPDLOG_ERROR("failed to pack texture atlas");
+            return false;
+        }
+        m_pages.push_back(std::move(page));
+        pending = std::move(remain);
+    }
+    return true;
+}
+
+float TextureAtlas::GetOccupancy() const {
+    if (m_pages.empty())
+        return 0.0f;
+    return (float)m_usedArea / ((float)m_pageSize * m_pageSize * m_pages.size());
+}
+
+bool RunTextureAtlasTest() {
+    bool success = true;
+    auto Check = [&](bool condition, const std::string& message) {
+        if (!condition) {
+            SPDLOG_ERROR("texture atlas test failed: {}", message);
+            success = false;
+        }
+    };
+
+    // 1. 크기 / channel 수가 제각각인 이미지 300 개를 작은 page 여러 장에 나눠 담는다
+    const int pageSize = 512;
+    const int padding = 4;
+    std::mt19937 random(7);
+    std::vector<ImageUPtr> images;
+    for (int i = 0; i < 300; i++) {
+        int width = std::uniform_int_distribution<int>(1, 96)(random);
+        int height = std::uniform_int_distribution<int>(1, 96)(random);
+        int channelCount = std::uniform_int_distribution<int>(1, 4)(random);
+        auto image = Image::Create(width, height, channelCount);
+        if (!image)
+            return false;
+        for (size_t j = 0; j < image->GetDataSize(); j++)
+            image->GetData()[j] = (uint8_t)random();
+        images.push_back(std::move(image));
+    }
+    std::vector<const Image*> imagePointers;
+    for (auto& image: images)
+        imagePointers.push_back(image.get());
+
+    auto atlas = TextureAtlas::Create(pageSize, padding);
+    std::vector<AtlasEntry> entries;
+    if (!atlas || !atlas->Pack(imagePointers, entries)) {
+        SPDLOG_ERROR("texture atlas test failed: pack");
+        return false;
+    }
+    auto& pages = atlas->GetPages();
+    int alignment = 1 << (atlas->GetLevelCount() - 1);
+    Check(atlas->GetLevelCount() == 3, fmt::format("{} levels for padding {}", atlas->GetLevelCount(), padding));
+    Check(entries.size() == images.size(), "entry count");
+
+    // padding 까지 포함해서 alignment 에 맞춘 영역
+    struct Rect {
+        int x0, y0, x1, y1;
+    };
+    std::vector<Rect> rects(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        auto& entry = entries[i];
+        auto image = images[i].get();
+        if (entry.page < 0 || entry.page >= (int)pages.size()) {
+            Check(false, fmt::format("image {} has page {}", i, entry.page));
+            continue;
+        }
+        auto& rect = rects[i];
+        rect.x0 = entry.x - padding;
+        rect.y0 = entry.y - padding;
+        rect.x1 = entry.x + entry.width + padding;
+        rect.y1 = entry.y + entry.height + padding;
+        Check(entry.width == image->GetWidth() && entry.height == image->GetHeight(),
+            fmt::format("image {} size {}x{} != {}x{}", i, entry.width, entry.height,
+                image->GetWidth(), image->GetHeight()));
+        Check(rect.x0 >= 0 && rect.y0 >= 0 && rect.x1 <= pageSize && rect.y1 <= pageSize,
+            fmt::format("image {} outside page", i));
+        // mip level 2 까지 한 texel 이 두 이미지에 걸치지 않으려면 시작이 alignment 의 배수여야 한다
+        Check(rect.x0 % alignment == 0 && rect.y0 % alignment == 0,
+            fmt::format("image {} at ({}, {}) not aligned to {}", i, rect.x0, rect.y0, alignment));
+
+        // uv (0, 0) ~ (1, 1) 이 page 안의 이미지 영역으로 가야 한다
+        glm::vec4 expected(entry.width / (float)pageSize, entry.height / (float)pageSize,
+            entry.x / (float)pageSize, entry.y / (float)pageSize);
+        Check(glm::length(entry.scaleOffset - expected) < 1e-6f,
+            fmt::format("image {} scaleOffset ({}, {}, {}, {})", i, entry.scaleOffset.x,
+                entry.scaleOffset.y, entry.scaleOffset.z, entry.scaleOffset.w));
+
+        // 안쪽과 padding 모두 반대쪽 가장자리로 감싼 원본 pixel 이어야 하고
+        // channel 이 모자라면 GL_RED / GL_RG / GL_RGB 로 올린 것처럼 0, 0, 255 로 채운다
+        auto page = pages[entry.page].get();
+        int channelCount = image->GetChannelCount();
+        size_t wrongCount = 0;
+        for (int y = rect.y0; y < rect.y1; y++) {
+            int srcY = ((y - entry.y) % entry.height + entry.height) % entry.height;
+            for (int x = rect.x0; x < rect.x1; x++) {
+                int srcX = ((x - entry.x) % entry.width + entry.width) % entry.width;
+                const uint8_t* src = image->GetData() + ((size_t)srcY * entry.width + srcX) * channelCount;
+                const uint8_t* dst = page->GetData() + ((size_t)y * pageSize + x) * 4;
+                uint8_t expectedPixel[4] = { 0, 0, 0, 255 };
+                for (int c = 0; c < channelCount; c++)
+                    expectedPixel[c] = src[c];
+                if (memcmp(dst, expectedPixel, 4) != 0)
+                    wrongCount++;
+            }
+        }
+        Check(wrongCount == 0, fmt::format("image {} ({} channels) has {} wrong pixels",
+            i, channelCount, wrongCount));
+    }
+
+    // padding 을 포함한 영역끼리도 겹치면 안 된다
+    size_t overlapCount = 0;
+    for (size_t i = 0; i < rects.size(); i++) {
+        for (size_t j = i + 1; j < rects.size(); j++) {
+            if (entries[i].page != entries[j].page)
+                continue;
+            auto& a = rects[i];
+            auto& b = rects[j];
+            if (a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1)
+                overlapCount++;
+        }
+    }
+    Check(overlapCount == 0, fmt::format("{} overlapping rects", overlapCount));
+    SPDLOG_INFO("texture atlas: {} images in {} pages of {}, {:.0f}% used",
+        images.size(), pages.size(), pageSize, atlas->GetOccupancy() * 100.0f);
+
+    // 2. page 에 들어가지 않는 이미지와 8bit 가 아닌 이미지는 거절한다
+    auto largeImage = Image::Create(pageSize - 2 * padding + 1, 8, 4);
+    auto floatImage = Image::Create(8, 8, 3, 4);
+    auto rejectAtlas = TextureAtlas::Create(pageSize, padding);
+    std::vector<AtlasEntry> rejectEntries;
+    Check(!rejectAtlas->Pack({ largeImage.get() }, rejectEntries), "oversized image accepted");
+    Check(!rejectAtlas->Pack({ floatImage.get() }, rejectEntries), "float image accepted");
+    Check(rejectAtlas->GetPages().empty(), "rejected pack created a page");
+
+    if (success)
+        SPDLOG_INFO("texture atlas test passed");
+    return success;
+}
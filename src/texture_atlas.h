@@ -0,0 +1,57 @@
+#ifndef __TEXTURE_ATLAS_H__
+#define __TEXTURE_ATLAS_H__
+
+#include "image.h"
+
+// atlas 안에서 이미지 하나가 차지하는 영역
+// shader 에서 uv = fract(uv) * scaleOffset.xy + scaleOffset.zw 로 찾아간다
+struct AtlasEntry {
+    int page { -1 };
+    int x { 0 };
+    int y { 0 };
+    int width { 0 };
+    int height { 0 };
+    glm::vec4 scaleOffset { 1.0f, 1.0f, 0.0f, 0.0f };
+};
+
+// 작은 8bit 이미지를 stb_rect_pack (imgui 에 들어 있는 imstb_rectpack.h) 으로 RGBA8 page 에 모은다
+// 이미지 둘레에는 반대쪽 가장자리를 이어 붙인 padding 을 둬서 반복 (GL_REPEAT) 하는 uv 도
+// 경계에서 이웃 이미지가 섞이지 않는다
+// GL 을 쓰지 않으므로 worker thread 에서 불러도 된다
+CLASS_PTR(TextureAtlas)
+class TextureAtlas {
+public:
+    // padding 은 2 의 거듭제곱으로 내려서 mip level 수를 정한다 (4 이면 3 level)
+    static TextureAtlasUPtr Create(int pageSize = 2048, int padding = 4);
+
+    // images 를 packing 해서 새 page 에 복사하고 entries[i] 에 위치를 채운다
+    // 한 page 에 들어가지 않는 나머지는 다음 page 로 넘긴다
+    // 8bit 가 아니거나 padding 을 더해서 page 보다 큰 이미지가 있으면 false
+    // packing 효율을 위해 이미지를 모두 모은 뒤 한 번에 부른다
+    bool Pack(const std::vector<const Image*>& images, std::vector<AtlasEntry>& entries);
+
+    int GetPageSize() const { return m_pageSize; }
+    int GetPadding() const { return m_padding; }
+    // page 의 mip level 수. 그 이상 줄이면 이웃 이미지와 섞인다
+    int GetLevelCount() const { return m_levelCount; }
+    const std::vector<ImageUPtr>& GetPages() const { return m_pages; }
+    // padding 을 뺀 이미지가 page 면적에서 차지하는 비율
+    float GetOccupancy() const;
+
+private:
+    TextureAtlas() {}
+    bool Init(int pageSize, int padding);
+
+    int m_pageSize { 0 };
+    int m_padding { 0 };
+    int m_alignment { 1 };
+    int m_levelCount { 1 };
+    std::vector<ImageUPtr> m_pages;
+    size_t m_usedArea { 0 };
+};
+
+// 임의의 이미지를 packing 해서 겹침, alignment, 감싼 padding, channel 확장, scaleOffset 과
+// 너무 큰 / 8bit 가 아닌 이미지의 거절을 검사한다. 모두 맞으면 true
+bool RunTextureAtlasTest();
+
+#endif // __TEXTURE_ATLAS_H__
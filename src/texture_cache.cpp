@@ -0,0 +1,112 @@
+#include "texture_cache.h"
+#include <filesystem>
+
+TextureCache* TextureCache::Get() {
+    static TextureCache textureCache;
+    return &textureCache;
+}
+
+std::string TextureCache::MakeKey(const std::string& filepath,
+    const TextureLoadOption& option) {
+    // "./a/../b.png" 와 "b.png" 가 같은 항목이 되도록 정규화한다
+    std::error_code error;
+    auto canonicalPath = std::filesystem::weakly_canonical(filepath, error);
+    auto path = error ? filepath : canonicalPath.generic_string();
+    static const char hdrFormatChars[] = { 'F', 'H', 'E' };
+    return fmt::format("{}|{}{}{}{}{}{}", path,
+        option.flipVertical ? 'f' : '-',
+        option.sRGB ? 's' : '-',
+        option.generateMipmap ? 'm' : '-',
+        option.mipFilter == MipFilter::Kaiser ? 'k' : 'b',
+        option.preserveAlphaCoverage ? 'a' : '-',
+        hdrFormatChars[(int)option.hdrFormat]);
+}
+
+TexturePtr TextureCache::Find(const std::string& filepath,
+    const TextureLoadOption& option) {
+    auto it = m_textures.find(MakeKey(filepath, option));
+    if (it != m_textures.end()) {
+        auto texture = it->second.lock();
+        if (texture) {
+            m_hitCount++;
+            return texture;
+        }
+    }
+    m_missCount++;
+    return nullptr;
+}
+
+void TextureCache::Insert(const std::string& filepath,
+    const TextureLoadOption& option, const TexturePtr& texture) {
+    m_textures[MakeKey(filepath, option)] = texture;
+}
+
+TexturePtr TextureCache::Load(const std::string& filepath,
+    const TextureLoadOption& option) {
+    auto texture = Find(filepath, option);
+    if (texture)
+        return texture;
+    return LoadMissing(filepath, option);
+}
+
+TexturePtr TextureCache::LoadMissing(const std::string& filepath,
+    const TextureLoadOption& option) {
+    TexturePtr texture;
+    // block 압축 .dds 는 --compress 로 미리 압축한 mip chain 을 그대로 쓴다 (flip / mipmap 옵션 무시)
+    auto ext = filepath.substr(filepath.find_last_of('.') + 1);
+    if ((ext == "dds" || ext == "DDS") && IsBlockCompressedDDS(filepath)) {
+        auto compressedImage = CompressedImage::LoadDDS(filepath);
+        if (!compressedImage)
+            return nullptr;
+        texture = Texture::CreateFromCompressedImage(compressedImage.get());
+    }
+    else {
+        auto levels = LoadImageLevels(filepath, option);
+        if (levels.empty())
+            return nullptr;
+        texture = Texture::CreateFromMipChain(levels, option.sRGB);
+    }
+    if (!texture)
+        return nullptr;
+    Insert(filepath, option, texture);
+    return texture;
+}
+
+size_t TextureCache::GetAliveCount() const {
+    size_t count = 0;
+    for (auto& [key, texture]: m_textures) {
+        if (!texture.expired())
+            count++;
+    }
+    return count;
+}
+
+void TextureCache::Purge() {
+    for (auto it = m_textures.begin(); it != m_textures.end(); ) {
+        if (it->second.expired())
+            it = m_textures.erase(it);
+        else
+            ++it;
+    }
+}
+
+std::vector<ImageUPtr> LoadImageLevels(const std::string& filepath,
+    const TextureLoadOption& option, ImageAllocator* allocator, ThreadPool* threadPool) {
+    std::vector<ImageUPtr> levels;
+    auto ext = filepath.substr(filepath.find_last_of('.') + 1);
+    if (ext == "dds" || ext == "DDS")
+        levels = Image::LoadDDS(filepath);
+    else if (ext == "hdr" || ext == "HDR")
+        levels.push_back(LoadRadianceHDR(filepath, option.hdrFormat, option.flipVertical, allocator));
+    else
+        levels.push_back(Image::Load(filepath, option.flipVertical, allocator));
+    if (levels.empty() || !levels[0]) {
+        levels.clear();
+        return levels;
+    }
+    if (option.generateMipmap && levels.size() == 1) {
+        for (auto& level: levels[0]->GenerateMipChain(option.GetMipChainOption(), threadPool))
+            levels.push_back(std::move(level));
+    }
+    return levels;
+}
@@ -0,0 +1,65 @@
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include "texture.h"
+#include "hdr_image.h"
+#include <unordered_map>
+
+struct TextureLoadOption {
+    bool flipVertical { true };
+    bool sRGB { false };
+    bool generateMipmap { true };
+    MipFilter mipFilter { MipFilter::Box };
+    // alpha test 용 텍스처는 mip level 에서도 alpha coverage 를 유지한다
+    bool preserveAlphaCoverage { false };
+    // .hdr 을 풀 pixel format. RGB9E5 는 half 보다 작지만 render target 으로 쓸 수 없다
+    HdrFormat hdrFormat { HdrFormat::Half };
+
+    MipChainOption GetMipChainOption() const {
+        MipChainOption option;
+        option.filter = mipFilter;
+        option.sRGB = sRGB;
+        option.preserveAlphaCoverage = preserveAlphaCoverage;
+        return option;
+    }
+};
+
+// 이미지를 읽고 option 에 따라 mip chain 을 만든다 ([0] 이 원본, 실패하면 비어 있다)
+// 압축하지 않은 .dds 는 map 한 그대로 쓰고, 파일에 mip level 이 있으면 새로 만들지 않는다
+// GL 을 쓰지 않으므로 worker thread 에서 불러도 된다
+// mip chain 은 threadPool (nullptr 이면 ThreadPool::GetDefault()) 에 나눠서 만든다
+std::vector<ImageUPtr> LoadImageLevels(const std::string& filepath,
+    const TextureLoadOption& option, ImageAllocator* allocator = nullptr,
+    ThreadPool* threadPool = nullptr);
+
+// 같은 파일 + 같은 옵션의 텍스처를 한 번만 만들고 공유한다
+// weak pointer 로 들고 있으므로 쓰는 곳이 모두 사라지면 텍스처도 해제된다
+// GL 텍스처를 만들기 때문에 GL context thread 에서만 사용한다
+class TextureCache {
+public:
+    static TextureCache* Get();
+
+    TexturePtr Find(const std::string& filepath, const TextureLoadOption& option = {});
+    void Insert(const std::string& filepath, const TextureLoadOption& option,
+        const TexturePtr& texture);
+    // cache 에 없으면 이미지를 읽어서 텍스처를 만든다
+    TexturePtr Load(const std::string& filepath, const TextureLoadOption& option = {});
+    // Find 로 없는 것을 이미 확인했을 때 쓴다. hit / miss 를 다시 세지 않고 읽어서 넣는다
+    TexturePtr LoadMissing(const std::string& filepath, const TextureLoadOption& option = {});
+
+    size_t GetHitCount() const { return m_hitCount; }
+    size_t GetMissCount() const { return m_missCount; }
+    size_t GetAliveCount() const;
+    // 이미 해제된 텍스처의 항목을 지운다
+    void Purge();
+
+private:
+    TextureCache() {}
+    static std::string MakeKey(const std::string& filepath, const TextureLoadOption& option);
+
+    std::unordered_map<std::string, TextureWPtr> m_textures;
+    size_t m_hitCount { 0 };
+    size_t m_missCount { 0 };
+};
+
+#endif // __TEXTURE_CACHE_H__
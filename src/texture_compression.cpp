@@ -0,0 +1,750 @@
+#include "texture_compression.h"
+#include "simd.h"
+#include <glm/gtc/packing.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// block 의 16 pixel 을 RGBA8 로 가져온다. 이미지 밖은 가장자리 pixel 을 반복한다
+// 1 channel 은 회색, 2 channel 은 (r, g, 0) 으로 채운다
+static void FetchBlockRGBA8(const Image* image, int blockX, int blockY, uint8_t* rgba) {
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+    int channelCount = image->GetChannelCount();
+    const uint8_t* data = image->GetData();
+    for (int y = 0; y < 4; y++) {
+        int py = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int px = std::min(blockX * 4 + x, width - 1);
+            const uint8_t* src = data + ((size_t)py * width + px) * channelCount;
+            uint8_t* dst = rgba + (y * 4 + x) * 4;
+            switch (channelCount) {
+                case 1: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 255; break;
+                case 2: dst[0] = src[0]; dst[1] = src[1]; dst[2] = 0; dst[3] = 255; break;
+                case 3: dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255; break;
+                default: memcpy(dst, src, 4); break;
+            }
+        }
+    }
+}
+
+static void FetchBlockFloat(const Image* image, int blockX, int blockY, float points[16][3]) {
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+    int channelCount = image->GetChannelCount();
+    auto data = (const float*)image->GetData();
+    for (int y = 0; y < 4; y++) {
+        int py = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int px = std::min(blockX * 4 + x, width - 1);
+            const float* src = data + ((size_t)py * width + px) * channelCount;
+            for (int c = 0; c < 3; c++)
+                points[y * 4 + x][c] = src[std::min(c, channelCount - 1)];
+        }
+    }
+}
+
+// 점들의 평균을 지나는 주축 위에서 가장 바깥쪽 두 점을 endpoint 로 잡는다
+static void ComputePrincipalEndpoints(const float points[16][3], float e0[3], float e1[3]) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += points[i][c];
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    // covariance: xx, xy, xz, yy, yz, zz
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float d[3] = { points[i][0] - mean[0], points[i][1] - mean[1], points[i][2] - mean[2] };
+        cov[0] += d[0] * d[0];
+        cov[1] += d[0] * d[1];
+        cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1];
+        cov[4] += d[1] * d[2];
+        cov[5] += d[2] * d[2];
+    }
+
+    // power iteration, 분산이 가장 큰 축에서 시작한다
+    float axis[3] = { cov[0], cov[3], cov[5] };
+    if (axis[0] >= axis[1] && axis[0] >= axis[2])
+        axis[0] = 1.0f, axis[1] = 0.0f, axis[2] = 0.0f;
+    else if (axis[1] >= axis[2])
+        axis[0] = 0.0f, axis[1] = 1.0f, axis[2] = 0.0f;
+    else
+        axis[0] = 0.0f, axis[1] = 0.0f, axis[2] = 1.0f;
+    for (int iter = 0; iter < 8; iter++) {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+        if (length < 1e-8f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    float minT = 0.0f;
+    float maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = (points[i][0] - mean[0]) * axis[0] + (points[i][1] - mean[1]) * axis[1] +
+            (points[i][2] - mean[2]) * axis[2];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < 3; c++) {
+        e0[c] = mean[c] + axis[c] * maxT / axisLength2;
+        e1[c] = mean[c] + axis[c] * minT / axisLength2;
+    }
+}
+
+// pixel 마다 정해진 e0 비율 weights 로 두 endpoint 를 least squares 로 다시 구한다
+static bool RefitEndpoints(const float points[16][3], const float weights[16],
+    float e0[3], float e1[3]) {
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[3] = { 0.0f, 0.0f, 0.0f };
+    float bx[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float a = weights[i];
+        float b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += a * points[i][c];
+            bx[c] += b * points[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < 3; c++) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+// ----- BC1 color block -----
+
+static uint16_t PackRGB565(const float color[3]) {
+    int r = glm::clamp((int)(color[0] * (31.0f / 255.0f) + 0.5f), 0, 31);
+    int g = glm::clamp((int)(color[1] * (63.0f / 255.0f) + 0.5f), 0, 63);
+    int b = glm::clamp((int)(color[2] * (31.0f / 255.0f) + 0.5f), 0, 31);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t color, int rgb[3]) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void BuildColorPalette(uint16_t c0, uint16_t c1, bool fourColor, int palette[4][3]) {
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (fourColor) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+// 16 pixel 을 가장 가까운 palette 색에 대응시키고 제곱 오차 합을 돌려준다
+static float FitColorIndices(const float points[16][3], const int palette[4][3],
+    uint32_t& indices) {
+    indices = 0;
+    float error = 0.0f;
+    int i = 0;
+#if USE_SSE
+    // pixel 4개씩 palette 4색과의 거리를 한 번에 비교한다
+    for (; i < 16; i += 4) {
+        __m128 r = _mm_setr_ps(points[i][0], points[i + 1][0], points[i + 2][0], points[i + 3][0]);
+        __m128 g = _mm_setr_ps(points[i][1], points[i + 1][1], points[i + 2][1], points[i + 3][1]);
+        __m128 b = _mm_setr_ps(points[i][2], points[i + 1][2], points[i + 2][2], points[i + 3][2]);
+        __m128 bestDistance = _mm_set1_ps(1e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int k = 0; k < 4; k++) {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps((float)palette[k][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps((float)palette[k][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps((float)palette[k][2]));
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                _mm_mul_ps(db, db));
+            __m128 closer = _mm_cmplt_ps(distance, bestDistance);
+            bestDistance = _mm_min_ps(distance, bestDistance);
+            __m128i mask = _mm_castps_si128(closer);
+            bestIndex = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(k)),
+                _mm_andnot_si128(mask, bestIndex));
+        }
+        alignas(16) int32_t index[4];
+        alignas(16) float distance[4];
+        _mm_store_si128((__m128i*)index, bestIndex);
+        _mm_store_ps(distance, bestDistance);
+        for (int j = 0; j < 4; j++) {
+            indices |= (uint32_t)index[j] << (2 * (i + j));
+            error += distance[j];
+        }
+    }
+#endif
+    for (; i < 16; i++) {
+        float bestDistance = 1e30f;
+        int bestIndex = 0;
+        for (int k = 0; k < 4; k++) {
+            float dr = points[i][0] - palette[k][0];
+            float dg = points[i][1] - palette[k][1];
+            float db = points[i][2] - palette[k][2];
+            float distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                bestIndex = k;
+            }
+        }
+        indices |= (uint32_t)bestIndex << (2 * i);
+        error += bestDistance;
+    }
+    return error;
+}
+
+// c0 > c1 인 4색 mode 로만 만든다 (BC3 의 color block 과 같은 규칙)
+static float EncodeColorEndpoints(const float points[16][3], const float e0[3], const float e1[3],
+    uint16_t& c0, uint16_t& c1, uint32_t& indices) {
+    c0 = PackRGB565(e0);
+    c1 = PackRGB565(e1);
+    if (c0 < c1)
+        std::swap(c0, c1);
+    int palette[4][3];
+    BuildColorPalette(c0, c1, true, palette);
+    if (c0 == c1) {
+        // 4색 mode 가 안 되므로 모두 c0 를 쓴다
+        indices = 0;
+        float error = 0.0f;
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                error += (points[i][c] - palette[0][c]) * (points[i][c] - palette[0][c]);
+        return error;
+    }
+    return FitColorIndices(points, palette, indices);
+}
+
+static void EncodeColorBlock(const uint8_t* rgba, bool highQuality, uint8_t* out) {
+    float points[16][3];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            points[i][c] = rgba[i * 4 + c];
+
+    float e0[3], e1[3];
+    ComputePrincipalEndpoints(points, e0, e1);
+    // 양 끝 pixel 보다 조금 안쪽으로 당겨서 평균 오차를 줄인다
+    for (int c = 0; c < 3; c++) {
+        float inset = (e0[c] - e1[c]) / 16.0f;
+        e0[c] = glm::clamp(e0[c] - inset, 0.0f, 255.0f);
+        e1[c] = glm::clamp(e1[c] + inset, 0.0f, 255.0f);
+    }
+
+    uint16_t c0, c1;
+    uint32_t indices;
+    float error = EncodeColorEndpoints(points, e0, e1, c0, c1, indices);
+    if (highQuality && error > 0.0f && c0 != c1) {
+        // index 0 -> c0, 1 -> c1, 2 -> 2/3 c0, 3 -> 1/3 c0
+        static const float COLOR_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = COLOR_WEIGHTS[(indices >> (2 * i)) & 3];
+        if (RefitEndpoints(points, weights, e0, e1)) {
+            uint16_t refitC0, refitC1;
+            uint32_t refitIndices;
+            float refitError = EncodeColorEndpoints(points, e0, e1, refitC0, refitC1, refitIndices);
+            if (refitError < error) {
+                c0 = refitC0;
+                c1 = refitC1;
+                indices = refitIndices;
+            }
+        }
+    }
+    out[0] = (uint8_t)(c0 & 0xff);
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)(c1 & 0xff);
+    out[3] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+static void DecodeColorBlock(const uint8_t* in, bool alwaysFourColor, uint8_t* rgba) {
+    uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+    uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+    uint32_t indices = (uint32_t)in[4] | ((uint32_t)in[5] << 8) |
+        ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+    bool fourColor = alwaysFourColor || c0 > c1;
+    int palette[4][3];
+    BuildColorPalette(c0, c1, fourColor, palette);
+    for (int i = 0; i < 16; i++) {
+        int index = (indices >> (2 * i)) & 3;
+        for (int c = 0; c < 3; c++)
+            rgba[i * 4 + c] = (uint8_t)palette[index][c];
+        rgba[i * 4 + 3] = (!fourColor && index == 3) ? 0 : 255;
+    }
+}
+
+// ----- BC4 single channel block (BC3 alpha, BC5 의 두 channel) -----
+
+static void BuildAlphaPalette(int a0, int a1, int palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+    }
+    else {
+        for (int i = 2; i < 6; i++)
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// values 는 stride 간격으로 16개
+static void EncodeAlphaBlock(const uint8_t* values, int stride, uint8_t* out) {
+    int minValue = 255;
+    int maxValue = 0;
+    for (int i = 0; i < 16; i++) {
+        minValue = std::min(minValue, (int)values[i * stride]);
+        maxValue = std::max(maxValue, (int)values[i * stride]);
+    }
+    out[0] = (uint8_t)maxValue;
+    out[1] = (uint8_t)minValue;
+    uint64_t indices = 0;
+    if (maxValue > minValue) {
+        int palette[8];
+        BuildAlphaPalette(maxValue, minValue, palette);
+        for (int i = 0; i < 16; i++) {
+            int value = values[i * stride];
+            int bestIndex = 0;
+            int bestDistance = 256;
+            for (int k = 0; k < 8; k++) {
+                int distance = std::abs(value - palette[k]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = k;
+                }
+            }
+            indices |= (uint64_t)bestIndex << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+static void DecodeAlphaBlock(const uint8_t* in, uint8_t* values, int stride) {
+    int palette[8];
+    BuildAlphaPalette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t)in[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        values[i * stride] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+// ----- BC6H (unsigned half float) -----
+// mode 11 하나만 쓴다: subset 1개, endpoint 10bit x 2, index 4bit
+// 부드러운 HDR 환경맵에서는 충분하고, 여러 partition 을 탐색하는 것보다 훨씬 빠르다
+
+static const int BC6H_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const int BC6H_MAX_HALF = 0x7bff;
+
+// 10bit endpoint -> 17bit 보간 공간
+static int UnquantizeBC6H(int value) {
+    if (value == 0)
+        return 0;
+    if (value == 1023)
+        return 0xffff;
+    return (value << 6) + 32;
+}
+
+// 보간 결과 -> half float bit
+static int FinishUnquantizeBC6H(int value) {
+    return (value * 31) >> 6;
+}
+
+// 위 두 단계를 거쳐 half 값 h 가 나오는 endpoint
+static int QuantizeBC6H(float half) {
+    return glm::clamp((int)std::floor((half - 15.5f) / 31.0f + 0.5f), 0, 1023);
+}
+
+static void BuildBC6HPalette(const int q0[3], const int q1[3], float palette[16][3]) {
+    for (int c = 0; c < 3; c++) {
+        int u0 = UnquantizeBC6H(q0[c]);
+        int u1 = UnquantizeBC6H(q1[c]);
+        for (int i = 0; i < 16; i++) {
+            int w = BC6H_WEIGHTS[i];
+            palette[i][c] = (float)FinishUnquantizeBC6H((u0 * (64 - w) + u1 * w + 32) >> 6);
+        }
+    }
+}
+
+static float EncodeBC6HEndpoints(const float points[16][3], const float e0[3], const float e1[3],
+    int q0[3], int q1[3], uint8_t indices[16]) {
+    for (int c = 0; c < 3; c++) {
+        q0[c] = QuantizeBC6H(e0[c]);
+        q1[c] = QuantizeBC6H(e1[c]);
+    }
+    float palette[16][3];
+    BuildBC6HPalette(q0, q1, palette);
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float bestDistance = 1e30f;
+        int bestIndex = 0;
+        for (int k = 0; k < 16; k++) {
+            float dr = points[i][0] - palette[k][0];
+            float dg = points[i][1] - palette[k][1];
+            float db = points[i][2] - palette[k][2];
+            float distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                bestIndex = k;
+            }
+        }
+        indices[i] = (uint8_t)bestIndex;
+        error += bestDistance;
+    }
+    return error;
+}
+
+// LSB 부터 채우는 128bit writer / reader
+struct BlockBits {
+    uint64_t bits[2] { 0, 0 };
+    int position { 0 };
+
+    void Write(uint32_t value, int count) {
+        for (int i = 0; i < count; i++, position++)
+            bits[position >> 6] |= (uint64_t)((value >> i) & 1) << (position & 63);
+    }
+    uint32_t Read(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++, position++)
+            value |= (uint32_t)((bits[position >> 6] >> (position & 63)) & 1) << i;
+        return value;
+    }
+};
+
+static void EncodeBC6HBlock(const float colors[16][3], bool highQuality, uint8_t* out) {
+    // half float 의 bit 를 정수로 본 공간 (log 에 가까워서 HDR 오차를 고르게 본다)
+    float points[16][3];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            float value = colors[i][c];
+            value = value > 0.0f ? value : 0.0f;    // 음수, NaN 은 0
+            points[i][c] = (float)std::min((int)glm::packHalf1x16(value), BC6H_MAX_HALF);
+        }
+    }
+
+    float e0[3], e1[3];
+    ComputePrincipalEndpoints(points, e0, e1);
+    int q0[3], q1[3];
+    uint8_t indices[16];
+    float error = EncodeBC6HEndpoints(points, e0, e1, q0, q1, indices);
+    if (highQuality && error > 0.0f) {
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = 1.0f - BC6H_WEIGHTS[indices[i]] / 64.0f;
+        if (RefitEndpoints(points, weights, e0, e1)) {
+            int refitQ0[3], refitQ1[3];
+            uint8_t refitIndices[16];
+            float refitError = EncodeBC6HEndpoints(points, e0, e1, refitQ0, refitQ1, refitIndices);
+            if (refitError < error) {
+                memcpy(q0, refitQ0, sizeof(q0[0]) * 3);
+                memcpy(q1, refitQ1, sizeof(q1[0]) * 3);
+                memcpy(indices, refitIndices, sizeof(indices));
+            }
+        }
+    }
+
+    // 첫 pixel 의 index 는 최상위 bit 를 생략하므로 8 보다 작아야 한다
+    if (indices[0] >= 8) {
+        for (int c = 0; c < 3; c++)
+            std::swap(q0[c], q1[c]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = (uint8_t)(15 - indices[i]);
+    }
+
+    BlockBits block;
+    block.Write(0x03, 5);
+    for (int c = 0; c < 3; c++)
+        block.Write(q0[c], 10);
+    for (int c = 0; c < 3; c++)
+        block.Write(q1[c], 10);
+    block.Write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        block.Write(indices[i], 4);
+    memcpy(out, block.bits, 16);
+}
+
+static bool DecodeBC6HBlock(const uint8_t* in, float colors[16][3]) {
+    BlockBits block;
+    memcpy(block.bits, in, 16);
+    if (block.Read(5) != 0x03) {
+        memset(colors, 0, sizeof(float) * 48);
+        return false;
+    }
+    int q0[3], q1[3];
+    for (int c = 0; c < 3; c++)
+        q0[c] = (int)block.Read(10);
+    for (int c = 0; c < 3; c++)
+        q1[c] = (int)block.Read(10);
+    float palette[16][3];
+    BuildBC6HPalette(q0, q1, palette);
+    for (int i = 0; i < 16; i++) {
+        int index = (int)block.Read(i == 0 ? 3 : 4);
+        for (int c = 0; c < 3; c++)
+            colors[i][c] = glm::unpackHalf1x16((uint16_t)palette[index][c]);
+    }
+    return true;
+}
+
+// ----- image 단위 처리 -----
+
+static void CompressLevel(const Image* image, const BlockCompressionOption& option,
+    uint8_t* dst, ThreadPool* threadPool) {
+    int blockCountX = (image->GetWidth() + 3) / 4;
+    int blockCountY = (image->GetHeight() + 3) / 4;
+    size_t blockSize = GetBlockByteSize(option.format);
+    threadPool->ParallelFor(blockCountY, [&](size_t begin, size_t end) {
+        for (size_t blockY = begin; blockY < end; blockY++) {
+            uint8_t* out = dst + blockY * blockCountX * blockSize;
+            for (int blockX = 0; blockX < blockCountX; blockX++, out += blockSize) {
+                if (option.format == BlockFormat::BC6H) {
+                    float colors[16][3];
+                    FetchBlockFloat(image, blockX, (int)blockY, colors);
+                    EncodeBC6HBlock(colors, option.highQuality, out);
+                    continue;
+                }
+                uint8_t rgba[64];
+                FetchBlockRGBA8(image, blockX, (int)blockY, rgba);
+                switch (option.format) {
+                    default:
+                    case BlockFormat::BC1:
+                        EncodeColorBlock(rgba, option.highQuality, out);
+                        break;
+                    case BlockFormat::BC3:
+                        EncodeAlphaBlock(rgba + 3, 4, out);
+                        EncodeColorBlock(rgba, option.highQuality, out + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        EncodeAlphaBlock(rgba, 4, out);
+                        break;
+                    case BlockFormat::BC5:
+                        EncodeAlphaBlock(rgba, 4, out);
+                        EncodeAlphaBlock(rgba + 1, 4, out + 8);
+                        break;
+                }
+            }
+        }
+    });
+}
+
+CompressedImageUPtr CompressImage(const Image* image, const BlockCompressionOption& option,
+    ThreadPool* threadPool) {
+    bool hdrImage = image->GetPixelType() != PixelType::UInt8;
+    bool hdrFormat = option.format == BlockFormat::BC6H;
+    if (hdrImage != hdrFormat) {
+        SPDLOG_ERROR("{} can not compress {} image", GetBlockFormatName(option.format),
+            hdrImage ? "hdr" : "8bit");
+        return nullptr;
+    }
+    // BC6H encoder 는 float 을 읽으므로 half / RGB9E5 는 한 번 풀어 둔다
+    ImageUPtr floatImage;
+    if (hdrImage && image->GetPixelType() != PixelType::Float) {
+        floatImage = image->ConvertToFloat();
+        if (!floatImage)
+            return nullptr;
+        image = floatImage.get();
+    }
+    if (!threadPool)
+        threadPool = ThreadPool::GetDefault();
+
+    int levelCount = 1;
+    if (option.generateMipmap) {
+        while ((std::max(image->GetWidth(), image->GetHeight()) >> levelCount) > 0)
+            levelCount++;
+    }
+    bool sRGB = option.sRGB &&
+        (option.format == BlockFormat::BC1 || option.format == BlockFormat::BC3);
+    auto result = CompressedImage::Create(option.format,
+        image->GetWidth(), image->GetHeight(), levelCount, sRGB);
+    if (!result)
+        return nullptr;
+
+    CompressLevel(image, option, result->GetData(0), threadPool);
+    if (levelCount > 1) {
+        // sRGB 로 저장하는 텍스처는 mip 도 linear 공간에서 filtering 해야 어두워지지 않는다
+        auto mipOption = option.mipOption;
+        mipOption.sRGB = sRGB;
+        auto mipLevels = image->GenerateMipChain(mipOption, threadPool);
+        if ((int)mipLevels.size() + 1 != levelCount)
+            return nullptr;
+        for (int level = 1; level < levelCount; level++)
+            CompressLevel(mipLevels[level - 1].get(), option, result->GetData(level), threadPool);
+    }
+    return std::move(result);
+}
+
+ImageUPtr DecompressImage(const CompressedImage* image, int level) {
+    int width = image->GetWidth(level);
+    int height = image->GetHeight(level);
+    bool hdr = image->GetFormat() == BlockFormat::BC6H;
+    auto result = hdr ? Image::Create(width, height, 3, 4) : Image::Create(width, height, 4, 1);
+    if (!result)
+        return nullptr;
+
+    int blockCountX = (width + 3) / 4;
+    int blockCountY = (height + 3) / 4;
+    size_t blockSize = GetBlockByteSize(image->GetFormat());
+    const uint8_t* in = image->GetData(level);
+    bool unknownBlock = false;
+    for (int blockY = 0; blockY < blockCountY; blockY++) {
+        for (int blockX = 0; blockX < blockCountX; blockX++, in += blockSize) {
+            uint8_t rgba[64];
+            float colors[16][3];
+            switch (image->GetFormat()) {
+                case BlockFormat::BC1:
+                    DecodeColorBlock(in, false, rgba);
+                    break;
+                case BlockFormat::BC3:
+                    DecodeColorBlock(in + 8, true, rgba);
+                    DecodeAlphaBlock(in, rgba + 3, 4);
+                    break;
+                case BlockFormat::BC4:
+                    memset(rgba, 255, sizeof(rgba));
+                    DecodeAlphaBlock(in, rgba, 4);
+                    for (int i = 0; i < 16; i++)
+                        rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+                    break;
+                case BlockFormat::BC5:
+                    memset(rgba, 255, sizeof(rgba));
+                    DecodeAlphaBlock(in, rgba, 4);
+                    DecodeAlphaBlock(in + 8, rgba + 1, 4);
+                    for (int i = 0; i < 16; i++)
+                        rgba[i * 4 + 2] = 0;
+                    break;
+                case BlockFormat::BC6H:
+                    if (!DecodeBC6HBlock(in, colors))
+                        unknownBlock = true;
+                    break;
+            }
+            for (int y = 0; y < 4 && blockY * 4 + y < height; y++) {
+                for (int x = 0; x < 4 && blockX * 4 + x < width; x++) {
+                    size_t pixel = (size_t)(blockY * 4 + y) * width + blockX * 4 + x;
+                    if (hdr)
+                        memcpy((float*)result->GetData() + pixel * 3, colors[y * 4 + x], sizeof(float) * 3);
+                    else
+                        memcpy(result->GetData() + pixel * 4, rgba + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+    if (unknownBlock)
+        SPDLOG_WARN("BC6H blocks other than mode 11 are decoded as black");
+    return std::move(result);
+}
+
+float ComputePSNR(const Image* reference, const Image* test, int channelCount) {
+    if (reference->GetWidth() != test->GetWidth() || reference->GetHeight() != test->GetHeight() ||
+        reference->GetPixelType() != test->GetPixelType() ||
+        (reference->GetPixelType() != PixelType::UInt8 && reference->GetPixelType() != PixelType::Float)) {
+        SPDLOG_ERROR("can not compare images of different size or type");
+        return 0.0f;
+    }
+    channelCount = std::min(channelCount,
+        std::min(reference->GetChannelCount(), test->GetChannelCount()));
+    size_t pixelCount = (size_t)reference->GetWidth() * reference->GetHeight();
+    bool hdr = reference->GetPixelType() == PixelType::Float;
+    double sum = 0.0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        for (int c = 0; c < channelCount; c++) {
+            size_t refIndex = i * reference->GetChannelCount() + c;
+            size_t testIndex = i * test->GetChannelCount() + c;
+            double diff;
+            if (hdr) {
+                float a = std::max(((const float*)reference->GetData())[refIndex], 0.0f);
+                float b = std::max(((const float*)test->GetData())[testIndex], 0.0f);
+                diff = a / (1.0 + a) - b / (1.0 + b);
+            }
+            else {
+                diff = ((int)reference->GetData()[refIndex] - (int)test->GetData()[testIndex]) / 255.0;
+            }
+            sum += diff * diff;
+        }
+    }
+    double mse = sum / (double)(pixelCount * channelCount);
+    if (mse <= 0.0)
+        return 99.0f;
+    return (float)(10.0 * std::log10(1.0 / mse));
+}
+
+bool RunCompressionBenchmark(const std::string& filepath, ThreadPool* threadPool) {
+    auto image = Image::Load(filepath, false);
+    if (!image)
+        return false;
+    // PSNR 은 BC6H decoder 결과와 같은 float 으로 비교한다
+    if (image->GetPixelType() == PixelType::Half || image->GetPixelType() == PixelType::RGB9E5) {
+        image = image->ConvertToFloat();
+        if (!image)
+            return false;
+    }
+    if (!threadPool)
+        threadPool = ThreadPool::GetDefault();
+
+    struct Case {
+        BlockFormat format;
+        int channelCount;
+    };
+    std::vector<Case> cases;
+    if (image->GetPixelType() == PixelType::Float) {
+        cases.push_back({ BlockFormat::BC6H, 3 });
+    }
+    else {
+        cases.push_back({ BlockFormat::BC1, 3 });
+        cases.push_back({ BlockFormat::BC3, 4 });
+        cases.push_back({ BlockFormat::BC4, 1 });
+        cases.push_back({ BlockFormat::BC5, 2 });
+    }
+
+    size_t pixelCount = (size_t)image->GetWidth() * image->GetHeight();
+    size_t sourceSize = pixelCount * image->GetPixelSize();
+    SPDLOG_INFO("compression benchmark: {} ({}x{}, {} channels, {} threads)",
+        filepath, image->GetWidth(), image->GetHeight(), image->GetChannelCount(),
+        threadPool->GetThreadCount() + 1);
+    for (auto& benchCase: cases) {
+        for (bool highQuality: { false, true }) {
+            BlockCompressionOption option;
+            option.format = benchCase.format;
+            option.generateMipmap = false;
+            option.highQuality = highQuality;
+            auto startTime = std::chrono::steady_clock::now();
+            auto compressed = CompressImage(image.get(), option, threadPool);
+            float elapsed = std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - startTime).count();
+            if (!compressed)
+                return false;
+            auto decoded = DecompressImage(compressed.get());
+            if (!decoded)
+                return false;
+            SPDLOG_INFO("  {} {:7}: PSNR {:6.2f} dB, {:8.1f} ms, {:7.2f} Mpixel/s, {:.1f}:1",
+                GetBlockFormatName(benchCase.format), highQuality ? "quality" : "fast",
+                ComputePSNR(image.get(), decoded.get(), benchCase.channelCount), elapsed,
+                pixelCount / (elapsed * 1000.0f),
+                (float)sourceSize / (float)compressed->GetDataSize());
+        }
+    }
+    return true;
+}
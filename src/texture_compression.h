@@ -0,0 +1,35 @@
+#ifndef __TEXTURE_COMPRESSION_H__
+#define __TEXTURE_COMPRESSION_H__
+
+#include "common.h"
+#include "image.h"
+#include "thread_pool.h"
+
+struct BlockCompressionOption {
+    BlockFormat format { BlockFormat::BC1 };
+    // BC1 / BC3 만 해당, GL 에서 sRGB format 으로 올린다
+    bool sRGB { false };
+    bool generateMipmap { true };
+    // mip level 생성 방식, sRGB 는 위의 sRGB 를 따른다
+    MipChainOption mipOption;
+    // index 를 정한 뒤 endpoint 를 least squares 로 한 번 더 맞춘다 (약 2배 느림)
+    bool highQuality { true };
+};
+
+// 8bit 이미지는 BC1/3/4/5, float / half / RGB9E5 이미지는 BC6H 로 압축한다
+// 4x4 block 행 단위로 threadPool 에 나눠서 처리한다 (nullptr 이면 ThreadPool::GetDefault())
+CompressedImageUPtr CompressImage(const Image* image, const BlockCompressionOption& option,
+    ThreadPool* threadPool = nullptr);
+
+// 품질 측정용 decoder. BC1~5 는 RGBA8, BC6H 는 RGB float 이미지를 돌려준다
+// BC6H 는 CompressImage 가 만드는 mode 11 block 만 풀 수 있다
+ImageUPtr DecompressImage(const CompressedImage* image, int level = 0);
+
+// 두 이미지의 앞쪽 channelCount 개 channel 로 계산한 PSNR (dB)
+// float 이미지는 Reinhard tone mapping 으로 [0, 1] 에 넣은 뒤 비교한다
+float ComputePSNR(const Image* reference, const Image* test, int channelCount);
+
+// format / 품질 설정별로 압축해 보고 PSNR, 처리량, 압축률을 log 로 남긴다
+bool RunCompressionBenchmark(const std::string& filepath, ThreadPool* threadPool = nullptr);
+
+#endif // __TEXTURE_COMPRESSION_H__
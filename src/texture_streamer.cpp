@@ -0,0 +1,208 @@
+#include "texture_streamer.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstring>
+
+TextureStreamerUPtr TextureStreamer::Create(size_t frameBudget,
+    uint32_t bufferCount, size_t bufferSize, ThreadPool* threadPool) {
+    auto streamer = TextureStreamerUPtr(new TextureStreamer());
+    if (!streamer->Init(frameBudget, bufferCount, bufferSize, threadPool))
+        return nullptr;
+    return std::move(streamer);
+}
+
+TextureStreamer::~TextureStreamer() {
+    for (auto& pixelBuffer: m_buffers) {
+        if (pixelBuffer.fence)
+            glDeleteSync(pixelBuffer.fence);
+        if (pixelBuffer.buffer)
+            glDeleteBuffers(1, &pixelBuffer.buffer);
+    }
+}
+
+bool TextureStreamer::Init(size_t frameBudget, uint32_t bufferCount, size_t bufferSize,
+    ThreadPool* threadPool) {
+    if (bufferCount == 0 || bufferSize == 0) {
+        SPDLOG_ERROR("texture streamer needs at least one pixel buffer");
+        return false;
+    }
+    m_threadPool = threadPool ? threadPool : ThreadPool::GetDefault();
+    m_frameBudget = frameBudget;
+    m_buffers.resize(bufferCount);
+    for (auto& pixelBuffer: m_buffers) {
+        glGenBuffers(1, &pixelBuffer.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, GL_STREAM_DRAW);
+        pixelBuffer.size = bufferSize;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_windowStart = std::chrono::steady_clock::now();
+    return true;
+}
+
+TexturePtr TextureStreamer::Load(const std::string& filepath,
+    const TextureLoadOption& option, const glm::vec4& placeholderColor) {
+    auto textureCache = TextureCache::Get();
+    auto texture = textureCache->Find(filepath, option);
+    if (texture)
+        return texture;
+
+    auto placeholder = Image::CreateSingleColorImage(1, 1, placeholderColor);
+    texture = Texture::CreateFromImage(placeholder.get(), false, false);
+    textureCache->Insert(filepath, option, texture);
+
+    Request request;
+    request.target = texture;
+    request.option = option;
+    request.levels = m_threadPool->Submit([filepath, option]() {
+        return LoadImageLevels(filepath, option);
+    });
+    m_requests.push_back(std::move(request));
+    return texture;
+}
+
+void TextureStreamer::Update() {
+    PROFILE_SCOPE("TextureStreamer::Update");
+    auto startTime = std::chrono::steady_clock::now();
+
+    // decode 가 끝난 요청을 upload 대기열로 옮긴다
+    for (auto& request: m_requests) {
+        if (request.levels.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+        auto levels = request.levels.get();
+        if (levels.empty()) {
+            m_stats.failedCount++;
+            continue;
+        }
+        // 그 사이 텍스처를 쓰는 곳이 모두 사라졌으면 올릴 필요가 없다
+        if (request.target.expired())
+            continue;
+        Upload upload;
+        upload.target = request.target;
+        upload.option = request.option;
+        upload.format = GetImageTextureFormat(levels[0].get(), request.option.sRGB);
+        upload.levels = std::move(levels);
+        m_uploads.push_back(std::move(upload));
+    }
+    m_requests.erase(std::remove_if(m_requests.begin(), m_requests.end(),
+        [](const Request& request) { return !request.levels.valid(); }),
+        m_requests.end());
+
+    size_t budget = m_frameBudget;
+    size_t frameBytes = 0;
+    while (!m_uploads.empty() && budget > 0) {
+        auto& upload = m_uploads.front();
+        if (upload.target.expired()) {
+            m_uploads.pop_front();
+            continue;
+        }
+        size_t uploadBytes = UploadRows(upload, budget);
+        if (uploadBytes == 0) {
+            m_stats.stallCount++;
+            break;
+        }
+        frameBytes += uploadBytes;
+        budget -= std::min(budget, uploadBytes);
+        if (upload.level >= (int)upload.levels.size()) {
+            FinishUpload(upload);
+            m_uploads.pop_front();
+        }
+    }
+
+    m_stats.pendingDecodeCount = (uint32_t)m_requests.size();
+    m_stats.pendingUploadCount = (uint32_t)m_uploads.size();
+    m_stats.frameUploadBytes = frameBytes;
+    m_stats.totalUploadBytes += frameBytes;
+    auto endTime = std::chrono::steady_clock::now();
+    m_stats.updateTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+    m_windowBytes += frameBytes;
+    float windowTime = std::chrono::duration<float>(endTime - m_windowStart).count();
+    if (windowTime >= 1.0f) {
+        m_stats.uploadThroughput = (float)m_windowBytes / (1024.0f * 1024.0f) / windowTime;
+        m_windowBytes = 0;
+        m_windowStart = endTime;
+    }
+    PROFILE_COUNTER("texture upload KB", frameBytes / 1024);
+}
+
+size_t TextureStreamer::UploadRows(Upload& upload, size_t budget) {
+    // ring 의 다음 buffer 를 GPU 가 다 읽기 전에는 기다리지 않고 다음 frame 으로 넘긴다
+    auto& pixelBuffer = m_buffers[m_nextBuffer];
+    if (pixelBuffer.fence) {
+        auto status = glClientWaitSync(pixelBuffer.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            return 0;
+        glDeleteSync(pixelBuffer.fence);
+        pixelBuffer.fence = nullptr;
+    }
+
+    if (!upload.staging) {
+        upload.staging = Texture::Create(upload.levels[0]->GetWidth(), upload.levels[0]->GetHeight(),
+            upload.format.internalFormat, upload.format.type);
+        // 나머지 level 의 storage 도 미리 잡아 둔다
+        for (size_t level = 1; level < upload.levels.size(); level++) {
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, upload.format.internalFormat,
+                upload.levels[level]->GetWidth(), upload.levels[level]->GetHeight(), 0,
+                upload.format.format, upload.format.type, nullptr);
+        }
+    }
+
+    auto image = upload.levels[upload.level].get();
+    size_t rowSize = image->GetRowSize();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+    // 한 줄이 buffer 보다 크면 buffer 를 키운다 (fence 를 지났으므로 안전)
+    if (rowSize > pixelBuffer.size) {
+        pixelBuffer.size = rowSize;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.size, nullptr, GL_STREAM_DRAW);
+    }
+
+    // 예산이 한 줄보다 작아도 최소 한 줄은 올려야 진행된다
+    int remainRows = image->GetHeight() - upload.nextRow;
+    size_t maxBytes = std::min(pixelBuffer.size, budget);
+    int rowCount = std::min(remainRows, std::max(1, (int)(maxBytes / rowSize)));
+    size_t size = rowSize * rowCount;
+
+    auto dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!dst) {
+        SPDLOG_ERROR("failed to map pixel buffer for texture upload");
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return 0;
+    }
+    memcpy(dst, image->GetData() + rowSize * upload.nextRow, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    upload.staging->Bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.nextRow,
+        image->GetWidth(), rowCount,
+        upload.format.format, upload.format.type, (const void*)0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    m_nextBuffer = (m_nextBuffer + 1) % (uint32_t)m_buffers.size();
+    upload.nextRow += rowCount;
+    if (upload.nextRow >= image->GetHeight()) {
+        upload.level++;
+        upload.nextRow = 0;
+    }
+    return size;
+}
+
+void TextureStreamer::FinishUpload(Upload& upload) {
+    upload.staging->Bind();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)upload.levels.size() - 1);
+    if (upload.levels.size() > 1)
+        upload.staging->SetFilter(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    else
+        upload.staging->SetFilter(GL_LINEAR, GL_LINEAR);
+    // placeholder 를 쓰던 곳이 그대로 새 텍스처를 보게 된다
+    // placeholder 의 GL 객체는 staging 과 함께 해제된다
+    if (auto target = upload.target.lock())
+        target->Swap(*upload.staging);
+    upload.staging.reset();
+    upload.levels.clear();
+    m_stats.completedCount++;
+}
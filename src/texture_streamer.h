@@ -0,0 +1,92 @@
+#ifndef __TEXTURE_STREAMER_H__
+#define __TEXTURE_STREAMER_H__
+
+#include "texture.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+#include <deque>
+#include <chrono>
+
+struct TextureStreamerStats {
+    uint32_t pendingDecodeCount { 0 };
+    uint32_t pendingUploadCount { 0 };
+    uint32_t completedCount { 0 };
+    uint32_t failedCount { 0 };
+    // PBO 를 GPU 가 아직 읽는 중이라 남은 upload 를 다음 frame 으로 미룬 횟수
+    uint32_t stallCount { 0 };
+    uint64_t frameUploadBytes { 0 };
+    uint64_t totalUploadBytes { 0 };
+    float uploadThroughput { 0.0f };    // MB/s, 최근 1초 평균
+    float updateTime { 0.0f };          // ms
+};
+
+// 이미지 decode 와 mip chain 생성은 worker thread 에서, GL upload 는 pixel buffer object ring 을 거쳐
+// frame 마다 정해진 byte 만큼만 나눠서 한다
+// Load 는 placeholder 텍스처를 바로 돌려주고, upload 가 끝나면 같은 Texture 객체의
+// 내용을 교체하므로 material 등에 미리 연결해 둘 수 있다
+// GL 을 쓰므로 Load / Update 는 GL context thread 에서만 부른다
+CLASS_PTR(TextureStreamer)
+class TextureStreamer {
+public:
+    // threadPool 이 nullptr 이면 ThreadPool::GetDefault() 를 쓴다
+    static TextureStreamerUPtr Create(size_t frameBudget = 8 << 20,
+        uint32_t bufferCount = 3, size_t bufferSize = 4 << 20,
+        ThreadPool* threadPool = nullptr);
+    ~TextureStreamer();
+
+    // 같은 파일 + 옵션은 TextureCache 를 통해 공유한다
+    TexturePtr Load(const std::string& filepath, const TextureLoadOption& option = {},
+        const glm::vec4& placeholderColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    // frame 마다 한 번 불러서 decode 가 끝난 이미지를 예산만큼 올린다
+    void Update();
+
+    void SetFrameBudget(size_t bytes) { m_frameBudget = bytes; }
+    size_t GetFrameBudget() const { return m_frameBudget; }
+    bool IsIdle() const { return m_requests.empty() && m_uploads.empty(); }
+    const TextureStreamerStats& GetStats() const { return m_stats; }
+
+private:
+    TextureStreamer() {}
+    bool Init(size_t frameBudget, uint32_t bufferCount, size_t bufferSize,
+        ThreadPool* threadPool);
+
+    struct Request {
+        TextureWPtr target;
+        TextureLoadOption option;
+        // [0] 이 원본, 나머지는 mip level
+        std::future<std::vector<ImageUPtr>> levels;
+    };
+    struct Upload {
+        TextureWPtr target;
+        TextureLoadOption option;
+        std::vector<ImageUPtr> levels;
+        ImageTextureFormat format;
+        // 모든 level 을 받는 텍스처, 다 올라가면 target 과 맞바꾼다
+        TextureUPtr staging;
+        int level { 0 };
+        int nextRow { 0 };
+    };
+    struct PixelBuffer {
+        uint32_t buffer { 0 };
+        size_t size { 0 };
+        // 이 buffer 를 읽는 glTexSubImage2D 뒤에 넣은 fence
+        GLsync fence { nullptr };
+    };
+
+    // upload 할 수 있으면 올린 byte 수, PBO 가 아직 사용 중이면 0
+    size_t UploadRows(Upload& upload, size_t budget);
+    void FinishUpload(Upload& upload);
+
+    ThreadPool* m_threadPool { nullptr };
+    size_t m_frameBudget { 0 };
+    std::vector<Request> m_requests;
+    std::deque<Upload> m_uploads;
+    std::vector<PixelBuffer> m_buffers;
+    uint32_t m_nextBuffer { 0 };
+
+    TextureStreamerStats m_stats;
+    uint64_t m_windowBytes { 0 };
+    std::chrono::steady_clock::time_point m_windowStart;
+};
+
+#endif // __TEXTURE_STREAMER_H__
@@ -0,0 +1,96 @@
+#include "thread_pool.h"
+#include <atomic>
+
+ThreadPoolUPtr ThreadPool::Create(uint32_t threadCount) {
+    auto threadPool = ThreadPoolUPtr(new ThreadPool());
+    threadPool->Init(threadCount);
+    return std::move(threadPool);
+}
+
+ThreadPool* ThreadPool::GetDefault() {
+    static ThreadPoolUPtr defaultThreadPool = Create();
+    return defaultThreadPool.get();
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& thread: m_threads)
+        thread.join();
+}
+
+void ThreadPool::Init(uint32_t threadCount) {
+    if (threadCount == 0) {
+        uint32_t hardwareThreadCount = std::thread::hardware_concurrency();
+        threadCount = hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 1;
+    }
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_threads.emplace_back([this]() { WorkerLoop(); });
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count,
+    const std::function<void(size_t begin, size_t end)>& func,
+    size_t batchSize) {
+    if (count == 0)
+        return;
+    batchSize = std::max<size_t>(batchSize, 1);
+    size_t batchCount = (count + batchSize - 1) / batchSize;
+    if (batchCount == 1) {
+        func(0, count);
+        return;
+    }
+
+    // 늦게 시작한 worker 가 함수 종료 후에 state 를 건드릴 수 있어서 shared_ptr 로 잡는다
+    struct State {
+        std::atomic<size_t> nextBatch { 0 };
+        std::atomic<size_t> doneBatch { 0 };
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<State>();
+    auto runBatches = [state, &func, count, batchSize, batchCount]() {
+        size_t batch;
+        while ((batch = state->nextBatch.fetch_add(1)) < batchCount) {
+            size_t begin = batch * batchSize;
+            func(begin, std::min(begin + batchSize, count));
+            if (state->doneBatch.fetch_add(1) + 1 == batchCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_all();
+            }
+        }
+    };
+
+    size_t helperCount = std::min<size_t>(m_threads.size(), batchCount - 1);
+    for (size_t i = 0; i < helperCount; i++)
+        Enqueue(runBatches);
+    runBatches();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&]() { return state->doneBatch.load() == batchCount; });
+}
@@ -0,0 +1,53 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include "common.h"
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+
+CLASS_PTR(ThreadPool)
+class ThreadPool {
+public:
+    // threadCount 가 0 이면 hardware thread 수 - 1 만큼 만든다 (호출 thread 도 일을 하므로)
+    static ThreadPoolUPtr Create(uint32_t threadCount = 0);
+    // 프로그램 전체에서 같이 쓰는 pool
+    static ThreadPool* GetDefault();
+    ~ThreadPool();
+
+    uint32_t GetThreadCount() const { return (uint32_t)m_threads.size(); }
+
+    template <typename F>
+    auto Submit(F&& task) -> std::future<decltype(task())> {
+        using ResultType = decltype(task());
+        auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(
+            std::forward<F>(task));
+        auto future = packagedTask->get_future();
+        Enqueue([packagedTask]() { (*packagedTask)(); });
+        return future;
+    }
+
+    // [0, count) 범위를 batchSize 단위로 나눠 worker 와 호출 thread 가 같이 처리하고
+    // 모두 끝날 때까지 기다린다. worker 안에서 다시 호출해도 deadlock 이 생기지 않는다
+    void ParallelFor(size_t count,
+        const std::function<void(size_t begin, size_t end)>& func,
+        size_t batchSize = 1);
+
+private:
+    ThreadPool() {}
+    void Init(uint32_t threadCount);
+    void Enqueue(std::function<void()> task);
+    void WorkerLoop();
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop { false };
+};
+
+#endif // __THREAD_POOL_H__
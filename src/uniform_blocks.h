@@ -0,0 +1,72 @@
+#ifndef __UNIFORM_BLOCKS_H__
+#define __UNIFORM_BLOCKS_H__
+
+#include "common.h"
+#include <cstddef>
+#include <string_view>
+
+// 여러 program 이 같이 쓰는 std140 uniform block
+// shader 쪽 선언 (pbr*.fs, pbr_instanced*.vs, defer_light.fs) 과 layout 이 정확히 같아야 한다
+
+enum UniformBlockBinding : uint32_t {
+    UNIFORM_BINDING_CAMERA = 0,
+    UNIFORM_BINDING_LIGHTS = 1,
+};
+
+// layout (std140) uniform Camera
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewPos;          // xyz 만 사용
+};
+
+// shader 의 MAX_LIGHT_COUNT 와 같아야 한다
+// GL 3.3 이 보장하는 최소 block 크기 16KB 안에 들어가도록 잡는다
+const size_t MAX_LIGHT_COUNT = 256;
+
+struct LightData {
+    glm::vec4 position;         // xyz 만 사용
+    glm::vec4 color;            // rgb 만 사용
+};
+
+// layout (std140) uniform Lights
+struct LightBlock {
+    LightData lights[MAX_LIGHT_COUNT];
+    int32_t lightCount;
+    int32_t padding[3];
+};
+
+// std140: mat4 는 vec4 4개, vec4 는 16 byte 정렬, 구조체 배열 원소는 16 byte 배수
+static_assert(sizeof(glm::mat4) == 64, "glm::mat4 must be tightly packed");
+static_assert(sizeof(glm::vec4) == 16, "glm::vec4 must be tightly packed");
+static_assert(offsetof(CameraBlock, view) == 0, "std140 mismatch: Camera.view");
+static_assert(offsetof(CameraBlock, projection) == 64, "std140 mismatch: Camera.projection");
+static_assert(offsetof(CameraBlock, viewProjection) == 128, "std140 mismatch: Camera.viewProjection");
+static_assert(offsetof(CameraBlock, viewPos) == 192, "std140 mismatch: Camera.viewPos");
+static_assert(sizeof(CameraBlock) == 208, "std140 mismatch: Camera size");
+static_assert(sizeof(LightData) == 32, "std140 mismatch: Light stride");
+static_assert(offsetof(LightData, color) == 16, "std140 mismatch: Light.color");
+static_assert(offsetof(LightBlock, lightCount) == MAX_LIGHT_COUNT * 32, "std140 mismatch: Lights.lightCount");
+static_assert(sizeof(LightBlock) % 16 == 0, "std140 mismatch: Lights size");
+static_assert(sizeof(LightBlock) <= 16384, "Lights block exceeds GL_MAX_UNIFORM_BLOCK_SIZE minimum");
+
+// shader 의 block 이름 -> 고정 binding point, 모르는 이름이면 -1
+inline int GetUniformBlockBinding(std::string_view blockName) {
+    if (blockName == "Camera")
+        return UNIFORM_BINDING_CAMERA;
+    if (blockName == "Lights")
+        return UNIFORM_BINDING_LIGHTS;
+    return -1;
+}
+
+// binding point 별 C++ 구조체 크기, program link 시 GL 이 계산한 크기와 비교한다
+inline size_t GetUniformBlockSize(int binding) {
+    switch (binding) {
+    case UNIFORM_BINDING_CAMERA: return sizeof(CameraBlock);
+    case UNIFORM_BINDING_LIGHTS: return sizeof(LightBlock);
+    default: return 0;
+    }
+}
+
+#endif // __UNIFORM_BLOCKS_H__
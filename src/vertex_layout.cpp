@@ -1,4 +1,5 @@
 #include "vertex_layout.h"
+#include "render_state.h"
 
 VertexLayoutUPtr VertexLayout::Create() {
     auto vertexLayout = VertexLayoutUPtr(new VertexLayout());
@@ -9,11 +10,12 @@ VertexLayoutUPtr VertexLayout::Create() {
 VertexLayout::~VertexLayout() {
     if (m_vertexArrayObject) {
         glDeleteVertexArrays(1, &m_vertexArrayObject);
+        RenderState::Get()->OnVertexArrayDeleted(m_vertexArrayObject);
     }
 }
 
 void VertexLayout::Bind() const {
-    glBindVertexArray(m_vertexArrayObject);
+    RenderState::Get()->BindVertexArray(m_vertexArrayObject);
 }
 
 void VertexLayout::SetAttrib(
@@ -26,6 +28,10 @@ void VertexLayout::SetAttrib(
         type, normalized, stride, (const void*)offset);
 }
 
+void VertexLayout::SetAttribDivisor(uint32_t attribIndex, uint32_t divisor) const {
+    glVertexAttribDivisor(attribIndex, divisor);
+}
+
 void VertexLayout::Init() {
     glGenVertexArrays(1, &m_vertexArrayObject);
     Bind();
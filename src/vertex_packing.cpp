@@ -0,0 +1,197 @@
+#include "vertex_packing.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+glm::vec2 EncodeOctahedral(const glm::vec3& v) {
+	float sum = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (sum == 0.0f)
+		return glm::vec2(0.0f, 0.0f);
+	glm::vec2 e(v.x / sum, v.y / sum);
+	// 아래쪽 반구는 대각선 기준으로 접어서 바깥 삼각형에 넣는다
+	if (v.z < 0.0f) {
+		e = glm::vec2(
+			(1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return e;
+}
+
+glm::vec3 DecodeOctahedral(const glm::vec2& e) {
+	glm::vec3 v(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	if (v.z < 0.0f) {
+		float x = v.x;
+		v.x = (1.0f - fabsf(v.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		v.y = (1.0f - fabsf(x)) * (v.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return glm::normalize(v);
+}
+
+static int16_t PackSnorm16(float value) {
+	return (int16_t)roundf(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+static float UnpackSnorm16(int16_t value) {
+	return std::max((float)value / 32767.0f, -1.0f);
+}
+
+static uint16_t PackUnorm16(float value) {
+	return (uint16_t)roundf(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f);
+}
+
+void PackVertices(const Vertex* vertices, size_t vertexCount,
+	std::vector<PackedVertex>& packedVertices,
+	glm::vec3& positionOffset, glm::vec3& positionScale) {
+	glm::vec3 boundsMin(0.0f);
+	glm::vec3 boundsMax(0.0f);
+	if (vertexCount > 0) {
+		boundsMin = boundsMax = vertices[0].position;
+		for (size_t i = 1; i < vertexCount; i++) {
+			boundsMin = glm::min(boundsMin, vertices[i].position);
+			boundsMax = glm::max(boundsMax, vertices[i].position);
+		}
+	}
+	positionOffset = boundsMin;
+	positionScale = boundsMax - boundsMin;
+
+	packedVertices.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		auto& v = vertices[i];
+		auto& p = packedVertices[i];
+		for (int k = 0; k < 3; k++) {
+			p.position[k] = positionScale[k] > 0.0f ?
+				PackUnorm16((v.position[k] - boundsMin[k]) / positionScale[k]) : 0;
+		}
+		p.position[3] = v.tangent.w < 0.0f ? 65535 : 0;
+
+		auto normal = EncodeOctahedral(v.normal);
+		p.normal[0] = PackSnorm16(normal.x);
+		p.normal[1] = PackSnorm16(normal.y);
+		auto tangent = EncodeOctahedral(glm::vec3(v.tangent));
+		p.tangent[0] = PackSnorm16(tangent.x);
+		p.tangent[1] = PackSnorm16(tangent.y);
+
+		p.texCoord[0] = glm::packHalf1x16(v.texCoord.x);
+		p.texCoord[1] = glm::packHalf1x16(v.texCoord.y);
+	}
+}
+
+Vertex UnpackVertex(const PackedVertex& packedVertex,
+	const glm::vec3& positionOffset, const glm::vec3& positionScale) {
+	auto& p = packedVertex;
+	Vertex v;
+	v.position = positionOffset + positionScale * glm::vec3(
+		(float)p.position[0] / 65535.0f,
+		(float)p.position[1] / 65535.0f,
+		(float)p.position[2] / 65535.0f);
+	v.normal = DecodeOctahedral(glm::vec2(UnpackSnorm16(p.normal[0]), UnpackSnorm16(p.normal[1])));
+	v.tangent = glm::vec4(
+		DecodeOctahedral(glm::vec2(UnpackSnorm16(p.tangent[0]), UnpackSnorm16(p.tangent[1]))),
+		p.position[3] > 32767 ? -1.0f : 1.0f);
+	v.texCoord = glm::vec2(glm::unpackHalf1x16(p.texCoord[0]), glm::unpackHalf1x16(p.texCoord[1]));
+	return v;
+}
+
+VertexPackingError MeasureVertexPackingError(const Vertex* vertices, size_t vertexCount) {
+	std::vector<PackedVertex> packedVertices;
+	glm::vec3 positionOffset, positionScale;
+	PackVertices(vertices, vertexCount, packedVertices, positionOffset, positionScale);
+
+	auto AngleBetween = [](const glm::vec3& a, const glm::vec3& b) -> float {
+		float lengths = glm::length(a) * glm::length(b);
+		if (lengths == 0.0f)
+			return 0.0f;
+		float cosine = std::min(std::max(glm::dot(a, b) / lengths, -1.0f), 1.0f);
+		return glm::degrees(acosf(cosine));
+	};
+
+	VertexPackingError error;
+	float diagonal = glm::length(positionScale);
+	for (size_t i = 0; i < vertexCount; i++) {
+		auto& v = vertices[i];
+		auto decoded = UnpackVertex(packedVertices[i], positionOffset, positionScale);
+		if (diagonal > 0.0f)
+			error.position = std::max(error.position,
+				glm::length(decoded.position - v.position) / diagonal);
+		error.normalAngle = std::max(error.normalAngle, AngleBetween(decoded.normal, v.normal));
+		// handedness 가 뒤집히면 bitangent 가 반대가 되므로 180 도로 친다
+		float tangentAngle = (decoded.tangent.w < 0.0f) != (v.tangent.w < 0.0f) ? 180.0f :
+			AngleBetween(glm::vec3(decoded.tangent), glm::vec3(v.tangent));
+		error.tangentAngle = std::max(error.tangentAngle, tangentAngle);
+		error.texCoord = std::max(error.texCoord, glm::length(decoded.texCoord - v.texCoord));
+	}
+	return error;
+}
+
+bool RunVertexPackingTest() {
+	bool success = true;
+	auto Check = [&](bool condition, const std::string& message) {
+		if (!condition) {
+			SPDLOG_ERROR("vertex packing test failed: {}", message);
+			success = false;
+		}
+	};
+	// position: unorm16 반올림 (축마다 0.5 / 65535), 방향: snorm16 octahedral
+	// uv: [-4, 4] 범위 half float 의 반올림 오차 (2^-10 * 4 / 2)
+	const float maxPositionError = 1.0e-5f;
+	const float maxAngleError = 0.01f;
+	const float maxTexCoordError = 2.0e-3f;
+
+	// 1. octahedral 경계: 축 방향과 z < 0 반구의 접힌 영역
+	std::vector<glm::vec3> directions = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		glm::normalize(glm::vec3(1, 1, -1)), glm::normalize(glm::vec3(-1, 1, -1)),
+		glm::normalize(glm::vec3(1, -1, -1e-4f)), glm::normalize(glm::vec3(-3, -1, -2)),
+	};
+	for (auto& direction: directions) {
+		auto decoded = DecodeOctahedral(EncodeOctahedral(direction));
+		Check(glm::length(decoded - direction) < 1e-5f,
+			fmt::format("octahedral ({}, {}, {}) -> ({}, {}, {})", direction.x, direction.y,
+				direction.z, decoded.x, decoded.y, decoded.z));
+	}
+
+	// 2. 임의의 vertex. 경계 방향도 섞고 handedness 는 절반씩
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto RandomDirection = [&]() {
+		glm::vec3 v;
+		do {
+			v = glm::vec3(unit(random), unit(random), unit(random));
+		} while (glm::length(v) < 0.1f || glm::length(v) > 1.0f);
+		return glm::normalize(v);
+	};
+	std::vector<Vertex> vertices(10000);
+	for (size_t i = 0; i < vertices.size(); i++) {
+		auto& v = vertices[i];
+		v.position = glm::vec3(unit(random) * 50.0f, unit(random) * 2.0f + 10.0f, unit(random) * 0.01f);
+		v.normal = i < directions.size() ? directions[i] : RandomDirection();
+		// tangent 는 normal 에 수직으로 만든다
+		auto tangent = glm::normalize(glm::cross(v.normal, RandomDirection()));
+		v.tangent = glm::vec4(tangent, i % 2 ? -1.0f : 1.0f);
+		v.texCoord = glm::vec2(unit(random) * 4.0f, unit(random));
+	}
+	auto error = MeasureVertexPackingError(vertices.data(), vertices.size());
+	Check(error.position <= maxPositionError,
+		fmt::format("position error {:.2e} > {:.2e}", error.position, maxPositionError));
+	Check(error.normalAngle <= maxAngleError,
+		fmt::format("normal error {:.4f} deg > {:.4f}", error.normalAngle, maxAngleError));
+	// handedness 가 뒤집히면 180 도가 나온다
+	Check(error.tangentAngle <= maxAngleError,
+		fmt::format("tangent error {:.4f} deg > {:.4f}", error.tangentAngle, maxAngleError));
+	Check(error.texCoord <= maxTexCoordError,
+		fmt::format("uv error {:.2e} > {:.2e}", error.texCoord, maxTexCoordError));
+
+	// 3. 모든 vertex 가 한 점에 있으면 bounding box 크기가 0 이어도 그 점으로 돌아와야 한다
+	std::vector<Vertex> flat(3, vertices[0]);
+	std::vector<PackedVertex> packed;
+	glm::vec3 positionOffset, positionScale;
+	PackVertices(flat.data(), flat.size(), packed, positionOffset, positionScale);
+	auto decoded = UnpackVertex(packed[0], positionOffset, positionScale);
+	Check(glm::length(decoded.position - flat[0].position) < 1e-4f, "degenerate bounding box");
+
+	SPDLOG_INFO("vertex packing test: {} vertices, max error: position {:.2e}, normal {:.4f} deg, "
+		"tangent {:.4f} deg, uv {:.2e}: {}", vertices.size(), error.position, error.normalAngle,
+		error.tangentAngle, error.texCoord, success ? "passed" : "FAILED");
+	return success;
+}
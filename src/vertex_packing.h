@@ -0,0 +1,44 @@
+#ifndef __VERTEX_PACKING_H__
+#define __VERTEX_PACKING_H__
+
+#include "common.h"
+#include "mesh.h"
+#include <vector>
+
+// Vertex (44 byte) 를 20 byte 로 줄인 layout
+// position: mesh bounding box 기준 unorm16 x 3 (w 는 tangent handedness, 0: +1, 65535: -1)
+// normal, tangent: octahedral encoding snorm16 x 2
+// texCoord: half float x 2
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t texCoord[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must be 20 bytes");
+
+// 단위 벡터 <-> [-1, 1]^2 octahedral 좌표
+glm::vec2 EncodeOctahedral(const glm::vec3& v);
+glm::vec3 DecodeOctahedral(const glm::vec2& e);
+
+// 디코딩: position = positionOffset + positionScale * unorm
+void PackVertices(const Vertex* vertices, size_t vertexCount,
+    std::vector<PackedVertex>& packedVertices,
+    glm::vec3& positionOffset, glm::vec3& positionScale);
+Vertex UnpackVertex(const PackedVertex& packedVertex,
+    const glm::vec3& positionOffset, const glm::vec3& positionScale);
+
+// encode -> decode 왕복 오차. position 은 bounding box 대각선 길이 대비 비율, 방향은 degree
+struct VertexPackingError {
+    float position { 0.0f };
+    float normalAngle { 0.0f };
+    float tangentAngle { 0.0f };
+    float texCoord { 0.0f };
+};
+VertexPackingError MeasureVertexPackingError(const Vertex* vertices, size_t vertexCount);
+
+// 임의의 vertex 와 경계 입력 (축 방향 / 남반구 normal, 크기가 0 인 bounding box, 음수 handedness) 을
+// 왕복시켜서 오차가 format 의 정밀도 안에 드는지 검사한다. 실패한 항목을 로그로 남기고 false
+bool RunVertexPackingTest();
+
+#endif // __VERTEX_PACKING_H__